@@ -184,6 +184,25 @@ check_c_source_compiles("
     }
 " JEMALLOC_HAVE_BUILTIN_FFS)
 
+# Per-function x86 SIMD targets, selected at runtime via
+# __builtin_cpu_supports() (used by the batched bitmap search).
+check_c_source_compiles("
+    #include <immintrin.h>
+    __attribute__((target(\"avx2,popcnt\")))
+    static __m256i widen8(__m128i x) { return _mm256_cvtepu8_epi32(x); }
+    __attribute__((target(\"sse4.1,popcnt\")))
+    static __m128i widen4(__m128i x) { return _mm_cvtepu8_epi32(x); }
+    int main() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports(\"avx2\")) {
+            widen8(_mm_setzero_si128());
+        } else if (__builtin_cpu_supports(\"sse4.1\")) {
+            widen4(_mm_setzero_si128());
+        }
+        return 0;
+    }
+" JEMALLOC_HAVE_X86_SIMD_DISPATCH)
+
 # If builtin versions don't exist, check for standard library versions
 if(NOT JEMALLOC_HAVE_BUILTIN_FFS)
     check_c_source_compiles("
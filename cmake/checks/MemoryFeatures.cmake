@@ -59,6 +59,19 @@ if(NOT WIN32)
     endif()
 endif()
 
+# mremap(2) with MREMAP_FIXED, for moving large allocations without copying
+if(CMAKE_SYSTEM_NAME MATCHES "Linux")
+    check_c_source_compiles("
+        #define _GNU_SOURCE
+        #include <sys/mman.h>
+        int main() {
+            void* p = mremap((void*)0, 4096, 4096,
+                             MREMAP_MAYMOVE|MREMAP_FIXED, (void*)4096);
+            return p == MAP_FAILED;
+        }
+    " JEMALLOC_HAVE_MREMAP)
+endif()
+
 # sbrk support (deprecated on many systems)
 check_symbol_exists(sbrk "unistd.h" JEMALLOC_HAVE_SBRK)
 
@@ -100,6 +113,7 @@ set(JEMALLOC_HAVE_MADV_DONTNEED "${JEMALLOC_HAVE_MADV_DONTNEED}")
 set(JEMALLOC_HAVE_MADV_FREE "${JEMALLOC_HAVE_MADV_FREE}")
 set(JEMALLOC_HAVE_MADV_DONTDUMP "${JEMALLOC_HAVE_MADV_DONTDUMP}")
 set(JEMALLOC_HAVE_MADV_NOHUGEPAGE "${JEMALLOC_HAVE_MADV_NOHUGEPAGE}")
+set(JEMALLOC_HAVE_MREMAP "${JEMALLOC_HAVE_MREMAP}")
 set(JEMALLOC_HAVE_SBRK "${JEMALLOC_HAVE_SBRK}")
 set(JEMALLOC_HAVE_VIRTUALALLOC "${JEMALLOC_HAVE_VIRTUALALLOC}")
 set(JEMALLOC_HAVE_PTHREAD_ATFORK "${JEMALLOC_HAVE_PTHREAD_ATFORK}")
@@ -2,6 +2,7 @@
 # Detect profiling backend support for heap profiling
 
 include(CheckCSourceCompiles)
+include(CheckIncludeFiles)
 
 # Only check for profiling backends if profiling is enabled
 if(NOT JEMALLOC_ENABLE_PROF)
@@ -36,6 +37,64 @@ else()
     set(JEMALLOC_PROF_MSVC 0 PARENT_SCOPE)
 endif()
 
-# Note: Other profiling backends (libunwind, libgcc, frame pointer)
-# will be added in future work. For now, those are handled by the
-# existing source code's #ifdef fallbacks.
\ No newline at end of file
+# ============================================================================
+# Unix Profiling Backend Detection
+# ============================================================================
+
+if(NOT WIN32)
+    # DWARF based unwinders: libunwind if available, libgcc otherwise
+    check_include_files("libunwind.h" JEMALLOC_HAVE_LIBUNWIND_H)
+    if(JEMALLOC_HAVE_LIBUNWIND_H)
+        set(CMAKE_REQUIRED_LIBRARIES unwind)
+        check_c_source_compiles("
+            #define UNW_LOCAL_ONLY
+            #include <libunwind.h>
+            int main() {
+                void* vec[10];
+                return unw_backtrace(vec, 10);
+            }
+        " JEMALLOC_HAVE_UNW_BACKTRACE)
+        unset(CMAKE_REQUIRED_LIBRARIES)
+    endif()
+
+    if(JEMALLOC_HAVE_UNW_BACKTRACE)
+        set(JEMALLOC_PROF_LIBUNWIND 1)
+        list(APPEND JEMALLOC_PLATFORM_LIBS unwind)
+        message(STATUS "Profiling backend: libunwind")
+    else()
+        check_c_source_compiles("
+            #include <unwind.h>
+            static _Unwind_Reason_Code cb(struct _Unwind_Context* c, void* a) {
+                return _URC_NO_REASON;
+            }
+            int main() {
+                _Unwind_Backtrace(cb, 0);
+                return 0;
+            }
+        " JEMALLOC_HAVE_UNWIND_BACKTRACE)
+        if(JEMALLOC_HAVE_UNWIND_BACKTRACE)
+            set(JEMALLOC_PROF_LIBGCC 1)
+            message(STATUS "Profiling backend: libgcc")
+        endif()
+    endif()
+
+    # Walking frame pointers is much cheaper than DWARF unwinding, so it takes
+    # precedence whenever jemalloc keeps them (Linux only, since it needs the
+    # thread stack bounds from procfs).  The unwinder found above, if any,
+    # becomes its fallback.
+    string(TOUPPER "${CMAKE_BUILD_TYPE}" _prof_build_type)
+    if(JEMALLOC_PLATFORM STREQUAL "linux"
+       AND "${CMAKE_C_FLAGS} ${CMAKE_C_FLAGS_${_prof_build_type}}"
+           MATCHES "-fno-omit-frame-pointer")
+        set(JEMALLOC_PROF_FRAME_POINTER 1)
+        message(STATUS "Profiling backend: frame pointers")
+        # The stack bounds are looked up per thread.
+        check_c_source_compiles("
+            #define _GNU_SOURCE
+            #include <unistd.h>
+            int main() {
+                return (int)gettid();
+            }
+        " JEMALLOC_HAVE_GETTID)
+    endif()
+endif()
\ No newline at end of file
@@ -34,6 +34,31 @@ else()
     set(JEMALLOC_HAVE_PTHREAD FALSE)
 endif()
 
+# futex(2), for the optional futex-based malloc_mutex_t
+if(CMAKE_SYSTEM_NAME MATCHES "Linux")
+    check_c_source_compiles("
+        #include <linux/futex.h>
+        #include <sys/syscall.h>
+        #include <unistd.h>
+        int main() {
+            int word = 0;
+            return (int)syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, 1,
+                                (void*)0, (void*)0, 0);
+        }
+    " JEMALLOC_HAVE_FUTEX)
+
+    # membarrier(2), for flushing the tcaches of idle threads remotely
+    check_c_source_compiles("
+        #include <linux/membarrier.h>
+        #include <sys/syscall.h>
+        #include <unistd.h>
+        int main() {
+            return (int)syscall(SYS_membarrier,
+                                MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+        }
+    " JEMALLOC_HAVE_MEMBARRIER)
+endif()
+
 # Check for CPU yield instruction
 if(CMAKE_SYSTEM_PROCESSOR MATCHES "aarch64|arm64|ARM64")
     # ARM64 CPU yield
@@ -59,3 +84,5 @@ endif()
 # Export to parent scope
 set(JEMALLOC_HAVE_PTHREAD "${JEMALLOC_HAVE_PTHREAD}")
 set(JEMALLOC_HAVE_PTHREAD_ATFORK "${JEMALLOC_HAVE_PTHREAD_ATFORK}")
+set(JEMALLOC_HAVE_FUTEX "${JEMALLOC_HAVE_FUTEX}")
+set(JEMALLOC_HAVE_MEMBARRIER "${JEMALLOC_HAVE_MEMBARRIER}")
@@ -223,6 +223,28 @@ set(JEMALLOC_CACHE_OBLIVIOUS 1)  # Default enabled
 set(JEMALLOC_FILL 1)  # Memory filling support
 set(JEMALLOC_LAZY_LOCK 0)  # Not used on modern systems
 
+# rtree_ctx cache geometry - both sizes must be powers of two
+foreach(ncache_var JEMALLOC_RTREE_CTX_NCACHE JEMALLOC_RTREE_CTX_NCACHE_L2)
+    set(ncache_val ${${ncache_var}})
+    if(NOT ncache_val MATCHES "^[0-9]+$" OR ncache_val LESS 1)
+        message(FATAL_ERROR "${ncache_var}=${ncache_val} is not a positive integer")
+    endif()
+    math(EXPR ncache_mask "${ncache_val} & (${ncache_val} - 1)")
+    if(NOT ncache_mask EQUAL 0)
+        message(FATAL_ERROR "${ncache_var}=${ncache_val} is not a power of two")
+    endif()
+endforeach()
+if(JEMALLOC_RTREE_CTX_NCACHE GREATER 256)
+    message(FATAL_ERROR "JEMALLOC_RTREE_CTX_NCACHE must be at most 256")
+endif()
+if(JEMALLOC_RTREE_CTX_NCACHE_L2 GREATER 64)
+    message(FATAL_ERROR "JEMALLOC_RTREE_CTX_NCACHE_L2 must be at most 64")
+endif()
+
+if(JEMALLOC_ENABLE_FUTEX_MUTEX AND NOT JEMALLOC_HAVE_FUTEX)
+    message(FATAL_ERROR "JEMALLOC_ENABLE_FUTEX_MUTEX requires futex(2)")
+endif()
+
 # JEMALLOC_TLS_MODEL for __thread variables
 if(NOT JEMALLOC_IS_WINDOWS)
     set(JEMALLOC_TLS_MODEL "__attribute__((tls_model(\"initial-exec\")))")
@@ -371,6 +393,19 @@ else()
     string(REGEX REPLACE "#undef JEMALLOC_DSS\n" "/* #undef JEMALLOC_DSS */\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
 endif()
 
+string(REGEX REPLACE "#undef JEMALLOC_RTREE_CTX_NCACHE\n" "#define JEMALLOC_RTREE_CTX_NCACHE ${JEMALLOC_RTREE_CTX_NCACHE}\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+string(REGEX REPLACE "#undef JEMALLOC_RTREE_CTX_NCACHE_L2\n" "#define JEMALLOC_RTREE_CTX_NCACHE_L2 ${JEMALLOC_RTREE_CTX_NCACHE_L2}\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+if(JEMALLOC_ENABLE_RTREE_CTX_STATS)
+    string(REGEX REPLACE "#undef JEMALLOC_RTREE_CTX_STATS\n" "#define JEMALLOC_RTREE_CTX_STATS\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+else()
+    string(REGEX REPLACE "#undef JEMALLOC_RTREE_CTX_STATS\n" "/* #undef JEMALLOC_RTREE_CTX_STATS */\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+endif()
+if(JEMALLOC_ENABLE_FUTEX_MUTEX)
+    string(REGEX REPLACE "#undef JEMALLOC_MUTEX_FUTEX\n" "#define JEMALLOC_MUTEX_FUTEX\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+else()
+    string(REGEX REPLACE "#undef JEMALLOC_MUTEX_FUTEX\n" "/* #undef JEMALLOC_MUTEX_FUTEX */\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+endif()
+
 string(REGEX REPLACE "#undef JEMALLOC_FILL\n" "#define JEMALLOC_FILL ${JEMALLOC_FILL}\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
 string(REGEX REPLACE "#undef JEMALLOC_CACHE_OBLIVIOUS\n" "#define JEMALLOC_CACHE_OBLIVIOUS ${JEMALLOC_CACHE_OBLIVIOUS}\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
 string(REGEX REPLACE "#undef JEMALLOC_LAZY_LOCK\n" "/* #undef JEMALLOC_LAZY_LOCK */\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
@@ -413,6 +448,15 @@ endif()
 if(JEMALLOC_HAVE_MADVISE)
     string(REGEX REPLACE "#undef JEMALLOC_HAVE_MADVISE\n" "#define JEMALLOC_HAVE_MADVISE 1\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
 endif()
+if(JEMALLOC_HAVE_MREMAP)
+    string(REGEX REPLACE "#undef JEMALLOC_HAVE_MREMAP\n" "#define JEMALLOC_HAVE_MREMAP 1\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+endif()
+if(JEMALLOC_HAVE_MEMBARRIER)
+    string(REGEX REPLACE "#undef JEMALLOC_HAVE_MEMBARRIER\n" "#define JEMALLOC_HAVE_MEMBARRIER 1\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+endif()
+if(JEMALLOC_HAVE_X86_SIMD_DISPATCH)
+    string(REGEX REPLACE "#undef JEMALLOC_HAVE_X86_SIMD_DISPATCH\n" "#define JEMALLOC_HAVE_X86_SIMD_DISPATCH 1\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+endif()
 
 # strerror_r return type detection (GNU vs XSI)
 if(JEMALLOC_STRERROR_R_RETURNS_CHAR_WITH_GNU_SOURCE)
@@ -460,6 +504,18 @@ else()
     string(REGEX REPLACE "#undef JEMALLOC_PROF_MSVC\n" "/* #undef JEMALLOC_PROF_MSVC */\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
 endif()
 
+# Profiling backends - libunwind, libgcc and frame pointers (Unix)
+foreach(_prof_backend LIBUNWIND LIBGCC FRAME_POINTER)
+    if(JEMALLOC_PROF_${_prof_backend})
+        string(REGEX REPLACE "#undef JEMALLOC_PROF_${_prof_backend}\n" "#define JEMALLOC_PROF_${_prof_backend} 1\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+    else()
+        string(REGEX REPLACE "#undef JEMALLOC_PROF_${_prof_backend}\n" "/* #undef JEMALLOC_PROF_${_prof_backend} */\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+    endif()
+endforeach()
+if(JEMALLOC_HAVE_GETTID)
+    string(REGEX REPLACE "#undef JEMALLOC_HAVE_GETTID\n" "#define JEMALLOC_HAVE_GETTID 1\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
+endif()
+
 # JEMALLOC_PROF - enable if profiling is enabled and backend detected
 if(JEMALLOC_ENABLE_PROF AND JEMALLOC_PROF)
     string(REGEX REPLACE "#undef JEMALLOC_PROF\n" "#define JEMALLOC_PROF 1\n" INTERNAL_DEFS_CONTENT "${INTERNAL_DEFS_CONTENT}")
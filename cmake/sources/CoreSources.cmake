@@ -7,6 +7,7 @@ get_filename_component(JEMALLOC_ROOT "${CMAKE_CURRENT_LIST_DIR}/../.." ABSOLUTE)
 # Core source files (platform-independent)
 set(JEMALLOC_CORE_SOURCES
     ${JEMALLOC_ROOT}/src/jemalloc.c
+    ${JEMALLOC_ROOT}/src/alloc_trace.c
     ${JEMALLOC_ROOT}/src/arena.c
     ${JEMALLOC_ROOT}/src/background_thread.c
     ${JEMALLOC_ROOT}/src/base.c
@@ -0,0 +1,102 @@
+#ifndef JEMALLOC_INTERNAL_ALLOC_TRACE_H
+#define JEMALLOC_INTERNAL_ALLOC_TRACE_H
+
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/alloc_trace_types.h"
+#include "jemalloc/internal/tsd_types.h"
+
+/*
+ * Allocation traces (opt.alloc_trace).  While tracing, every allocation,
+ * deallocation and resize made through the public API is recorded, via the
+ * hooks in hook.h, so that the sequence of calls can be replayed offline
+ * (see test/stress/alloc_replay.c).
+ *
+ * Each thread buffers its events, and writes them out a block at a time when
+ * its buffer fills up, when it exits, and when tracing stops.  Events of
+ * threads that can't keep a buffer of their own (e.g. ones that only ever
+ * free) go to a shared buffer, with thread index 0.  Blocks of different
+ * threads interleave arbitrarily; the global sequence numbers of the events
+ * give the order to replay them in.
+ *
+ * If a write fails, the partial block is cut off and later blocks are dropped,
+ * so that the file ends with the last complete one; stopping then fails.
+ *
+ * The file is written in native byte order, and consists of an
+ * alloc_trace_header_t, followed by any number of blocks, each of which is an
+ * alloc_trace_block_t followed by nevents alloc_trace_event_t's.
+ */
+
+#define ALLOC_TRACE_MAGIC "jetrace"
+#define ALLOC_TRACE_VERSION 1
+
+typedef struct alloc_trace_header_s alloc_trace_header_t;
+struct alloc_trace_header_s {
+	char     magic[8];
+	uint32_t version;
+	/* sizeof(alloc_trace_event_t). */
+	uint32_t event_size;
+	/* Time tracing started, on the same clock as the event times. */
+	uint64_t start_ns;
+};
+
+typedef struct alloc_trace_block_s alloc_trace_block_t;
+struct alloc_trace_block_s {
+	uint32_t thread;
+	uint32_t nevents;
+};
+
+enum alloc_trace_op_e {
+	alloc_trace_op_malloc,
+	alloc_trace_op_calloc,
+	alloc_trace_op_posix_memalign,
+	alloc_trace_op_aligned_alloc,
+	alloc_trace_op_memalign,
+	alloc_trace_op_valloc,
+	alloc_trace_op_pvalloc,
+	alloc_trace_op_mallocx,
+	alloc_trace_op_realloc,
+	alloc_trace_op_rallocx,
+	alloc_trace_op_xallocx,
+	alloc_trace_op_free,
+	alloc_trace_op_dallocx,
+	alloc_trace_op_sdallocx,
+	alloc_trace_op_limit
+};
+typedef enum alloc_trace_op_e alloc_trace_op_t;
+
+/*
+ * A single call.  Allocations set ptr, frees set old_ptr, and resizes set both
+ * (to the same address if the object wasn't moved).  A realloc(ptr, 0) that
+ * freed ptr has a ptr of 0.  Failed allocations aren't recorded.
+ */
+typedef struct alloc_trace_event_s alloc_trace_event_t;
+struct alloc_trace_event_s {
+	uint64_t seq;
+	uint64_t time_ns;
+	uint64_t ptr;
+	uint64_t old_ptr;
+	/* Requested size; the size argument of sdallocx for it. */
+	uint64_t size;
+	/* Usable size of ptr, or of old_ptr for frees. */
+	uint64_t usize;
+	/* Alignment, number of elements for calloc, or extra for xallocx. */
+	uint64_t arg;
+	/* The MALLOCX_* flags of the *allocx() functions. */
+	uint32_t flags;
+	/* Arena of ptr, or of old_ptr for frees. */
+	uint16_t arena;
+	uint16_t op;
+};
+
+extern char opt_alloc_trace[ALLOC_TRACE_FILENAME_LEN];
+
+bool alloc_trace_boot(void);
+void alloc_trace_init(tsdn_t *tsdn);
+bool alloc_trace_start(tsdn_t *tsdn, const char *filename);
+bool alloc_trace_stop(tsdn_t *tsdn);
+void alloc_trace_tsd_cleanup(tsd_t *tsd);
+void alloc_trace_prefork(tsdn_t *tsdn);
+void alloc_trace_postfork_parent(tsdn_t *tsdn);
+void alloc_trace_postfork_child(tsdn_t *tsdn);
+
+#endif /* JEMALLOC_INTERNAL_ALLOC_TRACE_H */
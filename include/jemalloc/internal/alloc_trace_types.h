@@ -0,0 +1,11 @@
+#ifndef JEMALLOC_INTERNAL_ALLOC_TRACE_TYPES_H
+#define JEMALLOC_INTERNAL_ALLOC_TRACE_TYPES_H
+
+typedef struct alloc_trace_tbuf_s alloc_trace_tbuf_t;
+
+/* Number of events a thread buffers before writing them out as a block. */
+#define ALLOC_TRACE_TBUF_NEVENTS 1024
+
+#define ALLOC_TRACE_FILENAME_LEN (PATH_MAX + 1)
+
+#endif /* JEMALLOC_INTERNAL_ALLOC_TRACE_TYPES_H */
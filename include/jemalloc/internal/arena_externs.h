@@ -17,6 +17,9 @@
  */
 #define ARENA_DEFERRED_PURGE_NPAGES_THRESHOLD UINT64_C(1024)
 
+/* Upper bound on the per size class region count in opt.slab_hugepage_sizes. */
+#define ARENA_SLAB_HUGEPAGE_REGIONS_MAX 4096
+
 extern ssize_t opt_dirty_decay_ms;
 extern ssize_t opt_muzzy_decay_ms;
 
@@ -39,6 +42,10 @@ extern pac_thp_t huge_arena_pac_thp;
  */
 extern uint32_t arena_bin_offsets[SC_NBINS];
 
+extern unsigned arena_slab_hugepage_regions[SC_NBINS];
+
+bool arena_slab_hugepage_sizes_update(
+    size_t start_size, size_t end_size, size_t nregions);
 void arena_basic_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
     const char **dss, ssize_t *dirty_decay_ms, ssize_t *muzzy_decay_ms,
     size_t *nactive, size_t *ndirty, size_t *nmuzzy);
@@ -207,6 +207,12 @@ arena_malloc(tsdn_t *tsdn, arena_t *arena, size_t size, szind_t ind, bool zero,
 		                   tcache->tcache_slow))) {
 			return tcache_alloc_large(tsdn_tsd(tsdn), arena, tcache,
 			    size, ind, zero, slow_path);
+		} else if (unlikely(tcache_large_cache_enabled(ind))) {
+			void *ret = tcache_large_cache_alloc(
+			    tcache, sz_s2u(size), ind, zero);
+			if (ret != NULL) {
+				return ret;
+			}
 		}
 		/* (size > tcache_max) case falls through. */
 	}
@@ -323,6 +329,10 @@ arena_dalloc_large(tsdn_t *tsdn, void *ptr, tcache_t *tcache, szind_t szind,
 		        szind, &tcache->bins[szind], tcache->tcache_slow)) {
 			tcache_dalloc_large(
 			    tsdn_tsd(tsdn), tcache, ptr, szind, slow_path);
+		} else if (unlikely(tcache_large_cache_enabled(szind))
+		    && tcache_large_cache_dalloc(
+		        tsdn_tsd(tsdn), tcache, ptr, usize, szind)) {
+			/* Cached. */
 		} else {
 			edata_t *edata = emap_edata_lookup(
 			    tsdn, &arena_emap_global, ptr);
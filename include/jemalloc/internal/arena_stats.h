@@ -60,6 +60,7 @@ struct arena_stats_s {
 	size_t base;           /* Derived. */
 	size_t metadata_edata; /* Derived. */
 	size_t metadata_rtree; /* Derived. */
+	size_t metadata_reclaimable; /* Derived. */
 	size_t resident;       /* Derived. */
 	size_t metadata_thp;   /* Derived. */
 	size_t mapped;         /* Derived. */
@@ -73,6 +74,13 @@ struct arena_stats_s {
 	uint64_t nflushes_large;  /* Derived. */
 	uint64_t nrequests_large; /* Derived. */
 
+	/*
+	 * Bytes of zeroed (e.g. calloc) large allocations, split by whether they
+	 * had to be zeroed or were already known to be zero.
+	 */
+	locked_u64_t zeroed_bytes_large;
+	locked_u64_t zero_skipped_bytes_large;
+
 	/*
 	 * The stats logically owned by the pa_shard in the same arena.  This
 	 * lives here only because it's convenient for the purposes of the ctl
@@ -84,6 +92,21 @@ struct arena_stats_s {
 	size_t tcache_bytes;         /* Derived. */
 	size_t tcache_stashed_bytes; /* Derived. */
 
+	/*
+	 * Reuse distance tcache GC (opt.experimental_tcache_gc_reuse): # of bin
+	 * GCs that the low-water policy would have flushed but were skipped,
+	 * and bytes flushed beyond what the low-water policy would have.
+	 */
+	locked_u64_t tcache_gc_nflushes_avoided;
+	locked_u64_t tcache_gc_bytes_saved;
+
+	/*
+	 * Cache bin refills that checked the arena's tcache handoff
+	 * (opt.tcache_steal), and those that were served by it.
+	 */
+	locked_u64_t tcache_steal_attempts;
+	locked_u64_t tcache_steal_successes;
+
 	mutex_prof_data_t mutex_prof_data[mutex_prof_num_arena_mutexes];
 
 	/* One element for each large size class. */
@@ -18,6 +18,22 @@
 #include "jemalloc/internal/sc.h"
 #include "jemalloc/internal/ticker.h"
 
+/*
+ * Per small size class state for carving slabs out of dedicated hugepage
+ * regions; see arena_slab_alloc_hugepage().
+ */
+typedef struct arena_hugepage_slabs_s arena_hugepage_slabs_t;
+struct arena_hugepage_slabs_s {
+	/* Uncarved tails of the regions mapped so far. */
+	edata_list_active_t reserves;
+	/* Empty slabs, kept for reuse by the same size class. */
+	edata_list_active_t avail;
+	/* Number of regions mapped for this size class. */
+	unsigned nregions;
+	/* Number of slabs from the regions currently handed out to the bins. */
+	size_t curslabs;
+};
+
 struct arena_s {
 	/*
 	 * Number of threads currently assigned to this arena.  Each thread has
@@ -58,6 +74,34 @@ struct arena_s {
 	ql_head(cache_bin_array_descriptor_t) cache_bin_array_descriptor_ql;
 	malloc_mutex_t tcache_ql_mtx;
 
+	/*
+	 * With opt.tcache_steal, per small size class, a batch of free regions
+	 * that a thread with an over-full cache bin handed off, for a thread
+	 * with an empty one to take before going to the bin.  Regions are
+	 * chained through their first word.  A batch is only ever published
+	 * into an empty slot, and taken as a whole, so there is no ABA.
+	 * tcache_handoff_gen is bumped before each publish, and
+	 * tcache_handoff_seen is its value at the last decay tick; a batch
+	 * still there with the same generation at the next tick is freed back.
+	 * tcache_handoff_nbytes counts the bytes held, for stats; it is raised
+	 * before a batch is published and lowered after regions are taken.
+	 *
+	 * Synchronization: atomic.
+	 */
+	atomic_p_t  tcache_handoff[SC_NBINS];
+	atomic_u_t  tcache_handoff_gen[SC_NBINS];
+	atomic_u_t  tcache_handoff_seen[SC_NBINS];
+	atomic_zu_t tcache_handoff_nbytes;
+
+	/*
+	 * With opt.slab_hugepage_sizes, slab placement for the size classes
+	 * configured there.
+	 *
+	 * Synchronization: hugepage_slabs_mtx.
+	 */
+	arena_hugepage_slabs_t hugepage_slabs[SC_NBINS];
+	malloc_mutex_t         hugepage_slabs_mtx;
+
 	/*
 	 * Represents a dss_prec_t, but atomically.
 	 *
@@ -46,6 +46,7 @@
  * Also included (with naming differences to avoid conflicts with the standard
  * library):
  *   atomic_fence(atomic_memory_order_t) (mimics C11's atomic_thread_fence).
+ *   atomic_compiler_fence() (mimics C11's atomic_signal_fence, seq_cst).
  *   ATOMIC_INIT (mimics C11's ATOMIC_VAR_INIT).
  */
 
@@ -14,6 +14,7 @@
 #define atomic_memory_order_seq_cst memory_order_seq_cst
 
 #define atomic_fence atomic_thread_fence
+#define atomic_compiler_fence() atomic_signal_fence(memory_order_seq_cst)
 
 /* clang-format off */
 #define JEMALLOC_GENERATE_ATOMICS(type, short_type,			\
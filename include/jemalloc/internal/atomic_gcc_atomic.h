@@ -40,6 +40,11 @@ atomic_fence(atomic_memory_order_t mo) {
 	__atomic_thread_fence(atomic_enum_to_builtin(mo));
 }
 
+ATOMIC_INLINE void
+atomic_compiler_fence(void) {
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
 #define JEMALLOC_GENERATE_ATOMICS(type, short_type, /* unused */ lg_size)      \
 	typedef struct {                                                       \
 		type repr;                                                     \
@@ -50,6 +50,11 @@ atomic_fence(atomic_memory_order_t mo) {
 	asm volatile("" ::: "memory");
 }
 
+ATOMIC_INLINE void
+atomic_compiler_fence(void) {
+	asm volatile("" ::: "memory");
+}
+
 /*
  * A correct implementation of seq_cst loads and stores on weakly ordered
  * architectures could do either of the following:
@@ -40,6 +40,11 @@ atomic_fence(atomic_memory_order_t mo) {
 	_ReadWriteBarrier();
 }
 
+ATOMIC_INLINE void
+atomic_compiler_fence(void) {
+	_ReadWriteBarrier();
+}
+
 #define ATOMIC_INTERLOCKED_REPR(lg_size) atomic_repr_##lg_size##_t
 
 #define ATOMIC_CONCAT(a, b) ATOMIC_RAW_CONCAT(a, b)
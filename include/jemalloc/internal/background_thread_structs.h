@@ -35,8 +35,13 @@ typedef enum {
 struct background_thread_info_s {
 #ifdef JEMALLOC_BACKGROUND_THREAD
 	/* Background thread is pthread specific. */
-	pthread_t      thread;
+	pthread_t thread;
+#	ifdef JEMALLOC_MUTEX_FUTEX
+	/* Wakeup sequence number; the thread sleeps on it with futex(2). */
+	atomic_u32_t cond;
+#	else
 	pthread_cond_t cond;
+#	endif
 #endif
 	malloc_mutex_t            mtx;
 	background_thread_state_t state;
@@ -32,6 +32,19 @@ typedef enum metadata_thp_mode_e metadata_thp_mode_t;
 extern metadata_thp_mode_t opt_metadata_thp;
 extern const char *const   metadata_thp_mode_names[];
 
+/*
+ * With opt_metadata_reclaim, edata_t's are carved out of dedicated chunks of
+ * this size (instead of the bump allocated base blocks), so that any page of a
+ * chunk whose edata_t's have all been handed back via base_free_edata_batch()
+ * can be purged.  Ignored with metadata_thp, or custom metadata extent hooks.
+ */
+#define LG_BASE_EDATA_CHUNK 21
+#define BASE_EDATA_CHUNK_SIZE ((size_t)1 << LG_BASE_EDATA_CHUNK)
+#define BASE_EDATA_CHUNK_NPAGES (BASE_EDATA_CHUNK_SIZE >> LG_PAGE)
+extern bool opt_metadata_reclaim;
+
+typedef struct base_edata_chunk_s base_edata_chunk_t;
+
 /* Embedded at the beginning of every block of base-managed virtual memory. */
 typedef struct base_block_s base_block_t;
 struct base_block_s {
@@ -81,10 +94,17 @@ struct base_s {
 	/* Contains reusable base edata (used by tcache_stacks currently). */
 	edata_avail_t edata_avail;
 
+	/* Whether edata_t's come from reclaimable chunks. */
+	bool edata_reclaim;
+	/* Chain of all edata chunks. */
+	base_edata_chunk_t *edata_chunks;
+
 	/* Stats, only maintained if config_stats. */
 	size_t allocated;
 	size_t edata_allocated;
 	size_t rtree_allocated;
+	/* Portion of edata_allocated that lives in reclaimable chunks. */
+	size_t edata_reclaimable;
 	size_t resident;
 	size_t mapped;
 	/* Number of THP regions touched. */
@@ -101,6 +121,12 @@ metadata_thp_enabled(void) {
 	return (opt_metadata_thp != metadata_thp_disabled);
 }
 
+/* Whether edata_t's may be handed back with base_free_edata_batch(). */
+static inline bool
+base_edata_reclaim_enabled(const base_t *base) {
+	return base->edata_reclaim;
+}
+
 base_t *b0get(void);
 base_t *base_new(tsdn_t *tsdn, unsigned ind, const extent_hooks_t *extent_hooks,
     bool metadata_use_hooks);
@@ -111,12 +137,17 @@ extent_hooks_t *base_extent_hooks_set(
     base_t *base, extent_hooks_t *extent_hooks);
 void    *base_alloc(tsdn_t *tsdn, base_t *base, size_t size, size_t alignment);
 edata_t *base_alloc_edata(tsdn_t *tsdn, base_t *base);
+size_t   base_alloc_edata_batch(tsdn_t *tsdn, base_t *base,
+      edata_list_inactive_t *list, size_t nedata);
+void     base_free_edata_batch(
+        tsdn_t *tsdn, base_t *base, edata_list_inactive_t *list);
 void    *base_alloc_rtree(tsdn_t *tsdn, base_t *base, size_t size);
 void    *b0_alloc_tcache_stack(tsdn_t *tsdn, size_t size);
 void     b0_dalloc_tcache_stack(tsdn_t *tsdn, void *tcache_stack);
 void     base_stats_get(tsdn_t *tsdn, base_t *base, size_t *allocated,
         size_t *edata_allocated, size_t *rtree_allocated, size_t *resident,
         size_t *mapped, size_t *n_thp);
+size_t   base_edata_reclaimable_get(tsdn_t *tsdn, base_t *base);
 void     base_prefork(tsdn_t *tsdn, base_t *base);
 void     base_postfork_parent(tsdn_t *tsdn, base_t *base);
 void     base_postfork_child(tsdn_t *tsdn, base_t *base);
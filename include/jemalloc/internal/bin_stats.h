@@ -48,6 +48,17 @@ struct bin_stats_s {
 
 	/* Current size of nonfull slabs heap in this bin. */
 	size_t nonfull_slabs;
+
+	/*
+	 * With opt.slab_hugepage_sizes, the number of hugepage regions mapped
+	 * for this size class, how many of curslabs were carved out of them,
+	 * and the bytes of the regions held in neither (empty slabs kept for
+	 * reuse, and uncarved space).  Tracked per arena rather than per bin
+	 * shard.
+	 */
+	size_t hugepage_regions;
+	size_t hugepage_curslabs;
+	size_t hugepage_unused_bytes;
 };
 
 typedef struct bin_stats_data_s bin_stats_data_t;
@@ -176,9 +176,24 @@ typedef struct bitmap_info_s {
 #endif /* BITMAP_USE_TREE */
 } bitmap_info_t;
 
+/* Instruction sets bitmap_sfu_batch() can use, in order of preference. */
+typedef enum bitmap_simd_e {
+	bitmap_simd_none,
+	bitmap_simd_sse41,
+	bitmap_simd_avx2,
+	bitmap_simd_limit
+} bitmap_simd_t;
+
+/* The best one the CPU supports, picked by bitmap_boot(). */
+extern bitmap_simd_t bitmap_simd;
+
 void   bitmap_info_init(bitmap_info_t *binfo, size_t nbits);
 void   bitmap_init(bitmap_t *bitmap, const bitmap_info_t *binfo, bool fill);
 size_t bitmap_size(const bitmap_info_t *binfo);
+void   bitmap_boot(void);
+bool   bitmap_simd_supported(bitmap_simd_t simd);
+void   bitmap_sfu_batch_simd(bitmap_t *bitmap, const bitmap_info_t *binfo,
+      size_t cnt, uint32_t *bits, bitmap_simd_t simd);
 
 static inline bool
 bitmap_full(bitmap_t *bitmap, const bitmap_info_t *binfo) {
@@ -378,4 +393,14 @@ bitmap_unset(bitmap_t *bitmap, const bitmap_info_t *binfo, size_t bit) {
 #endif /* BITMAP_USE_TREE */
 }
 
+/*
+ * sfu_batch: set the first cnt unset bits, writing their indices to bits in
+ * ascending order.  Equivalent to cnt calls to bitmap_sfu().
+ */
+static inline void
+bitmap_sfu_batch(
+    bitmap_t *bitmap, const bitmap_info_t *binfo, size_t cnt, uint32_t *bits) {
+	bitmap_sfu_batch_simd(bitmap, binfo, cnt, bits, bitmap_simd);
+}
+
 #endif /* JEMALLOC_INTERNAL_BITMAP_H */
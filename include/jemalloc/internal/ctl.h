@@ -13,7 +13,7 @@
 #include "jemalloc/internal/stats.h"
 
 /* Maximum ctl tree depth. */
-#define CTL_MAX_DEPTH 7
+#define CTL_MAX_DEPTH 8
 #define CTL_MULTI_SETTING_MAX_LEN 1000
 
 typedef struct ctl_node_s {
@@ -61,6 +61,8 @@ typedef struct ctl_stats_s {
 	size_t metadata_edata;
 	size_t metadata_rtree;
 	size_t metadata_thp;
+	size_t metadata_reclaimable;
+	size_t metadata_pinned;
 	size_t resident;
 	size_t mapped;
 	size_t retained;
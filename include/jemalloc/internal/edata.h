@@ -63,7 +63,7 @@ struct e_prof_info_s {
 	/*
 	 * Points to a prof_recent_t for the allocation; NULL
 	 * means the recent allocation record no longer exists.
-	 * Protected by prof_recent_alloc_mtx.
+	 * Protected by the tdata lock of the allocating thread.
 	 */
 	atomic_p_t e_prof_recent_alloc;
 };
@@ -110,8 +110,10 @@ struct edata_s {
 	 * i: szind
 	 * f: nfree
 	 * s: bin_shard
+	 * h: is_head
+	 * u: hugepage_slab
 	 *
-	 * 00000000 ... 0000ssss ssffffff ffffiiii iiiitttg zpcbaaaa aaaaaaaa
+	 * 00000000 ... 00uhssss ssffffff ffffiiii iiiitttg zpcbaaaa aaaaaaaa
 	 *
 	 * arena_ind: Arena from which this extent came, or all 1 bits if
 	 *            unassociated.
@@ -145,6 +147,13 @@ struct edata_s {
 	 * nfree: Number of free regions in slab.
 	 *
 	 * bin_shard: the shard of the bin from which this extent came.
+	 *
+	 * is_head: Whether the extent begins a mapping; see
+	 *          ehooks_default_merge_impl().
+	 *
+	 * hugepage_slab: The slab was carved out of one of its arena's
+	 *                dedicated hugepage regions, and goes back to that size
+	 *                class rather than to the page allocator when empty.
 	 */
 	uint64_t e_bits;
 #define MASK(CURRENT_FIELD_WIDTH, CURRENT_FIELD_SHIFT)                         \
@@ -210,6 +219,12 @@ struct edata_s {
 #define EDATA_BITS_IS_HEAD_MASK                                                \
 	MASK(EDATA_BITS_IS_HEAD_WIDTH, EDATA_BITS_IS_HEAD_SHIFT)
 
+#define EDATA_BITS_HUGEPAGE_SLAB_WIDTH 1
+#define EDATA_BITS_HUGEPAGE_SLAB_SHIFT                                         \
+	(EDATA_BITS_IS_HEAD_WIDTH + EDATA_BITS_IS_HEAD_SHIFT)
+#define EDATA_BITS_HUGEPAGE_SLAB_MASK                                          \
+	MASK(EDATA_BITS_HUGEPAGE_SLAB_WIDTH, EDATA_BITS_HUGEPAGE_SLAB_SHIFT)
+
 	/* Pointer to the extent that this structure is responsible for. */
 	void *e_addr;
 
@@ -656,6 +671,18 @@ edata_is_head_set(edata_t *edata, bool is_head) {
 	    | ((uint64_t)is_head << EDATA_BITS_IS_HEAD_SHIFT);
 }
 
+static inline bool
+edata_hugepage_slab_get(const edata_t *edata) {
+	return (bool)((edata->e_bits & EDATA_BITS_HUGEPAGE_SLAB_MASK)
+	    >> EDATA_BITS_HUGEPAGE_SLAB_SHIFT);
+}
+
+static inline void
+edata_hugepage_slab_set(edata_t *edata, bool hugepage_slab) {
+	edata->e_bits = (edata->e_bits & ~EDATA_BITS_HUGEPAGE_SLAB_MASK)
+	    | ((uint64_t)hugepage_slab << EDATA_BITS_HUGEPAGE_SLAB_SHIFT);
+}
+
 static inline bool
 edata_state_in_transition(extent_state_t state) {
 	return state >= extent_state_transition;
@@ -686,6 +713,7 @@ edata_init(edata_t *edata, unsigned arena_ind, void *addr, size_t size,
 	edata_committed_set(edata, committed);
 	edata_pai_set(edata, pai);
 	edata_is_head_set(edata, is_head == EXTENT_IS_HEAD);
+	edata_hugepage_slab_set(edata, false);
 	if (config_prof) {
 		edata_prof_tctx_set(edata, NULL);
 	}
@@ -698,6 +726,7 @@ edata_binit(
 	edata_addr_set(edata, addr);
 	edata_bsize_set(edata, bsize);
 	edata_slab_set(edata, false);
+	edata_hugepage_slab_set(edata, false);
 	edata_szind_set(edata, SC_NSIZES);
 	edata_sn_set(edata, sn);
 	edata_state_set(edata, extent_state_active);
@@ -7,23 +7,77 @@
 /* For tests only. */
 #define EDATA_CACHE_FAST_FILL 4
 
+/* Upper bound on the number of per-CPU shards in an edata_cache_t. */
+#define EDATA_CACHE_PERCPU_NSHARDS_MAX 255
+
+/*
+ * Maximum number of edata_t's held by each per-CPU shard; 0 disables the
+ * per-CPU layer altogether.
+ */
+#define EDATA_CACHE_PERCPU_MAX_DEFAULT 16
+extern size_t opt_edata_cache_percpu_max;
+
 /*
  * A cache of edata_t structures allocated via base_alloc_edata (as opposed to
  * the underlying extents they describe).  The contents of returned edata_t
  * objects are garbage and cannot be relied upon.
  */
 
+/*
+ * Optional per-CPU front end of an edata_cache_t.  Each shard holds a small LIFO
+ * list of edata_t's; an empty shard is refilled, and an overfull one flushed,
+ * in batches of half its capacity under a single acquisition of the central
+ * mutex.  Shard and central mutexes are never held at the same time.
+ */
+typedef struct edata_cache_percpu_s edata_cache_percpu_t;
+struct edata_cache_percpu_s {
+	JEMALLOC_ALIGNED(CACHELINE)
+	malloc_mutex_t        mtx;
+	edata_list_inactive_t list;
+	/* Written under mtx; read racily for stats. */
+	atomic_zu_t           count;
+};
+
 typedef struct edata_cache_s edata_cache_t;
 struct edata_cache_s {
 	edata_avail_t  avail;
+	/* Number of edata_t's in avail; excludes the per-CPU shards. */
 	atomic_zu_t    count;
 	malloc_mutex_t mtx;
 	base_t        *base;
+
+	/* NULL unless edata_cache_percpu_init() succeeded. */
+	edata_cache_percpu_t *percpu;
+	unsigned              npercpu;
+	size_t                percpu_max;
 };
 
 bool     edata_cache_init(edata_cache_t *edata_cache, base_t *base);
+bool     edata_cache_percpu_init(
+        tsdn_t *tsdn, edata_cache_t *edata_cache, size_t percpu_max);
 edata_t *edata_cache_get(tsdn_t *tsdn, edata_cache_t *edata_cache);
 void edata_cache_put(tsdn_t *tsdn, edata_cache_t *edata_cache, edata_t *edata);
+/*
+ * Move up to nedata edata_t's from the cache onto list, returning the number
+ * moved.  Unlike edata_cache_get(), never allocates from the base.
+ */
+size_t edata_cache_get_batch(tsdn_t *tsdn, edata_cache_t *edata_cache,
+    edata_list_inactive_t *list, size_t nedata);
+/* Move all of list into the cache. */
+void edata_cache_put_batch(
+    tsdn_t *tsdn, edata_cache_t *edata_cache, edata_list_inactive_t *list);
+/*
+ * Hands every cached edata_t back to the base, so that their memory can be
+ * purged.  A no-op unless base_edata_reclaim_enabled().
+ */
+void edata_cache_reclaim(tsdn_t *tsdn, edata_cache_t *edata_cache);
+/* Total cached edata_t's, including those held by the per-CPU shards. */
+size_t edata_cache_navail(edata_cache_t *edata_cache);
+/* Accumulates (resp. resets) mutex stats over all per-CPU shards. */
+void   edata_cache_percpu_mutex_stats_read(tsdn_t *tsdn,
+      edata_cache_t *edata_cache, mutex_prof_data_t *mutex_prof_data);
+void edata_cache_percpu_mutex_stats_reset(
+    tsdn_t *tsdn, edata_cache_t *edata_cache);
 
 void edata_cache_prefork(tsdn_t *tsdn, edata_cache_t *edata_cache);
 void edata_cache_postfork_parent(tsdn_t *tsdn, edata_cache_t *edata_cache);
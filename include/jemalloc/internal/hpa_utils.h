@@ -13,22 +13,27 @@ typedef struct {
 } hpa_io_vector_t;
 #endif
 
-/* Actually invoke hooks. If we fail vectorized, use single purges */
-static void
+/*
+ * Actually invoke hooks. If we fail vectorized, use single purges.  Returns true
+ * if any of the ranges may not have been purged.
+ */
+static bool
 hpa_try_vectorized_purge(
     hpa_shard_t *shard, hpa_io_vector_t *vec, size_t vlen, size_t nbytes) {
 	bool success = opt_process_madvise_max_batch > 0
 	    && !shard->central->hooks.vectorized_purge(vec, vlen, nbytes);
+	bool err = false;
 	if (!success) {
 		/* On failure, it is safe to purge again (potential perf
          * penalty) If kernel can tell exactly which regions
          * failed, we could avoid that penalty.
          */
 		for (size_t i = 0; i < vlen; ++i) {
-			shard->central->hooks.purge(
+			err |= shard->central->hooks.purge(
 			    vec[i].iov_base, vec[i].iov_len);
 		}
 	}
+	return err;
 }
 
 /*
@@ -40,6 +45,8 @@ typedef struct {
 	size_t           cur;
 	size_t           total_bytes;
 	size_t           capacity;
+	/* Whether any purge issued through this accumulator failed. */
+	bool             err;
 } hpa_range_accum_t;
 
 static inline void
@@ -48,12 +55,14 @@ hpa_range_accum_init(hpa_range_accum_t *ra, hpa_io_vector_t *v, size_t sz) {
 	ra->capacity = sz;
 	ra->total_bytes = 0;
 	ra->cur = 0;
+	ra->err = false;
 }
 
 static inline void
 hpa_range_accum_flush(hpa_range_accum_t *ra, hpa_shard_t *shard) {
 	assert(ra->total_bytes > 0 && ra->cur > 0);
-	hpa_try_vectorized_purge(shard, ra->vp, ra->cur, ra->total_bytes);
+	ra->err |= hpa_try_vectorized_purge(
+	    shard, ra->vp, ra->cur, ra->total_bytes);
 	ra->cur = 0;
 	ra->total_bytes = 0;
 }
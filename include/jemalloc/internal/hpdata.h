@@ -125,6 +125,12 @@ struct hpdata_s {
 	/* The touched pages (using the same definition as above). */
 	fb_group_t touched_pages[FB_NGROUPS(HUGEPAGE_PAGES)];
 
+	/*
+	 * Whether untouched pages are known to read as zero.  True for fresh
+	 * mappings; cleared for good if a purge of this hpdata ever fails.
+	 */
+	bool h_untouched_zeroed;
+
 	/* Time when this extent (hpdata) becomes eligible for purging */
 	nstime_t h_time_purge_allowed;
 
@@ -164,6 +170,16 @@ hpdata_huge_get(const hpdata_t *hpdata) {
 	return hpdata->h_huge;
 }
 
+static inline bool
+hpdata_untouched_zeroed_get(const hpdata_t *hpdata) {
+	return hpdata->h_untouched_zeroed;
+}
+
+static inline void
+hpdata_untouched_zeroed_set(hpdata_t *hpdata, bool untouched_zeroed) {
+	hpdata->h_untouched_zeroed = untouched_zeroed;
+}
+
 static inline bool
 hpdata_alloc_allowed_get(const hpdata_t *hpdata) {
 	return hpdata->h_alloc_allowed;
@@ -390,9 +406,11 @@ void hpdata_init(hpdata_t *hpdata, void *addr, uint64_t age, bool is_huge);
 
 /*
  * Given an hpdata which can serve an allocation request, pick and reserve an
- * offset within that allocation.
+ * offset within that allocation.  If r_zeroed is non-NULL, it is set to whether
+ * the reserved pages are known to read as zero (i.e. none of them had been
+ * touched since the hpdata was mapped or last purged).
  */
-void *hpdata_reserve_alloc(hpdata_t *hpdata, size_t sz);
+void *hpdata_reserve_alloc(hpdata_t *hpdata, size_t sz, bool *r_zeroed);
 void  hpdata_unreserve(hpdata_t *hpdata, void *addr, size_t sz);
 
 /*
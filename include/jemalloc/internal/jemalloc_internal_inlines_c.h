@@ -280,6 +280,27 @@ fastpath_success_finish(
 	}
 }
 
+/*
+ * Tells tcache_idle_reclaim_scan() that the fast paths below may be using the
+ * thread's cache bins; see tcache_owner_enter().  Set before checking the
+ * event thresholds, which the scan zeroes to keep the thread off the fast
+ * paths.  A no-op unless tracked, i.e. tcache_idle_reclaim_remote_enabled(),
+ * which the fast paths read once.
+ */
+JEMALLOC_ALWAYS_INLINE void
+fastpath_tcache_busy_set(tsd_t *tsd, bool tracked, bool busy) {
+	if (likely(!tracked)) {
+		return;
+	}
+	atomic_b_t *tcache_busy = tsd_tcache_fastpath_busyp_get_unsafe(tsd);
+	if (busy) {
+		atomic_store_b(tcache_busy, true, ATOMIC_RELAXED);
+		atomic_compiler_fence();
+	} else {
+		atomic_store_b(tcache_busy, false, ATOMIC_RELEASE);
+	}
+}
+
 JEMALLOC_ALWAYS_INLINE bool
 malloc_initialized(void) {
 	return (malloc_init_state == malloc_init_initialized);
@@ -335,6 +356,8 @@ imalloc_fastpath(size_t size, void *(fallback_alloc)(size_t)) {
 	    && (size <= SC_SMALL_MAXCLASS));
 
 	uint64_t allocated, threshold;
+	bool     busy_tracked = tcache_idle_reclaim_remote_enabled();
+	fastpath_tcache_busy_set(tsd, busy_tracked, true);
 	te_malloc_fastpath_ctx(tsd, &allocated, &threshold);
 	uint64_t allocated_after = allocated + usize;
 	/*
@@ -354,6 +377,7 @@ imalloc_fastpath(size_t size, void *(fallback_alloc)(size_t)) {
 	 * 0) in a single branch.
 	 */
 	if (unlikely(allocated_after >= threshold)) {
+		fastpath_tcache_busy_set(tsd, busy_tracked, false);
 		return fallback_alloc(size);
 	}
 	assert(tsd_fast(tsd));
@@ -381,13 +405,16 @@ imalloc_fastpath(size_t size, void *(fallback_alloc)(size_t)) {
 		}
 #endif
 		fastpath_success_finish(tsd, allocated_after, bin, ret);
+		fastpath_tcache_busy_set(tsd, busy_tracked, false);
 		return ret;
 	}
 	ret = cache_bin_alloc(bin, &tcache_success);
 	if (tcache_success) {
 		fastpath_success_finish(tsd, allocated_after, bin, ret);
+		fastpath_tcache_busy_set(tsd, busy_tracked, false);
 		return ret;
 	}
+	fastpath_tcache_busy_set(tsd, busy_tracked, false);
 
 	return fallback_alloc(size);
 }
@@ -542,6 +569,8 @@ free_fastpath(void *ptr, size_t size, bool size_hint) {
 	assert(alloc_ctx.slab);
 
 	uint64_t deallocated, threshold;
+	bool     busy_tracked = tcache_idle_reclaim_remote_enabled();
+	fastpath_tcache_busy_set(tsd, busy_tracked, true);
 	te_free_fastpath_ctx(tsd, &deallocated, &threshold);
 
 	uint64_t deallocated_after = deallocated + usize;
@@ -553,11 +582,13 @@ free_fastpath(void *ptr, size_t size, bool size_hint) {
          * below) needs to be after this branch.
          */
 	if (unlikely(deallocated_after >= threshold)) {
+		fastpath_tcache_busy_set(tsd, busy_tracked, false);
 		return false;
 	}
 	assert(tsd_fast(tsd));
 	bool fail = maybe_check_alloc_ctx(tsd, ptr, &alloc_ctx);
 	if (fail) {
+		fastpath_tcache_busy_set(tsd, busy_tracked, false);
 		/* See the comment in isfree. */
 		return true;
 	}
@@ -574,8 +605,10 @@ free_fastpath(void *ptr, size_t size, bool size_hint) {
 	assert(!opt_junk_free);
 
 	if (!cache_bin_dalloc_easy(bin, ptr)) {
+		fastpath_tcache_busy_set(tsd, busy_tracked, false);
 		return false;
 	}
+	fastpath_tcache_busy_set(tsd, busy_tracked, false);
 
 	*tsd_thread_deallocatedp_get(tsd) = deallocated_after;
 
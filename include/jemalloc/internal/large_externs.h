@@ -5,6 +5,10 @@
 #include "jemalloc/internal/edata.h"
 #include "jemalloc/internal/hook.h"
 
+/* Default value of opt.large_remap_threshold: 2MiB. */
+#define LARGE_REMAP_THRESHOLD_DEFAULT ((size_t)1 << 21)
+extern size_t opt_large_remap_threshold;
+
 void *large_malloc(tsdn_t *tsdn, arena_t *arena, size_t usize, bool zero);
 void *large_palloc(
     tsdn_t *tsdn, arena_t *arena, size_t usize, size_t alignment, bool zero);
@@ -7,7 +7,15 @@
 #include "jemalloc/internal/tsd.h"
 #include "jemalloc/internal/witness.h"
 
-extern int64_t opt_mutex_max_spin;
+extern int64_t  opt_mutex_max_spin;
+extern unsigned opt_mutex_hold_sample;
+
+/*
+ * Spin limits can be overridden per witness rank (see
+ * malloc_mutex_max_spin_ranks_parse()).  Ranks at or above the last slot,
+ * i.e. all the leaf ranks, share that slot.
+ */
+#define MUTEX_SPIN_RANK_NSLOTS 64
 
 typedef enum {
 	/* Can only acquire one mutex of a given witness rank at a time. */
@@ -40,6 +48,8 @@ struct malloc_mutex_s {
 			 * before release), and may be read by other threads.
 			 */
 			atomic_b_t locked;
+			/* Slot of the witness rank, for the spin limit lookup. */
+			uint8_t spin_rank_slot;
 #ifdef _WIN32
 #	if _WIN32_WINNT >= 0x0600
 			SRWLOCK lock;
@@ -48,6 +58,9 @@ struct malloc_mutex_s {
 #	endif
 #elif (defined(JEMALLOC_OS_UNFAIR_LOCK))
 			os_unfair_lock lock;
+#elif (defined(JEMALLOC_MUTEX_FUTEX))
+			/* One of the MALLOC_MUTEX_FUTEX_* states. */
+			atomic_u32_t lock;
 #elif (defined(JEMALLOC_MUTEX_INIT_CB))
 			pthread_mutex_t lock;
 			malloc_mutex_t *postponed_next;
@@ -90,6 +103,10 @@ struct malloc_mutex_s {
 #	define MALLOC_MUTEX_LOCK(m) os_unfair_lock_lock(&(m)->lock)
 #	define MALLOC_MUTEX_UNLOCK(m) os_unfair_lock_unlock(&(m)->lock)
 #	define MALLOC_MUTEX_TRYLOCK(m) (!os_unfair_lock_trylock(&(m)->lock))
+#elif (defined(JEMALLOC_MUTEX_FUTEX))
+#	define MALLOC_MUTEX_LOCK(m) malloc_mutex_futex_lock(&(m)->lock)
+#	define MALLOC_MUTEX_UNLOCK(m) malloc_mutex_futex_unlock(&(m)->lock)
+#	define MALLOC_MUTEX_TRYLOCK(m) malloc_mutex_futex_trylock(&(m)->lock)
 #else
 #	define MALLOC_MUTEX_LOCK(m) pthread_mutex_lock(&(m)->lock)
 #	define MALLOC_MUTEX_UNLOCK(m) pthread_mutex_unlock(&(m)->lock)
@@ -99,7 +116,9 @@ struct malloc_mutex_s {
 #define LOCK_PROF_DATA_INITIALIZER                                             \
 	{                                                                      \
 		NSTIME_ZERO_INITIALIZER, NSTIME_ZERO_INITIALIZER, 0, 0, 0,     \
-		    ATOMIC_INIT(0), 0, NULL, 0                                 \
+		    ATOMIC_INIT(0), 0, NSTIME_ZERO_INITIALIZER,                \
+		    NSTIME_ZERO_INITIALIZER, {0}, NSTIME_ZERO_INITIALIZER, 0,  \
+		    NULL, 0, 0, false                                          \
 	}
 
 #ifdef _WIN32
@@ -109,7 +128,8 @@ struct malloc_mutex_s {
 #		define MALLOC_MUTEX_INITIALIZER                               \
 			{                                                      \
 				{{LOCK_PROF_DATA_INITIALIZER,                  \
-				    ATOMIC_INIT(false), OS_UNFAIR_LOCK_INIT}}, \
+				    ATOMIC_INIT(false), 0,                     \
+				    OS_UNFAIR_LOCK_INIT}},                     \
 				    WITNESS_INITIALIZER(                       \
 				        "mutex", WITNESS_RANK_OMIT),           \
 				    0                                          \
@@ -118,7 +138,29 @@ struct malloc_mutex_s {
 #		define MALLOC_MUTEX_INITIALIZER                               \
 			{                                                      \
 				{{LOCK_PROF_DATA_INITIALIZER,                  \
-				    ATOMIC_INIT(false), OS_UNFAIR_LOCK_INIT}}, \
+				    ATOMIC_INIT(false), 0,                     \
+				    OS_UNFAIR_LOCK_INIT}},                     \
+				    WITNESS_INITIALIZER(                       \
+				        "mutex", WITNESS_RANK_OMIT)            \
+			}
+#	endif
+#elif (defined(JEMALLOC_MUTEX_FUTEX))
+#	if defined(JEMALLOC_DEBUG)
+#		define MALLOC_MUTEX_INITIALIZER                               \
+			{                                                      \
+				{{LOCK_PROF_DATA_INITIALIZER,                  \
+				    ATOMIC_INIT(false), 0,                     \
+				    ATOMIC_INIT(MALLOC_MUTEX_FUTEX_UNLOCKED)}}, \
+				    WITNESS_INITIALIZER(                       \
+				        "mutex", WITNESS_RANK_OMIT),           \
+				    0                                          \
+			}
+#	else
+#		define MALLOC_MUTEX_INITIALIZER                               \
+			{                                                      \
+				{{LOCK_PROF_DATA_INITIALIZER,                  \
+				    ATOMIC_INIT(false), 0,                     \
+				    ATOMIC_INIT(MALLOC_MUTEX_FUTEX_UNLOCKED)}}, \
 				    WITNESS_INITIALIZER(                       \
 				        "mutex", WITNESS_RANK_OMIT)            \
 			}
@@ -128,7 +170,7 @@ struct malloc_mutex_s {
 #		define MALLOC_MUTEX_INITIALIZER                               \
 			{                                                      \
 				{{LOCK_PROF_DATA_INITIALIZER,                  \
-				    ATOMIC_INIT(false),                        \
+				    ATOMIC_INIT(false), 0,                     \
 				    PTHREAD_MUTEX_INITIALIZER, NULL}},         \
 				    WITNESS_INITIALIZER(                       \
 				        "mutex", WITNESS_RANK_OMIT),           \
@@ -138,7 +180,7 @@ struct malloc_mutex_s {
 #		define MALLOC_MUTEX_INITIALIZER                               \
 			{                                                      \
 				{{LOCK_PROF_DATA_INITIALIZER,                  \
-				    ATOMIC_INIT(false),                        \
+				    ATOMIC_INIT(false), 0,                     \
 				    PTHREAD_MUTEX_INITIALIZER, NULL}},         \
 				    WITNESS_INITIALIZER(                       \
 				        "mutex", WITNESS_RANK_OMIT)            \
@@ -151,7 +193,7 @@ struct malloc_mutex_s {
 #		define MALLOC_MUTEX_INITIALIZER                               \
 			{                                                      \
 				{{LOCK_PROF_DATA_INITIALIZER,                  \
-				    ATOMIC_INIT(false),                        \
+				    ATOMIC_INIT(false), 0,                     \
 				    PTHREAD_MUTEX_INITIALIZER}},               \
 				    WITNESS_INITIALIZER(                       \
 				        "mutex", WITNESS_RANK_OMIT),           \
@@ -161,7 +203,7 @@ struct malloc_mutex_s {
 #		define MALLOC_MUTEX_INITIALIZER                               \
 			{                                                      \
 				{{LOCK_PROF_DATA_INITIALIZER,                  \
-				    ATOMIC_INIT(false),                        \
+				    ATOMIC_INIT(false), 0,                     \
 				    PTHREAD_MUTEX_INITIALIZER}},               \
 				    WITNESS_INITIALIZER(                       \
 				        "mutex", WITNESS_RANK_OMIT)            \
@@ -185,6 +227,54 @@ bool malloc_mutex_boot(void);
 void malloc_mutex_prof_data_reset(tsdn_t *tsdn, malloc_mutex_t *mutex);
 
 void malloc_mutex_lock_slow(malloc_mutex_t *mutex);
+void malloc_mutex_hold_sample_begin(malloc_mutex_t *mutex);
+void malloc_mutex_hold_sample_end(malloc_mutex_t *mutex);
+bool malloc_mutex_max_spin_ranks_parse(const char *v, size_t vlen);
+int64_t malloc_mutex_max_spin_get(witness_rank_t rank);
+
+#ifdef JEMALLOC_MUTEX_FUTEX
+/*
+ * The futex word goes from UNLOCKED to LOCKED on an uncontended acquire, and to
+ * CONTENDED once some thread may be sleeping on it; unlocking a CONTENDED lock
+ * wakes exactly one sleeper, instead of the whole herd.
+ */
+#	define MALLOC_MUTEX_FUTEX_UNLOCKED 0U
+#	define MALLOC_MUTEX_FUTEX_LOCKED 1U
+#	define MALLOC_MUTEX_FUTEX_CONTENDED 2U
+
+void malloc_mutex_futex_lock_slow(atomic_u32_t *lock);
+/*
+ * Thin futex(2) wrappers.  malloc_futex_wait() sleeps as long as *word == val,
+ * until woken or until the (CLOCK_REALTIME, absolute) deadline, if any, passes;
+ * it returns ETIMEDOUT on timeout and 0 otherwise (including spurious wakeups).
+ */
+int  malloc_futex_wait(
+     atomic_u32_t *word, uint32_t val, const struct timespec *deadline);
+void malloc_futex_wake(atomic_u32_t *word, int nwake);
+
+/* Returns true if the lock was *not* acquired, like the pthread variant. */
+static inline bool
+malloc_mutex_futex_trylock(atomic_u32_t *lock) {
+	uint32_t expected = MALLOC_MUTEX_FUTEX_UNLOCKED;
+	return !atomic_compare_exchange_strong_u32(lock, &expected,
+	    MALLOC_MUTEX_FUTEX_LOCKED, ATOMIC_ACQUIRE, ATOMIC_RELAXED);
+}
+
+static inline void
+malloc_mutex_futex_lock(atomic_u32_t *lock) {
+	if (malloc_mutex_futex_trylock(lock)) {
+		malloc_mutex_futex_lock_slow(lock);
+	}
+}
+
+static inline void
+malloc_mutex_futex_unlock(atomic_u32_t *lock) {
+	if (atomic_exchange_u32(lock, MALLOC_MUTEX_FUTEX_UNLOCKED, ATOMIC_RELEASE)
+	    == MALLOC_MUTEX_FUTEX_CONTENDED) {
+		malloc_futex_wake(lock, 1);
+	}
+}
+#endif
 
 static inline void
 malloc_mutex_lock_final(malloc_mutex_t *mutex) {
@@ -211,6 +301,21 @@ mutex_owner_stats_update(tsdn_t *tsdn, malloc_mutex_t *mutex) {
 			data->prev_owner = tsdn;
 			data->n_owner_switches++;
 		}
+		if (unlikely(opt_mutex_hold_sample != 0)) {
+			if (data->hold_sample_countdown == 0) {
+				malloc_mutex_hold_sample_begin(mutex);
+			} else {
+				data->hold_sample_countdown--;
+			}
+		}
+	}
+}
+
+/* Ends the timing of the current hold, if it is being sampled. */
+static inline void
+mutex_hold_sample_finish(malloc_mutex_t *mutex) {
+	if (config_stats && unlikely(mutex->prof_data.hold_sampled)) {
+		malloc_mutex_hold_sample_end(mutex);
 	}
 }
 
@@ -247,6 +352,15 @@ malloc_mutex_prof_merge(mutex_prof_data_t *sum, mutex_prof_data_t *data) {
 	sum->n_wait_times += data->n_wait_times;
 	sum->n_spin_acquired += data->n_spin_acquired;
 
+	sum->n_hold_samples += data->n_hold_samples;
+	nstime_add(&sum->tot_hold_time, &data->tot_hold_time);
+	if (nstime_compare(&sum->max_hold_time, &data->max_hold_time) < 0) {
+		nstime_copy(&sum->max_hold_time, &data->max_hold_time);
+	}
+	for (unsigned i = 0; i < MUTEX_PROF_HOLD_HIST_NBUCKETS; i++) {
+		sum->hold_hist[i] += data->hold_hist[i];
+	}
+
 	if (sum->max_n_thds < data->max_n_thds) {
 		sum->max_n_thds = data->max_n_thds;
 	}
@@ -278,6 +392,7 @@ malloc_mutex_unlock(tsdn_t *tsdn, malloc_mutex_t *mutex) {
 	witness_unlock(tsdn_witness_tsdp_get(tsdn), &mutex->witness);
 	if (isthreaded) {
 		assert(malloc_mutex_is_locked(mutex));
+		mutex_hold_sample_finish(mutex);
 		atomic_store_b(&mutex->locked, false, ATOMIC_RELAXED);
 		MALLOC_MUTEX_UNLOCK(mutex);
 	}
@@ -27,6 +27,7 @@ typedef enum {
 #define MUTEX_PROF_ARENA_MUTEXES                                               \
 	OP(large)                                                              \
 	OP(extent_avail)                                                       \
+	OP(edata_cache_percpu)                                                 \
 	OP(extents_dirty)                                                      \
 	OP(extents_muzzy)                                                      \
 	OP(extents_retained)                                                   \
@@ -61,7 +62,11 @@ typedef enum {
 	OP(num_owner_switch_ps, uint64_t, "(#/sec)", true, num_owner_switch)   \
 	OP(total_wait_time, uint64_t, "total_wait_ns", false, total_wait_time) \
 	OP(total_wait_time_ps, uint64_t, "(#/sec)", true, total_wait_time)     \
-	OP(max_wait_time, uint64_t, "max_wait_ns", false, max_wait_time)
+	OP(max_wait_time, uint64_t, "max_wait_ns", false, max_wait_time)     \
+	OP(num_hold_samples, uint64_t, "n_hold_samp", false,                   \
+	    num_hold_samples)                                                  \
+	OP(total_hold_time, uint64_t, "total_hold_ns", false, total_hold_time) \
+	OP(max_hold_time, uint64_t, "max_hold_ns", false, max_hold_time)
 
 #define MUTEX_PROF_UINT32_COUNTERS                                             \
 	OP(max_num_thds, uint32_t, "max_n_thds", false, max_num_thds)
@@ -83,6 +88,15 @@ COUNTER_ENUM(MUTEX_PROF_UINT32_COUNTERS, uint32_t)
 #undef COUNTER_ENUM
 #undef OP
 
+/*
+ * Sampled hold times (see opt.mutex_hold_sample) are kept in a log2 histogram
+ * of nanoseconds: bucket 0 counts holds shorter than
+ * 2^MUTEX_PROF_HOLD_HIST_LG_MIN ns, bucket i > 0 counts holds in
+ * [2^(LG_MIN + i - 1), 2^(LG_MIN + i)) ns, and the last bucket is open ended.
+ */
+#define MUTEX_PROF_HOLD_HIST_LG_MIN 7
+#define MUTEX_PROF_HOLD_HIST_NBUCKETS 16
+
 typedef struct {
 	/*
 	 * Counters touched on the slow path, i.e. when there is lock
@@ -101,6 +115,19 @@ typedef struct {
 	/* Current # of threads waiting on the lock.  Atomic synced. */
 	atomic_u32_t n_waiting_thds;
 
+	/*
+	 * Hold time samples, updated (with the mutex held) when a sampled hold
+	 * ends.
+	 */
+	/* # of sampled holds. */
+	uint64_t n_hold_samples;
+	/* Total and max time (in nano seconds) of the sampled holds. */
+	nstime_t tot_hold_time;
+	nstime_t max_hold_time;
+	uint64_t hold_hist[MUTEX_PROF_HOLD_HIST_NBUCKETS];
+	/* Start time of the current hold, valid if hold_sampled. */
+	nstime_t hold_start;
+
 	/*
 	 * Data touched on the fast path.  These are modified right after we
 	 * grab the lock, so it's placed closest to the end (i.e. right before
@@ -113,6 +140,10 @@ typedef struct {
 	tsdn_t *prev_owner;
 	/* # of lock() operations in total. */
 	uint64_t n_lock_ops;
+	/* # of acquisitions to skip before sampling the next hold. */
+	uint64_t hold_sample_countdown;
+	/* Whether the current hold is being timed. */
+	bool hold_sampled;
 } mutex_prof_data_t;
 
 #endif /* JEMALLOC_INTERNAL_MUTEX_PROF_H */
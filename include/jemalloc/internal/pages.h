@@ -85,6 +85,25 @@ static const bool pages_can_purge_forced =
 #endif
     ;
 
+/*
+ * PAGES_CAN_REMAP is defined if pages can be moved between two mappings without
+ * copying their contents.  This needs MREMAP_DONTUNMAP: without it, the old
+ * range would be left unmapped until refilled, and another thread could map
+ * something there in between.
+ */
+#if !defined(_WIN32) && defined(JEMALLOC_HAVE_MREMAP)                         \
+    && defined(MREMAP_DONTUNMAP)
+#	define PAGES_CAN_REMAP
+#endif
+
+static const bool pages_can_remap =
+#ifdef PAGES_CAN_REMAP
+    true
+#else
+    false
+#endif
+    ;
+
 #if defined(JEMALLOC_HAVE_MADVISE_HUGE) || defined(JEMALLOC_HAVE_MEMCNTL)
 #	define PAGES_CAN_HUGIFY
 #endif
@@ -129,6 +148,7 @@ bool  pages_commit(void *addr, size_t size);
 bool  pages_decommit(void *addr, size_t size);
 bool  pages_purge_lazy(void *addr, size_t size);
 bool  pages_purge_forced(void *addr, size_t size);
+bool  pages_remap(void *old_addr, void *new_addr, size_t size);
 bool pages_purge_process_madvise(void *vec, size_t ven_len, size_t total_bytes);
 bool pages_huge(void *addr, size_t size);
 bool pages_nohuge(void *addr, size_t size);
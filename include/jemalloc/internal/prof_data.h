@@ -8,30 +8,52 @@ extern malloc_mutex_t bt2gctx_mtx;
 extern malloc_mutex_t tdatas_mtx;
 extern malloc_mutex_t prof_dump_mtx;
 
+extern malloc_mutex_t *bt2gctx_locks;
 extern malloc_mutex_t *gctx_locks;
 extern malloc_mutex_t *tdata_locks;
 
 extern size_t prof_unbiased_sz[PROF_SC_NSIZES];
 extern size_t prof_shifted_unbiased_cnt[PROF_SC_NSIZES];
 
+/* Whether changed contexts are tracked, for delta dumps. */
+extern atomic_b_t prof_dump_delta_tracking;
+
 void prof_bt_hash(const void *key, size_t r_hash[2]);
 bool prof_bt_keycomp(const void *k1, const void *k2);
 
 bool         prof_data_init(tsd_t *tsd);
+void         prof_data_postfork_child(void);
 prof_tctx_t *prof_lookup(tsd_t *tsd, prof_bt_t *bt);
 int          prof_thread_name_set_impl(tsd_t *tsd, const char *thread_name);
 void         prof_unbias_map_init(void);
+void prof_gctx_delta_dirty_push(prof_gctx_t *gctx);
+void prof_dump_delta_failed(tsdn_t *tsdn);
 void prof_dump_impl(tsd_t *tsd, write_cb_t *prof_dump_write, void *cbopaque,
-    prof_tdata_t *tdata, bool leakcheck);
+    prof_tdata_t *tdata, bool leakcheck, bool delta);
+typedef void(prof_dump_bin_write_t)(void *, const void *, size_t);
+void prof_dump_binary_impl(tsd_t *tsd, prof_dump_bin_write_t *prof_dump_write,
+    void *cbopaque, prof_tdata_t *tdata, bool leakcheck, bool delta);
+typedef void(prof_tdata_visit_t)(tsdn_t *, prof_tdata_t *, void *);
+void          prof_tdata_foreach(
+             tsdn_t *tsdn, prof_tdata_visit_t *visit, void *arg);
 prof_tdata_t *prof_tdata_init_impl(tsd_t *tsd, uint64_t thr_uid,
     uint64_t thr_discrim, char *thread_name, bool active);
 void          prof_tdata_detach(tsd_t *tsd, prof_tdata_t *tdata);
 void          prof_reset(tsd_t *tsd, size_t lg_sample);
 void          prof_tctx_try_destroy(tsd_t *tsd, prof_tctx_t *tctx);
+void          prof_gctx_lifetime_record(
+             tsdn_t *tsdn, prof_gctx_t *gctx, const nstime_t *alloc_time);
+unsigned      prof_leak_epoch_get(void);
+void          prof_leak_epoch_end(tsd_t *tsd, prof_tdata_t *tdata);
+void          prof_leak_report_write(tsd_t *tsd, prof_tdata_t *tdata,
+             write_cb_t *write_cb, void *cbopaque);
 
 /* Used in unit tests. */
-size_t prof_tdata_count(void);
-size_t prof_bt_count(void);
-void   prof_cnt_all(prof_cnt_t *cnt_all);
+size_t       prof_tdata_count(void);
+size_t       prof_bt_count(void);
+prof_gctx_t *prof_bt2gctx_lookup(tsd_t *tsd, prof_bt_t *bt);
+bool         prof_bt2gctx_validate(
+             tsd_t *tsd, size_t *r_nslots, size_t *r_nused);
+void         prof_cnt_all(prof_cnt_t *cnt_all);
 
 #endif /* JEMALLOC_INTERNAL_PROF_DATA_H */
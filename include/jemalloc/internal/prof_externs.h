@@ -41,6 +41,37 @@ extern bool opt_prof_sys_thread_name;
 /* Whether to record per size class counts and request size totals. */
 extern bool opt_prof_stats;
 
+/*
+ * Whether the frame pointer unwinder checks each frame, and falls back to DWARF
+ * unwinding for samples with frames it can't trust.
+ */
+extern bool opt_prof_unwind_validate;
+
+/* Whether to keep per-backtrace histograms of sampled object lifetimes. */
+extern bool opt_prof_lifetime;
+
+/* Whether to attribute sampled objects to the arenas they come from. */
+extern bool opt_prof_per_arena;
+
+/*
+ * Whether allocation logs are streamed to their file while logging, and the
+ * size of each of the two buffers used to do so.
+ */
+extern bool   opt_prof_log_stream;
+extern size_t opt_prof_log_stream_buf_size;
+
+/*
+ * Number of consecutive epochs during which the live sampled bytes of a
+ * backtrace have to grow for the leak detector to report it (0 disables leak
+ * detection), and the epoch length (0: epochs only end via prof.leak_epoch).
+ */
+extern unsigned opt_prof_leak_epochs;
+extern uint64_t opt_prof_leak_epoch_ms;
+
+/* Format of heap profile dumps. */
+extern prof_dump_format_t opt_prof_dump_format;
+extern const char *const  prof_dump_format_names[];
+
 /* Accessed via prof_active_[gs]et{_unlocked,}(). */
 extern bool prof_active_state;
 
@@ -82,9 +113,16 @@ void prof_malloc_sample_object(
     tsd_t *tsd, const void *ptr, size_t size, size_t usize, prof_tctx_t *tctx);
 void prof_free_sampled_object(
     tsd_t *tsd, const void *ptr, size_t usize, prof_info_t *prof_info);
-prof_tctx_t *prof_tctx_create(tsd_t *tsd);
+prof_tctx_t *prof_tctx_create(tsd_t *tsd, unsigned arena_ind);
 void         prof_idump(tsdn_t *tsdn);
 bool         prof_mdump(tsd_t *tsd, const char *filename);
+bool         prof_ddump(tsd_t *tsd, const char *filename);
+bool         prof_leak_epoch_advance(tsd_t *tsd);
+uint64_t     prof_leak_epoch_ns_until_due(void);
+void         prof_leak_epoch_deferred_work(tsd_t *tsd);
+/* Work left to the background thread; called with no locks held. */
+void         prof_background_work(tsd_t *tsd);
+bool prof_leak_report(tsd_t *tsd, write_cb_t *write_cb, void *cbopaque);
 void         prof_gdump(tsdn_t *tsdn);
 
 void        prof_tdata_cleanup(tsd_t *tsd);
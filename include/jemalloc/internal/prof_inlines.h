@@ -32,6 +32,16 @@ prof_active_get_unlocked(void) {
 	return prof_active_state;
 }
 
+/* Returns the lifetime histogram bucket for ns; see PROF_LIFETIME_NBUCKETS. */
+JEMALLOC_ALWAYS_INLINE unsigned
+prof_lifetime_bucket(uint64_t ns) {
+	if (ns == 0) {
+		return 0;
+	}
+	unsigned lg = fls_u64(ns);
+	return lg < PROF_LIFETIME_NBUCKETS ? lg : PROF_LIFETIME_NBUCKETS - 1;
+}
+
 JEMALLOC_ALWAYS_INLINE bool
 prof_gdump_get_unlocked(void) {
 	/*
@@ -160,15 +170,20 @@ prof_sample_should_skip(tsd_t *tsd, bool sample_event) {
 	return !tdata->active;
 }
 
+/*
+ * arena_ind is the arena the allocation is expected to come from, or
+ * ARENA_IND_AUTOMATIC for the thread's arena; see opt_prof_per_arena.
+ */
 JEMALLOC_ALWAYS_INLINE prof_tctx_t *
-prof_alloc_prep(tsd_t *tsd, bool prof_active, bool sample_event) {
+prof_alloc_prep(
+    tsd_t *tsd, bool prof_active, bool sample_event, unsigned arena_ind) {
 	prof_tctx_t *ret;
 
 	if (!prof_active
 	    || likely(prof_sample_should_skip(tsd, sample_event))) {
 		ret = PROF_TCTX_SENTINEL;
 	} else {
-		ret = prof_tctx_create(tsd);
+		ret = prof_tctx_create(tsd, arena_ind);
 	}
 
 	return ret;
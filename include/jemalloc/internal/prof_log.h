@@ -5,8 +5,10 @@
 #include "jemalloc/internal/mutex.h"
 
 extern malloc_mutex_t log_mtx;
+extern malloc_mutex_t log_stream_mtx;
 
 void prof_try_log(tsd_t *tsd, size_t usize, prof_info_t *prof_info);
+void prof_log_stream_flush(tsd_t *tsd);
 bool prof_log_init(tsd_t *tsdn);
 
 /* Used in unit tests. */
@@ -19,5 +21,7 @@ void   prof_log_dummy_set(bool new_value);
 
 bool prof_log_start(tsdn_t *tsdn, const char *filename);
 bool prof_log_stop(tsdn_t *tsdn);
+/* Records dropped by the current or last streamed log. */
+uint64_t prof_log_dropped_get(tsdn_t *tsdn);
 
 #endif /* JEMALLOC_INTERNAL_PROF_LOG_H */
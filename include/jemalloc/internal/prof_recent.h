@@ -14,9 +14,10 @@ void prof_recent_alloc_reset(tsd_t *tsd, edata_t *edata);
 bool prof_recent_init(void);
 void edata_prof_recent_alloc_init(edata_t *edata);
 
-/* Used in unit tests. */
 typedef ql_head(prof_recent_t) prof_recent_list_t;
-extern prof_recent_list_t prof_recent_alloc_list;
+
+/* Used in unit tests. */
+size_t   prof_recent_alloc_records_test(prof_recent_t **records, size_t limit);
 edata_t *prof_recent_alloc_edata_get_no_lock_test(const prof_recent_t *node);
 prof_recent_t *edata_prof_recent_alloc_get_no_lock_test(const edata_t *edata);
 
@@ -12,6 +12,11 @@ struct prof_bt_s {
 	/* Backtrace, stored as len program counters. */
 	void   **vec;
 	unsigned len;
+	/*
+	 * Arena of the sampled objects, if opt_prof_per_arena is enabled; 0
+	 * otherwise.  Backtraces in different arenas are distinct.
+	 */
+	unsigned arena_ind;
 };
 
 #ifdef JEMALLOC_PROF_LIBGCC
@@ -134,9 +139,61 @@ struct prof_gctx_s {
 	/* Linkage for tree of contexts to be dumped. */
 	rb_node(prof_gctx_t) dump_link;
 
+	/*
+	 * Set (under lock) once gctx has been removed from bt2gctx.  Lookups
+	 * can still find a removed gctx until it is freed, and must skip it.
+	 */
+	bool unlinked;
+
+	/* Linkage for the list of removed contexts awaiting deallocation. */
+	prof_gctx_t *retired_next;
+
+	/* Hash of bt, which selects the bt2gctx slot and stripe lock. */
+	size_t bt_hash;
+
 	/* Temporary storage for summation during dump. */
 	prof_cnt_t cnt_summed;
 
+	/*
+	 * Histogram of the lifetimes of the sampled objects freed so far, with
+	 * PROF_LIFETIME_NBUCKETS buckets, if opt_prof_lifetime is enabled; NULL
+	 * otherwise.  Stored past vec, and protected by lock.
+	 */
+	uint64_t *lifetimes;
+
+	/*
+	 * Once delta dumps are in use, set whenever a sampled object of this
+	 * context is allocated or freed, and cleared by the delta dump that
+	 * picks up the change.  A context is on the list of changed contexts,
+	 * linked through delta_next, exactly while this is set, and must not
+	 * be destroyed then.
+	 */
+	atomic_b_t   delta_dirty;
+	prof_gctx_t *delta_next;
+
+	/*
+	 * Whether the last delta dump reported nonzero counters for this
+	 * context.  It then must not be destroyed until a delta dump has
+	 * reported it as empty.  Protected by lock.
+	 */
+	bool delta_reported;
+
+	/*
+	 * The dump that last included this context.  Protected by lock, and
+	 * stable while bt2gctx_mtx is held.
+	 */
+	uint64_t dump_epoch;
+
+	/*
+	 * Leak detection state (opt.prof_leak_epochs), updated at the end of
+	 * each epoch: the number of consecutive epochs during which the live
+	 * sampled bytes grew, the live sampled bytes at the end of the last
+	 * epoch, and at the start of the streak.  Protected by lock.
+	 */
+	unsigned leak_nepochs;
+	uint64_t leak_bytes;
+	uint64_t leak_base_bytes;
+
 	/* Associated backtrace. */
 	prof_bt_t bt;
 
@@ -204,6 +261,12 @@ struct prof_tdata_s {
 
 	/* Backtrace vector, used for calls to prof_backtrace(). */
 	void **vec;
+
+	/*
+	 * Ring of the recent allocations (opt.prof_recent_alloc_max) by this
+	 * thread, oldest first.  Protected by lock.
+	 */
+	ql_head(prof_recent_t) recent_allocs;
 };
 typedef rb_tree(prof_tdata_t) prof_tdata_tree_t;
 
@@ -212,6 +275,8 @@ struct prof_recent_s {
 	nstime_t dalloc_time;
 
 	ql_elm(prof_recent_t) link;
+	/* Global order of the record, among those of all threads. */
+	size_t       seq;
 	size_t       size;
 	size_t       usize;
 	atomic_p_t   alloc_edata; /* NULL means allocation has been freed. */
@@ -19,6 +19,7 @@ bool prof_prefix_set(tsdn_t *tsdn, const char *prefix);
 void prof_fdump_impl(tsd_t *tsd);
 void prof_idump_impl(tsd_t *tsd);
 bool prof_mdump_impl(tsd_t *tsd, const char *filename);
+bool prof_ddump_impl(tsd_t *tsd, const char *filename);
 void prof_gdump_impl(tsd_t *tsd);
 int  prof_thread_stack_range(uintptr_t fp, uintptr_t *low, uintptr_t *high);
 
@@ -17,6 +17,8 @@ typedef struct prof_recent_s prof_recent_t;
 #endif
 #define LG_PROF_SAMPLE_DEFAULT 19
 #define LG_PROF_INTERVAL_DEFAULT -1
+#define PROF_LEAK_EPOCH_MS_DEFAULT (60 * 1000)
+#define PROF_LOG_STREAM_BUF_SIZE_DEFAULT (64 * 1024)
 
 /*
  * Hard limit on stack backtrace depth.  The version of prof_backtrace() that
@@ -30,6 +32,33 @@ typedef struct prof_recent_s prof_recent_t;
 #endif
 #define PROF_BT_MAX_DEFAULT 128
 
+/* Heap profile dump formats; see opt.prof_dump_format. */
+enum prof_dump_format_e {
+	prof_dump_format_text = 0,
+	prof_dump_format_binary = 1,
+	prof_dump_format_limit = 2
+};
+typedef enum prof_dump_format_e prof_dump_format_t;
+
+/*
+ * Number of gctx's whose counters the binary dump copies out at a time; the
+ * copies are then encoded and written without holding any gctx lock.
+ */
+#define PROF_DUMP_BATCH 32
+
+/*
+ * Number of log2 buckets in the per-backtrace histograms of sampled object
+ * lifetimes (opt.prof_lifetime).  Bucket i counts lifetimes in [2^i, 2^(i+1))
+ * nanoseconds, except that bucket 0 also counts 0, and the last bucket counts
+ * all longer lifetimes (2^47 ns is about 39 hours).
+ */
+#ifdef JEMALLOC_PROF
+#	define PROF_LIFETIME_NBUCKETS 48
+#else
+/* Minimize memory bloat for non-prof builds. */
+#	define PROF_LIFETIME_NBUCKETS 1
+#endif
+
 /* Initial hash table size. */
 #define PROF_CKH_MINITEMS 64
 
@@ -52,6 +81,19 @@ typedef struct prof_recent_s prof_recent_t;
 #	define PROF_SC_NSIZES 1
 #endif
 
+/*
+ * Stack bounds of a thread, looked up the first time the frame pointer unwinder
+ * runs on it.  fallback is set if they couldn't be determined, or no longer
+ * hold (e.g. the thread switched to a fiber stack).
+ */
+typedef struct prof_stack_range_s prof_stack_range_t;
+struct prof_stack_range_s {
+	uintptr_t low;
+	uintptr_t high;
+	bool      fallback;
+};
+#define PROF_STACK_RANGE_INITIALIZER {0, 0, false}
+
 /* Size of stack-allocated buffer used by prof_printf(). */
 #define PROF_PRINTF_BUFSIZE 128
 
@@ -61,6 +103,13 @@ typedef struct prof_recent_s prof_recent_t;
  */
 #define PROF_NCTX_LOCKS 1024
 
+/*
+ * Number of mutexes that serialize writers to the global backtrace table.  A
+ * backtrace always maps to the same stripe, so inserting and removing it never
+ * contend with writers of other stripes; readers take no stripe at all.
+ */
+#define PROF_BT2GCTX_NSTRIPES 64
+
 /*
  * Number of mutexes shared among all tdata's.  No space is allocated for these
  * unless profiling is enabled, so it's okay to over-provision.
@@ -360,6 +360,7 @@ rtree_leaf_elm_lookup_fast(tsdn_t *tsdn, rtree_t *rtree, rtree_ctx_t *rtree_ctx,
 
 	rtree_leaf_elm_t *leaf = rtree_ctx->cache[slot].leaf;
 	assert(leaf != NULL);
+	RTREE_CTX_STATS_INC(rtree_ctx, hits);
 	uintptr_t subkey = rtree_subkey(key, RTREE_HEIGHT - 1);
 	*elm = &leaf[subkey];
 
@@ -380,6 +381,7 @@ rtree_leaf_elm_lookup(tsdn_t *tsdn, rtree_t *rtree, rtree_ctx_t *rtree_ctx,
 	if (likely(rtree_ctx->cache[slot].leafkey == leafkey)) {
 		rtree_leaf_elm_t *leaf = rtree_ctx->cache[slot].leaf;
 		assert(leaf != NULL);
+		RTREE_CTX_STATS_INC(rtree_ctx, hits);
 		uintptr_t subkey = rtree_subkey(key, RTREE_HEIGHT - 1);
 		return &leaf[subkey];
 	}
@@ -410,6 +412,7 @@ rtree_leaf_elm_lookup(tsdn_t *tsdn, rtree_t *rtree, rtree_ctx_t *rtree_ctx,
 			}                                                      \
 			rtree_ctx->cache[slot].leafkey = leafkey;              \
 			rtree_ctx->cache[slot].leaf = leaf;                    \
+			RTREE_CTX_STATS_INC(rtree_ctx, l2_hits);               \
 			uintptr_t subkey = rtree_subkey(                       \
 			    key, RTREE_HEIGHT - 1);                            \
 			return &leaf[subkey];                                  \
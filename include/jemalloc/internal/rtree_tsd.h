@@ -20,8 +20,29 @@
  * cache misses if made overly large, plus the cost of linear search in the LRU
  * cache.
  */
-#define RTREE_CTX_NCACHE 16
-#define RTREE_CTX_NCACHE_L2 8
+#ifdef JEMALLOC_RTREE_CTX_NCACHE
+#  define RTREE_CTX_NCACHE JEMALLOC_RTREE_CTX_NCACHE
+#else
+#  define RTREE_CTX_NCACHE 16
+#endif
+#ifdef JEMALLOC_RTREE_CTX_NCACHE_L2
+#  define RTREE_CTX_NCACHE_L2 JEMALLOC_RTREE_CTX_NCACHE_L2
+#else
+#  define RTREE_CTX_NCACHE_L2 8
+#endif
+
+/*
+ * Both sizes must be powers of two: the L1 slot is computed with a mask, and
+ * the static initializer below is built by repeated doubling.
+ */
+#if RTREE_CTX_NCACHE < 1 || RTREE_CTX_NCACHE > 256                             \
+    || (RTREE_CTX_NCACHE & (RTREE_CTX_NCACHE - 1)) != 0
+#  error "RTREE_CTX_NCACHE must be a power of two in [1, 256]"
+#endif
+#if RTREE_CTX_NCACHE_L2 < 1 || RTREE_CTX_NCACHE_L2 > 64                        \
+    || (RTREE_CTX_NCACHE_L2 & (RTREE_CTX_NCACHE_L2 - 1)) != 0
+#  error "RTREE_CTX_NCACHE_L2 must be a power of two in [1, 64]"
+#endif
 
 /* Needed for initialization only. */
 #define RTREE_LEAFKEY_INVALID ((uintptr_t)1)
@@ -33,19 +54,31 @@
 #define RTREE_CTX_INIT_ELM_4 RTREE_CTX_INIT_ELM_2, RTREE_CTX_INIT_ELM_2
 #define RTREE_CTX_INIT_ELM_8 RTREE_CTX_INIT_ELM_4, RTREE_CTX_INIT_ELM_4
 #define RTREE_CTX_INIT_ELM_16 RTREE_CTX_INIT_ELM_8, RTREE_CTX_INIT_ELM_8
+#define RTREE_CTX_INIT_ELM_32 RTREE_CTX_INIT_ELM_16, RTREE_CTX_INIT_ELM_16
+#define RTREE_CTX_INIT_ELM_64 RTREE_CTX_INIT_ELM_32, RTREE_CTX_INIT_ELM_32
+#define RTREE_CTX_INIT_ELM_128 RTREE_CTX_INIT_ELM_64, RTREE_CTX_INIT_ELM_64
+#define RTREE_CTX_INIT_ELM_256 RTREE_CTX_INIT_ELM_128, RTREE_CTX_INIT_ELM_128
 
 #define _RTREE_CTX_INIT_ELM_DATA(n) RTREE_CTX_INIT_ELM_##n
 #define RTREE_CTX_INIT_ELM_DATA(n) _RTREE_CTX_INIT_ELM_DATA(n)
 
+#ifdef JEMALLOC_RTREE_CTX_STATS
+#  define RTREE_CTX_STATS_INITIALIZER , {0, 0, 0, 0}
+#  define RTREE_CTX_STATS_INC(rtree_ctx, counter) ((rtree_ctx)->stats.counter++)
+#else
+#  define RTREE_CTX_STATS_INITIALIZER
+#  define RTREE_CTX_STATS_INC(rtree_ctx, counter)
+#endif
+
 /*
  * Static initializer (to invalidate the cache entries) is required because the
  * free fastpath may access the rtree cache before a full tsd initialization.
  */
 #define RTREE_CTX_INITIALIZER                                                  \
 	{                                                                      \
-		{RTREE_CTX_INIT_ELM_DATA(RTREE_CTX_NCACHE)}, {                 \
-			RTREE_CTX_INIT_ELM_DATA(RTREE_CTX_NCACHE_L2)           \
-		}                                                              \
+		{RTREE_CTX_INIT_ELM_DATA(RTREE_CTX_NCACHE)},                   \
+		    {RTREE_CTX_INIT_ELM_DATA(RTREE_CTX_NCACHE_L2)}             \
+		    RTREE_CTX_STATS_INITIALIZER                                \
 	}
 
 typedef struct rtree_leaf_elm_s rtree_leaf_elm_t;
@@ -56,14 +89,33 @@ struct rtree_ctx_cache_elm_s {
 	rtree_leaf_elm_t *leaf;
 };
 
+/*
+ * Per-thread lookup counters, only maintained when built with
+ * JEMALLOC_RTREE_CTX_STATS.  Every lookup lands in exactly one of hits, l2_hits
+ * or misses; evictions counts the valid L2 entries pushed out by misses.
+ */
+typedef struct rtree_ctx_stats_s rtree_ctx_stats_t;
+struct rtree_ctx_stats_s {
+	uint64_t hits;
+	uint64_t l2_hits;
+	uint64_t misses;
+	uint64_t evictions;
+};
+
 typedef struct rtree_ctx_s rtree_ctx_t;
 struct rtree_ctx_s {
 	/* Direct mapped cache. */
 	rtree_ctx_cache_elm_t cache[RTREE_CTX_NCACHE];
 	/* L2 LRU cache. */
 	rtree_ctx_cache_elm_t l2_cache[RTREE_CTX_NCACHE_L2];
+#ifdef JEMALLOC_RTREE_CTX_STATS
+	rtree_ctx_stats_t stats;
+#endif
 };
 
 void rtree_ctx_data_init(rtree_ctx_t *ctx);
+/* Copies out the counters; returns true if stats are not compiled in. */
+bool rtree_ctx_stats_read(rtree_ctx_t *ctx, rtree_ctx_stats_t *r_stats);
+void rtree_ctx_stats_reset(rtree_ctx_t *ctx);
 
 #endif /* JEMALLOC_INTERNAL_RTREE_CTX_H */
@@ -19,6 +19,27 @@ extern size_t   opt_tcache_gc_incr_bytes;
 extern size_t   opt_tcache_gc_delay_bytes;
 extern unsigned opt_lg_tcache_flush_small_div;
 extern unsigned opt_lg_tcache_flush_large_div;
+extern bool     opt_experimental_tcache_gc_reuse;
+extern ssize_t  opt_tcache_idle_reclaim_ms;
+extern ssize_t  opt_tcache_ncached_max_learn_ms;
+extern size_t   opt_tcache_large_cache_bytes;
+extern size_t   opt_tcache_large_cache_max;
+extern bool     opt_tcache_steal;
+extern bool     opt_tcache_fill_sort;
+
+/*
+ * Size classes below this go into the per thread cache of large extents when
+ * they don't have a cache bin; 0 if that cache is disabled.
+ */
+extern unsigned tcache_large_cache_nbins;
+
+/* Bytes flushed from tcaches found idle for opt.tcache_idle_reclaim_ms. */
+extern atomic_zu_t tcache_idle_reclaimed_bytes;
+/*
+ * Whether idle tcaches are flushed by the idle scan itself, rather than by
+ * their owners once they come back.  Needs membarrier(2).
+ */
+extern bool tcache_idle_reclaim_remote;
 
 /*
  * Number of tcache bins.  There are SC_NBINS small-object bins, plus 0 or more
@@ -54,10 +75,18 @@ void tcache_bin_flush_small(tsd_t *tsd, tcache_t *tcache,
     cache_bin_t *cache_bin, szind_t binind, unsigned rem);
 void tcache_bin_flush_large(tsd_t *tsd, tcache_t *tcache,
     cache_bin_t *cache_bin, szind_t binind, unsigned rem);
+bool tcache_bin_donate_small(tsd_t *tsd, tcache_t *tcache,
+    cache_bin_t *cache_bin, szind_t binind, unsigned rem);
 void tcache_bin_flush_stashed(tsd_t *tsd, tcache_t *tcache,
     cache_bin_t *cache_bin, szind_t binind, bool is_small);
 bool tcache_bin_info_default_init(
     const char *bin_settings_segment_cur, size_t len_left);
+void *tcache_large_cache_alloc(
+    tcache_t *tcache, size_t usize, szind_t szind, bool zero);
+bool tcache_large_cache_dalloc(
+    tsd_t *tsd, tcache_t *tcache, void *ptr, size_t usize, szind_t szind);
+void        tcache_ncached_max_learn_overflow(szind_t binind);
+const char *tcache_ncached_max_learned_get(void);
 bool tcache_bins_ncached_max_write(tsd_t *tsd, char *settings, size_t len);
 bool tcache_bin_ncached_max_read(
     tsd_t *tsd, size_t bin_size, cache_bin_sz_t *ncached_max);
@@ -77,6 +106,9 @@ void tcache_prefork(tsdn_t *tsdn);
 void tcache_postfork_parent(tsdn_t *tsdn);
 void tcache_postfork_child(tsdn_t *tsdn);
 void tcache_flush(tsd_t *tsd);
+void tcache_idle_reclaim_scan(tsdn_t *tsdn);
+bool tcache_owner_reclaim_running(tcache_slow_t *tcache_slow);
+void tcache_owner_wait(tcache_slow_t *tcache_slow);
 bool tsd_tcache_enabled_data_init(tsd_t *tsd);
 void tcache_enabled_set(tsd_t *tsd, bool enabled);
 
@@ -18,6 +18,69 @@ tcache_enabled_get(tsd_t *tsd) {
 	return tsd_tcache_enabled_get(tsd);
 }
 
+/*
+ * The arenas' lists of tcaches are only needed for stats, and to find idle
+ * tcaches.
+ */
+static inline bool
+tcache_ql_enabled(void) {
+	return config_stats || opt_tcache_idle_reclaim_ms >= 0;
+}
+
+/*
+ * Whether tcaches may be flushed by other threads, so that their owners have to
+ * say when they are using them.  Fixed at boot; without membarrier(2), known
+ * to be false at compile time.
+ */
+JEMALLOC_ALWAYS_INLINE bool
+tcache_idle_reclaim_remote_enabled(void) {
+#ifdef JEMALLOC_HAVE_MEMBARRIER
+	return unlikely(tcache_idle_reclaim_remote);
+#else
+	return false;
+#endif
+}
+
+/*
+ * The owner of a tcache brackets its uses of the cache bins off the malloc and
+ * free fast paths with these, so that tcache_idle_reclaim_scan() can tell when
+ * it is safe to flush the tcache from another thread.  The owner only fences
+ * the compiler between the store to owner_depth and the load of reclaim_state;
+ * the reclaimer makes up for it with membarrier(2) between its store to
+ * reclaim_state and its load of owner_depth.  Nests.
+ */
+JEMALLOC_ALWAYS_INLINE void
+tcache_owner_enter(tcache_slow_t *tcache_slow) {
+	if (!tcache_idle_reclaim_remote_enabled()) {
+		return;
+	}
+	uint32_t depth = atomic_load_u32(
+	    &tcache_slow->owner_depth, ATOMIC_RELAXED);
+	atomic_store_u32(&tcache_slow->owner_depth, depth + 1, ATOMIC_RELAXED);
+	atomic_compiler_fence();
+	if (unlikely(atomic_load_u32(&tcache_slow->reclaim_state,
+	        ATOMIC_ACQUIRE) != TCACHE_RECLAIM_NONE)) {
+		tcache_owner_wait(tcache_slow);
+	}
+}
+
+JEMALLOC_ALWAYS_INLINE void
+tcache_owner_exit(tcache_slow_t *tcache_slow) {
+	if (!tcache_idle_reclaim_remote_enabled()) {
+		return;
+	}
+	uint32_t depth = atomic_load_u32(
+	    &tcache_slow->owner_depth, ATOMIC_RELAXED);
+	assert(depth > 0);
+	atomic_store_u32(&tcache_slow->owner_depth, depth - 1, ATOMIC_RELEASE);
+}
+
+/* Whether a large size class without a cache bin may still be cached. */
+JEMALLOC_ALWAYS_INLINE bool
+tcache_large_cache_enabled(szind_t szind) {
+	return szind < tcache_large_cache_nbins;
+}
+
 static inline unsigned
 tcache_nbins_get(tcache_slow_t *tcache_slow) {
 	assert(tcache_slow != NULL);
@@ -87,8 +150,8 @@ tcache_bin_disabled(szind_t ind, cache_bin_t *bin, tcache_slow_t *tcache_slow) {
 }
 
 JEMALLOC_ALWAYS_INLINE void *
-tcache_alloc_small(tsd_t *tsd, arena_t *arena, tcache_t *tcache, size_t size,
-    szind_t binind, bool zero, bool slow_path) {
+tcache_alloc_small_impl(tsd_t *tsd, arena_t *arena, tcache_t *tcache,
+    size_t size, szind_t binind, bool zero, bool slow_path) {
 	void *ret;
 	bool  tcache_success;
 
@@ -131,8 +194,18 @@ tcache_alloc_small(tsd_t *tsd, arena_t *arena, tcache_t *tcache, size_t size,
 }
 
 JEMALLOC_ALWAYS_INLINE void *
-tcache_alloc_large(tsd_t *tsd, arena_t *arena, tcache_t *tcache, size_t size,
+tcache_alloc_small(tsd_t *tsd, arena_t *arena, tcache_t *tcache, size_t size,
     szind_t binind, bool zero, bool slow_path) {
+	tcache_owner_enter(tcache->tcache_slow);
+	void *ret = tcache_alloc_small_impl(
+	    tsd, arena, tcache, size, binind, zero, slow_path);
+	tcache_owner_exit(tcache->tcache_slow);
+	return ret;
+}
+
+JEMALLOC_ALWAYS_INLINE void *
+tcache_alloc_large_impl(tsd_t *tsd, arena_t *arena, tcache_t *tcache,
+    size_t size, szind_t binind, bool zero, bool slow_path) {
 	void *ret;
 	bool  tcache_success;
 
@@ -172,8 +245,18 @@ tcache_alloc_large(tsd_t *tsd, arena_t *arena, tcache_t *tcache, size_t size,
 	return ret;
 }
 
+JEMALLOC_ALWAYS_INLINE void *
+tcache_alloc_large(tsd_t *tsd, arena_t *arena, tcache_t *tcache, size_t size,
+    szind_t binind, bool zero, bool slow_path) {
+	tcache_owner_enter(tcache->tcache_slow);
+	void *ret = tcache_alloc_large_impl(
+	    tsd, arena, tcache, size, binind, zero, slow_path);
+	tcache_owner_exit(tcache->tcache_slow);
+	return ret;
+}
+
 JEMALLOC_ALWAYS_INLINE void
-tcache_dalloc_small(
+tcache_dalloc_small_impl(
     tsd_t *tsd, tcache_t *tcache, void *ptr, szind_t binind, bool slow_path) {
 	assert(tcache_salloc(tsd_tsdn(tsd), ptr) <= SC_SMALL_MAXCLASS);
 
@@ -201,14 +284,27 @@ tcache_dalloc_small(
 		}
 		cache_bin_sz_t max = cache_bin_ncached_max_get(bin);
 		unsigned       remain = max >> opt_lg_tcache_flush_small_div;
-		tcache_bin_flush_small(tsd, tcache, bin, binind, remain);
+		tcache_ncached_max_learn_overflow(binind);
+		if (!opt_tcache_steal
+		    || !tcache_bin_donate_small(
+		        tsd, tcache, bin, binind, remain)) {
+			tcache_bin_flush_small(tsd, tcache, bin, binind, remain);
+		}
 		bool ret = cache_bin_dalloc_easy(bin, ptr);
 		assert(ret);
 	}
 }
 
 JEMALLOC_ALWAYS_INLINE void
-tcache_dalloc_large(
+tcache_dalloc_small(
+    tsd_t *tsd, tcache_t *tcache, void *ptr, szind_t binind, bool slow_path) {
+	tcache_owner_enter(tcache->tcache_slow);
+	tcache_dalloc_small_impl(tsd, tcache, ptr, binind, slow_path);
+	tcache_owner_exit(tcache->tcache_slow);
+}
+
+JEMALLOC_ALWAYS_INLINE void
+tcache_dalloc_large_impl(
     tsd_t *tsd, tcache_t *tcache, void *ptr, szind_t binind, bool slow_path) {
 	assert(tcache_salloc(tsd_tsdn(tsd), ptr) > SC_SMALL_MAXCLASS);
 	assert(tcache_salloc(tsd_tsdn(tsd), ptr)
@@ -226,6 +322,14 @@ tcache_dalloc_large(
 	}
 }
 
+JEMALLOC_ALWAYS_INLINE void
+tcache_dalloc_large(
+    tsd_t *tsd, tcache_t *tcache, void *ptr, szind_t binind, bool slow_path) {
+	tcache_owner_enter(tcache->tcache_slow);
+	tcache_dalloc_large_impl(tsd, tcache, ptr, binind, slow_path);
+	tcache_owner_exit(tcache->tcache_slow);
+}
+
 JEMALLOC_ALWAYS_INLINE tcache_t *
 tcaches_get(tsd_t *tsd, unsigned ind) {
 	tcaches_t *elm = &tcaches[ind];
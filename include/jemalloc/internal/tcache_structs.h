@@ -2,11 +2,13 @@
 #define JEMALLOC_INTERNAL_TCACHE_STRUCTS_H
 
 #include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/atomic.h"
 #include "jemalloc/internal/cache_bin.h"
 #include "jemalloc/internal/ql.h"
 #include "jemalloc/internal/sc.h"
 #include "jemalloc/internal/tcache_types.h"
 #include "jemalloc/internal/ticker.h"
+#include "jemalloc/internal/tsd_types.h"
 
 /*
  * The tcache state is split into the slow and hot path data.  Each has a
@@ -48,6 +50,45 @@ struct tcache_slow_s {
 	 * actually flushing.
 	 */
 	uint8_t bin_flush_delay_items[SC_NBINS];
+	/*
+	 * For small bins, with opt.experimental_tcache_gc_reuse: ncached at the
+	 * start of the GC period, a decaying peak of the per period reuse depth
+	 * (in 1/16ths of an item), and the soft ncached_max derived from it.
+	 */
+	cache_bin_sz_t bin_gc_ncached[SC_NBINS];
+	uint32_t       bin_reuse_depth_fp[SC_NBINS];
+	cache_bin_sz_t bin_gc_target[SC_NBINS];
+	/*
+	 * Idle reclamation (opt.tcache_idle_reclaim_ms).  tsd is the owning
+	 * thread, or NULL for an explicit tcache.  The owner brackets its uses
+	 * of the cache bins off the fast paths with tcache_owner_enter() and
+	 * tcache_owner_exit(), which count owner_depth and check reclaim_state
+	 * (one of the TCACHE_RECLAIM_* values); see tcache_idle_reclaim_scan().
+	 * idle_reclaim_pending asks the owner to flush itself at its next GC
+	 * event, where the tcache can't be flushed remotely.  idle_seen_nbytes
+	 * and idle_since_ns belong to the idle scan, and are protected by the
+	 * arena's tcache_ql_mtx.
+	 */
+	tsd_t       *tsd;
+	atomic_u32_t owner_depth;
+	atomic_u32_t reclaim_state;
+	atomic_b_t   idle_reclaim_pending;
+	uint64_t     idle_seen_nbytes;
+	uint64_t     idle_since_ns;
+	/*
+	 * Large extents without a cache bin of their own, cached under a
+	 * shared byte budget (opt.tcache_large_cache_bytes).  Kept oldest
+	 * first; large_cache_low_water is the fewest items held since the last
+	 * GC.  large_cache_nrequests counts hits per size class, for stats.
+	 * large_cache_nbytes is only written by the owner, but read by stats
+	 * merging.
+	 */
+	void    *large_cache_ptrs[TCACHE_LARGE_CACHE_NSLOTS];
+	size_t   large_cache_usizes[TCACHE_LARGE_CACHE_NSLOTS];
+	unsigned large_cache_nitems;
+	unsigned large_cache_low_water;
+	atomic_zu_t large_cache_nbytes;
+	uint64_t large_cache_nrequests[TCACHE_LARGE_CACHE_NBINS_MAX - SC_NBINS];
 	/*
 	 * The start of the allocation containing the dynamic allocation for
 	 * either the cache bins alone, or the cache bin memory as well as this
@@ -19,6 +19,16 @@ typedef struct tcaches_s     tcaches_t;
 /* Used in TSD static initializer only. Will be initialized to opt_tcache. */
 #define TCACHE_ENABLED_ZERO_INITIALIZER false
 
+/*
+ * tcache_slow_t reclaim_state values; see tcache_idle_reclaim_scan().  The
+ * _SLOW variants mean the owner is kept on the slow paths meanwhile.
+ */
+#define TCACHE_RECLAIM_NONE 0
+#define TCACHE_RECLAIM_REQUESTED 1
+#define TCACHE_RECLAIM_RUNNING 2
+#define TCACHE_RECLAIM_RUNNING_SLOW 3
+#define TCACHE_RECLAIM_DONE_SLOW 4
+
 /* Used for explicit tcache only. Means flushed but not destroyed. */
 /* NOLINTNEXTLINE(performance-no-int-to-ptr) */
 #define TCACHES_ELM_NEED_REINIT ((tcache_t *)(uintptr_t)1)
@@ -33,5 +43,15 @@ typedef struct tcaches_s     tcaches_t;
 #define TCACHE_GC_INTERVAL_NS ((uint64_t)10 * KQU(1000000)) /* 10ms */
 #define TCACHE_GC_SMALL_NBINS_MAX ((SC_NBINS > 8) ? (SC_NBINS >> 3) : 1)
 #define TCACHE_GC_LARGE_NBINS_MAX 1
+/* Items held by the per thread cache of large extents, and their size limit. */
+#define TCACHE_LARGE_CACHE_NSLOTS 16
+#define TCACHE_LARGE_CACHE_LG_MAXCLASS_LIMIT 23
+#define TCACHE_LARGE_CACHE_MAXCLASS_LIMIT                                      \
+	((size_t)1 << TCACHE_LARGE_CACHE_LG_MAXCLASS_LIMIT)
+#define TCACHE_LARGE_CACHE_NBINS_MAX                                           \
+	(SC_NBINS                                                              \
+	    + SC_NGROUP                                                        \
+	        * (TCACHE_LARGE_CACHE_LG_MAXCLASS_LIMIT - SC_LG_LARGE_MINCLASS) \
+	    + 1)
 
 #endif /* JEMALLOC_INTERNAL_TCACHE_TYPES_H */
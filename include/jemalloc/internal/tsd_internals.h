@@ -5,6 +5,7 @@
 
 #include "jemalloc/internal/jemalloc_preamble.h"
 #include "jemalloc/internal/activity_callback.h"
+#include "jemalloc/internal/alloc_trace_types.h"
 #include "jemalloc/internal/arena_types.h"
 #include "jemalloc/internal/assert.h"
 #include "jemalloc/internal/bin_types.h"
@@ -73,6 +74,7 @@ typedef ql_elm(tsd_t) tsd_link_t;
 	O(prof_sample_last_event, uint64_t, uint64_t)                          \
 	O(stats_interval_last_event, uint64_t, uint64_t)                       \
 	O(prof_tdata, prof_tdata_t *, prof_tdata_t *)                          \
+	O(prof_stack_range, prof_stack_range_t, prof_stack_range_t)            \
 	O(prng_state, uint64_t, uint64_t)                                      \
 	O(san_extents_until_guard_small, uint64_t, uint64_t)                   \
 	O(san_extents_until_guard_large, uint64_t, uint64_t)                   \
@@ -80,9 +82,11 @@ typedef ql_elm(tsd_t) tsd_link_t;
 	O(arena, arena_t *, arena_t *)                                         \
 	O(arena_decay_ticker, ticker_geom_t, ticker_geom_t)                    \
 	O(sec_shard, uint8_t, uint8_t)                                         \
+	O(edata_cache_shard, uint8_t, uint8_t)                                 \
 	O(binshards, tsd_binshards_t, tsd_binshards_t)                         \
 	O(tsd_link, tsd_link_t, tsd_link_t)                                    \
 	O(in_hook, bool, bool)                                                 \
+	O(alloc_trace_tbuf, alloc_trace_tbuf_t *, alloc_trace_tbuf_t *)        \
 	O(peak, peak_t, peak_t)                                                \
 	O(activity_callback_thunk, activity_callback_thunk_t,                  \
 	    activity_callback_thunk_t)                                         \
@@ -98,13 +102,16 @@ typedef ql_elm(tsd_t) tsd_link_t;
 	    /* thread_deallocated_next_event */ 0,                             \
 	    /* te_data */ TE_DATA_INITIALIZER, /* prof_sample_last_event */ 0, \
 	    /* stats_interval_last_event */ 0, /* prof_tdata */ NULL,          \
+	    /* prof_stack_range */ PROF_STACK_RANGE_INITIALIZER,               \
 	    /* prng_state */ 0, /* san_extents_until_guard_small */ 0,         \
 	    /* san_extents_until_guard_large */ 0, /* iarena */ NULL,          \
 	    /* arena */ NULL, /* arena_decay_ticker */                         \
 	    TICKER_GEOM_INIT(ARENA_DECAY_NTICKS_PER_UPDATE),                   \
 	    /* sec_shard */ (uint8_t) - 1,                                     \
+	    /* edata_cache_shard */ (uint8_t) - 1,                             \
 	    /* binshards */ TSD_BINSHARDS_ZERO_INITIALIZER,                    \
 	    /* tsd_link */ {NULL}, /* in_hook */ false,                        \
+	    /* alloc_trace_tbuf */ NULL,                                       \
 	    /* peak */ PEAK_INITIALIZER, /* activity_callback_thunk */         \
 	    ACTIVITY_CALLBACK_THUNK_INITIALIZER,                               \
 	    /* tcache_slow */ TCACHE_SLOW_ZERO_INITIALIZER,                    \
@@ -116,12 +123,14 @@ typedef ql_elm(tsd_t) tsd_link_t;
 	O(thread_allocated_next_event_fast, uint64_t, uint64_t)                \
 	O(thread_deallocated, uint64_t, uint64_t)                              \
 	O(thread_deallocated_next_event_fast, uint64_t, uint64_t)              \
+	O(tcache_fastpath_busy, atomic_b_t, atomic_b_t)                        \
 	O(tcache, tcache_t, tcache_t)
 
 #define TSD_DATA_FAST_INITIALIZER                                              \
 	/* thread_allocated */ 0, /* thread_allocated_next_event_fast */ 0,    \
 	    /* thread_deallocated */ 0,                                        \
 	    /* thread_deallocated_next_event_fast */ 0,                        \
+	    /* tcache_fastpath_busy */ ATOMIC_INIT(false),                     \
 	    /* tcache */ TCACHE_ZERO_INITIALIZER,
 
 /*  O(name,			type,			nullable type) */
@@ -163,6 +172,12 @@ void   tsd_postfork_child(tsd_t *tsd);
 void tsd_global_slow_inc(tsdn_t *tsdn);
 void tsd_global_slow_dec(tsdn_t *tsdn);
 bool tsd_global_slow(void);
+/*
+ * Takes a single thread, possibly another one, down the slow paths until it
+ * next recomputes its state.  Returns false if the thread isn't in a nominal
+ * state.
+ */
+bool tsd_force_recompute_one(tsdn_t *tsdn, tsd_t *remote_tsd);
 
 #define TSD_MIN_INIT_STATE_MAX_FETCHED (128)
 
@@ -27,13 +27,19 @@ enum witness_rank_e {
 	WITNESS_RANK_TCACHES,
 	WITNESS_RANK_ARENAS,
 	WITNESS_RANK_BACKGROUND_THREAD_GLOBAL,
+	WITNESS_RANK_ALLOC_TRACE,
+	WITNESS_RANK_ALLOC_TRACE_TBUF,
+	WITNESS_RANK_ALLOC_TRACE_FILE,
 	WITNESS_RANK_PROF_DUMP,
+	WITNESS_RANK_PROF_RECENT_DUMP,
+	WITNESS_RANK_PROF_RECENT_ALLOC,
 	WITNESS_RANK_PROF_BT2GCTX,
+	WITNESS_RANK_PROF_BT2GCTX_STRIPE,
 	WITNESS_RANK_PROF_TDATAS,
 	WITNESS_RANK_PROF_TDATA,
+	WITNESS_RANK_PROF_LOG_STREAM,
 	WITNESS_RANK_PROF_LOG,
 	WITNESS_RANK_PROF_GCTX,
-	WITNESS_RANK_PROF_RECENT_DUMP,
 	WITNESS_RANK_BACKGROUND_THREAD,
 	/*
 	 * Used as an argument to witness_assert_depth_to_rank() in order to
@@ -48,6 +54,8 @@ enum witness_rank_e {
 
 	WITNESS_RANK_SEC_SHARD,
 
+	WITNESS_RANK_ARENA_HUGEPAGE_SLABS,
+
 	WITNESS_RANK_EXTENT_GROW,
 	WITNESS_RANK_HPA_SHARD_GROW = WITNESS_RANK_EXTENT_GROW,
 	WITNESS_RANK_SAN_BUMP_ALLOC = WITNESS_RANK_EXTENT_GROW,
@@ -74,7 +82,6 @@ enum witness_rank_e {
 	WITNESS_RANK_PROF_DUMP_FILENAME = WITNESS_RANK_LEAF,
 	WITNESS_RANK_PROF_GDUMP = WITNESS_RANK_LEAF,
 	WITNESS_RANK_PROF_NEXT_THR_UID = WITNESS_RANK_LEAF,
-	WITNESS_RANK_PROF_RECENT_ALLOC = WITNESS_RANK_LEAF,
 	WITNESS_RANK_PROF_STATS = WITNESS_RANK_LEAF,
 	WITNESS_RANK_PROF_THREAD_ACTIVE_INIT = WITNESS_RANK_LEAF,
 	WITNESS_RANK_THREAD_EVENTS_USER = WITNESS_RANK_LEAF,
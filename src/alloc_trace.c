@@ -0,0 +1,547 @@
+#include "jemalloc/internal/jemalloc_preamble.h"
+#include "jemalloc/internal/jemalloc_internal_includes.h"
+
+#include "jemalloc/internal/alloc_trace.h"
+
+#include "jemalloc/internal/assert.h"
+#include "jemalloc/internal/emap.h"
+#include "jemalloc/internal/hook.h"
+#include "jemalloc/internal/malloc_io.h"
+#include "jemalloc/internal/mutex.h"
+#include "jemalloc/internal/nstime.h"
+#include "jemalloc/internal/ql.h"
+
+char opt_alloc_trace[ALLOC_TRACE_FILENAME_LEN] = "";
+
+struct alloc_trace_tbuf_s {
+	malloc_mutex_t mtx;
+	ql_elm(alloc_trace_tbuf_t) link;
+	/*
+	 * Old address of the object last moved by realloc() through this
+	 * buffer; the free hook that follows is part of the same call.
+	 */
+	uint64_t moved;
+	/* Written out together with the first block.nevents events. */
+	alloc_trace_block_t block;
+	alloc_trace_event_t events[ALLOC_TRACE_TBUF_NEVENTS];
+};
+
+/*
+ * Protects the state below and the list of buffers, and serializes starting
+ * and stopping.
+ */
+static malloc_mutex_t alloc_trace_mtx;
+/* Serializes writes of blocks to the trace file, and protects the two below. */
+static malloc_mutex_t alloc_trace_file_mtx;
+/*
+ * Length of the trace file up to the end of its last complete block, and
+ * whether a write to it failed.  Blocks are dropped from then on, until
+ * tracing restarts.
+ */
+static size_t alloc_trace_file_len;
+static bool   alloc_trace_file_failed;
+
+/*
+ * Whether events are being recorded.  Only changed with alloc_trace_mtx held,
+ * and checked with the lock of the buffer the event goes to held, so that no
+ * event ends up in a buffer after stopping flushed it.
+ */
+static atomic_b_t alloc_trace_active = ATOMIC_INIT(false);
+static atomic_zu_t alloc_trace_seq = ATOMIC_INIT(0);
+static atomic_u_t alloc_trace_next_thread = ATOMIC_INIT(1);
+static int        alloc_trace_fd = -1;
+static void      *alloc_trace_hook_handle = NULL;
+
+static ql_head(alloc_trace_tbuf_t) alloc_trace_tbufs;
+/* Buffer with thread index 0; created by the first start. */
+static atomic_p_t alloc_trace_tbuf_shared = ATOMIC_INIT(NULL);
+
+static alloc_trace_tbuf_t *
+alloc_trace_tbuf_new(tsdn_t *tsdn, uint32_t thread) {
+	size_t              size = sizeof(alloc_trace_tbuf_t);
+	alloc_trace_tbuf_t *tbuf = (alloc_trace_tbuf_t *)iallocztm(tsdn, size,
+	    sz_size2index(size), false, NULL, true,
+	    arena_get(TSDN_NULL, 0, true), true);
+	if (tbuf == NULL) {
+		return NULL;
+	}
+	if (malloc_mutex_init(&tbuf->mtx, "alloc_trace_tbuf",
+	        WITNESS_RANK_ALLOC_TRACE_TBUF, malloc_mutex_rank_exclusive)) {
+		idalloctm(tsdn, tbuf, NULL, NULL, true, true);
+		return NULL;
+	}
+	ql_elm_new(tbuf, link);
+	tbuf->moved = 0;
+	tbuf->block.thread = thread;
+	tbuf->block.nevents = 0;
+	assert((byte_t *)tbuf->events
+	    == (byte_t *)&tbuf->block + sizeof(alloc_trace_block_t));
+	return tbuf;
+}
+
+static void
+alloc_trace_write_failed(tsdn_t *tsdn, int err) {
+	malloc_mutex_assert_owner(tsdn, &alloc_trace_file_mtx);
+	alloc_trace_file_failed = true;
+#ifndef _WIN32
+	/* Cut off whatever part of the block made it out. */
+	UNUSED int ret = ftruncate(alloc_trace_fd, (off_t)alloc_trace_file_len);
+#endif
+	malloc_printf(
+	    "<jemalloc>: write to allocation trace failed with %d, "
+	    "dropping further events\n",
+	    err);
+	if (opt_abort) {
+		abort();
+	}
+}
+
+static void
+alloc_trace_tbuf_flush(tsdn_t *tsdn, alloc_trace_tbuf_t *tbuf) {
+	malloc_mutex_assert_owner(tsdn, &tbuf->mtx);
+	if (tbuf->block.nevents == 0) {
+		return;
+	}
+	size_t len = sizeof(alloc_trace_block_t)
+	    + tbuf->block.nevents * sizeof(alloc_trace_event_t);
+	malloc_mutex_lock(tsdn, &alloc_trace_file_mtx);
+	if (!alloc_trace_file_failed) {
+		/* Short writes are retried; this only falls short on errors. */
+		if (malloc_write_fd(alloc_trace_fd, &tbuf->block, len)
+		    == (ssize_t)len) {
+			alloc_trace_file_len += len;
+		} else {
+			alloc_trace_write_failed(tsdn, errno);
+		}
+	}
+	malloc_mutex_unlock(tsdn, &alloc_trace_file_mtx);
+	tbuf->block.nevents = 0;
+}
+
+static alloc_trace_tbuf_t *
+alloc_trace_tbuf_get(tsdn_t *tsdn) {
+	tsd_t              *tsd = tsdn_tsd(tsdn);
+	alloc_trace_tbuf_t *tbuf = tsd_alloc_trace_tbuf_get(tsd);
+	if (tbuf != NULL) {
+		return tbuf;
+	}
+	/* Only threads whose tsd gets cleaned up can have a buffer. */
+	if (tsd_state_get(tsd) <= tsd_state_nominal_max) {
+		tbuf = alloc_trace_tbuf_new(tsdn,
+		    atomic_fetch_add_u(&alloc_trace_next_thread, 1,
+		        ATOMIC_RELAXED));
+	}
+	if (tbuf == NULL) {
+		return (alloc_trace_tbuf_t *)atomic_load_p(
+		    &alloc_trace_tbuf_shared, ATOMIC_ACQUIRE);
+	}
+	malloc_mutex_lock(tsdn, &alloc_trace_mtx);
+	ql_tail_insert(&alloc_trace_tbufs, tbuf, link);
+	malloc_mutex_unlock(tsdn, &alloc_trace_mtx);
+	tsd_alloc_trace_tbuf_set(tsd, tbuf);
+	return tbuf;
+}
+
+static void
+alloc_trace_record(alloc_trace_event_t *event) {
+	/* Also keeps idle threads from setting up buffers after a stop. */
+	if (!atomic_load_b(&alloc_trace_active, ATOMIC_RELAXED)) {
+		return;
+	}
+	tsdn_t *tsdn = tsdn_fetch();
+	if (tsdn_null(tsdn)) {
+		return;
+	}
+	alloc_trace_tbuf_t *tbuf = alloc_trace_tbuf_get(tsdn);
+	if (tbuf == NULL) {
+		return;
+	}
+
+	uint64_t ptr = (event->ptr != 0) ? event->ptr : event->old_ptr;
+	edata_t *edata = emap_edata_lookup(
+	    tsdn, &arena_emap_global, (void *)(uintptr_t)ptr);
+	event->usize = edata_usize_get(edata);
+	event->arena = (uint16_t)edata_arena_ind_get(edata);
+	nstime_t now;
+	nstime_init_update(&now);
+	event->time_ns = nstime_ns(&now);
+
+	malloc_mutex_lock(tsdn, &tbuf->mtx);
+	if (event->op == alloc_trace_op_realloc && event->ptr == 0) {
+		/* The free half of a moving realloc() isn't a call itself. */
+		bool moved = (tbuf->moved == event->old_ptr);
+		tbuf->moved = 0;
+		if (moved) {
+			goto label_unlock;
+		}
+	} else if (event->ptr != 0 && event->old_ptr != 0
+	    && event->ptr != event->old_ptr) {
+		tbuf->moved = event->old_ptr;
+	}
+	if (!atomic_load_b(&alloc_trace_active, ATOMIC_ACQUIRE)) {
+		goto label_unlock;
+	}
+	event->seq = atomic_fetch_add_zu(&alloc_trace_seq, 1, ATOMIC_RELAXED);
+	tbuf->events[tbuf->block.nevents++] = *event;
+	if (tbuf->block.nevents == ALLOC_TRACE_TBUF_NEVENTS) {
+		alloc_trace_tbuf_flush(tsdn, tbuf);
+	}
+label_unlock:
+	malloc_mutex_unlock(tsdn, &tbuf->mtx);
+}
+
+static void
+alloc_trace_hook_alloc(void *extra, hook_alloc_t type, void *result,
+    uintptr_t result_raw, uintptr_t args_raw[3]) {
+	if (result == NULL
+	    || (type == hook_alloc_posix_memalign && result_raw != 0)) {
+		return;
+	}
+	alloc_trace_event_t event = {0};
+	event.ptr = (uintptr_t)result;
+	switch (type) {
+	case hook_alloc_malloc:
+		event.op = alloc_trace_op_malloc;
+		event.size = args_raw[0];
+		break;
+	case hook_alloc_posix_memalign:
+		event.op = alloc_trace_op_posix_memalign;
+		event.arg = args_raw[1];
+		event.size = args_raw[2];
+		break;
+	case hook_alloc_aligned_alloc:
+		event.op = alloc_trace_op_aligned_alloc;
+		event.arg = args_raw[0];
+		event.size = args_raw[1];
+		break;
+	case hook_alloc_calloc:
+		event.op = alloc_trace_op_calloc;
+		event.arg = args_raw[0];
+		event.size = args_raw[1];
+		break;
+	case hook_alloc_memalign:
+		event.op = alloc_trace_op_memalign;
+		event.arg = args_raw[0];
+		event.size = args_raw[1];
+		break;
+	case hook_alloc_valloc:
+		event.op = alloc_trace_op_valloc;
+		event.size = args_raw[0];
+		break;
+	case hook_alloc_pvalloc:
+		event.op = alloc_trace_op_pvalloc;
+		event.size = args_raw[0];
+		break;
+	case hook_alloc_mallocx:
+		event.op = alloc_trace_op_mallocx;
+		event.size = args_raw[0];
+		event.flags = (uint32_t)args_raw[1];
+		break;
+	case hook_alloc_realloc:
+		event.op = alloc_trace_op_realloc;
+		event.old_ptr = args_raw[0];
+		event.size = args_raw[1];
+		break;
+	case hook_alloc_rallocx:
+		event.op = alloc_trace_op_rallocx;
+		event.old_ptr = args_raw[0];
+		event.size = args_raw[1];
+		event.flags = (uint32_t)args_raw[2];
+		break;
+	default:
+		not_reached();
+	}
+	alloc_trace_record(&event);
+}
+
+static void
+alloc_trace_hook_dalloc(
+    void *extra, hook_dalloc_t type, void *address, uintptr_t args_raw[3]) {
+	if (address == NULL) {
+		return;
+	}
+	alloc_trace_event_t event = {0};
+	event.old_ptr = (uintptr_t)address;
+	switch (type) {
+	case hook_dalloc_free:
+		event.op = alloc_trace_op_free;
+		break;
+	case hook_dalloc_dallocx:
+		event.op = alloc_trace_op_dallocx;
+		event.flags = (uint32_t)args_raw[1];
+		break;
+	case hook_dalloc_sdallocx:
+		event.op = alloc_trace_op_sdallocx;
+		event.size = args_raw[1];
+		event.flags = (uint32_t)args_raw[2];
+		break;
+	case hook_dalloc_realloc:
+		/* Either realloc(ptr, 0), or the free half of a move. */
+		event.op = alloc_trace_op_realloc;
+		break;
+	case hook_dalloc_rallocx:
+		/* Always the free half of a move. */
+		return;
+	default:
+		not_reached();
+	}
+	alloc_trace_record(&event);
+}
+
+static void
+alloc_trace_hook_expand(void *extra, hook_expand_t type, void *address,
+    size_t old_usize, size_t new_usize, uintptr_t result_raw,
+    uintptr_t args_raw[4]) {
+	alloc_trace_event_t event = {0};
+	event.ptr = (uintptr_t)address;
+	event.old_ptr = (uintptr_t)address;
+	event.size = args_raw[1];
+	switch (type) {
+	case hook_expand_realloc:
+		event.op = alloc_trace_op_realloc;
+		break;
+	case hook_expand_rallocx:
+		event.op = alloc_trace_op_rallocx;
+		event.flags = (uint32_t)args_raw[2];
+		break;
+	case hook_expand_xallocx:
+		event.op = alloc_trace_op_xallocx;
+		event.arg = args_raw[2];
+		event.flags = (uint32_t)args_raw[3];
+		break;
+	default:
+		not_reached();
+	}
+	alloc_trace_record(&event);
+}
+
+static int
+alloc_trace_open(const char *filename) {
+	int mode = 0644;
+#ifdef _MSC_VER
+	/* See prof_dump_open_file_impl(). */
+	mode &= 0600;
+#endif
+	return creat(filename, mode);
+}
+
+static void
+alloc_trace_stop_final(void) {
+	tsd_t *tsd = tsd_fetch();
+	alloc_trace_stop(tsd_tsdn(tsd));
+}
+
+static bool
+alloc_trace_start_locked(tsdn_t *tsdn, const char *filename) {
+	malloc_mutex_assert_owner(tsdn, &alloc_trace_mtx);
+
+	if (atomic_load_b(&alloc_trace_active, ATOMIC_RELAXED)
+	    || filename == NULL
+	    || strlen(filename) >= ALLOC_TRACE_FILENAME_LEN) {
+		return true;
+	}
+
+	static bool alloc_trace_atexit_called = false;
+	if (!alloc_trace_atexit_called) {
+		alloc_trace_atexit_called = true;
+		if (atexit(alloc_trace_stop_final) != 0) {
+			malloc_write(
+			    "<jemalloc>: Error in atexit() "
+			    "for allocation tracing\n");
+			if (opt_abort) {
+				abort();
+			}
+			return true;
+		}
+	}
+
+	if (atomic_load_p(&alloc_trace_tbuf_shared, ATOMIC_RELAXED) == NULL) {
+		alloc_trace_tbuf_t *shared = alloc_trace_tbuf_new(tsdn, 0);
+		if (shared == NULL) {
+			return true;
+		}
+		atomic_store_p(
+		    &alloc_trace_tbuf_shared, shared, ATOMIC_RELEASE);
+	}
+
+	int fd = alloc_trace_open(filename);
+	if (fd == -1) {
+		malloc_printf(
+		    "<jemalloc>: creat() for allocation trace \"%s\" "
+		    "failed with %d\n",
+		    filename, errno);
+		if (opt_abort) {
+			abort();
+		}
+		return true;
+	}
+	alloc_trace_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ALLOC_TRACE_MAGIC, sizeof(ALLOC_TRACE_MAGIC));
+	header.version = ALLOC_TRACE_VERSION;
+	header.event_size = sizeof(alloc_trace_event_t);
+	nstime_t now;
+	nstime_init_update(&now);
+	header.start_ns = nstime_ns(&now);
+	if (malloc_write_fd(fd, &header, sizeof(header))
+	    != (ssize_t)sizeof(header)) {
+		malloc_close(fd);
+		return true;
+	}
+
+	/* The hook may have been left installed by a fork; see below. */
+	if (alloc_trace_hook_handle == NULL) {
+		hooks_t hooks = {&alloc_trace_hook_alloc,
+		    &alloc_trace_hook_dalloc, &alloc_trace_hook_expand, NULL};
+		alloc_trace_hook_handle = hook_install(tsdn, &hooks);
+		if (alloc_trace_hook_handle == NULL) {
+			malloc_close(fd);
+			return true;
+		}
+	}
+	alloc_trace_fd = fd;
+	alloc_trace_file_len = sizeof(header);
+	alloc_trace_file_failed = false;
+	atomic_store_zu(&alloc_trace_seq, 0, ATOMIC_RELAXED);
+	atomic_store_b(&alloc_trace_active, true, ATOMIC_RELEASE);
+	return false;
+}
+
+bool
+alloc_trace_start(tsdn_t *tsdn, const char *filename) {
+	malloc_mutex_lock(tsdn, &alloc_trace_mtx);
+	bool ret = alloc_trace_start_locked(tsdn, filename);
+	malloc_mutex_unlock(tsdn, &alloc_trace_mtx);
+	return ret;
+}
+
+bool
+alloc_trace_stop(tsdn_t *tsdn) {
+	malloc_mutex_lock(tsdn, &alloc_trace_mtx);
+	if (!atomic_load_b(&alloc_trace_active, ATOMIC_RELAXED)) {
+		malloc_mutex_unlock(tsdn, &alloc_trace_mtx);
+		return true;
+	}
+	atomic_store_b(&alloc_trace_active, false, ATOMIC_RELEASE);
+	hook_remove(tsdn, alloc_trace_hook_handle);
+	alloc_trace_hook_handle = NULL;
+
+	alloc_trace_tbuf_t *tbuf;
+	ql_foreach (tbuf, &alloc_trace_tbufs, link) {
+		malloc_mutex_lock(tsdn, &tbuf->mtx);
+		alloc_trace_tbuf_flush(tsdn, tbuf);
+		malloc_mutex_unlock(tsdn, &tbuf->mtx);
+	}
+	tbuf = (alloc_trace_tbuf_t *)atomic_load_p(
+	    &alloc_trace_tbuf_shared, ATOMIC_RELAXED);
+	malloc_mutex_lock(tsdn, &tbuf->mtx);
+	alloc_trace_tbuf_flush(tsdn, tbuf);
+	malloc_mutex_unlock(tsdn, &tbuf->mtx);
+
+	malloc_mutex_lock(tsdn, &alloc_trace_file_mtx);
+	malloc_close(alloc_trace_fd);
+	alloc_trace_fd = -1;
+	bool failed = alloc_trace_file_failed;
+	malloc_mutex_unlock(tsdn, &alloc_trace_file_mtx);
+	malloc_mutex_unlock(tsdn, &alloc_trace_mtx);
+	return failed;
+}
+
+void
+alloc_trace_tsd_cleanup(tsd_t *tsd) {
+	alloc_trace_tbuf_t *tbuf = tsd_alloc_trace_tbuf_get(tsd);
+	if (tbuf == NULL) {
+		return;
+	}
+	tsdn_t *tsdn = tsd_tsdn(tsd);
+	malloc_mutex_lock(tsdn, &alloc_trace_mtx);
+	ql_remove(&alloc_trace_tbufs, tbuf, link);
+	malloc_mutex_lock(tsdn, &tbuf->mtx);
+	if (atomic_load_b(&alloc_trace_active, ATOMIC_RELAXED)) {
+		alloc_trace_tbuf_flush(tsdn, tbuf);
+	}
+	malloc_mutex_unlock(tsdn, &tbuf->mtx);
+	malloc_mutex_unlock(tsdn, &alloc_trace_mtx);
+
+	idalloctm(tsdn, tbuf, NULL, NULL, true, true);
+	tsd_alloc_trace_tbuf_set(tsd, NULL);
+}
+
+bool
+alloc_trace_boot(void) {
+	ql_new(&alloc_trace_tbufs);
+	if (malloc_mutex_init(&alloc_trace_mtx, "alloc_trace",
+	        WITNESS_RANK_ALLOC_TRACE, malloc_mutex_rank_exclusive)) {
+		return true;
+	}
+	return malloc_mutex_init(&alloc_trace_file_mtx, "alloc_trace_file",
+	    WITNESS_RANK_ALLOC_TRACE_FILE, malloc_mutex_rank_exclusive);
+}
+
+void
+alloc_trace_init(tsdn_t *tsdn) {
+	if (opt_alloc_trace[0] != '\0') {
+		alloc_trace_start(tsdn, opt_alloc_trace);
+	}
+}
+
+void
+alloc_trace_prefork(tsdn_t *tsdn) {
+	malloc_mutex_prefork(tsdn, &alloc_trace_mtx);
+	alloc_trace_tbuf_t *tbuf;
+	ql_foreach (tbuf, &alloc_trace_tbufs, link) {
+		malloc_mutex_prefork(tsdn, &tbuf->mtx);
+	}
+	tbuf = (alloc_trace_tbuf_t *)atomic_load_p(
+	    &alloc_trace_tbuf_shared, ATOMIC_RELAXED);
+	if (tbuf != NULL) {
+		malloc_mutex_prefork(tsdn, &tbuf->mtx);
+	}
+	malloc_mutex_prefork(tsdn, &alloc_trace_file_mtx);
+}
+
+void
+alloc_trace_postfork_parent(tsdn_t *tsdn) {
+	malloc_mutex_postfork_parent(tsdn, &alloc_trace_file_mtx);
+	alloc_trace_tbuf_t *tbuf = (alloc_trace_tbuf_t *)atomic_load_p(
+	    &alloc_trace_tbuf_shared, ATOMIC_RELAXED);
+	if (tbuf != NULL) {
+		malloc_mutex_postfork_parent(tsdn, &tbuf->mtx);
+	}
+	ql_foreach (tbuf, &alloc_trace_tbufs, link) {
+		malloc_mutex_postfork_parent(tsdn, &tbuf->mtx);
+	}
+	malloc_mutex_postfork_parent(tsdn, &alloc_trace_mtx);
+}
+
+static void
+alloc_trace_tbuf_postfork_child(tsdn_t *tsdn, alloc_trace_tbuf_t *tbuf) {
+	malloc_mutex_postfork_child(tsdn, &tbuf->mtx);
+	/* The events belong to the parent's trace. */
+	tbuf->block.nevents = 0;
+	tbuf->moved = 0;
+}
+
+void
+alloc_trace_postfork_child(tsdn_t *tsdn) {
+	malloc_mutex_postfork_child(tsdn, &alloc_trace_file_mtx);
+	alloc_trace_tbuf_t *tbuf = (alloc_trace_tbuf_t *)atomic_load_p(
+	    &alloc_trace_tbuf_shared, ATOMIC_RELAXED);
+	if (tbuf != NULL) {
+		alloc_trace_tbuf_postfork_child(tsdn, tbuf);
+	}
+	ql_foreach (tbuf, &alloc_trace_tbufs, link) {
+		alloc_trace_tbuf_postfork_child(tsdn, tbuf);
+	}
+	/*
+	 * The child doesn't continue the parent's trace.  The hook is left
+	 * installed (and ignores everything while inactive), since removing it
+	 * takes a lock that fork doesn't protect; the next start reuses it.
+	 */
+	if (atomic_load_b(&alloc_trace_active, ATOMIC_RELAXED)) {
+		atomic_store_b(&alloc_trace_active, false, ATOMIC_RELAXED);
+		malloc_close(alloc_trace_fd);
+		alloc_trace_fd = -1;
+	}
+	malloc_mutex_postfork_child(tsdn, &alloc_trace_mtx);
+}
@@ -42,6 +42,13 @@ size_t oversize_threshold = OVERSIZE_THRESHOLD_DEFAULT;
 uint32_t        arena_bin_offsets[SC_NBINS];
 static unsigned nbins_total;
 
+/*
+ * Per small size class, the maximum number of HUGEPAGE sized regions each
+ * arena dedicates to that class's slabs; 0 (the default) means slabs come from
+ * the page allocator as usual.  Set through opt.slab_hugepage_sizes.
+ */
+unsigned arena_slab_hugepage_regions[SC_NBINS];
+
 /*
  * a0 is used to handle huge requests before malloc init completes. After
  * that,the huge_arena_ind is updated to point to the actual huge arena,
@@ -70,9 +77,34 @@ static void arena_bin_lower_slab(
     tsdn_t *tsdn, arena_t *arena, edata_t *slab, bin_t *bin);
 static void arena_maybe_do_deferred_work(
     tsdn_t *tsdn, arena_t *arena, decay_t *decay, size_t npages_new);
+static void arena_tcache_handoff_drain(
+    tsdn_t *tsdn, arena_t *arena, bool all);
+static void arena_hugepage_slabs_purge(tsdn_t *tsdn, arena_t *arena);
 
 /******************************************************************************/
 
+bool
+arena_slab_hugepage_sizes_update(
+    size_t start_size, size_t end_size, size_t nregions) {
+	if (nregions > ARENA_SLAB_HUGEPAGE_REGIONS_MAX) {
+		return true;
+	}
+	if (start_size > SC_SMALL_MAXCLASS) {
+		return false;
+	}
+	if (end_size > SC_SMALL_MAXCLASS) {
+		end_size = SC_SMALL_MAXCLASS;
+	}
+
+	/* Compute the index since this happens before sz init. */
+	szind_t ind1 = sz_size2index_compute(start_size);
+	szind_t ind2 = sz_size2index_compute(end_size);
+	for (szind_t i = ind1; i <= ind2; i++) {
+		arena_slab_hugepage_regions[i] = (unsigned)nregions;
+	}
+	return false;
+}
+
 void
 arena_basic_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
     const char **dss, ssize_t *dirty_decay_ms, ssize_t *muzzy_decay_ms,
@@ -100,6 +132,8 @@ arena_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
 	base_stats_get(tsdn, arena->base, &base_allocated,
 	    &base_edata_allocated, &base_rtree_allocated, &base_resident,
 	    &base_mapped, &metadata_thp);
+	size_t base_edata_reclaimable = base_edata_reclaimable_get(
+	    tsdn, arena->base);
 	size_t pac_mapped_sz = pac_mapped(&arena->pa_shard.pac);
 	astats->mapped += base_mapped + pac_mapped_sz;
 	astats->resident += base_resident;
@@ -109,8 +143,27 @@ arena_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
 	astats->base += base_allocated;
 	astats->metadata_edata += base_edata_allocated;
 	astats->metadata_rtree += base_rtree_allocated;
+	astats->metadata_reclaimable += base_edata_reclaimable;
 	atomic_load_add_store_zu(&astats->internal, arena_internal_get(arena));
 	astats->metadata_thp += metadata_thp;
+	locked_inc_u64_unsynchronized(&astats->zeroed_bytes_large,
+	    locked_read_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+	        &arena->stats.zeroed_bytes_large));
+	locked_inc_u64_unsynchronized(&astats->zero_skipped_bytes_large,
+	    locked_read_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+	        &arena->stats.zero_skipped_bytes_large));
+	locked_inc_u64_unsynchronized(&astats->tcache_gc_nflushes_avoided,
+	    locked_read_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+	        &arena->stats.tcache_gc_nflushes_avoided));
+	locked_inc_u64_unsynchronized(&astats->tcache_gc_bytes_saved,
+	    locked_read_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+	        &arena->stats.tcache_gc_bytes_saved));
+	locked_inc_u64_unsynchronized(&astats->tcache_steal_attempts,
+	    locked_read_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+	        &arena->stats.tcache_steal_attempts));
+	locked_inc_u64_unsynchronized(&astats->tcache_steal_successes,
+	    locked_read_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+	        &arena->stats.tcache_steal_successes));
 
 	for (szind_t i = 0; i < SC_NSIZES - SC_NBINS; i++) {
 		/* ndalloc should be read before nmalloc,
@@ -183,6 +236,13 @@ arena_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
 			    * sz_index2size(i);
 		}
 	}
+	astats->tcache_bytes += atomic_load_zu(
+	    &arena->tcache_handoff_nbytes, ATOMIC_RELAXED);
+	tcache_slow_t *tcache_slow;
+	ql_foreach (tcache_slow, &arena->tcache_ql, link) {
+		astats->tcache_bytes += atomic_load_zu(
+		    &tcache_slow->large_cache_nbytes, ATOMIC_RELAXED);
+	}
 	malloc_mutex_prof_read(tsdn,
 	    &astats->mutex_prof_data[arena_prof_mutex_tcache_list],
 	    &arena->tcache_ql_mtx);
@@ -211,6 +271,23 @@ arena_stats_merge(tsdn_t *tsdn, arena_t *arena, unsigned *nthreads,
 			    tsdn, &bstats[i], arena_get_bin(arena, i, j));
 		}
 	}
+
+	malloc_mutex_lock(tsdn, &arena->hugepage_slabs_mtx);
+	for (szind_t i = 0; i < SC_NBINS; i++) {
+		bin_stats_t *stats = &bstats[i].stats_data;
+		stats->hugepage_regions += arena->hugepage_slabs[i].nregions;
+		stats->hugepage_curslabs += arena->hugepage_slabs[i].curslabs;
+		edata_t *edata;
+		ql_foreach (edata, &arena->hugepage_slabs[i].avail.head,
+		    ql_link_active) {
+			stats->hugepage_unused_bytes += edata_size_get(edata);
+		}
+		ql_foreach (edata, &arena->hugepage_slabs[i].reserves.head,
+		    ql_link_active) {
+			stats->hugepage_unused_bytes += edata_size_get(edata);
+		}
+	}
+	malloc_mutex_unlock(tsdn, &arena->hugepage_slabs_mtx);
 }
 
 static void
@@ -257,6 +334,9 @@ arena_slab_reg_alloc(edata_t *slab, const bin_info_t *bin_info) {
 	return ret;
 }
 
+/* Most region indices extracted from a slab bitmap at once. */
+#define ARENA_SLAB_REG_BATCH_MAX (4 * BITMAP_GROUP_NBITS)
+
 static void
 arena_slab_reg_alloc_batch(
     edata_t *slab, const bin_info_t *bin_info, unsigned cnt, void **ptrs) {
@@ -265,44 +345,26 @@ arena_slab_reg_alloc_batch(
 	assert(edata_nfree_get(slab) >= cnt);
 	assert(!bitmap_full(slab_data->bitmap, &bin_info->bitmap_info));
 
-#if (!defined JEMALLOC_INTERNAL_POPCOUNTL) || (defined BITMAP_USE_TREE)
-	for (unsigned i = 0; i < cnt; i++) {
-		size_t regind = bitmap_sfu(
-		    slab_data->bitmap, &bin_info->bitmap_info);
-		*(ptrs + i) = (void *)((uintptr_t)edata_addr_get(slab)
-		    + (uintptr_t)(bin_info->reg_size * regind));
-	}
-#else
-	unsigned group = 0;
-	bitmap_t g = slab_data->bitmap[group];
-	unsigned i = 0;
-	while (i < cnt) {
-		while (g == 0) {
-			g = slab_data->bitmap[++group];
-		}
-		size_t shift = group << LG_BITMAP_GROUP_NBITS;
-		size_t pop = popcount_lu(g);
-		if (pop > (cnt - i)) {
-			pop = cnt - i;
+	/*
+	 * Load from memory locations only once, outside the hot loop below.
+	 * Region indices come out of the bitmap a chunk at a time, to bound
+	 * the stack used for them.
+	 */
+	uintptr_t base = (uintptr_t)edata_addr_get(slab);
+	uintptr_t regsize = (uintptr_t)bin_info->reg_size;
+	uint32_t  reginds[ARENA_SLAB_REG_BATCH_MAX];
+	for (unsigned i = 0; i < cnt;) {
+		unsigned n = cnt - i;
+		if (n > ARENA_SLAB_REG_BATCH_MAX) {
+			n = ARENA_SLAB_REG_BATCH_MAX;
 		}
-
-		/*
-		 * Load from memory locations only once, outside the
-		 * hot loop below.
-		 */
-		uintptr_t base = (uintptr_t)edata_addr_get(slab);
-		uintptr_t regsize = (uintptr_t)bin_info->reg_size;
-		while (pop--) {
-			size_t bit = cfs_lu(&g);
-			size_t regind = shift + bit;
+		bitmap_sfu_batch(
+		    slab_data->bitmap, &bin_info->bitmap_info, n, reginds);
+		for (unsigned j = 0; j < n; j++, i++) {
 			/* NOLINTNEXTLINE(performance-no-int-to-ptr) */
-			*(ptrs + i) = (void *)(base + regsize * regind);
-
-			i++;
+			*(ptrs + i) = (void *)(base + regsize * reginds[j]);
 		}
-		slab_data->bitmap[group] = g;
 	}
-#endif
 	edata_nfree_sub(slab, cnt);
 }
 
@@ -391,6 +453,19 @@ arena_extent_alloc_large(
 
 	if (config_stats) {
 		arena_large_malloc_stats_update(tsdn, arena, usize);
+		if (zero) {
+			/*
+			 * Extents that were freshly mapped, committed or purged
+			 * come back flagged as zeroed; those skip the memset.
+			 */
+			LOCKEDINT_MTX_LOCK(tsdn, arena->stats.mtx);
+			locked_inc_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+			    edata_zeroed_get(edata)
+			        ? &arena->stats.zero_skipped_bytes_large
+			        : &arena->stats.zeroed_bytes_large,
+			    usize);
+			LOCKEDINT_MTX_UNLOCK(tsdn, arena->stats.mtx);
+		}
 	}
 	if (sz_large_pad != 0) {
 		arena_cache_oblivious_randomize(tsdn, arena, edata, alignment);
@@ -523,6 +598,10 @@ arena_decay_muzzy(
 
 void
 arena_decay(tsdn_t *tsdn, arena_t *arena, bool is_background_thread, bool all) {
+	if (opt_tcache_steal) {
+		/* Handed off regions nobody takes would otherwise stay. */
+		arena_tcache_handoff_drain(tsdn, arena, all);
+	}
 	if (all) {
 		/*
 		 * We should take a purge of "all" to mean "save as much memory
@@ -530,11 +609,19 @@ arena_decay(tsdn_t *tsdn, arena_t *arena, bool is_background_thread, bool all) {
 		 * like thread death, or manual purge calls).
 		 */
 		sec_flush(tsdn, &arena->pa_shard.hpa_sec);
+		arena_hugepage_slabs_purge(tsdn, arena);
 	}
 	if (arena_decay_dirty(tsdn, arena, is_background_thread, all)) {
 		return;
 	}
 	arena_decay_muzzy(tsdn, arena, is_background_thread, all);
+	if (all) {
+		/*
+		 * Purging coalesces extents, which frees their metadata; give
+		 * it back too, if the base can reclaim it.
+		 */
+		edata_cache_reclaim(tsdn, &arena->pa_shard.edata_cache);
+	}
 }
 
 static bool
@@ -615,6 +702,17 @@ arena_do_deferred_work(tsdn_t *tsdn, arena_t *arena) {
 
 void
 arena_slab_dalloc(tsdn_t *tsdn, arena_t *arena, edata_t *slab) {
+	if (edata_hugepage_slab_get(slab)) {
+		/* Keep it in its region, for the next slab of the class. */
+		arena_hugepage_slabs_t *hs =
+		    &arena->hugepage_slabs[edata_szind_get(slab)];
+		malloc_mutex_lock(tsdn, &arena->hugepage_slabs_mtx);
+		assert(hs->curslabs > 0);
+		hs->curslabs--;
+		edata_list_active_prepend(&hs->avail, slab);
+		malloc_mutex_unlock(tsdn, &arena->hugepage_slabs_mtx);
+		return;
+	}
 	bool deferred_work_generated = false;
 	pa_dalloc(tsdn, &arena->pa_shard, slab, &deferred_work_generated);
 	if (deferred_work_generated) {
@@ -779,6 +877,121 @@ arena_dalloc_promoted(
 	arena_dalloc_promoted_impl(tsdn, ptr, tcache, slow_path, edata);
 }
 
+/*
+ * Frees the regions sitting in the arena's tcache handoff slots: all of them,
+ * or only the batches that nobody took since the previous call.
+ */
+static void
+arena_tcache_handoff_drain(tsdn_t *tsdn, arena_t *arena, bool all) {
+	for (szind_t i = 0; i < SC_NBINS; i++) {
+		atomic_p_t *handoff = &arena->tcache_handoff[i];
+		void       *ptr;
+		if (all) {
+			ptr = atomic_exchange_p(handoff, NULL, ATOMIC_ACQUIRE);
+		} else {
+			unsigned gen = atomic_load_u(
+			    &arena->tcache_handoff_gen[i], ATOMIC_RELAXED);
+			unsigned seen = atomic_load_u(
+			    &arena->tcache_handoff_seen[i], ATOMIC_RELAXED);
+			atomic_store_u(&arena->tcache_handoff_seen[i], gen,
+			    ATOMIC_RELAXED);
+			ptr = atomic_load_p(handoff, ATOMIC_RELAXED);
+			if (ptr == NULL || gen != seen
+			    || !atomic_compare_exchange_strong_p(handoff, &ptr,
+			        NULL, ATOMIC_ACQUIRE, ATOMIC_RELAXED)) {
+				continue;
+			}
+		}
+		size_t n = 0;
+		while (ptr != NULL) {
+			void *next = *(void **)ptr;
+			arena_dalloc_small(tsdn, ptr);
+			ptr = next;
+			n++;
+		}
+		if (n > 0) {
+			atomic_fetch_sub_zu(&arena->tcache_handoff_nbytes,
+			    n * sz_index2size(i), ATOMIC_RELAXED);
+		}
+	}
+}
+
+/*
+ * Purges the parts of the dedicated hugepage regions that no slab uses: the
+ * empty slabs kept for reuse, and the uncarved reserves.  Both stay with their
+ * size class.  They are taken off their lists while being purged, since that
+ * can't be done under hugepage_slabs_mtx; slab allocations in the meantime
+ * fall back to ordinary slabs.
+ */
+static void
+arena_hugepage_slabs_purge(tsdn_t *tsdn, arena_t *arena) {
+	ehooks_t *ehooks = arena_get_ehooks(arena);
+	for (szind_t i = 0; i < SC_NBINS; i++) {
+		if (arena_slab_hugepage_regions[i] == 0) {
+			continue;
+		}
+		arena_hugepage_slabs_t *hs = &arena->hugepage_slabs[i];
+		edata_list_active_t     avail, reserves;
+		edata_list_active_init(&avail);
+		edata_list_active_init(&reserves);
+
+		malloc_mutex_lock(tsdn, &arena->hugepage_slabs_mtx);
+		edata_list_active_concat(&avail, &hs->avail);
+		edata_list_active_concat(&reserves, &hs->reserves);
+		malloc_mutex_unlock(tsdn, &arena->hugepage_slabs_mtx);
+
+		edata_list_active_t *lists[] = {&avail, &reserves};
+		for (unsigned j = 0; j < sizeof(lists) / sizeof(lists[0]); j++) {
+			edata_t *edata;
+			ql_foreach (edata, &lists[j]->head, ql_link_active) {
+				size_t size = edata_size_get(edata);
+				if (extent_purge_forced_wrapper(
+				        tsdn, ehooks, edata, 0, size)) {
+					extent_purge_lazy_wrapper(
+					    tsdn, ehooks, edata, 0, size);
+				}
+			}
+		}
+
+		malloc_mutex_lock(tsdn, &arena->hugepage_slabs_mtx);
+		edata_list_active_concat(&hs->avail, &avail);
+		edata_list_active_concat(&hs->reserves, &reserves);
+		malloc_mutex_unlock(tsdn, &arena->hugepage_slabs_mtx);
+	}
+}
+
+/*
+ * Returns the dedicated hugepage regions to the page allocator; their slabs
+ * have all been freed by the time this is called.
+ */
+static void
+arena_hugepage_slabs_reset(tsdn_t *tsdn, arena_t *arena) {
+	bool deferred_work_generated = false;
+	for (szind_t i = 0; i < SC_NBINS; i++) {
+		arena_hugepage_slabs_t *hs = &arena->hugepage_slabs[i];
+		edata_list_active_t     release;
+		edata_list_active_init(&release);
+
+		malloc_mutex_lock(tsdn, &arena->hugepage_slabs_mtx);
+		assert(hs->curslabs == 0);
+		edata_list_active_concat(&release, &hs->avail);
+		edata_list_active_concat(&release, &hs->reserves);
+		hs->nregions = 0;
+		malloc_mutex_unlock(tsdn, &arena->hugepage_slabs_mtx);
+
+		edata_t *edata;
+		while ((edata = edata_list_active_first(&release)) != NULL) {
+			edata_list_active_remove(&release, edata);
+			edata_hugepage_slab_set(edata, false);
+			pa_dalloc(tsdn, &arena->pa_shard, edata,
+			    &deferred_work_generated);
+		}
+	}
+	if (deferred_work_generated) {
+		arena_handle_deferred_work(tsdn, arena);
+	}
+}
+
 void
 arena_reset(tsd_t *tsd, arena_t *arena) {
 	/*
@@ -795,6 +1008,21 @@ arena_reset(tsd_t *tsd, arena_t *arena) {
 	 *   stats refreshes would impose an inconvenient burden.
 	 */
 
+	/*
+	 * Tcache handoffs hold regions from whichever arena the donating
+	 * tcache had cached them from, so check all of them.
+	 */
+	if (opt_tcache_steal) {
+		unsigned narenas = narenas_total_get();
+		for (unsigned i = 0; i < narenas; i++) {
+			arena_t *a = arena_get(tsd_tsdn(tsd), i, false);
+			if (a != NULL) {
+				arena_tcache_handoff_drain(
+				    tsd_tsdn(tsd), a, /* all */ true);
+			}
+		}
+	}
+
 	/* Large allocations. */
 	malloc_mutex_lock(tsd_tsdn(tsd), &arena->large_mtx);
 
@@ -833,6 +1061,7 @@ arena_reset(tsd_t *tsd, arena_t *arena) {
 			arena_bin_reset(tsd, arena, arena_get_bin(arena, i, j));
 		}
 	}
+	arena_hugepage_slabs_reset(tsd_tsdn(tsd), arena);
 	pa_shard_reset(tsd_tsdn(tsd), &arena->pa_shard);
 }
 
@@ -955,6 +1184,123 @@ arena_destroy(tsd_t *tsd, arena_t *arena) {
 	base_delete(tsd_tsdn(tsd), arena->base);
 }
 
+/*
+ * Takes a slab for binind off the avail list, or carves one off the front of a
+ * reserve.  Returns NULL if neither has room for one.
+ */
+static edata_t *
+arena_hugepage_slab_get_locked(tsdn_t *tsdn, arena_t *arena, szind_t binind,
+    size_t slab_size, edata_list_active_t *release) {
+	malloc_mutex_assert_owner(tsdn, &arena->hugepage_slabs_mtx);
+	arena_hugepage_slabs_t *hs = &arena->hugepage_slabs[binind];
+
+	edata_t *slab = edata_list_active_first(&hs->avail);
+	if (slab != NULL) {
+		edata_list_active_remove(&hs->avail, slab);
+		hs->curslabs++;
+		return slab;
+	}
+
+	edata_t *reserve;
+	while ((reserve = edata_list_active_first(&hs->reserves)) != NULL) {
+		size_t size = edata_size_get(reserve);
+		if (size < slab_size) {
+			/* A tail too small for another slab. */
+			edata_list_active_remove(&hs->reserves, reserve);
+			edata_list_active_append(release, reserve);
+			continue;
+		}
+		if (size > slab_size) {
+			edata_t *trail = extent_split_wrapper(tsdn,
+			    &arena->pa_shard.pac, arena_get_ehooks(arena),
+			    reserve, slab_size, size - slab_size,
+			    /* holding_core_locks */ true);
+			if (trail == NULL) {
+				return NULL;
+			}
+			edata_list_active_replace(&hs->reserves, reserve, trail);
+		} else {
+			edata_list_active_remove(&hs->reserves, reserve);
+		}
+		slab = reserve;
+		break;
+	}
+	if (slab == NULL) {
+		return NULL;
+	}
+
+	/* What pa_alloc() would have done for a slab. */
+	emap_remap(tsdn, arena->pa_shard.emap, slab, binind, /* slab */ true);
+	edata_szind_set(slab, binind);
+	edata_slab_set(slab, true);
+	if (slab_size > 2 * PAGE) {
+		emap_register_interior(tsdn, arena->pa_shard.emap, slab, binind);
+	}
+	edata_hugepage_slab_set(slab, true);
+	hs->curslabs++;
+	return slab;
+}
+
+/*
+ * Slab allocation for the size classes in opt.slab_hugepage_sizes: slabs are
+ * carved out of HUGEPAGE aligned regions that are dedicated to the class and
+ * advised to be backed by transparent huge pages, so that the class's regions
+ * are spread over a few TLB entries rather than over as many pages as it has
+ * slabs.  Returns NULL when the class has used up its regions (or the page
+ * allocator can't provide an aligned one), in which case the caller falls back
+ * to an ordinary slab.
+ */
+static edata_t *
+arena_slab_alloc_hugepage(tsdn_t *tsdn, arena_t *arena, szind_t binind,
+    const bin_info_t *bin_info) {
+	edata_list_active_t release;
+	edata_list_active_init(&release);
+
+	malloc_mutex_lock(tsdn, &arena->hugepage_slabs_mtx);
+	edata_t *slab = arena_hugepage_slab_get_locked(
+	    tsdn, arena, binind, bin_info->slab_size, &release);
+	arena_hugepage_slabs_t *hs = &arena->hugepage_slabs[binind];
+	if (slab == NULL && hs->nregions < arena_slab_hugepage_regions[binind]) {
+		/* Claim the region up front; pa_alloc() can't nest in here. */
+		hs->nregions++;
+		malloc_mutex_unlock(tsdn, &arena->hugepage_slabs_mtx);
+
+		bool     deferred_work_generated = false;
+		edata_t *region = pa_alloc(tsdn, &arena->pa_shard, HUGEPAGE,
+		    HUGEPAGE, /* slab */ false, SC_NSIZES, /* zero */ false,
+		    /* guarded */ false, &deferred_work_generated);
+		if (deferred_work_generated) {
+			arena_handle_deferred_work(tsdn, arena);
+		}
+		if (region != NULL && pages_can_hugify
+		    && ehooks_are_default(arena_get_ehooks(arena))) {
+			pages_huge(edata_base_get(region), HUGEPAGE);
+		}
+
+		malloc_mutex_lock(tsdn, &arena->hugepage_slabs_mtx);
+		if (region == NULL) {
+			hs->nregions--;
+		} else {
+			edata_list_active_append(&hs->reserves, region);
+			slab = arena_hugepage_slab_get_locked(
+			    tsdn, arena, binind, bin_info->slab_size, &release);
+		}
+	}
+	malloc_mutex_unlock(tsdn, &arena->hugepage_slabs_mtx);
+
+	bool    deferred_work_generated = false;
+	edata_t *edata;
+	while ((edata = edata_list_active_first(&release)) != NULL) {
+		edata_list_active_remove(&release, edata);
+		pa_dalloc(tsdn, &arena->pa_shard, edata,
+		    &deferred_work_generated);
+	}
+	if (deferred_work_generated) {
+		arena_handle_deferred_work(tsdn, arena);
+	}
+	return slab;
+}
+
 static edata_t *
 arena_slab_alloc(tsdn_t *tsdn, arena_t *arena, szind_t binind,
     unsigned binshard, const bin_info_t *bin_info) {
@@ -964,9 +1310,16 @@ arena_slab_alloc(tsdn_t *tsdn, arena_t *arena, szind_t binind,
 
 	bool guarded = san_slab_extent_decide_guard(
 	    tsdn, arena_get_ehooks(arena));
-	edata_t *slab = pa_alloc(tsdn, &arena->pa_shard, bin_info->slab_size,
-	    /* alignment */ PAGE, /* slab */ true, /* szind */ binind,
-	    /* zero */ false, guarded, &deferred_work_generated);
+	edata_t *slab = NULL;
+	if (arena_slab_hugepage_regions[binind] != 0 && !guarded
+	    && !pa_shard_uses_hpa(&arena->pa_shard)) {
+		slab = arena_slab_alloc_hugepage(tsdn, arena, binind, bin_info);
+	}
+	if (slab == NULL) {
+		slab = pa_alloc(tsdn, &arena->pa_shard, bin_info->slab_size,
+		    /* alignment */ PAGE, /* slab */ true, /* szind */ binind,
+		    /* zero */ false, guarded, &deferred_work_generated);
+	}
 
 	if (deferred_work_generated) {
 		arena_handle_deferred_work(tsdn, arena);
@@ -2071,7 +2424,8 @@ arena_new(tsdn_t *tsdn, unsigned ind, const arena_config_t *config) {
 		if (arena_stats_init(tsdn, &arena->stats)) {
 			goto label_error;
 		}
-
+	}
+	if (tcache_ql_enabled()) {
 		ql_new(&arena->tcache_ql);
 		ql_new(&arena->cache_bin_array_descriptor_ql);
 		if (malloc_mutex_init(&arena->tcache_ql_mtx, "tcache_ql",
@@ -2080,6 +2434,27 @@ arena_new(tsdn_t *tsdn, unsigned ind, const arena_config_t *config) {
 		}
 	}
 
+	for (i = 0; i < SC_NBINS; i++) {
+		atomic_store_p(&arena->tcache_handoff[i], NULL, ATOMIC_RELAXED);
+		atomic_store_u(&arena->tcache_handoff_gen[i], 0, ATOMIC_RELAXED);
+		atomic_store_u(
+		    &arena->tcache_handoff_seen[i], 0, ATOMIC_RELAXED);
+	}
+	atomic_store_zu(&arena->tcache_handoff_nbytes, 0, ATOMIC_RELAXED);
+
+	for (i = 0; i < SC_NBINS; i++) {
+		arena_hugepage_slabs_t *hs = &arena->hugepage_slabs[i];
+		edata_list_active_init(&hs->reserves);
+		edata_list_active_init(&hs->avail);
+		hs->nregions = 0;
+		hs->curslabs = 0;
+	}
+	if (malloc_mutex_init(&arena->hugepage_slabs_mtx, "arena_hugepage_slabs",
+	        WITNESS_RANK_ARENA_HUGEPAGE_SLABS,
+	        malloc_mutex_rank_exclusive)) {
+		goto label_error;
+	}
+
 	atomic_store_u(
 	    &arena->dss_prec, (unsigned)extent_dss_prec_get(), ATOMIC_RELAXED);
 
@@ -2278,7 +2653,7 @@ arena_prefork0(tsdn_t *tsdn, arena_t *arena) {
 
 void
 arena_prefork1(tsdn_t *tsdn, arena_t *arena) {
-	if (config_stats) {
+	if (tcache_ql_enabled()) {
 		malloc_mutex_prefork(tsdn, &arena->tcache_ql_mtx);
 	}
 }
@@ -2290,6 +2665,7 @@ arena_prefork2(tsdn_t *tsdn, arena_t *arena) {
 
 void
 arena_prefork3(tsdn_t *tsdn, arena_t *arena) {
+	malloc_mutex_prefork(tsdn, &arena->hugepage_slabs_mtx);
 	pa_shard_prefork3(tsdn, &arena->pa_shard);
 }
 
@@ -2331,7 +2707,8 @@ arena_postfork_parent(tsdn_t *tsdn, arena_t *arena) {
 	malloc_mutex_postfork_parent(tsdn, &arena->large_mtx);
 	base_postfork_parent(tsdn, arena->base);
 	pa_shard_postfork_parent(tsdn, &arena->pa_shard);
-	if (config_stats) {
+	malloc_mutex_postfork_parent(tsdn, &arena->hugepage_slabs_mtx);
+	if (tcache_ql_enabled()) {
 		malloc_mutex_postfork_parent(tsdn, &arena->tcache_ql_mtx);
 	}
 }
@@ -2346,7 +2723,7 @@ arena_postfork_child(tsdn_t *tsdn, arena_t *arena) {
 	if (tsd_iarena_get(tsdn_tsd(tsdn)) == arena) {
 		arena_nthreads_inc(arena, true);
 	}
-	if (config_stats) {
+	if (tcache_ql_enabled()) {
 		ql_new(&arena->tcache_ql);
 		ql_new(&arena->cache_bin_array_descriptor_ql);
 		tcache_slow_t *tcache_slow = tcache_slow_get(tsdn_tsd(tsdn));
@@ -2370,7 +2747,8 @@ arena_postfork_child(tsdn_t *tsdn, arena_t *arena) {
 	malloc_mutex_postfork_child(tsdn, &arena->large_mtx);
 	base_postfork_child(tsdn, arena->base);
 	pa_shard_postfork_child(tsdn, &arena->pa_shard);
-	if (config_stats) {
+	malloc_mutex_postfork_child(tsdn, &arena->hugepage_slabs_mtx);
+	if (tcache_ql_enabled()) {
 		malloc_mutex_postfork_child(tsdn, &arena->tcache_ql_mtx);
 	}
 }
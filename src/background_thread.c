@@ -161,6 +161,31 @@ set_current_thread_affinity(int cpu) {
 /* Minimal sleep interval 100 ms. */
 #	define BACKGROUND_THREAD_MIN_INTERVAL_NS (BILLION / 10)
 
+/*
+ * With futex based mutexes there is no pthread_mutex_t to hand to
+ * pthread_cond_wait(), so the condition variable becomes a sequence number
+ * that signalers bump (with info->mtx held) before waking the thread.
+ */
+static int
+background_thread_cond_init(background_thread_info_t *info) {
+#	ifdef JEMALLOC_MUTEX_FUTEX
+	atomic_store_u32(&info->cond, 0, ATOMIC_RELAXED);
+	return 0;
+#	else
+	return pthread_cond_init(&info->cond, NULL);
+#	endif
+}
+
+static void
+background_thread_cond_signal(background_thread_info_t *info) {
+#	ifdef JEMALLOC_MUTEX_FUTEX
+	atomic_fetch_add_u32(&info->cond, 1, ATOMIC_RELEASE);
+	malloc_futex_wake(&info->cond, 1);
+#	else
+	pthread_cond_signal(&info->cond);
+#	endif
+}
+
 static int
 background_thread_cond_wait(
     background_thread_info_t *info, struct timespec *ts) {
@@ -168,14 +193,23 @@ background_thread_cond_wait(
 
 	/*
 	 * pthread_cond_wait drops and re-acquires the mutex internally, w/o
-	 * going through our wrapper.  Update the locked state explicitly.
+	 * going through our wrapper.  Update the locked state explicitly, and
+	 * don't count the sleep towards a sampled hold time.
 	 */
+	mutex_hold_sample_finish(&info->mtx);
 	atomic_store_b(&info->mtx.locked, false, ATOMIC_RELAXED);
+#	ifdef JEMALLOC_MUTEX_FUTEX
+	uint32_t seq = atomic_load_u32(&info->cond, ATOMIC_ACQUIRE);
+	MALLOC_MUTEX_UNLOCK(&info->mtx);
+	ret = malloc_futex_wait(&info->cond, seq, ts);
+	MALLOC_MUTEX_LOCK(&info->mtx);
+#	else
 	if (ts == NULL) {
 		ret = pthread_cond_wait(&info->cond, &info->mtx.lock);
 	} else {
 		ret = pthread_cond_timedwait(&info->cond, &info->mtx.lock, ts);
 	}
+#	endif
 	atomic_store_b(&info->mtx.locked, true, ATOMIC_RELAXED);
 
 	return ret;
@@ -279,6 +313,20 @@ background_work_sleep_once(
 			ns_until_deferred = ns_arena_deferred;
 		}
 	}
+	if (ind == 0 && opt_tcache_idle_reclaim_ms >= 0) {
+		tcache_idle_reclaim_scan(tsdn);
+		uint64_t ns_idle_scan = (uint64_t)opt_tcache_idle_reclaim_ms
+		    * 1000 * 1000 / 2;
+		if (ns_idle_scan < ns_until_deferred) {
+			ns_until_deferred = ns_idle_scan;
+		}
+	}
+	if (ind == 0 && config_prof) {
+		uint64_t ns_leak_epoch = prof_leak_epoch_ns_until_due();
+		if (ns_leak_epoch < ns_until_deferred) {
+			ns_until_deferred = ns_leak_epoch;
+		}
+	}
 
 	uint64_t sleep_ns;
 	if (ns_until_deferred == BACKGROUND_THREAD_DEFERRED_MAX) {
@@ -310,7 +358,7 @@ background_threads_disable_single(tsd_t *tsd, background_thread_info_t *info) {
 	if (info->state == background_thread_started) {
 		has_thread = true;
 		info->state = background_thread_stopped;
-		pthread_cond_signal(&info->cond);
+		background_thread_cond_signal(info);
 	} else {
 		has_thread = false;
 	}
@@ -453,6 +501,14 @@ background_thread0_work(tsd_t *tsd) {
 		}
 		background_work_sleep_once(
 		    tsd_tsdn(tsd), &background_thread_info[0], 0);
+		if (config_prof && opt_prof) {
+			/* Prof work takes prof locks, which rank lower. */
+			malloc_mutex_unlock(
+			    tsd_tsdn(tsd), &background_thread_info[0].mtx);
+			prof_background_work(tsd);
+			malloc_mutex_lock(
+			    tsd_tsdn(tsd), &background_thread_info[0].mtx);
+		}
 	}
 
 	/*
@@ -562,7 +618,7 @@ background_thread_create_locked(tsd_t *tsd, unsigned arena_ind) {
 		malloc_mutex_lock(tsd_tsdn(tsd), &t0->mtx);
 		/* Only signal if thread 0 is actually started (avoid race condition) */
 		if (t0->state == background_thread_started) {
-			pthread_cond_signal(&t0->cond);
+			background_thread_cond_signal(t0);
 		}
 		malloc_mutex_unlock(tsd_tsdn(tsd), &t0->mtx);
 
@@ -695,7 +751,7 @@ background_thread_wakeup_early(
 	    && nstime_ns(remaining_sleep) < BACKGROUND_THREAD_MIN_INTERVAL_NS) {
 		return;
 	}
-	pthread_cond_signal(&info->cond);
+	background_thread_cond_signal(info);
 }
 
 void
@@ -739,7 +795,7 @@ background_thread_postfork_child(tsdn_t *tsdn) {
 		background_thread_info_t *info = &background_thread_info[i];
 		malloc_mutex_lock(tsdn, &info->mtx);
 		info->state = background_thread_stopped;
-		int ret = pthread_cond_init(&info->cond, NULL);
+		int ret = background_thread_cond_init(info);
 		assert(ret == 0);
 		background_thread_info_init(tsdn, info);
 		malloc_mutex_unlock(tsdn, &info->mtx);
@@ -857,7 +913,7 @@ background_thread_boot1(tsdn_t *tsdn, base_t *base) {
 		        malloc_mutex_address_ordered)) {
 			return true;
 		}
-		if (pthread_cond_init(&info->cond, NULL)) {
+		if (background_thread_cond_init(info)) {
 			return true;
 		}
 		malloc_mutex_lock(tsdn, &info->mtx);
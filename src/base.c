@@ -3,6 +3,7 @@
 
 #include "jemalloc/internal/assert.h"
 #include "jemalloc/internal/extent_mmap.h"
+#include "jemalloc/internal/fb.h"
 #include "jemalloc/internal/mutex.h"
 #include "jemalloc/internal/sz.h"
 
@@ -15,12 +16,38 @@
 #define BASE_AUTO_THP_THRESHOLD 2
 #define BASE_AUTO_THP_THRESHOLD_A0 5
 
+/* Per-slot footprint of edata_t's carved out of edata chunks. */
+#define BASE_EDATA_SLOT_SIZE ALIGNMENT_CEILING(sizeof(edata_t), EDATA_ALIGNMENT)
+#define BASE_EDATA_PAGE_NREGS (PAGE / BASE_EDATA_SLOT_SIZE)
+
+/*
+ * Lives at the beginning of each edata chunk; the remaining pages are slabs of
+ * BASE_EDATA_PAGE_NREGS edata_t slots each.  A page with no edata_t handed out
+ * is purged and marked non-resident; its free list is rebuilt on reuse.
+ */
+struct base_edata_chunk_s {
+	base_edata_chunk_t *next;
+	/* Serial number shared by all edata_t's of the chunk. */
+	size_t sn;
+	/* Free slots of each resident page; empty for non-resident pages. */
+	edata_list_inactive_t free[BASE_EDATA_CHUNK_NPAGES];
+	uint16_t              nfree[BASE_EDATA_CHUNK_NPAGES];
+	/* Pages with at least one free slot. */
+	fb_group_t has_free[FB_NGROUPS(BASE_EDATA_CHUNK_NPAGES)];
+	/* Pages that are (possibly) backed by physical memory. */
+	fb_group_t resident[FB_NGROUPS(BASE_EDATA_CHUNK_NPAGES)];
+};
+
+#define BASE_EDATA_CHUNK_HDR_NPAGES                                            \
+	(PAGE_CEILING(sizeof(base_edata_chunk_t)) >> LG_PAGE)
+
 /******************************************************************************/
 /* Data. */
 
 static base_t *b0;
 
 metadata_thp_mode_t opt_metadata_thp = METADATA_THP_DEFAULT;
+bool                opt_metadata_reclaim = false;
 
 const char *const metadata_thp_mode_names[] = {"disabled", "auto", "always"};
 
@@ -500,10 +527,14 @@ base_new(tsdn_t *tsdn, unsigned ind, const extent_hooks_t *extent_hooks,
 		edata_heap_new(&base->avail[i]);
 	}
 	edata_avail_new(&base->edata_avail);
+	base->edata_reclaim = opt_metadata_reclaim && !metadata_thp_enabled()
+	    && ehooks_are_default(&base->ehooks_base);
+	base->edata_chunks = NULL;
 
 	if (config_stats) {
 		base->edata_allocated = 0;
 		base->rtree_allocated = 0;
+		base->edata_reclaimable = 0;
 		base->allocated = sizeof(base_block_t);
 		base->resident = PAGE_CEILING(sizeof(base_block_t));
 		base->mapped = block->size;
@@ -527,7 +558,14 @@ base_new(tsdn_t *tsdn, unsigned ind, const extent_hooks_t *extent_hooks,
 
 void
 base_delete(tsdn_t *tsdn, base_t *base) {
-	ehooks_t     *ehooks = base_ehooks_get_for_metadata(base);
+	ehooks_t           *ehooks = base_ehooks_get_for_metadata(base);
+	base_edata_chunk_t *chunk = base->edata_chunks;
+	while (chunk != NULL) {
+		base_edata_chunk_t *next_chunk = chunk->next;
+		base_unmap(tsdn, ehooks, base_ind_get(base), chunk,
+		    BASE_EDATA_CHUNK_SIZE);
+		chunk = next_chunk;
+	}
 	base_block_t *next = base->blocks;
 	do {
 		base_block_t *block = next;
@@ -556,14 +594,14 @@ base_extent_hooks_set(base_t *base, extent_hooks_t *extent_hooks) {
 }
 
 static void *
-base_alloc_impl(tsdn_t *tsdn, base_t *base, size_t size, size_t alignment,
-    size_t *esn, size_t *ret_usize) {
+base_alloc_impl_locked(tsdn_t *tsdn, base_t *base, size_t size,
+    size_t alignment, size_t *esn, size_t *ret_usize) {
+	malloc_mutex_assert_owner(tsdn, &base->mtx);
 	alignment = QUANTUM_CEILING(alignment);
 	size_t usize = ALIGNMENT_CEILING(size, alignment);
 	size_t asize = usize + alignment - QUANTUM;
 
 	edata_t *edata = NULL;
-	malloc_mutex_lock(tsdn, &base->mtx);
 	for (szind_t i = sz_size2index(asize); i < SC_NSIZES; i++) {
 		edata = edata_heap_remove_first(&base->avail[i]);
 		if (edata != NULL) {
@@ -575,20 +613,26 @@ base_alloc_impl(tsdn_t *tsdn, base_t *base, size_t size, size_t alignment,
 		/* Try to allocate more space. */
 		edata = base_extent_alloc(tsdn, base, usize, alignment);
 	}
-	void *ret;
 	if (edata == NULL) {
-		ret = NULL;
-		goto label_return;
+		return NULL;
 	}
 
-	ret = base_extent_bump_alloc(tsdn, base, edata, usize, alignment);
+	void *ret = base_extent_bump_alloc(tsdn, base, edata, usize, alignment);
 	if (esn != NULL) {
 		*esn = (size_t)edata_sn_get(edata);
 	}
 	if (ret_usize != NULL) {
 		*ret_usize = usize;
 	}
-label_return:
+	return ret;
+}
+
+static void *
+base_alloc_impl(tsdn_t *tsdn, base_t *base, size_t size, size_t alignment,
+    size_t *esn, size_t *ret_usize) {
+	malloc_mutex_lock(tsdn, &base->mtx);
+	void *ret = base_alloc_impl_locked(
+	    tsdn, base, size, alignment, esn, ret_usize);
 	malloc_mutex_unlock(tsdn, &base->mtx);
 	return ret;
 }
@@ -606,8 +650,176 @@ base_alloc(tsdn_t *tsdn, base_t *base, size_t size, size_t alignment) {
 	return base_alloc_impl(tsdn, base, size, alignment, NULL, NULL);
 }
 
+static base_edata_chunk_t *
+base_edata_chunk_new(tsdn_t *tsdn, base_t *base) {
+	malloc_mutex_assert_owner(tsdn, &base->mtx);
+	assert(BASE_EDATA_CHUNK_SIZE <= BASE_BLOCK_MIN_ALIGN);
+
+	ehooks_t *ehooks = base_ehooks_get_for_metadata(base);
+	/* Drop mutex during base_map(), same as base_extent_alloc(). */
+	malloc_mutex_unlock(tsdn, &base->mtx);
+	base_edata_chunk_t *chunk = (base_edata_chunk_t *)base_map(
+	    tsdn, ehooks, base_ind_get(base), BASE_EDATA_CHUNK_SIZE);
+	malloc_mutex_lock(tsdn, &base->mtx);
+	if (chunk == NULL) {
+		return NULL;
+	}
+	assert(ALIGNMENT_ADDR2BASE(chunk, BASE_EDATA_CHUNK_SIZE) == chunk);
+
+	chunk->sn = base->extent_sn_next++;
+	fb_init(chunk->has_free, BASE_EDATA_CHUNK_NPAGES);
+	fb_init(chunk->resident, BASE_EDATA_CHUNK_NPAGES);
+	/* Header pages are never handed out, nor purged. */
+	fb_set_range(chunk->resident, BASE_EDATA_CHUNK_NPAGES, 0,
+	    BASE_EDATA_CHUNK_HDR_NPAGES);
+	for (size_t i = 0; i < BASE_EDATA_CHUNK_NPAGES; i++) {
+		edata_list_inactive_init(&chunk->free[i]);
+		chunk->nfree[i] = (i < BASE_EDATA_CHUNK_HDR_NPAGES)
+		    ? 0
+		    : BASE_EDATA_PAGE_NREGS;
+	}
+	fb_set_range(chunk->has_free, BASE_EDATA_CHUNK_NPAGES,
+	    BASE_EDATA_CHUNK_HDR_NPAGES,
+	    BASE_EDATA_CHUNK_NPAGES - BASE_EDATA_CHUNK_HDR_NPAGES);
+
+	chunk->next = base->edata_chunks;
+	base->edata_chunks = chunk;
+	if (config_stats) {
+		base->allocated += sizeof(base_edata_chunk_t);
+		base->resident += BASE_EDATA_CHUNK_HDR_NPAGES << LG_PAGE;
+		base->mapped += BASE_EDATA_CHUNK_SIZE;
+		assert(base->allocated <= base->resident);
+		assert(base->resident <= base->mapped);
+	}
+	return chunk;
+}
+
+/* Lowest-address first fit, to keep the pages that are in use dense. */
+static edata_t *
+base_edata_chunk_alloc(tsdn_t *tsdn, base_t *base) {
+	malloc_mutex_assert_owner(tsdn, &base->mtx);
+
+	base_edata_chunk_t *chunk;
+	size_t              page = BASE_EDATA_CHUNK_NPAGES;
+	for (chunk = base->edata_chunks; chunk != NULL; chunk = chunk->next) {
+		page = fb_ffs(chunk->has_free, BASE_EDATA_CHUNK_NPAGES, 0);
+		if (page < BASE_EDATA_CHUNK_NPAGES) {
+			break;
+		}
+	}
+	if (chunk == NULL) {
+		chunk = base_edata_chunk_new(tsdn, base);
+		if (chunk == NULL) {
+			return NULL;
+		}
+		page = BASE_EDATA_CHUNK_HDR_NPAGES;
+	}
+	assert(chunk->nfree[page] > 0);
+
+	if (!fb_get(chunk->resident, BASE_EDATA_CHUNK_NPAGES, page)) {
+		/* Fresh or purged page; all of its slots are free. */
+		assert(chunk->nfree[page] == BASE_EDATA_PAGE_NREGS);
+		byte_t *addr = (byte_t *)chunk + (page << LG_PAGE);
+		for (size_t i = 0; i < BASE_EDATA_PAGE_NREGS; i++) {
+			edata_list_inactive_append(&chunk->free[page],
+			    (edata_t *)(addr + i * BASE_EDATA_SLOT_SIZE));
+		}
+		fb_set(chunk->resident, BASE_EDATA_CHUNK_NPAGES, page);
+		if (config_stats) {
+			base->resident += PAGE;
+		}
+	}
+	edata_t *edata = edata_list_inactive_first(&chunk->free[page]);
+	edata_list_inactive_remove(&chunk->free[page], edata);
+	if (--chunk->nfree[page] == 0) {
+		fb_unset(chunk->has_free, BASE_EDATA_CHUNK_NPAGES, page);
+	}
+	edata_esn_set(edata, chunk->sn);
+	if (config_stats) {
+		base->allocated += BASE_EDATA_SLOT_SIZE;
+		base->edata_allocated += BASE_EDATA_SLOT_SIZE;
+		base->edata_reclaimable += BASE_EDATA_SLOT_SIZE;
+		assert(base->allocated <= base->resident);
+		assert(base->resident <= base->mapped);
+	}
+	return edata;
+}
+
+/* Purges the fully free pages of chunk, in maximal runs. */
+static void
+base_edata_chunk_purge(tsdn_t *tsdn, base_t *base, base_edata_chunk_t *chunk) {
+	malloc_mutex_assert_owner(tsdn, &base->mtx);
+
+	size_t page = BASE_EDATA_CHUNK_HDR_NPAGES;
+	while (page < BASE_EDATA_CHUNK_NPAGES) {
+		size_t npurge = 0;
+		while (page + npurge < BASE_EDATA_CHUNK_NPAGES
+		    && chunk->nfree[page + npurge] == BASE_EDATA_PAGE_NREGS
+		    && fb_get(chunk->resident, BASE_EDATA_CHUNK_NPAGES,
+		        page + npurge)) {
+			npurge++;
+		}
+		if (npurge == 0) {
+			page++;
+			continue;
+		}
+		if (!pages_purge_forced((byte_t *)chunk + (page << LG_PAGE),
+		        npurge << LG_PAGE)) {
+			for (size_t i = page; i < page + npurge; i++) {
+				edata_list_inactive_init(&chunk->free[i]);
+			}
+			fb_unset_range(chunk->resident,
+			    BASE_EDATA_CHUNK_NPAGES, page, npurge);
+			if (config_stats) {
+				base->resident -= npurge << LG_PAGE;
+			}
+		}
+		page += npurge;
+	}
+}
+
+/*
+ * Hands edata_t's obtained from base_alloc_edata{,_batch}() back to their
+ * chunks, purging the pages that become entirely free.  Only valid if
+ * base_edata_reclaim_enabled().
+ */
+void
+base_free_edata_batch(tsdn_t *tsdn, base_t *base, edata_list_inactive_t *list) {
+	assert(base_edata_reclaim_enabled(base));
+
+	malloc_mutex_lock(tsdn, &base->mtx);
+	edata_t *edata;
+	while ((edata = edata_list_inactive_first(list)) != NULL) {
+		edata_list_inactive_remove(list, edata);
+		base_edata_chunk_t *chunk = (base_edata_chunk_t *)
+		    ALIGNMENT_ADDR2BASE(edata, BASE_EDATA_CHUNK_SIZE);
+		size_t page = ((uintptr_t)edata - (uintptr_t)chunk) >> LG_PAGE;
+		assert(page >= BASE_EDATA_CHUNK_HDR_NPAGES);
+		assert(chunk->nfree[page] < BASE_EDATA_PAGE_NREGS);
+		edata_list_inactive_prepend(&chunk->free[page], edata);
+		chunk->nfree[page]++;
+		fb_set(chunk->has_free, BASE_EDATA_CHUNK_NPAGES, page);
+		if (config_stats) {
+			base->allocated -= BASE_EDATA_SLOT_SIZE;
+			base->edata_allocated -= BASE_EDATA_SLOT_SIZE;
+			base->edata_reclaimable -= BASE_EDATA_SLOT_SIZE;
+		}
+	}
+	for (base_edata_chunk_t *chunk = base->edata_chunks; chunk != NULL;
+	    chunk = chunk->next) {
+		base_edata_chunk_purge(tsdn, base, chunk);
+	}
+	malloc_mutex_unlock(tsdn, &base->mtx);
+}
+
 edata_t *
 base_alloc_edata(tsdn_t *tsdn, base_t *base) {
+	if (base_edata_reclaim_enabled(base)) {
+		malloc_mutex_lock(tsdn, &base->mtx);
+		edata_t *edata = base_edata_chunk_alloc(tsdn, base);
+		malloc_mutex_unlock(tsdn, &base->mtx);
+		return edata;
+	}
 	size_t   esn, usize;
 	edata_t *edata = base_alloc_impl(
 	    tsdn, base, sizeof(edata_t), EDATA_ALIGNMENT, &esn, &usize);
@@ -621,6 +833,43 @@ base_alloc_edata(tsdn_t *tsdn, base_t *base) {
 	return edata;
 }
 
+/*
+ * Allocates up to nedata edata_t's under a single acquisition of the base mutex
+ * and appends them to list.  Returns the number allocated, which is only less
+ * than nedata if the base ran out of memory.
+ */
+size_t
+base_alloc_edata_batch(tsdn_t *tsdn, base_t *base, edata_list_inactive_t *list,
+    size_t nedata) {
+	size_t nalloc = 0;
+	size_t usize_total = 0;
+	malloc_mutex_lock(tsdn, &base->mtx);
+	while (nalloc < nedata) {
+		edata_t *edata;
+		if (base_edata_reclaim_enabled(base)) {
+			edata = base_edata_chunk_alloc(tsdn, base);
+		} else {
+			size_t esn, usize;
+			edata = base_alloc_impl_locked(tsdn, base,
+			    sizeof(edata_t), EDATA_ALIGNMENT, &esn, &usize);
+			if (edata != NULL) {
+				edata_esn_set(edata, esn);
+				usize_total += usize;
+			}
+		}
+		if (edata == NULL) {
+			break;
+		}
+		edata_list_inactive_append(list, edata);
+		nalloc++;
+	}
+	malloc_mutex_unlock(tsdn, &base->mtx);
+	if (config_stats) {
+		base->edata_allocated += usize_total;
+	}
+	return nalloc;
+}
+
 void *
 base_alloc_rtree(tsdn_t *tsdn, base_t *base, size_t size) {
 	size_t usize;
@@ -724,6 +973,17 @@ base_stats_get(tsdn_t *tsdn, base_t *base, size_t *allocated,
 	malloc_mutex_unlock(tsdn, &base->mtx);
 }
 
+size_t
+base_edata_reclaimable_get(tsdn_t *tsdn, base_t *base) {
+	cassert(config_stats);
+
+	malloc_mutex_lock(tsdn, &base->mtx);
+	assert(base->edata_reclaimable <= base->edata_allocated);
+	size_t reclaimable = base->edata_reclaimable;
+	malloc_mutex_unlock(tsdn, &base->mtx);
+	return reclaimable;
+}
+
 void
 base_prefork(tsdn_t *tsdn, base_t *base) {
 	malloc_mutex_prefork(tsdn, &base->mtx);
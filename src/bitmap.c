@@ -3,6 +3,14 @@
 
 #include "jemalloc/internal/assert.h"
 
+#ifdef JEMALLOC_HAVE_X86_SIMD_DISPATCH
+#	include <immintrin.h>
+#	define BITMAP_TARGET_SSE41 __attribute__((target("sse4.1,popcnt")))
+#	define BITMAP_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#endif
+
+bitmap_simd_t bitmap_simd = bitmap_simd_none;
+
 /******************************************************************************/
 
 #ifdef BITMAP_USE_TREE
@@ -119,3 +127,170 @@ size_t
 bitmap_size(const bitmap_info_t *binfo) {
 	return (bitmap_info_ngroups(binfo) << LG_SIZEOF_BITMAP);
 }
+
+/******************************************************************************/
+/* Batched sfu. */
+
+#ifndef BITMAP_USE_TREE
+/*
+ * Bit positions set in each byte value, zero padded to 8 entries, so that the
+ * SIMD paths can widen a whole row at once.
+ */
+static uint8_t bitmap_byte_bits[256][8];
+static uint8_t bitmap_byte_nbits[256];
+
+/* Extracts up to cnt set bits (free regions) from *gp. */
+static inline size_t
+bitmap_group_sfu_batch(bitmap_t *gp, uint32_t base, size_t cnt,
+    uint32_t *bits) {
+	bitmap_t g = *gp;
+	size_t   n = 0;
+	while (g != 0 && n < cnt) {
+		bits[n++] = base + (uint32_t)ffs_lu(g);
+		g &= g - 1;
+	}
+	*gp = g;
+	return n;
+}
+
+static void
+bitmap_sfu_batch_scalar(
+    bitmap_t *bitmap, size_t ngroups, size_t cnt, uint32_t *bits) {
+	size_t n = 0;
+	for (size_t i = 0; i < ngroups && n < cnt; i++) {
+		n += bitmap_group_sfu_batch(&bitmap[i],
+		    (uint32_t)(i << LG_BITMAP_GROUP_NBITS), cnt - n, &bits[n]);
+	}
+	assert(n == cnt);
+}
+
+/*
+ * The SIMD paths decode a group a byte at a time, storing a full row of 8
+ * indices per byte and advancing by the number of bits actually set.  The
+ * overhanging stores need up to 8 entries of slack in bits, so a group is only
+ * decoded this way when all of it is wanted and the slack is there; otherwise
+ * (i.e. near the end of the batch) it falls back to the scalar loop.
+ */
+#	define BITMAP_SFU_BATCH_SIMD(decode_row)                             \
+		size_t n = 0;                                                  \
+		for (size_t i = 0; i < ngroups && n < cnt; i++) {              \
+			bitmap_t g = bitmap[i];                                \
+			uint32_t base = (uint32_t)(i << LG_BITMAP_GROUP_NBITS); \
+			if (g == 0) {                                          \
+				continue;                                      \
+			}                                                      \
+			if ((size_t)__builtin_popcountl(g) + 8 > cnt - n) {    \
+				n += bitmap_group_sfu_batch(                   \
+				    &bitmap[i], base, cnt - n, &bits[n]);      \
+				continue;                                      \
+			}                                                      \
+			for (unsigned b = 0; b < sizeof(bitmap_t); b++) {      \
+				unsigned byte = (unsigned)(g >> (b << 3))      \
+				    & 0xffU;                                   \
+				decode_row(&bits[n], bitmap_byte_bits[byte],   \
+				    base + (b << 3));                          \
+				n += bitmap_byte_nbits[byte];                  \
+			}                                                      \
+			bitmap[i] = 0;                                         \
+		}                                                              \
+		assert(n == cnt);
+
+#	ifdef JEMALLOC_HAVE_X86_SIMD_DISPATCH
+BITMAP_TARGET_SSE41 static inline void
+bitmap_decode_row_sse41(uint32_t *dst, const uint8_t *row, uint32_t base) {
+	__m128i r = _mm_loadl_epi64((const __m128i *)row);
+	__m128i b = _mm_set1_epi32((int)base);
+	_mm_storeu_si128((__m128i *)dst, _mm_add_epi32(_mm_cvtepu8_epi32(r), b));
+	_mm_storeu_si128((__m128i *)(dst + 4),
+	    _mm_add_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(r, 4)), b));
+}
+
+BITMAP_TARGET_SSE41 static void
+bitmap_sfu_batch_sse41(
+    bitmap_t *bitmap, size_t ngroups, size_t cnt, uint32_t *bits) {
+	BITMAP_SFU_BATCH_SIMD(bitmap_decode_row_sse41)
+}
+
+BITMAP_TARGET_AVX2 static inline void
+bitmap_decode_row_avx2(uint32_t *dst, const uint8_t *row, uint32_t base) {
+	__m256i r = _mm256_cvtepu8_epi32(
+	    _mm_loadl_epi64((const __m128i *)row));
+	_mm256_storeu_si256((__m256i *)dst,
+	    _mm256_add_epi32(r, _mm256_set1_epi32((int)base)));
+}
+
+BITMAP_TARGET_AVX2 static void
+bitmap_sfu_batch_avx2(
+    bitmap_t *bitmap, size_t ngroups, size_t cnt, uint32_t *bits) {
+	BITMAP_SFU_BATCH_SIMD(bitmap_decode_row_avx2)
+}
+#	endif
+#endif /* BITMAP_USE_TREE */
+
+bool
+bitmap_simd_supported(bitmap_simd_t simd) {
+	switch (simd) {
+	case bitmap_simd_none:
+		return true;
+#if defined(JEMALLOC_HAVE_X86_SIMD_DISPATCH) && !defined(BITMAP_USE_TREE)
+	case bitmap_simd_sse41:
+		return __builtin_cpu_supports("sse4.1")
+		    && __builtin_cpu_supports("popcnt");
+	case bitmap_simd_avx2:
+		return __builtin_cpu_supports("avx2")
+		    && __builtin_cpu_supports("popcnt");
+#endif
+	default:
+		return false;
+	}
+}
+
+void
+bitmap_boot(void) {
+#ifndef BITMAP_USE_TREE
+	for (unsigned byte = 0; byte < 256; byte++) {
+		unsigned n = 0;
+		for (unsigned bit = 0; bit < 8; bit++) {
+			if (byte & (1U << bit)) {
+				bitmap_byte_bits[byte][n++] = (uint8_t)bit;
+			}
+		}
+		bitmap_byte_nbits[byte] = (uint8_t)n;
+	}
+#endif
+#ifdef JEMALLOC_HAVE_X86_SIMD_DISPATCH
+	__builtin_cpu_init();
+#endif
+	bitmap_simd = bitmap_simd_none;
+	for (unsigned simd = bitmap_simd_none + 1; simd < bitmap_simd_limit;
+	     simd++) {
+		if (bitmap_simd_supported((bitmap_simd_t)simd)) {
+			bitmap_simd = (bitmap_simd_t)simd;
+		}
+	}
+}
+
+void
+bitmap_sfu_batch_simd(bitmap_t *bitmap, const bitmap_info_t *binfo,
+    size_t cnt, uint32_t *bits, bitmap_simd_t simd) {
+	assert(bitmap_simd_supported(simd));
+#ifdef BITMAP_USE_TREE
+	for (size_t i = 0; i < cnt; i++) {
+		bits[i] = (uint32_t)bitmap_sfu(bitmap, binfo);
+	}
+#else
+	switch (simd) {
+#	ifdef JEMALLOC_HAVE_X86_SIMD_DISPATCH
+	case bitmap_simd_avx2:
+		bitmap_sfu_batch_avx2(bitmap, binfo->ngroups, cnt, bits);
+		break;
+	case bitmap_simd_sse41:
+		bitmap_sfu_batch_sse41(bitmap, binfo->ngroups, cnt, bits);
+		break;
+#	endif
+	default:
+		bitmap_sfu_batch_scalar(bitmap, binfo->ngroups, cnt, bits);
+		break;
+	}
+#endif
+}
@@ -1,6 +1,7 @@
 #include "jemalloc/internal/jemalloc_preamble.h"
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
+#include "jemalloc/internal/alloc_trace.h"
 #include "jemalloc/internal/assert.h"
 #include "jemalloc/internal/ctl.h"
 #include "jemalloc/internal/extent_dss.h"
@@ -72,6 +73,11 @@ CTL_PROTO(thread_tcache_ncached_max_write)
 CTL_PROTO(thread_tcache_ncached_max_read_sizeclass)
 CTL_PROTO(thread_peak_read)
 CTL_PROTO(thread_peak_reset)
+CTL_PROTO(thread_rtree_ctx_hits)
+CTL_PROTO(thread_rtree_ctx_l2_hits)
+CTL_PROTO(thread_rtree_ctx_misses)
+CTL_PROTO(thread_rtree_ctx_evictions)
+CTL_PROTO(thread_rtree_ctx_reset)
 CTL_PROTO(thread_prof_name)
 CTL_PROTO(thread_prof_active)
 CTL_PROTO(thread_arena)
@@ -90,6 +96,7 @@ CTL_PROTO(config_prof)
 CTL_PROTO(config_prof_libgcc)
 CTL_PROTO(config_prof_libunwind)
 CTL_PROTO(config_prof_frameptr)
+CTL_PROTO(config_rtree_ctx_stats)
 CTL_PROTO(config_stats)
 CTL_PROTO(config_utrace)
 CTL_PROTO(config_xmalloc)
@@ -118,13 +125,16 @@ CTL_PROTO(opt_hpa_sec_bytes_after_flush)
 CTL_PROTO(opt_hpa_sec_batch_fill_extra)
 CTL_PROTO(opt_huge_arena_pac_thp)
 CTL_PROTO(opt_metadata_thp)
+CTL_PROTO(opt_metadata_reclaim)
 CTL_PROTO(opt_retain)
 CTL_PROTO(opt_dss)
 CTL_PROTO(opt_narenas)
 CTL_PROTO(opt_percpu_arena)
 CTL_PROTO(opt_oversize_threshold)
+CTL_PROTO(opt_large_remap_threshold)
 CTL_PROTO(opt_background_thread)
 CTL_PROTO(opt_mutex_max_spin)
+CTL_PROTO(opt_mutex_hold_sample)
 CTL_PROTO(opt_max_background_threads)
 CTL_PROTO(opt_dirty_decay_ms)
 CTL_PROTO(opt_muzzy_decay_ms)
@@ -138,8 +148,15 @@ CTL_PROTO(opt_utrace)
 CTL_PROTO(opt_xmalloc)
 CTL_PROTO(opt_experimental_infallible_new)
 CTL_PROTO(opt_experimental_tcache_gc)
+CTL_PROTO(opt_experimental_tcache_gc_reuse)
+CTL_PROTO(opt_tcache_idle_reclaim_ms)
+CTL_PROTO(opt_tcache_ncached_max_learn_ms)
 CTL_PROTO(opt_tcache)
 CTL_PROTO(opt_tcache_max)
+CTL_PROTO(opt_tcache_large_cache_bytes)
+CTL_PROTO(opt_tcache_large_cache_max)
+CTL_PROTO(opt_tcache_steal)
+CTL_PROTO(opt_tcache_fill_sort)
 CTL_PROTO(opt_tcache_nslots_small_min)
 CTL_PROTO(opt_tcache_nslots_small_max)
 CTL_PROTO(opt_tcache_nslots_large)
@@ -150,6 +167,7 @@ CTL_PROTO(opt_lg_tcache_flush_small_div)
 CTL_PROTO(opt_lg_tcache_flush_large_div)
 CTL_PROTO(opt_thp)
 CTL_PROTO(opt_lg_extent_max_active_fit)
+CTL_PROTO(opt_edata_cache_percpu_max)
 CTL_PROTO(opt_prof)
 CTL_PROTO(opt_prof_prefix)
 CTL_PROTO(opt_prof_active)
@@ -167,9 +185,18 @@ CTL_PROTO(opt_prof_pid_namespace)
 CTL_PROTO(opt_prof_recent_alloc_max)
 CTL_PROTO(opt_prof_stats)
 CTL_PROTO(opt_prof_sys_thread_name)
+CTL_PROTO(opt_prof_unwind_validate)
+CTL_PROTO(opt_prof_lifetime)
+CTL_PROTO(opt_prof_per_arena)
+CTL_PROTO(opt_prof_log_stream)
+CTL_PROTO(opt_prof_log_stream_buf_size)
+CTL_PROTO(opt_prof_leak_epochs)
+CTL_PROTO(opt_prof_leak_epoch_ms)
 CTL_PROTO(opt_prof_time_res)
+CTL_PROTO(opt_prof_dump_format)
 CTL_PROTO(opt_lg_san_uaf_align)
 CTL_PROTO(opt_zero_realloc)
+CTL_PROTO(opt_alloc_trace)
 CTL_PROTO(opt_disable_large_size_classes)
 CTL_PROTO(opt_process_madvise_max_batch)
 CTL_PROTO(opt_malloc_conf_symlink)
@@ -177,6 +204,7 @@ CTL_PROTO(opt_malloc_conf_env_var)
 CTL_PROTO(opt_malloc_conf_global_var)
 CTL_PROTO(opt_malloc_conf_global_var_2_conf_harder)
 CTL_PROTO(tcache_create)
+CTL_PROTO(tcache_ncached_max_learned)
 CTL_PROTO(tcache_flush)
 CTL_PROTO(tcache_destroy)
 CTL_PROTO(arena_i_initialized)
@@ -196,6 +224,7 @@ CTL_PROTO(arenas_bin_i_size)
 CTL_PROTO(arenas_bin_i_nregs)
 CTL_PROTO(arenas_bin_i_slab_size)
 CTL_PROTO(arenas_bin_i_nshards)
+CTL_PROTO(arenas_bin_i_hugepage_regions)
 INDEX_PROTO(arenas_bin_i)
 CTL_PROTO(arenas_lextent_i_size)
 INDEX_PROTO(arenas_lextent_i)
@@ -214,13 +243,17 @@ CTL_PROTO(arenas_lookup)
 CTL_PROTO(prof_thread_active_init)
 CTL_PROTO(prof_active)
 CTL_PROTO(prof_dump)
+CTL_PROTO(prof_dump_delta)
 CTL_PROTO(prof_gdump)
 CTL_PROTO(prof_prefix)
 CTL_PROTO(prof_reset)
+CTL_PROTO(prof_leak_epoch)
+CTL_PROTO(prof_leak_report)
 CTL_PROTO(prof_interval)
 CTL_PROTO(lg_prof_sample)
 CTL_PROTO(prof_log_start)
 CTL_PROTO(prof_log_stop)
+CTL_PROTO(prof_log_dropped)
 CTL_PROTO(prof_stats_bins_i_live)
 CTL_PROTO(prof_stats_bins_i_accum)
 INDEX_PROTO(prof_stats_bins_i)
@@ -239,6 +272,8 @@ CTL_PROTO(stats_arenas_i_large_ndalloc)
 CTL_PROTO(stats_arenas_i_large_nrequests)
 CTL_PROTO(stats_arenas_i_large_nfills)
 CTL_PROTO(stats_arenas_i_large_nflushes)
+CTL_PROTO(stats_arenas_i_large_zeroed_bytes)
+CTL_PROTO(stats_arenas_i_large_zero_skipped_bytes)
 CTL_PROTO(stats_arenas_i_bins_j_nmalloc)
 CTL_PROTO(stats_arenas_i_bins_j_ndalloc)
 CTL_PROTO(stats_arenas_i_bins_j_nrequests)
@@ -249,6 +284,9 @@ CTL_PROTO(stats_arenas_i_bins_j_nslabs)
 CTL_PROTO(stats_arenas_i_bins_j_nreslabs)
 CTL_PROTO(stats_arenas_i_bins_j_curslabs)
 CTL_PROTO(stats_arenas_i_bins_j_nonfull_slabs)
+CTL_PROTO(stats_arenas_i_bins_j_hugepage_regions)
+CTL_PROTO(stats_arenas_i_bins_j_hugepage_curslabs)
+CTL_PROTO(stats_arenas_i_bins_j_hugepage_unused_bytes)
 INDEX_PROTO(stats_arenas_i_bins_j)
 CTL_PROTO(stats_arenas_i_lextents_j_nmalloc)
 CTL_PROTO(stats_arenas_i_lextents_j_ndalloc)
@@ -333,8 +371,13 @@ CTL_PROTO(stats_arenas_i_internal)
 CTL_PROTO(stats_arenas_i_metadata_edata)
 CTL_PROTO(stats_arenas_i_metadata_rtree)
 CTL_PROTO(stats_arenas_i_metadata_thp)
+CTL_PROTO(stats_arenas_i_metadata_reclaimable)
 CTL_PROTO(stats_arenas_i_tcache_bytes)
 CTL_PROTO(stats_arenas_i_tcache_stashed_bytes)
+CTL_PROTO(stats_arenas_i_tcache_gc_nflushes_avoided)
+CTL_PROTO(stats_arenas_i_tcache_gc_bytes_saved)
+CTL_PROTO(stats_arenas_i_tcache_steal_attempts)
+CTL_PROTO(stats_arenas_i_tcache_steal_successes)
 CTL_PROTO(stats_arenas_i_resident)
 CTL_PROTO(stats_arenas_i_abandoned_vm)
 CTL_PROTO(stats_arenas_i_hpa_sec_bytes)
@@ -348,10 +391,13 @@ CTL_PROTO(stats_metadata)
 CTL_PROTO(stats_metadata_edata)
 CTL_PROTO(stats_metadata_rtree)
 CTL_PROTO(stats_metadata_thp)
+CTL_PROTO(stats_metadata_reclaimable)
+CTL_PROTO(stats_metadata_pinned)
 CTL_PROTO(stats_resident)
 CTL_PROTO(stats_mapped)
 CTL_PROTO(stats_retained)
 CTL_PROTO(stats_zero_reallocs)
+CTL_PROTO(stats_tcache_idle_reclaimed_bytes)
 CTL_PROTO(experimental_hooks_install)
 CTL_PROTO(experimental_hooks_remove)
 CTL_PROTO(experimental_hooks_prof_backtrace)
@@ -369,6 +415,8 @@ INDEX_PROTO(experimental_arenas_i)
 CTL_PROTO(experimental_prof_recent_alloc_max)
 CTL_PROTO(experimental_prof_recent_alloc_dump)
 CTL_PROTO(experimental_batch_alloc)
+CTL_PROTO(experimental_alloc_trace_start)
+CTL_PROTO(experimental_alloc_trace_stop)
 CTL_PROTO(experimental_arenas_create_ext)
 
 #define MUTEX_STATS_CTL_PROTO_GEN(n)                                           \
@@ -378,7 +426,12 @@ CTL_PROTO(experimental_arenas_create_ext)
 	CTL_PROTO(stats_##n##_num_owner_switch)                                \
 	CTL_PROTO(stats_##n##_total_wait_time)                                 \
 	CTL_PROTO(stats_##n##_max_wait_time)                                   \
-	CTL_PROTO(stats_##n##_max_num_thds)
+	CTL_PROTO(stats_##n##_max_num_thds)                                    \
+	CTL_PROTO(stats_##n##_num_hold_samples)                                \
+	CTL_PROTO(stats_##n##_total_hold_time)                                 \
+	CTL_PROTO(stats_##n##_max_hold_time)                                   \
+	CTL_PROTO(stats_##n##_hold_hist_k)                                     \
+	INDEX_PROTO(stats_##n##_hold_hist)
 
 /* Global mutexes. */
 #define OP(mtx) MUTEX_STATS_CTL_PROTO_GEN(mutexes_##mtx)
@@ -426,6 +479,13 @@ static const ctl_named_node_t thread_peak_node[] = {
     {NAME("reset"), CTL(thread_peak_reset)},
 };
 
+static const ctl_named_node_t thread_rtree_ctx_node[] = {
+    {NAME("hits"), CTL(thread_rtree_ctx_hits)},
+    {NAME("l2_hits"), CTL(thread_rtree_ctx_l2_hits)},
+    {NAME("misses"), CTL(thread_rtree_ctx_misses)},
+    {NAME("evictions"), CTL(thread_rtree_ctx_evictions)},
+    {NAME("reset"), CTL(thread_rtree_ctx_reset)}};
+
 static const ctl_named_node_t thread_prof_node[] = {
     {NAME("name"), CTL(thread_prof_name)},
     {NAME("active"), CTL(thread_prof_active)}};
@@ -438,6 +498,7 @@ static const ctl_named_node_t thread_node[] = {
     {NAME("deallocatedp"), CTL(thread_deallocatedp)},
     {NAME("tcache"), CHILD(named, thread_tcache)},
     {NAME("peak"), CHILD(named, thread_peak)},
+    {NAME("rtree_ctx"), CHILD(named, thread_rtree_ctx)},
     {NAME("prof"), CHILD(named, thread_prof)},
     {NAME("idle"), CTL(thread_idle)}};
 
@@ -451,6 +512,7 @@ static const ctl_named_node_t config_node[] = {
     {NAME("prof_libgcc"), CTL(config_prof_libgcc)},
     {NAME("prof_libunwind"), CTL(config_prof_libunwind)},
     {NAME("prof_frameptr"), CTL(config_prof_frameptr)},
+    {NAME("rtree_ctx_stats"), CTL(config_rtree_ctx_stats)},
     {NAME("stats"), CTL(config_stats)}, {NAME("utrace"), CTL(config_utrace)},
     {NAME("xmalloc"), CTL(config_xmalloc)}};
 
@@ -486,11 +548,14 @@ static const ctl_named_node_t opt_node[] = {{NAME("abort"), CTL(opt_abort)},
     {NAME("hpa_sec_batch_fill_extra"), CTL(opt_hpa_sec_batch_fill_extra)},
     {NAME("huge_arena_pac_thp"), CTL(opt_huge_arena_pac_thp)},
     {NAME("metadata_thp"), CTL(opt_metadata_thp)},
+    {NAME("metadata_reclaim"), CTL(opt_metadata_reclaim)},
     {NAME("retain"), CTL(opt_retain)}, {NAME("dss"), CTL(opt_dss)},
     {NAME("narenas"), CTL(opt_narenas)},
     {NAME("percpu_arena"), CTL(opt_percpu_arena)},
     {NAME("oversize_threshold"), CTL(opt_oversize_threshold)},
+    {NAME("large_remap_threshold"), CTL(opt_large_remap_threshold)},
     {NAME("mutex_max_spin"), CTL(opt_mutex_max_spin)},
+    {NAME("mutex_hold_sample"), CTL(opt_mutex_hold_sample)},
     {NAME("background_thread"), CTL(opt_background_thread)},
     {NAME("max_background_threads"), CTL(opt_max_background_threads)},
     {NAME("dirty_decay_ms"), CTL(opt_dirty_decay_ms)},
@@ -503,8 +568,17 @@ static const ctl_named_node_t opt_node[] = {{NAME("abort"), CTL(opt_abort)},
     {NAME("utrace"), CTL(opt_utrace)}, {NAME("xmalloc"), CTL(opt_xmalloc)},
     {NAME("experimental_infallible_new"), CTL(opt_experimental_infallible_new)},
     {NAME("experimental_tcache_gc"), CTL(opt_experimental_tcache_gc)},
+    {NAME("experimental_tcache_gc_reuse"),
+        CTL(opt_experimental_tcache_gc_reuse)},
+    {NAME("tcache_idle_reclaim_ms"), CTL(opt_tcache_idle_reclaim_ms)},
+    {NAME("tcache_ncached_max_learn_ms"),
+        CTL(opt_tcache_ncached_max_learn_ms)},
     {NAME("tcache"), CTL(opt_tcache)},
     {NAME("tcache_max"), CTL(opt_tcache_max)},
+    {NAME("tcache_large_cache_bytes"), CTL(opt_tcache_large_cache_bytes)},
+    {NAME("tcache_large_cache_max"), CTL(opt_tcache_large_cache_max)},
+    {NAME("tcache_steal"), CTL(opt_tcache_steal)},
+    {NAME("tcache_fill_sort"), CTL(opt_tcache_fill_sort)},
     {NAME("tcache_nslots_small_min"), CTL(opt_tcache_nslots_small_min)},
     {NAME("tcache_nslots_small_max"), CTL(opt_tcache_nslots_small_max)},
     {NAME("tcache_nslots_large"), CTL(opt_tcache_nslots_large)},
@@ -515,6 +589,7 @@ static const ctl_named_node_t opt_node[] = {{NAME("abort"), CTL(opt_abort)},
     {NAME("lg_tcache_flush_large_div"), CTL(opt_lg_tcache_flush_large_div)},
     {NAME("thp"), CTL(opt_thp)},
     {NAME("lg_extent_max_active_fit"), CTL(opt_lg_extent_max_active_fit)},
+    {NAME("edata_cache_percpu_max"), CTL(opt_edata_cache_percpu_max)},
     {NAME("prof"), CTL(opt_prof)}, {NAME("prof_prefix"), CTL(opt_prof_prefix)},
     {NAME("prof_active"), CTL(opt_prof_active)},
     {NAME("prof_thread_active_init"), CTL(opt_prof_thread_active_init)},
@@ -532,9 +607,18 @@ static const ctl_named_node_t opt_node[] = {{NAME("abort"), CTL(opt_abort)},
     {NAME("prof_recent_alloc_max"), CTL(opt_prof_recent_alloc_max)},
     {NAME("prof_stats"), CTL(opt_prof_stats)},
     {NAME("prof_sys_thread_name"), CTL(opt_prof_sys_thread_name)},
+    {NAME("prof_unwind_validate"), CTL(opt_prof_unwind_validate)},
+    {NAME("prof_lifetime"), CTL(opt_prof_lifetime)},
+    {NAME("prof_per_arena"), CTL(opt_prof_per_arena)},
+    {NAME("prof_log_stream"), CTL(opt_prof_log_stream)},
+    {NAME("prof_log_stream_buf_size"), CTL(opt_prof_log_stream_buf_size)},
+    {NAME("prof_leak_epochs"), CTL(opt_prof_leak_epochs)},
+    {NAME("prof_leak_epoch_ms"), CTL(opt_prof_leak_epoch_ms)},
     {NAME("prof_time_resolution"), CTL(opt_prof_time_res)},
+    {NAME("prof_dump_format"), CTL(opt_prof_dump_format)},
     {NAME("lg_san_uaf_align"), CTL(opt_lg_san_uaf_align)},
     {NAME("zero_realloc"), CTL(opt_zero_realloc)},
+    {NAME("alloc_trace"), CTL(opt_alloc_trace)},
     {NAME("debug_double_free_max_scan"), CTL(opt_debug_double_free_max_scan)},
     {NAME("disable_large_size_classes"), CTL(opt_disable_large_size_classes)},
     {NAME("process_madvise_max_batch"), CTL(opt_process_madvise_max_batch)},
@@ -542,7 +626,8 @@ static const ctl_named_node_t opt_node[] = {{NAME("abort"), CTL(opt_abort)},
 
 static const ctl_named_node_t tcache_node[] = {
     {NAME("create"), CTL(tcache_create)}, {NAME("flush"), CTL(tcache_flush)},
-    {NAME("destroy"), CTL(tcache_destroy)}};
+    {NAME("destroy"), CTL(tcache_destroy)},
+    {NAME("ncached_max_learned"), CTL(tcache_ncached_max_learned)}};
 
 static const ctl_named_node_t arena_i_node[] = {
     {NAME("initialized"), CTL(arena_i_initialized)},
@@ -568,7 +653,8 @@ static const ctl_named_node_t arenas_bin_i_node[] = {
     {NAME("size"), CTL(arenas_bin_i_size)},
     {NAME("nregs"), CTL(arenas_bin_i_nregs)},
     {NAME("slab_size"), CTL(arenas_bin_i_slab_size)},
-    {NAME("nshards"), CTL(arenas_bin_i_nshards)}};
+    {NAME("nshards"), CTL(arenas_bin_i_nshards)},
+    {NAME("hugepage_regions"), CTL(arenas_bin_i_hugepage_regions)}};
 static const ctl_named_node_t super_arenas_bin_i_node[] = {
     {NAME(""), CHILD(named, arenas_bin_i)}};
 
@@ -623,11 +709,15 @@ static const ctl_named_node_t prof_stats_node[] = {
 static const ctl_named_node_t prof_node[] = {
     {NAME("thread_active_init"), CTL(prof_thread_active_init)},
     {NAME("active"), CTL(prof_active)}, {NAME("dump"), CTL(prof_dump)},
+    {NAME("dump_delta"), CTL(prof_dump_delta)},
     {NAME("gdump"), CTL(prof_gdump)}, {NAME("prefix"), CTL(prof_prefix)},
     {NAME("reset"), CTL(prof_reset)}, {NAME("interval"), CTL(prof_interval)},
     {NAME("lg_sample"), CTL(lg_prof_sample)},
+    {NAME("leak_epoch"), CTL(prof_leak_epoch)},
+    {NAME("leak_report"), CTL(prof_leak_report)},
     {NAME("log_start"), CTL(prof_log_start)},
     {NAME("log_stop"), CTL(prof_log_stop)},
+    {NAME("log_dropped"), CTL(prof_log_dropped)},
     {NAME("stats"), CHILD(named, prof_stats)}};
 
 static const ctl_named_node_t stats_arenas_i_small_node[] = {
@@ -644,9 +734,16 @@ static const ctl_named_node_t stats_arenas_i_large_node[] = {
     {NAME("ndalloc"), CTL(stats_arenas_i_large_ndalloc)},
     {NAME("nrequests"), CTL(stats_arenas_i_large_nrequests)},
     {NAME("nfills"), CTL(stats_arenas_i_large_nfills)},
-    {NAME("nflushes"), CTL(stats_arenas_i_large_nflushes)}};
+    {NAME("nflushes"), CTL(stats_arenas_i_large_nflushes)},
+    {NAME("zeroed_bytes"), CTL(stats_arenas_i_large_zeroed_bytes)},
+    {NAME("zero_skipped_bytes"),
+        CTL(stats_arenas_i_large_zero_skipped_bytes)}};
 
 #define MUTEX_PROF_DATA_NODE(prefix)                                                                          \
+	static const ctl_named_node_t stats_##prefix##_hold_hist_k_node[] = {                                 \
+	    {NAME(""), CTL(stats_##prefix##_hold_hist_k)}};                                                   \
+	static const ctl_indexed_node_t stats_##prefix##_hold_hist_node[] = {                                 \
+	    {INDEX(stats_##prefix##_hold_hist)}};                                                             \
 	static const ctl_named_node_t stats_##prefix##_node[] = {                                             \
 	    {NAME("num_ops"), CTL(stats_##prefix##_num_ops)},                                                 \
 	    {NAME("num_wait"), CTL(stats_##prefix##_num_wait)},                                               \
@@ -656,8 +753,11 @@ static const ctl_named_node_t stats_arenas_i_large_node[] = {
 	    {NAME("total_wait_time"), CTL(stats_##prefix##_total_wait_time)},                                 \
 	    {NAME("max_wait_time"), CTL(stats_##prefix##_max_wait_time)},                                     \
 	    {NAME("max_num_thds"),                                                                            \
-	        CTL(stats_##prefix##_max_num_thds)} /* Note that # of current waiting thread not provided. */ \
-	};
+	        CTL(stats_##prefix##_max_num_thds)}, /* Note that # of current waiting thread not provided. */ \
+	    {NAME("num_hold_samples"), CTL(stats_##prefix##_num_hold_samples)},                               \
+	    {NAME("total_hold_time"), CTL(stats_##prefix##_total_hold_time)},                                 \
+	    {NAME("max_hold_time"), CTL(stats_##prefix##_max_hold_time)},                                     \
+	    {NAME("hold_hist"), CHILD(indexed, stats_##prefix##_hold_hist)}};
 
 MUTEX_PROF_DATA_NODE(arenas_i_bins_j_mutex)
 
@@ -672,6 +772,11 @@ static const ctl_named_node_t stats_arenas_i_bins_j_node[] = {
     {NAME("nreslabs"), CTL(stats_arenas_i_bins_j_nreslabs)},
     {NAME("curslabs"), CTL(stats_arenas_i_bins_j_curslabs)},
     {NAME("nonfull_slabs"), CTL(stats_arenas_i_bins_j_nonfull_slabs)},
+    {NAME("hugepage_regions"), CTL(stats_arenas_i_bins_j_hugepage_regions)},
+    {NAME("hugepage_curslabs"),
+        CTL(stats_arenas_i_bins_j_hugepage_curslabs)},
+    {NAME("hugepage_unused_bytes"),
+        CTL(stats_arenas_i_bins_j_hugepage_unused_bytes)},
     {NAME("mutex"), CHILD(named, stats_arenas_i_bins_j_mutex)}};
 
 static const ctl_named_node_t super_stats_arenas_i_bins_j_node[] = {
@@ -817,8 +922,16 @@ static const ctl_named_node_t stats_arenas_i_node[] = {
     {NAME("metadata_edata"), CTL(stats_arenas_i_metadata_edata)},
     {NAME("metadata_rtree"), CTL(stats_arenas_i_metadata_rtree)},
     {NAME("metadata_thp"), CTL(stats_arenas_i_metadata_thp)},
+    {NAME("metadata_reclaimable"), CTL(stats_arenas_i_metadata_reclaimable)},
     {NAME("tcache_bytes"), CTL(stats_arenas_i_tcache_bytes)},
     {NAME("tcache_stashed_bytes"), CTL(stats_arenas_i_tcache_stashed_bytes)},
+    {NAME("tcache_gc_nflushes_avoided"),
+        CTL(stats_arenas_i_tcache_gc_nflushes_avoided)},
+    {NAME("tcache_gc_bytes_saved"), CTL(stats_arenas_i_tcache_gc_bytes_saved)},
+    {NAME("tcache_steal_attempts"),
+        CTL(stats_arenas_i_tcache_steal_attempts)},
+    {NAME("tcache_steal_successes"),
+        CTL(stats_arenas_i_tcache_steal_successes)},
     {NAME("resident"), CTL(stats_arenas_i_resident)},
     {NAME("abandoned_vm"), CTL(stats_arenas_i_abandoned_vm)},
     {NAME("hpa_sec_bytes"), CTL(stats_arenas_i_hpa_sec_bytes)},
@@ -857,6 +970,8 @@ static const ctl_named_node_t stats_node[] = {
     {NAME("metadata_edata"), CTL(stats_metadata_edata)},
     {NAME("metadata_rtree"), CTL(stats_metadata_rtree)},
     {NAME("metadata_thp"), CTL(stats_metadata_thp)},
+    {NAME("metadata_reclaimable"), CTL(stats_metadata_reclaimable)},
+    {NAME("metadata_pinned"), CTL(stats_metadata_pinned)},
     {NAME("resident"), CTL(stats_resident)},
     {NAME("mapped"), CTL(stats_mapped)},
     {NAME("retained"), CTL(stats_retained)},
@@ -864,6 +979,8 @@ static const ctl_named_node_t stats_node[] = {
     {NAME("mutexes"), CHILD(named, stats_mutexes)},
     {NAME("arenas"), CHILD(indexed, stats_arenas)},
     {NAME("zero_reallocs"), CTL(stats_zero_reallocs)},
+    {NAME("tcache_idle_reclaimed_bytes"),
+        CTL(stats_tcache_idle_reclaimed_bytes)},
 };
 
 static const ctl_named_node_t experimental_hooks_node[] = {
@@ -898,6 +1015,11 @@ static const ctl_named_node_t experimental_prof_recent_node[] = {
     {NAME("alloc_dump"), CTL(experimental_prof_recent_alloc_dump)},
 };
 
+static const ctl_named_node_t experimental_alloc_trace_node[] = {
+    {NAME("start"), CTL(experimental_alloc_trace_start)},
+    {NAME("stop"), CTL(experimental_alloc_trace_stop)},
+};
+
 static const ctl_named_node_t experimental_node[] = {
     {NAME("hooks"), CHILD(named, experimental_hooks)},
     {NAME("utilization"), CHILD(named, experimental_utilization)},
@@ -905,6 +1027,7 @@ static const ctl_named_node_t experimental_node[] = {
     {NAME("arenas_create_ext"), CTL(experimental_arenas_create_ext)},
     {NAME("prof_recent"), CHILD(named, experimental_prof_recent)},
     {NAME("batch_alloc"), CTL(experimental_batch_alloc)},
+    {NAME("alloc_trace"), CHILD(named, experimental_alloc_trace)},
     {NAME("thread"), CHILD(named, experimental_thread)}};
 
 static const ctl_named_node_t root_node[] = {{NAME("version"), CTL(version)},
@@ -1145,6 +1268,8 @@ ctl_arena_stats_sdmerge(
 			    astats->astats.metadata_edata;
 			sdstats->astats.metadata_rtree +=
 			    astats->astats.metadata_rtree;
+			sdstats->astats.metadata_reclaimable +=
+			    astats->astats.metadata_reclaimable;
 			sdstats->astats.resident += astats->astats.resident;
 			sdstats->astats.metadata_thp +=
 			    astats->astats.metadata_thp;
@@ -1178,6 +1303,10 @@ ctl_arena_stats_sdmerge(
 		sdstats->astats.nrequests_large +=
 		    astats->astats.nrequests_large;
 		sdstats->astats.nflushes_large += astats->astats.nflushes_large;
+		ctl_accum_locked_u64(&sdstats->astats.zeroed_bytes_large,
+		    &astats->astats.zeroed_bytes_large);
+		ctl_accum_locked_u64(&sdstats->astats.zero_skipped_bytes_large,
+		    &astats->astats.zero_skipped_bytes_large);
 		ctl_accum_atomic_zu(
 		    &sdstats->astats.pa_shard_stats.pac_stats.abandoned_vm,
 		    &astats->astats.pa_shard_stats.pac_stats.abandoned_vm);
@@ -1185,6 +1314,14 @@ ctl_arena_stats_sdmerge(
 		sdstats->astats.tcache_bytes += astats->astats.tcache_bytes;
 		sdstats->astats.tcache_stashed_bytes +=
 		    astats->astats.tcache_stashed_bytes;
+		ctl_accum_locked_u64(&sdstats->astats.tcache_gc_nflushes_avoided,
+		    &astats->astats.tcache_gc_nflushes_avoided);
+		ctl_accum_locked_u64(&sdstats->astats.tcache_gc_bytes_saved,
+		    &astats->astats.tcache_gc_bytes_saved);
+		ctl_accum_locked_u64(&sdstats->astats.tcache_steal_attempts,
+		    &astats->astats.tcache_steal_attempts);
+		ctl_accum_locked_u64(&sdstats->astats.tcache_steal_successes,
+		    &astats->astats.tcache_steal_successes);
 
 		if (ctl_arena->arena_ind == 0) {
 			sdstats->astats.uptime = astats->astats.uptime;
@@ -1209,9 +1346,18 @@ ctl_arena_stats_sdmerge(
 			if (!destroyed) {
 				merged->curslabs += bstats->curslabs;
 				merged->nonfull_slabs += bstats->nonfull_slabs;
+				merged->hugepage_regions +=
+				    bstats->hugepage_regions;
+				merged->hugepage_curslabs +=
+				    bstats->hugepage_curslabs;
+				merged->hugepage_unused_bytes +=
+				    bstats->hugepage_unused_bytes;
 			} else {
 				assert(bstats->curslabs == 0);
 				assert(bstats->nonfull_slabs == 0);
+				assert(bstats->hugepage_regions == 0);
+				assert(bstats->hugepage_curslabs == 0);
+				assert(bstats->hugepage_unused_bytes == 0);
 			}
 			malloc_mutex_prof_merge(&sdstats->bstats[i].mutex_data,
 			    &astats->bstats[i].mutex_data);
@@ -1357,6 +1503,11 @@ ctl_refresh(tsdn_t *tsdn) {
 		ctl_stats->resident = ctl_sarena->astats->astats.resident;
 		ctl_stats->metadata_thp =
 		    ctl_sarena->astats->astats.metadata_thp;
+		ctl_stats->metadata_reclaimable =
+		    ctl_sarena->astats->astats.metadata_reclaimable;
+		assert(ctl_stats->metadata_reclaimable <= ctl_stats->metadata);
+		ctl_stats->metadata_pinned = ctl_stats->metadata
+		    - ctl_stats->metadata_reclaimable;
 		ctl_stats->mapped = ctl_sarena->astats->astats.mapped;
 		ctl_stats->retained = ctl_sarena->astats->astats.pa_shard_stats
 		                          .pac_stats.retained;
@@ -2122,6 +2273,7 @@ CTL_RO_CONFIG_GEN(config_prof, bool)
 CTL_RO_CONFIG_GEN(config_prof_libgcc, bool)
 CTL_RO_CONFIG_GEN(config_prof_libunwind, bool)
 CTL_RO_CONFIG_GEN(config_prof_frameptr, bool)
+CTL_RO_CONFIG_GEN(config_rtree_ctx_stats, bool)
 CTL_RO_CONFIG_GEN(config_stats, bool)
 CTL_RO_CONFIG_GEN(config_utrace, bool)
 CTL_RO_CONFIG_GEN(config_xmalloc, bool)
@@ -2172,13 +2324,16 @@ CTL_RO_NL_GEN(
 CTL_RO_NL_GEN(opt_huge_arena_pac_thp, opt_huge_arena_pac_thp, bool)
 CTL_RO_NL_GEN(
     opt_metadata_thp, metadata_thp_mode_names[opt_metadata_thp], const char *)
+CTL_RO_NL_GEN(opt_metadata_reclaim, opt_metadata_reclaim, bool)
 CTL_RO_NL_GEN(opt_retain, opt_retain, bool)
 CTL_RO_NL_GEN(opt_dss, opt_dss, const char *)
 CTL_RO_NL_GEN(opt_narenas, opt_narenas, unsigned)
 CTL_RO_NL_GEN(
     opt_percpu_arena, percpu_arena_mode_names[opt_percpu_arena], const char *)
 CTL_RO_NL_GEN(opt_mutex_max_spin, opt_mutex_max_spin, int64_t)
+CTL_RO_NL_GEN(opt_mutex_hold_sample, opt_mutex_hold_sample, unsigned)
 CTL_RO_NL_GEN(opt_oversize_threshold, opt_oversize_threshold, size_t)
+CTL_RO_NL_GEN(opt_large_remap_threshold, opt_large_remap_threshold, size_t)
 CTL_RO_NL_GEN(opt_background_thread, opt_background_thread, bool)
 CTL_RO_NL_GEN(opt_max_background_threads, opt_max_background_threads, size_t)
 CTL_RO_NL_GEN(opt_dirty_decay_ms, opt_dirty_decay_ms, ssize_t)
@@ -2194,8 +2349,17 @@ CTL_RO_NL_CGEN(config_xmalloc, opt_xmalloc, opt_xmalloc, bool)
 CTL_RO_NL_CGEN(config_enable_cxx, opt_experimental_infallible_new,
     opt_experimental_infallible_new, bool)
 CTL_RO_NL_GEN(opt_experimental_tcache_gc, opt_experimental_tcache_gc, bool)
+CTL_RO_NL_GEN(opt_experimental_tcache_gc_reuse,
+    opt_experimental_tcache_gc_reuse, bool)
+CTL_RO_NL_GEN(opt_tcache_idle_reclaim_ms, opt_tcache_idle_reclaim_ms, ssize_t)
+CTL_RO_NL_GEN(opt_tcache_ncached_max_learn_ms, opt_tcache_ncached_max_learn_ms,
+    ssize_t)
 CTL_RO_NL_GEN(opt_tcache, opt_tcache, bool)
 CTL_RO_NL_GEN(opt_tcache_max, opt_tcache_max, size_t)
+CTL_RO_NL_GEN(opt_tcache_large_cache_bytes, opt_tcache_large_cache_bytes, size_t)
+CTL_RO_NL_GEN(opt_tcache_large_cache_max, opt_tcache_large_cache_max, size_t)
+CTL_RO_NL_GEN(opt_tcache_steal, opt_tcache_steal, bool)
+CTL_RO_NL_GEN(opt_tcache_fill_sort, opt_tcache_fill_sort, bool)
 CTL_RO_NL_GEN(
     opt_tcache_nslots_small_min, opt_tcache_nslots_small_min, unsigned)
 CTL_RO_NL_GEN(
@@ -2211,6 +2375,8 @@ CTL_RO_NL_GEN(
 CTL_RO_NL_GEN(opt_thp, thp_mode_names[opt_thp], const char *)
 CTL_RO_NL_GEN(
     opt_lg_extent_max_active_fit, opt_lg_extent_max_active_fit, size_t)
+CTL_RO_NL_GEN(
+    opt_edata_cache_percpu_max, opt_edata_cache_percpu_max, size_t)
 CTL_RO_NL_GEN(
     opt_process_madvise_max_batch, opt_process_madvise_max_batch, size_t)
 CTL_RO_NL_CGEN(config_prof, opt_prof, opt_prof, bool)
@@ -2235,12 +2401,26 @@ CTL_RO_NL_CGEN(
 CTL_RO_NL_CGEN(config_prof, opt_prof_stats, opt_prof_stats, bool)
 CTL_RO_NL_CGEN(
     config_prof, opt_prof_sys_thread_name, opt_prof_sys_thread_name, bool)
+CTL_RO_NL_CGEN(
+    config_prof, opt_prof_unwind_validate, opt_prof_unwind_validate, bool)
+CTL_RO_NL_CGEN(config_prof, opt_prof_lifetime, opt_prof_lifetime, bool)
+CTL_RO_NL_CGEN(config_prof, opt_prof_per_arena, opt_prof_per_arena, bool)
+CTL_RO_NL_CGEN(config_prof, opt_prof_log_stream, opt_prof_log_stream, bool)
+CTL_RO_NL_CGEN(config_prof, opt_prof_log_stream_buf_size,
+    opt_prof_log_stream_buf_size, size_t)
+CTL_RO_NL_CGEN(
+    config_prof, opt_prof_leak_epochs, opt_prof_leak_epochs, unsigned)
+CTL_RO_NL_CGEN(
+    config_prof, opt_prof_leak_epoch_ms, opt_prof_leak_epoch_ms, uint64_t)
 CTL_RO_NL_CGEN(config_prof, opt_prof_time_res,
     prof_time_res_mode_names[opt_prof_time_res], const char *)
+CTL_RO_NL_CGEN(config_prof, opt_prof_dump_format,
+    prof_dump_format_names[opt_prof_dump_format], const char *)
 CTL_RO_NL_CGEN(
     config_uaf_detection, opt_lg_san_uaf_align, opt_lg_san_uaf_align, ssize_t)
 CTL_RO_NL_GEN(opt_zero_realloc,
     zero_realloc_mode_names[opt_zero_realloc_action], const char *)
+CTL_RO_NL_GEN(opt_alloc_trace, opt_alloc_trace, const char *)
 CTL_RO_NL_GEN(
     opt_disable_large_size_classes, opt_disable_large_size_classes, bool)
 
@@ -2492,6 +2672,36 @@ label_return:
 	return ret;
 }
 
+static rtree_ctx_stats_t
+thread_rtree_ctx_stats_get(tsd_t *tsd) {
+	rtree_ctx_stats_t stats;
+	rtree_ctx_stats_read(tsd_rtree_ctx(tsd), &stats);
+	return stats;
+}
+
+CTL_RO_NL_CGEN(config_rtree_ctx_stats, thread_rtree_ctx_hits,
+    thread_rtree_ctx_stats_get(tsd).hits, uint64_t)
+CTL_RO_NL_CGEN(config_rtree_ctx_stats, thread_rtree_ctx_l2_hits,
+    thread_rtree_ctx_stats_get(tsd).l2_hits, uint64_t)
+CTL_RO_NL_CGEN(config_rtree_ctx_stats, thread_rtree_ctx_misses,
+    thread_rtree_ctx_stats_get(tsd).misses, uint64_t)
+CTL_RO_NL_CGEN(config_rtree_ctx_stats, thread_rtree_ctx_evictions,
+    thread_rtree_ctx_stats_get(tsd).evictions, uint64_t)
+
+static int
+thread_rtree_ctx_reset_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+    void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+	if (!config_rtree_ctx_stats) {
+		return ENOENT;
+	}
+	NEITHER_READ_NOR_WRITE();
+	rtree_ctx_stats_reset(tsd_rtree_ctx(tsd));
+	ret = 0;
+label_return:
+	return ret;
+}
+
 static int
 thread_prof_name_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
     size_t *oldlenp, void *newp, size_t newlen) {
@@ -2638,6 +2848,25 @@ label_return:
 	return ret;
 }
 
+static int
+tcache_ncached_max_learned_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+    void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+
+	READONLY();
+	const char *settings = tcache_ncached_max_learned_get();
+	if (settings == NULL) {
+		/* Not learning, or still warming up. */
+		ret = EAGAIN;
+		goto label_return;
+	}
+	READ(settings, const char *);
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
 /******************************************************************************/
 
 static int
@@ -3244,6 +3473,8 @@ CTL_RO_NL_GEN(arenas_bin_i_size, bin_infos[mib[2]].reg_size, size_t)
 CTL_RO_NL_GEN(arenas_bin_i_nregs, bin_infos[mib[2]].nregs, uint32_t)
 CTL_RO_NL_GEN(arenas_bin_i_slab_size, bin_infos[mib[2]].slab_size, size_t)
 CTL_RO_NL_GEN(arenas_bin_i_nshards, bin_infos[mib[2]].n_shards, uint32_t)
+CTL_RO_NL_GEN(arenas_bin_i_hugepage_regions,
+    arena_slab_hugepage_regions[mib[2]], unsigned)
 static const ctl_named_node_t *
 arenas_bin_i_index(tsdn_t *tsdn, const size_t *mib, size_t miblen, size_t i) {
 	if (i > SC_NBINS) {
@@ -3439,6 +3670,29 @@ label_return:
 	return ret;
 }
 
+static int
+prof_dump_delta_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
+    size_t *oldlenp, void *newp, size_t newlen) {
+	int         ret;
+	const char *filename = NULL;
+
+	if (!config_prof || !opt_prof) {
+		return ENOENT;
+	}
+
+	WRITEONLY();
+	WRITE(filename, const char *);
+
+	if (prof_ddump(tsd, filename)) {
+		ret = EFAULT;
+		goto label_return;
+	}
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
 static int
 prof_gdump_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
     size_t *oldlenp, void *newp, size_t newlen) {
@@ -3515,6 +3769,61 @@ label_return:
 CTL_RO_NL_CGEN(config_prof, prof_interval, prof_interval, uint64_t)
 CTL_RO_NL_CGEN(config_prof, lg_prof_sample, lg_prof_sample, size_t)
 
+static int
+prof_leak_epoch_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
+    size_t *oldlenp, void *newp, size_t newlen) {
+	int             ret;
+	UNUSED unsigned newval;
+
+	if (!config_prof || !opt_prof || opt_prof_leak_epochs == 0) {
+		return ENOENT;
+	}
+
+	WRITE(newval, unsigned);
+	if (newp == NULL) {
+		prof_leak_epoch_deferred_work(tsd);
+	} else if (prof_leak_epoch_advance(tsd)) {
+		ret = EFAULT;
+		goto label_return;
+	}
+	unsigned epoch = prof_leak_epoch_get();
+	READ(epoch, unsigned);
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
+typedef struct write_cb_packet_s write_cb_packet_t;
+struct write_cb_packet_s {
+	write_cb_t *write_cb;
+	void       *cbopaque;
+};
+
+static int
+prof_leak_report_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
+    size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+
+	if (!config_prof || !opt_prof || opt_prof_leak_epochs == 0) {
+		return ENOENT;
+	}
+
+	WRITEONLY();
+	write_cb_packet_t write_cb_packet;
+	ASSURED_WRITE(write_cb_packet, write_cb_packet_t);
+
+	if (prof_leak_report(
+	        tsd, write_cb_packet.write_cb, write_cb_packet.cbopaque)) {
+		ret = EFAULT;
+		goto label_return;
+	}
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
 static int
 prof_log_start_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
     size_t *oldlenp, void *newp, size_t newlen) {
@@ -3553,6 +3862,25 @@ prof_log_stop_ctl(tsd_t *tsd, const size_t *mib, size_t miblen, void *oldp,
 	return 0;
 }
 
+static int
+prof_log_dropped_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
+    void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int      ret;
+	uint64_t dropped;
+
+	if (!config_prof || !opt_prof) {
+		return ENOENT;
+	}
+
+	READONLY();
+	dropped = prof_log_dropped_get(tsd_tsdn(tsd));
+	READ(dropped, uint64_t);
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
 static int
 experimental_hooks_prof_backtrace_ctl(tsd_t *tsd, const size_t *mib,
     size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
@@ -3737,6 +4065,10 @@ CTL_RO_CGEN(
 CTL_RO_CGEN(
     config_stats, stats_metadata_rtree, ctl_stats->metadata_rtree, size_t)
 CTL_RO_CGEN(config_stats, stats_metadata_thp, ctl_stats->metadata_thp, size_t)
+CTL_RO_CGEN(config_stats, stats_metadata_reclaimable,
+    ctl_stats->metadata_reclaimable, size_t)
+CTL_RO_CGEN(
+    config_stats, stats_metadata_pinned, ctl_stats->metadata_pinned, size_t)
 CTL_RO_CGEN(config_stats, stats_resident, ctl_stats->resident, size_t)
 CTL_RO_CGEN(config_stats, stats_mapped, ctl_stats->mapped, size_t)
 CTL_RO_CGEN(config_stats, stats_retained, ctl_stats->retained, size_t)
@@ -3750,6 +4082,8 @@ CTL_RO_CGEN(config_stats, stats_background_thread_run_interval,
 
 CTL_RO_CGEN(config_stats, stats_zero_reallocs,
     atomic_load_zu(&zero_realloc_count, ATOMIC_RELAXED), size_t)
+CTL_RO_CGEN(config_stats, stats_tcache_idle_reclaimed_bytes,
+    atomic_load_zu(&tcache_idle_reclaimed_bytes, ATOMIC_RELAXED), size_t)
 
 CTL_RO_GEN(stats_arenas_i_dss, arenas_i(mib[2])->dss, const char *)
 CTL_RO_GEN(
@@ -3812,10 +4146,28 @@ CTL_RO_CGEN(config_stats, stats_arenas_i_metadata_rtree,
     arenas_i(mib[2])->astats->astats.metadata_rtree, size_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_metadata_thp,
     arenas_i(mib[2])->astats->astats.metadata_thp, size_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_metadata_reclaimable,
+    arenas_i(mib[2])->astats->astats.metadata_reclaimable, size_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_tcache_bytes,
     arenas_i(mib[2])->astats->astats.tcache_bytes, size_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_tcache_stashed_bytes,
     arenas_i(mib[2])->astats->astats.tcache_stashed_bytes, size_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_tcache_gc_nflushes_avoided,
+    locked_read_u64_unsynchronized(
+        &arenas_i(mib[2])->astats->astats.tcache_gc_nflushes_avoided),
+    uint64_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_tcache_gc_bytes_saved,
+    locked_read_u64_unsynchronized(
+        &arenas_i(mib[2])->astats->astats.tcache_gc_bytes_saved),
+    uint64_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_tcache_steal_attempts,
+    locked_read_u64_unsynchronized(
+        &arenas_i(mib[2])->astats->astats.tcache_steal_attempts),
+    uint64_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_tcache_steal_successes,
+    locked_read_u64_unsynchronized(
+        &arenas_i(mib[2])->astats->astats.tcache_steal_successes),
+    uint64_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_resident,
     arenas_i(mib[2])->astats->astats.resident, size_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_abandoned_vm,
@@ -3855,6 +4207,14 @@ CTL_RO_CGEN(config_stats, stats_arenas_i_large_nfills,
     arenas_i(mib[2])->astats->astats.nmalloc_large, uint64_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_large_nflushes,
     arenas_i(mib[2])->astats->astats.nflushes_large, uint64_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_large_zeroed_bytes,
+    locked_read_u64_unsynchronized(
+        &arenas_i(mib[2])->astats->astats.zeroed_bytes_large),
+    uint64_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_large_zero_skipped_bytes,
+    locked_read_u64_unsynchronized(
+        &arenas_i(mib[2])->astats->astats.zero_skipped_bytes_large),
+    uint64_t)
 
 /* Lock profiling related APIs below. */
 #define RO_MUTEX_CTL_GEN(n, l)                                                 \
@@ -3870,7 +4230,23 @@ CTL_RO_CGEN(config_stats, stats_arenas_i_large_nflushes,
 	CTL_RO_CGEN(config_stats, stats_##n##_max_wait_time,                   \
 	    nstime_ns(&l.max_wait_time), uint64_t)                             \
 	CTL_RO_CGEN(                                                           \
-	    config_stats, stats_##n##_max_num_thds, l.max_n_thds, uint32_t)
+	    config_stats, stats_##n##_max_num_thds, l.max_n_thds, uint32_t)    \
+	CTL_RO_CGEN(config_stats, stats_##n##_num_hold_samples,                \
+	    l.n_hold_samples, uint64_t)                                        \
+	CTL_RO_CGEN(config_stats, stats_##n##_total_hold_time,                 \
+	    nstime_ns(&l.tot_hold_time), uint64_t)                             \
+	CTL_RO_CGEN(config_stats, stats_##n##_max_hold_time,                   \
+	    nstime_ns(&l.max_hold_time), uint64_t)                             \
+	/* The histogram bucket is the last mib element. */                    \
+	CTL_RO_CGEN(config_stats, stats_##n##_hold_hist_k,                     \
+	    l.hold_hist[mib[miblen - 1]], uint64_t)                            \
+	static const ctl_named_node_t *stats_##n##_hold_hist_index(            \
+	    tsdn_t *tsdn, const size_t *mib, size_t miblen, size_t k) {        \
+		if (k >= MUTEX_PROF_HOLD_HIST_NBUCKETS) {                      \
+			return NULL;                                           \
+		}                                                              \
+		return stats_##n##_hold_hist_k_node;                           \
+	}
 
 /* Global mutexes. */
 #define OP(mtx)                                                                \
@@ -3931,6 +4307,8 @@ stats_mutexes_reset_ctl(tsd_t *tsd, const size_t *mib, size_t miblen,
 		}
 		MUTEX_PROF_RESET(arena->large_mtx);
 		MUTEX_PROF_RESET(arena->pa_shard.edata_cache.mtx);
+		edata_cache_percpu_mutex_stats_reset(
+		    tsdn, &arena->pa_shard.edata_cache);
 		MUTEX_PROF_RESET(arena->pa_shard.pac.ecache_dirty.mtx);
 		MUTEX_PROF_RESET(arena->pa_shard.pac.ecache_muzzy.mtx);
 		MUTEX_PROF_RESET(arena->pa_shard.pac.ecache_retained.mtx);
@@ -3970,6 +4348,15 @@ CTL_RO_CGEN(config_stats, stats_arenas_i_bins_j_curslabs,
     arenas_i(mib[2])->astats->bstats[mib[4]].stats_data.curslabs, size_t)
 CTL_RO_CGEN(config_stats, stats_arenas_i_bins_j_nonfull_slabs,
     arenas_i(mib[2])->astats->bstats[mib[4]].stats_data.nonfull_slabs, size_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_bins_j_hugepage_regions,
+    arenas_i(mib[2])->astats->bstats[mib[4]].stats_data.hugepage_regions,
+    size_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_bins_j_hugepage_curslabs,
+    arenas_i(mib[2])->astats->bstats[mib[4]].stats_data.hugepage_curslabs,
+    size_t)
+CTL_RO_CGEN(config_stats, stats_arenas_i_bins_j_hugepage_unused_bytes,
+    arenas_i(mib[2])->astats->bstats[mib[4]].stats_data.hugepage_unused_bytes,
+    size_t)
 
 static const ctl_named_node_t *
 stats_arenas_i_bins_j_index(
@@ -4560,12 +4947,6 @@ label_return:
 	return ret;
 }
 
-typedef struct write_cb_packet_s write_cb_packet_t;
-struct write_cb_packet_s {
-	write_cb_t *write_cb;
-	void       *cbopaque;
-};
-
 static int
 experimental_prof_recent_alloc_dump_ctl(tsd_t *tsd, const size_t *mib,
     size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
@@ -4591,6 +4972,43 @@ label_return:
 	return ret;
 }
 
+static int
+experimental_alloc_trace_start_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+
+	const char *filename = NULL;
+
+	WRITEONLY();
+	WRITE(filename, const char *);
+
+	if (alloc_trace_start(tsd_tsdn(tsd), filename)) {
+		ret = EFAULT;
+		goto label_return;
+	}
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
+static int
+experimental_alloc_trace_stop_ctl(tsd_t *tsd, const size_t *mib,
+    size_t miblen, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+	int ret;
+
+	NEITHER_READ_NOR_WRITE();
+
+	if (alloc_trace_stop(tsd_tsdn(tsd))) {
+		ret = EFAULT;
+		goto label_return;
+	}
+
+	ret = 0;
+label_return:
+	return ret;
+}
+
 typedef struct batch_alloc_packet_s batch_alloc_packet_t;
 struct batch_alloc_packet_s {
 	void **ptrs;
@@ -1,6 +1,8 @@
 #include "jemalloc/internal/jemalloc_preamble.h"
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
+size_t opt_edata_cache_percpu_max = EDATA_CACHE_PERCPU_MAX_DEFAULT;
+
 bool
 edata_cache_init(edata_cache_t *edata_cache, base_t *base) {
 	edata_avail_new(&edata_cache->avail);
@@ -15,11 +17,84 @@ edata_cache_init(edata_cache_t *edata_cache, base_t *base) {
 		return true;
 	}
 	edata_cache->base = base;
+	edata_cache->percpu = NULL;
+	edata_cache->npercpu = 0;
+	edata_cache->percpu_max = 0;
 	return false;
 }
 
-edata_t *
-edata_cache_get(tsdn_t *tsdn, edata_cache_t *edata_cache) {
+bool
+edata_cache_percpu_init(
+    tsdn_t *tsdn, edata_cache_t *edata_cache, size_t percpu_max) {
+	assert(edata_cache->percpu == NULL);
+	if (percpu_max == 0 || ncpus == 0) {
+		/*
+		 * Leave the per-CPU layer disabled.  Arena 0 is created before
+		 * ncpus is known; malloc_init_hard() calls this again for it.
+		 */
+		return false;
+	}
+	unsigned npercpu = ncpus < EDATA_CACHE_PERCPU_NSHARDS_MAX
+	    ? ncpus
+	    : EDATA_CACHE_PERCPU_NSHARDS_MAX;
+	edata_cache_percpu_t *percpu = (edata_cache_percpu_t *)base_alloc(tsdn,
+	    edata_cache->base, npercpu * sizeof(edata_cache_percpu_t),
+	    CACHELINE);
+	if (percpu == NULL) {
+		return true;
+	}
+	for (unsigned i = 0; i < npercpu; i++) {
+		if (malloc_mutex_init(&percpu[i].mtx, "edata_cache_percpu",
+		        WITNESS_RANK_EDATA_CACHE, malloc_mutex_rank_exclusive)) {
+			return true;
+		}
+		edata_list_inactive_init(&percpu[i].list);
+		atomic_store_zu(&percpu[i].count, 0, ATOMIC_RELAXED);
+	}
+	edata_cache->npercpu = npercpu;
+	edata_cache->percpu_max = percpu_max;
+	edata_cache->percpu = percpu;
+	return false;
+}
+
+static edata_cache_percpu_t *
+edata_cache_percpu_pick(tsdn_t *tsdn, edata_cache_t *edata_cache) {
+	assert(edata_cache->percpu != NULL);
+	if (have_percpu_arena) {
+		malloc_cpuid_t cpuid = malloc_getcpu();
+		if (cpuid >= 0) {
+			return &edata_cache->percpu[
+			    (unsigned)cpuid % edata_cache->npercpu];
+		}
+	}
+	/*
+	 * No cheap way to learn the current CPU; fall back to a sticky random
+	 * shard per thread, the same way the SEC picks its shards.
+	 */
+	if (tsdn_null(tsdn)) {
+		return &edata_cache->percpu[0];
+	}
+	tsd_t   *tsd = tsdn_tsd(tsdn);
+	uint8_t *idxp = tsd_edata_cache_shardp_get(tsd);
+	if (*idxp == (uint8_t)-1) {
+		uint64_t rand32 = prng_lg_range_u64(
+		    tsd_prng_statep_get(tsd), 32);
+		uint32_t idx = (uint32_t)((rand32
+		    * (uint64_t)EDATA_CACHE_PERCPU_NSHARDS_MAX) >> 32);
+		assert(idx < EDATA_CACHE_PERCPU_NSHARDS_MAX);
+		*idxp = (uint8_t)idx;
+	}
+	return &edata_cache->percpu[*idxp % edata_cache->npercpu];
+}
+
+static size_t
+edata_cache_percpu_batch(edata_cache_t *edata_cache) {
+	size_t batch = edata_cache->percpu_max / 2;
+	return batch == 0 ? 1 : batch;
+}
+
+static edata_t *
+edata_cache_central_get(tsdn_t *tsdn, edata_cache_t *edata_cache) {
 	malloc_mutex_lock(tsdn, &edata_cache->mtx);
 	edata_t *edata = edata_avail_first(&edata_cache->avail);
 	if (edata == NULL) {
@@ -32,26 +107,257 @@ edata_cache_get(tsdn_t *tsdn, edata_cache_t *edata_cache) {
 	return edata;
 }
 
-void
-edata_cache_put(tsdn_t *tsdn, edata_cache_t *edata_cache, edata_t *edata) {
+static void
+edata_cache_central_put(
+    tsdn_t *tsdn, edata_cache_t *edata_cache, edata_t *edata) {
 	malloc_mutex_lock(tsdn, &edata_cache->mtx);
 	edata_avail_insert(&edata_cache->avail, edata);
 	atomic_load_add_store_zu(&edata_cache->count, 1);
 	malloc_mutex_unlock(tsdn, &edata_cache->mtx);
 }
 
+static size_t
+edata_cache_central_get_batch(tsdn_t *tsdn, edata_cache_t *edata_cache,
+    edata_list_inactive_t *list, size_t nedata) {
+	size_t nfilled = 0;
+	malloc_mutex_lock(tsdn, &edata_cache->mtx);
+	while (nfilled < nedata) {
+		edata_t *edata = edata_avail_remove_first(&edata_cache->avail);
+		if (edata == NULL) {
+			break;
+		}
+		edata_list_inactive_append(list, edata);
+		nfilled++;
+	}
+	atomic_load_sub_store_zu(&edata_cache->count, nfilled);
+	malloc_mutex_unlock(tsdn, &edata_cache->mtx);
+	return nfilled;
+}
+
+static void
+edata_cache_central_put_batch(
+    tsdn_t *tsdn, edata_cache_t *edata_cache, edata_list_inactive_t *list) {
+	edata_t *edata;
+	size_t   nflushed = 0;
+	malloc_mutex_lock(tsdn, &edata_cache->mtx);
+	while ((edata = edata_list_inactive_first(list)) != NULL) {
+		edata_list_inactive_remove(list, edata);
+		edata_avail_insert(&edata_cache->avail, edata);
+		nflushed++;
+	}
+	atomic_load_add_store_zu(&edata_cache->count, nflushed);
+	malloc_mutex_unlock(tsdn, &edata_cache->mtx);
+}
+
+/*
+ * Called with an empty shard.  Grabs a batch from the central cache (or, if
+ * that is empty too, pre-allocates one from the base), keeps one edata_t for the
+ * caller and stashes the rest in the shard.
+ */
+static edata_t *
+edata_cache_percpu_refill(
+    tsdn_t *tsdn, edata_cache_t *edata_cache, edata_cache_percpu_t *shard) {
+	edata_list_inactive_t batch;
+	edata_list_inactive_init(&batch);
+	size_t nfill = edata_cache_percpu_batch(edata_cache);
+	size_t nfilled = edata_cache_central_get_batch(
+	    tsdn, edata_cache, &batch, nfill);
+	if (nfilled < nfill) {
+		nfilled += base_alloc_edata_batch(
+		    tsdn, edata_cache->base, &batch, nfill - nfilled);
+	}
+	edata_t *edata = edata_list_inactive_first(&batch);
+	if (edata == NULL) {
+		return NULL;
+	}
+	edata_list_inactive_remove(&batch, edata);
+	nfilled--;
+	if (nfilled > 0) {
+		malloc_mutex_lock(tsdn, &shard->mtx);
+		edata_list_inactive_concat(&shard->list, &batch);
+		atomic_load_add_store_zu(&shard->count, nfilled);
+		malloc_mutex_unlock(tsdn, &shard->mtx);
+	}
+	return edata;
+}
+
+edata_t *
+edata_cache_get(tsdn_t *tsdn, edata_cache_t *edata_cache) {
+	if (edata_cache->percpu == NULL) {
+		return edata_cache_central_get(tsdn, edata_cache);
+	}
+	edata_cache_percpu_t *shard = edata_cache_percpu_pick(
+	    tsdn, edata_cache);
+	malloc_mutex_lock(tsdn, &shard->mtx);
+	edata_t *edata = edata_list_inactive_first(&shard->list);
+	if (edata != NULL) {
+		edata_list_inactive_remove(&shard->list, edata);
+		atomic_load_sub_store_zu(&shard->count, 1);
+	}
+	malloc_mutex_unlock(tsdn, &shard->mtx);
+	if (edata != NULL) {
+		return edata;
+	}
+	return edata_cache_percpu_refill(tsdn, edata_cache, shard);
+}
+
+void
+edata_cache_put(tsdn_t *tsdn, edata_cache_t *edata_cache, edata_t *edata) {
+	if (edata_cache->percpu == NULL) {
+		edata_cache_central_put(tsdn, edata_cache, edata);
+		return;
+	}
+	edata_cache_percpu_t *shard = edata_cache_percpu_pick(
+	    tsdn, edata_cache);
+	edata_list_inactive_t flush;
+	edata_list_inactive_init(&flush);
+	bool do_flush = false;
+
+	malloc_mutex_lock(tsdn, &shard->mtx);
+	/* LIFO, in the hopes of some cache locality. */
+	edata_list_inactive_prepend(&shard->list, edata);
+	size_t count = atomic_load_zu(&shard->count, ATOMIC_RELAXED) + 1;
+	if (count > edata_cache->percpu_max) {
+		/* Hand the coldest half back to the central cache. */
+		size_t nflush = edata_cache_percpu_batch(edata_cache);
+		for (size_t i = 0; i < nflush; i++) {
+			edata_t *last = edata_list_inactive_last(&shard->list);
+			edata_list_inactive_remove(&shard->list, last);
+			edata_list_inactive_append(&flush, last);
+		}
+		count -= nflush;
+		do_flush = true;
+	}
+	atomic_store_zu(&shard->count, count, ATOMIC_RELAXED);
+	malloc_mutex_unlock(tsdn, &shard->mtx);
+
+	if (do_flush) {
+		edata_cache_central_put_batch(tsdn, edata_cache, &flush);
+	}
+}
+
+size_t
+edata_cache_get_batch(tsdn_t *tsdn, edata_cache_t *edata_cache,
+    edata_list_inactive_t *list, size_t nedata) {
+	size_t nfilled = 0;
+	if (edata_cache->percpu != NULL) {
+		edata_cache_percpu_t *shard = edata_cache_percpu_pick(
+		    tsdn, edata_cache);
+		malloc_mutex_lock(tsdn, &shard->mtx);
+		edata_t *edata;
+		while (nfilled < nedata
+		    && (edata = edata_list_inactive_first(&shard->list))
+		        != NULL) {
+			edata_list_inactive_remove(&shard->list, edata);
+			edata_list_inactive_append(list, edata);
+			nfilled++;
+		}
+		atomic_load_sub_store_zu(&shard->count, nfilled);
+		malloc_mutex_unlock(tsdn, &shard->mtx);
+	}
+	if (nfilled < nedata) {
+		nfilled += edata_cache_central_get_batch(
+		    tsdn, edata_cache, list, nedata - nfilled);
+	}
+	return nfilled;
+}
+
+void
+edata_cache_put_batch(
+    tsdn_t *tsdn, edata_cache_t *edata_cache, edata_list_inactive_t *list) {
+	if (edata_cache->percpu != NULL) {
+		edata_cache_percpu_t *shard = edata_cache_percpu_pick(
+		    tsdn, edata_cache);
+		malloc_mutex_lock(tsdn, &shard->mtx);
+		size_t   count = atomic_load_zu(&shard->count, ATOMIC_RELAXED);
+		edata_t *edata;
+		while (count < edata_cache->percpu_max
+		    && (edata = edata_list_inactive_first(list)) != NULL) {
+			edata_list_inactive_remove(list, edata);
+			edata_list_inactive_prepend(&shard->list, edata);
+			count++;
+		}
+		atomic_store_zu(&shard->count, count, ATOMIC_RELAXED);
+		malloc_mutex_unlock(tsdn, &shard->mtx);
+	}
+	if (!edata_list_inactive_empty(list)) {
+		edata_cache_central_put_batch(tsdn, edata_cache, list);
+	}
+}
+
+void
+edata_cache_reclaim(tsdn_t *tsdn, edata_cache_t *edata_cache) {
+	if (!base_edata_reclaim_enabled(edata_cache->base)) {
+		return;
+	}
+	edata_list_inactive_t list;
+	edata_list_inactive_init(&list);
+	for (unsigned i = 0; i < edata_cache->npercpu; i++) {
+		edata_cache_percpu_t *shard = &edata_cache->percpu[i];
+		malloc_mutex_lock(tsdn, &shard->mtx);
+		edata_list_inactive_concat(&list, &shard->list);
+		atomic_store_zu(&shard->count, 0, ATOMIC_RELAXED);
+		malloc_mutex_unlock(tsdn, &shard->mtx);
+	}
+	edata_cache_central_get_batch(tsdn, edata_cache, &list, SIZE_MAX);
+	if (!edata_list_inactive_empty(&list)) {
+		base_free_edata_batch(tsdn, edata_cache->base, &list);
+	}
+}
+
+size_t
+edata_cache_navail(edata_cache_t *edata_cache) {
+	size_t navail = atomic_load_zu(&edata_cache->count, ATOMIC_RELAXED);
+	for (unsigned i = 0; i < edata_cache->npercpu; i++) {
+		navail += atomic_load_zu(
+		    &edata_cache->percpu[i].count, ATOMIC_RELAXED);
+	}
+	return navail;
+}
+
+void
+edata_cache_percpu_mutex_stats_read(tsdn_t *tsdn, edata_cache_t *edata_cache,
+    mutex_prof_data_t *mutex_prof_data) {
+	for (unsigned i = 0; i < edata_cache->npercpu; i++) {
+		malloc_mutex_t *mtx = &edata_cache->percpu[i].mtx;
+		malloc_mutex_lock(tsdn, mtx);
+		malloc_mutex_prof_accum(tsdn, mutex_prof_data, mtx);
+		malloc_mutex_unlock(tsdn, mtx);
+	}
+}
+
+void
+edata_cache_percpu_mutex_stats_reset(
+    tsdn_t *tsdn, edata_cache_t *edata_cache) {
+	for (unsigned i = 0; i < edata_cache->npercpu; i++) {
+		malloc_mutex_t *mtx = &edata_cache->percpu[i].mtx;
+		malloc_mutex_lock(tsdn, mtx);
+		malloc_mutex_prof_data_reset(tsdn, mtx);
+		malloc_mutex_unlock(tsdn, mtx);
+	}
+}
+
 void
 edata_cache_prefork(tsdn_t *tsdn, edata_cache_t *edata_cache) {
 	malloc_mutex_prefork(tsdn, &edata_cache->mtx);
+	for (unsigned i = 0; i < edata_cache->npercpu; i++) {
+		malloc_mutex_prefork(tsdn, &edata_cache->percpu[i].mtx);
+	}
 }
 
 void
 edata_cache_postfork_parent(tsdn_t *tsdn, edata_cache_t *edata_cache) {
+	for (unsigned i = 0; i < edata_cache->npercpu; i++) {
+		malloc_mutex_postfork_parent(tsdn, &edata_cache->percpu[i].mtx);
+	}
 	malloc_mutex_postfork_parent(tsdn, &edata_cache->mtx);
 }
 
 void
 edata_cache_postfork_child(tsdn_t *tsdn, edata_cache_t *edata_cache) {
+	for (unsigned i = 0; i < edata_cache->npercpu; i++) {
+		malloc_mutex_postfork_child(tsdn, &edata_cache->percpu[i].mtx);
+	}
 	malloc_mutex_postfork_child(tsdn, &edata_cache->mtx);
 }
 
@@ -64,17 +370,8 @@ edata_cache_fast_init(edata_cache_fast_t *ecs, edata_cache_t *fallback) {
 
 static void
 edata_cache_fast_try_fill_from_fallback(tsdn_t *tsdn, edata_cache_fast_t *ecs) {
-	edata_t *edata;
-	malloc_mutex_lock(tsdn, &ecs->fallback->mtx);
-	for (int i = 0; i < EDATA_CACHE_FAST_FILL; i++) {
-		edata = edata_avail_remove_first(&ecs->fallback->avail);
-		if (edata == NULL) {
-			break;
-		}
-		edata_list_inactive_append(&ecs->list, edata);
-		atomic_load_sub_store_zu(&ecs->fallback->count, 1);
-	}
-	malloc_mutex_unlock(tsdn, &ecs->fallback->mtx);
+	edata_cache_get_batch(
+	    tsdn, ecs->fallback, &ecs->list, EDATA_CACHE_FAST_FILL);
 }
 
 edata_t *
@@ -114,18 +411,10 @@ edata_cache_fast_flush_all(tsdn_t *tsdn, edata_cache_fast_t *ecs) {
 	 * only flushing down to some threshold in anticipation of
 	 * future get requests).  But just flushing everything provides
 	 * a good opportunity to defrag too, and lets us share code between the
-	 * flush and disable pathways.
+	 * flush and disable pathways.  Bypass the per-CPU shards for that, so
+	 * that everything goes back through the address-ordered avail heap.
 	 */
-	edata_t *edata;
-	size_t   nflushed = 0;
-	malloc_mutex_lock(tsdn, &ecs->fallback->mtx);
-	while ((edata = edata_list_inactive_first(&ecs->list)) != NULL) {
-		edata_list_inactive_remove(&ecs->list, edata);
-		edata_avail_insert(&ecs->fallback->avail, edata);
-		nflushed++;
-	}
-	atomic_load_add_store_zu(&ecs->fallback->count, nflushed);
-	malloc_mutex_unlock(tsdn, &ecs->fallback->mtx);
+	edata_cache_central_put_batch(tsdn, ecs->fallback, &ecs->list);
 }
 
 void
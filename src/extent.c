@@ -803,6 +803,7 @@ extent_grow_retained(tsdn_t *tsdn, pac_t *pac, ehooks_t *ehooks, size_t size,
 			goto label_err;
 		}
 		/* A successful commit should return zeroed memory. */
+		edata_zeroed_set(edata, true);
 		if (config_debug) {
 			void   *addr = edata_addr_get(edata);
 			size_t *p = (size_t *)addr;
@@ -1434,6 +1435,8 @@ extent_commit_zero(tsdn_t *tsdn, ehooks_t *ehooks, edata_t *edata, bool commit,
 		        edata_size_get(edata), growing_retained)) {
 			return true;
 		}
+		/* Freshly committed pages read as zero. */
+		edata_zeroed_set(edata, true);
 	}
 	if (zero && !edata_zeroed_get(edata)) {
 		void  *addr = edata_base_get(edata);
@@ -505,7 +505,8 @@ hpa_process_madvise_max_iovec_len(void) {
 	    : opt_process_madvise_max_batch;
 }
 
-static inline void
+/* Returns true if any of the purges failed. */
+static inline bool
 hpa_purge_actual_unlocked(
     hpa_shard_t *shard, hpa_purge_item_t *batch, size_t batch_sz) {
 	assert(batch_sz > 0);
@@ -534,6 +535,7 @@ hpa_purge_actual_unlocked(
 		}
 	}
 	hpa_range_accum_finish(&accum, shard);
+	return accum.err;
 }
 
 static inline bool
@@ -599,8 +601,8 @@ hpa_purge_start_hp(hpa_purge_batch_t *b, hpa_shard_t *shard) {
 
 /* Finish purge of one huge page. */
 static inline void
-hpa_purge_finish_hp(
-    tsdn_t *tsdn, hpa_shard_t *shard, hpa_purge_item_t *hp_item) {
+hpa_purge_finish_hp(tsdn_t *tsdn, hpa_shard_t *shard,
+    hpa_purge_item_t *hp_item, bool purge_err) {
 	if (hp_item->dehugify) {
 		shard->stats.ndehugifies++;
 	}
@@ -614,6 +616,13 @@ hpa_purge_finish_hp(
 		hpdata_dehugify(hp_item->hp);
 	}
 	hpdata_purge_end(hp_item->hp, &hp_item->state);
+	if (purge_err) {
+		/*
+		 * We can't tell which ranges failed, so stop trusting that any
+		 * untouched page of this hpdata reads as zero.
+		 */
+		hpdata_untouched_zeroed_set(hp_item->hp, false);
+	}
 	hpdata_mid_purge_set(hp_item->hp, false);
 
 	hpdata_alloc_allowed_set(hp_item->hp, true);
@@ -678,7 +687,8 @@ hpa_purge(tsdn_t *tsdn, hpa_shard_t *shard, size_t max_hp) {
 			break;
 		}
 		malloc_mutex_unlock(tsdn, &shard->mtx);
-		hpa_purge_actual_unlocked(shard, batch.items, batch.item_cnt);
+		bool purge_err = hpa_purge_actual_unlocked(
+		    shard, batch.items, batch.item_cnt);
 		malloc_mutex_lock(tsdn, &shard->mtx);
 
 		/* The shard updates */
@@ -687,7 +697,8 @@ hpa_purge(tsdn_t *tsdn, hpa_shard_t *shard, size_t max_hp) {
 		shard->central->hooks.curtime(&shard->last_purge,
 		    /* first_reading */ false);
 		for (size_t i = 0; i < batch.item_cnt; ++i) {
-			hpa_purge_finish_hp(tsdn, shard, &batch.items[i]);
+			hpa_purge_finish_hp(
+			    tsdn, shard, &batch.items[i], purge_err);
 		}
 	}
 	malloc_mutex_assert_owner(tsdn, &shard->mtx);
@@ -873,12 +884,13 @@ hpa_try_alloc_one_no_grow(
 		hpdata_age_set(ps, shard->age_counter++);
 	}
 
-	void *addr = hpdata_reserve_alloc(ps, size);
+	bool  zeroed;
+	void *addr = hpdata_reserve_alloc(ps, size, &zeroed);
 	JE_USDT(hpa_alloc, 5, shard->ind, addr, size, hpdata_nactive_get(ps),
 	    hpdata_age_get(ps));
 	edata_init(edata, shard->ind, addr, size, /* slab */ false, SC_NSIZES,
-	    /* sn */ hpdata_age_get(ps), extent_state_active,
-	    /* zeroed */ false, /* committed */ true, EXTENT_PAI_HPA,
+	    /* sn */ hpdata_age_get(ps), extent_state_active, zeroed,
+	    /* committed */ true, EXTENT_PAI_HPA,
 	    EXTENT_NOT_HEAD);
 	edata_ps_set(edata, ps);
 
@@ -1083,13 +1095,13 @@ hpa_alloc(tsdn_t *tsdn, pai_t *self, size_t size, size_t alignment, bool zero,
 	witness_assert_depth_to_rank(
 	    tsdn_witness_tsdp_get(tsdn), WITNESS_RANK_CORE, 0);
 
-	/* We don't handle alignment or zeroing for now. */
-	if (alignment > PAGE || zero) {
+	/* We don't handle alignment for now. */
+	if (alignment > PAGE) {
 		return NULL;
 	}
 	/*
-	 * An alloc with alignment == PAGE and zero == false is equivalent to a
-	 * batch alloc of 1.  Just do that, so we can share code.
+	 * An alloc with alignment == PAGE is equivalent to a batch alloc of 1.
+	 * Just do that, so we can share code.
 	 */
 	edata_list_active_t results;
 	edata_list_active_init(&results);
@@ -1097,6 +1109,13 @@ hpa_alloc(tsdn_t *tsdn, pai_t *self, size_t size, size_t alignment, bool zero,
 	    &results, frequent_reuse, deferred_work_generated);
 	assert(nallocs == 0 || nallocs == 1);
 	edata_t *edata = edata_list_active_first(&results);
+	/*
+	 * The hpdata already told us whether the pages were left untouched since
+	 * they were mapped or purged; only zero them if they weren't.
+	 */
+	if (edata != NULL && zero && !edata_zeroed_get(edata)) {
+		memset(edata_base_get(edata), 0, edata_size_get(edata));
+	}
 	return edata;
 }
 
@@ -6,7 +6,7 @@
 
 static void    *hpa_hooks_map(size_t size);
 static void     hpa_hooks_unmap(void *ptr, size_t size);
-static void     hpa_hooks_purge(void *ptr, size_t size);
+static bool     hpa_hooks_purge(void *ptr, size_t size);
 static bool     hpa_hooks_hugify(void *ptr, size_t size, bool sync);
 static void     hpa_hooks_dehugify(void *ptr, size_t size);
 static void     hpa_hooks_curtime(nstime_t *r_nstime, bool first_reading);
@@ -37,10 +37,10 @@ hpa_hooks_unmap(void *ptr, size_t size) {
 	pages_unmap(ptr, size);
 }
 
-static void
+static bool
 hpa_hooks_purge(void *ptr, size_t size) {
 	JE_USDT(hpa_purge, 2, size, ptr);
-	pages_purge_forced(ptr, size);
+	return pages_purge_forced(ptr, size);
 }
 
 static bool
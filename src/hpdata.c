@@ -41,6 +41,7 @@ ph_gen(, hpdata_age_heap, hpdata_t, age_link, hpdata_age_comp)
 		fb_init(hpdata->touched_pages, HUGEPAGE_PAGES);
 		hpdata->h_ntouched = 0;
 	}
+	hpdata->h_untouched_zeroed = true;
 	nstime_init_zero(&hpdata->h_time_purge_allowed);
 	hpdata->h_purged_when_empty_and_huge = false;
 
@@ -48,7 +49,7 @@ ph_gen(, hpdata_age_heap, hpdata_t, age_link, hpdata_age_comp)
 }
 
 void *
-hpdata_reserve_alloc(hpdata_t *hpdata, size_t sz) {
+hpdata_reserve_alloc(hpdata_t *hpdata, size_t sz, bool *r_zeroed) {
 	hpdata_assert_consistent(hpdata);
 	/*
 	 * This is a metadata change; the hpdata should therefore either not be
@@ -108,6 +109,9 @@ hpdata_reserve_alloc(hpdata_t *hpdata, size_t sz) {
 	    hpdata->touched_pages, HUGEPAGE_PAGES, result, npages);
 	fb_set_range(hpdata->touched_pages, HUGEPAGE_PAGES, result, npages);
 	hpdata->h_ntouched += new_dirty;
+	if (r_zeroed != NULL) {
+		*r_zeroed = hpdata->h_untouched_zeroed && new_dirty == npages;
+	}
 
 	/*
 	 * If we allocated out of a range that was the longest in the hpdata, it
@@ -1,6 +1,7 @@
 #include "jemalloc/internal/jemalloc_preamble.h"
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
+#include "jemalloc/internal/alloc_trace.h"
 #include "jemalloc/internal/assert.h"
 #include "jemalloc/internal/atomic.h"
 #include "jemalloc/internal/buf_writer.h"
@@ -1369,6 +1370,7 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 				}
 				CONF_CONTINUE;
 			}
+			CONF_HANDLE_BOOL(opt_metadata_reclaim, "metadata_reclaim")
 			CONF_HANDLE_BOOL(opt_retain, "retain")
 			if (strncmp("dss", k, klen) == 0) {
 				int  m;
@@ -1438,6 +1440,28 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 				} while (vlen_left > 0);
 				CONF_CONTINUE;
 			}
+			if (CONF_MATCH("slab_hugepage_sizes")) {
+				const char *segment_cur = v;
+				size_t      vlen_left = vlen;
+				do {
+					size_t size_start;
+					size_t size_end;
+					size_t nregions;
+					bool   err = multi_setting_parse_next(
+                                            &segment_cur, &vlen_left,
+                                            &size_start, &size_end, &nregions);
+					if (err
+					    || arena_slab_hugepage_sizes_update(
+					        size_start, size_end, nregions)) {
+						CONF_ERROR(
+						    "Invalid settings for "
+						    "slab_hugepage_sizes",
+						    k, klen, v, vlen);
+						break;
+					}
+				} while (vlen_left > 0);
+				CONF_CONTINUE;
+			}
 			if (CONF_MATCH("tcache_ncached_max")) {
 				bool err = tcache_bin_info_default_init(
 				    v, vlen);
@@ -1452,6 +1476,18 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 			CONF_HANDLE_INT64_T(opt_mutex_max_spin,
 			    "mutex_max_spin", -1, INT64_MAX, CONF_CHECK_MIN,
 			    CONF_DONT_CHECK_MAX, false);
+			CONF_HANDLE_UNSIGNED(opt_mutex_hold_sample,
+			    "mutex_hold_sample", 0, UINT_MAX,
+			    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX, false);
+			if (CONF_MATCH("mutex_max_spin_ranks")) {
+				if (malloc_mutex_max_spin_ranks_parse(v, vlen)) {
+					CONF_ERROR(
+					    "Invalid settings for "
+					    "mutex_max_spin_ranks",
+					    k, klen, v, vlen);
+				}
+				CONF_CONTINUE;
+			}
 			CONF_HANDLE_SSIZE_T(opt_dirty_decay_ms,
 			    "dirty_decay_ms", -1,
 			    NSTIME_SEC_MAX * KQU(1000) < QU(SSIZE_MAX)
@@ -1521,10 +1557,32 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 
 			CONF_HANDLE_BOOL(opt_experimental_tcache_gc,
 			    "experimental_tcache_gc")
+			CONF_HANDLE_BOOL(opt_experimental_tcache_gc_reuse,
+			    "experimental_tcache_gc_reuse")
+			CONF_HANDLE_SSIZE_T(opt_tcache_ncached_max_learn_ms,
+			    "tcache_ncached_max_learn_ms", -1,
+			    NSTIME_SEC_MAX * KQU(1000) < QU(SSIZE_MAX)
+			        ? NSTIME_SEC_MAX * KQU(1000)
+			        : SSIZE_MAX)
+			CONF_HANDLE_SSIZE_T(opt_tcache_idle_reclaim_ms,
+			    "tcache_idle_reclaim_ms", -1,
+			    NSTIME_SEC_MAX * KQU(1000) < QU(SSIZE_MAX)
+			        ? NSTIME_SEC_MAX * KQU(1000)
+			        : SSIZE_MAX)
 			CONF_HANDLE_BOOL(opt_tcache, "tcache")
 			CONF_HANDLE_SIZE_T(opt_tcache_max, "tcache_max", 0,
 			    TCACHE_MAXCLASS_LIMIT, CONF_DONT_CHECK_MIN,
 			    CONF_CHECK_MAX, /* clip */ true)
+			CONF_HANDLE_SIZE_T(opt_tcache_large_cache_bytes,
+			    "tcache_large_cache_bytes", 0, SIZE_T_MAX,
+			    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+			    /* clip */ false)
+			CONF_HANDLE_SIZE_T(opt_tcache_large_cache_max,
+			    "tcache_large_cache_max", 0,
+			    TCACHE_LARGE_CACHE_MAXCLASS_LIMIT,
+			    CONF_DONT_CHECK_MIN, CONF_CHECK_MAX, /* clip */ true)
+			CONF_HANDLE_BOOL(opt_tcache_steal, "tcache_steal")
+			CONF_HANDLE_BOOL(opt_tcache_fill_sort, "tcache_fill_sort")
 			if (CONF_MATCH("lg_tcache_max")) {
 				size_t m;
 				CONF_VALUE_READ(size_t, m)
@@ -1590,10 +1648,16 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 			CONF_HANDLE_SIZE_T(opt_oversize_threshold,
 			    "oversize_threshold", 0, SC_LARGE_MAXCLASS,
 			    CONF_DONT_CHECK_MIN, CONF_CHECK_MAX, false)
+			CONF_HANDLE_SIZE_T(opt_large_remap_threshold,
+			    "large_remap_threshold", 0, SC_LARGE_MAXCLASS,
+			    CONF_DONT_CHECK_MIN, CONF_CHECK_MAX, false)
 			CONF_HANDLE_SIZE_T(opt_lg_extent_max_active_fit,
 			    "lg_extent_max_active_fit", 0,
 			    (sizeof(size_t) << 3), CONF_DONT_CHECK_MIN,
 			    CONF_CHECK_MAX, false)
+			CONF_HANDLE_SIZE_T(opt_edata_cache_percpu_max,
+			    "edata_cache_percpu_max", 0, 1024,
+			    CONF_DONT_CHECK_MIN, CONF_CHECK_MAX, /* clip */ true)
 
 			if (strncmp("percpu_arena", k, klen) == 0) {
 				bool match = false;
@@ -1810,6 +1874,38 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 				CONF_HANDLE_BOOL(opt_prof_stats, "prof_stats")
 				CONF_HANDLE_BOOL(opt_prof_sys_thread_name,
 				    "prof_sys_thread_name")
+				CONF_HANDLE_BOOL(opt_prof_unwind_validate,
+				    "prof_unwind_validate")
+				CONF_HANDLE_BOOL(opt_prof_lifetime, "prof_lifetime")
+				CONF_HANDLE_BOOL(
+				    opt_prof_per_arena, "prof_per_arena")
+				CONF_HANDLE_BOOL(
+				    opt_prof_log_stream, "prof_log_stream")
+				CONF_HANDLE_SIZE_T(opt_prof_log_stream_buf_size,
+				    "prof_log_stream_buf_size", 1024,
+				    SC_LARGE_MAXCLASS, CONF_CHECK_MIN,
+				    CONF_CHECK_MAX, /* clip */ true)
+				CONF_HANDLE_UNSIGNED(opt_prof_leak_epochs,
+				    "prof_leak_epochs", 0, UINT_MAX,
+				    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+				    false)
+				CONF_HANDLE_UINT64_T(opt_prof_leak_epoch_ms,
+				    "prof_leak_epoch_ms", 0, UINT64_MAX,
+				    CONF_DONT_CHECK_MIN, CONF_DONT_CHECK_MAX,
+				    false)
+				if (CONF_MATCH("prof_dump_format")) {
+					if (CONF_MATCH_VALUE("text")) {
+						opt_prof_dump_format =
+						    prof_dump_format_text;
+					} else if (CONF_MATCH_VALUE("binary")) {
+						opt_prof_dump_format =
+						    prof_dump_format_binary;
+					} else {
+						CONF_ERROR("Invalid conf value",
+						    k, klen, v, vlen);
+					}
+					CONF_CONTINUE;
+				}
 				if (CONF_MATCH("prof_time_resolution")) {
 					if (CONF_MATCH_VALUE("default")) {
 						opt_prof_time_res =
@@ -1890,6 +1986,7 @@ malloc_conf_init_helper(sc_data_t *sc_data, unsigned bin_shard_sizes[SC_NBINS],
 				}
 				CONF_CONTINUE;
 			}
+			CONF_HANDLE_CHAR_P(opt_alloc_trace, "alloc_trace", "")
 			if (config_uaf_detection
 			    && CONF_MATCH("lg_san_uaf_align")) {
 				ssize_t a;
@@ -2056,6 +2153,7 @@ malloc_init_hard_a0_locked(void) {
 	san_init(opt_lg_san_uaf_align);
 	sz_boot(&sc_data, opt_cache_oblivious);
 	bin_info_boot(&sc_data, bin_shard_sizes);
+	bitmap_boot();
 
 	if (opt_stats_print) {
 		/* Print statistics at exit. */
@@ -2111,6 +2209,9 @@ malloc_init_hard_a0_locked(void) {
 		return true;
 	}
 	hook_boot();
+	if (alloc_trace_boot()) {
+		return true;
+	}
 	experimental_thread_events_boot();
 	/*
 	 * Create enough scaffolding to allow recursive allocation in
@@ -2410,6 +2511,15 @@ malloc_init_hard(void) {
 	    || background_thread_boot1(tsd_tsdn(tsd), b0get())) {
 		UNLOCK_RETURN(tsd_tsdn(tsd), true, true)
 	}
+	/*
+	 * Arena 0 was created before ncpus was known, so it couldn't get its
+	 * per-CPU edata cache shards in arena_new.
+	 */
+	if (edata_cache_percpu_init(tsd_tsdn(tsd),
+	        &arena_get(tsd_tsdn(tsd), 0, false)->pa_shard.edata_cache,
+	        opt_edata_cache_percpu_max)) {
+		UNLOCK_RETURN(tsd_tsdn(tsd), true, true)
+	}
 	if (opt_hpa) {
 		/*
 		 * We didn't initialize arena 0 hpa_shard in arena_new, because
@@ -2453,6 +2563,7 @@ malloc_init_hard(void) {
 			return true;
 		}
 	}
+	alloc_trace_init(tsd_tsdn(tsd));
 #undef UNLOCK_RETURN
 	return false;
 }
@@ -2784,7 +2895,7 @@ imalloc_body(static_opts_t *sopts, dynamic_opts_t *dopts, tsd_t *tsd) {
 		bool prof_active = prof_active_get_unlocked();
 		bool sample_event = te_prof_sample_event_lookahead(tsd, usize);
 		prof_tctx_t *tctx = prof_alloc_prep(
-		    tsd, prof_active, sample_event);
+		    tsd, prof_active, sample_event, dopts->arena_ind);
 
 		emap_alloc_ctx_t alloc_ctx;
 		if (likely(tctx == PROF_TCTX_SENTINEL)) {
@@ -3628,7 +3739,8 @@ irallocx_prof(tsd_t *tsd, void *old_ptr, size_t old_usize, size_t size,
 	prof_info_get_and_reset_recent(tsd, old_ptr, alloc_ctx, &old_prof_info);
 	bool         prof_active = prof_active_get_unlocked();
 	bool         sample_event = te_prof_sample_event_lookahead(tsd, usize);
-	prof_tctx_t *tctx = prof_alloc_prep(tsd, prof_active, sample_event);
+	prof_tctx_t *tctx = prof_alloc_prep(tsd, prof_active, sample_event,
+	    arena == NULL ? ARENA_IND_AUTOMATIC : arena_ind_get(arena));
 	void        *p;
 	if (unlikely(tctx != PROF_TCTX_SENTINEL)) {
 		p = irallocx_prof_sample(tsd_tsdn(tsd), old_ptr, old_usize,
@@ -3875,7 +3987,9 @@ ixallocx_prof(tsd_t *tsd, void *ptr, size_t old_usize, size_t size,
 	}
 	bool prof_active = prof_active_get_unlocked();
 	bool sample_event = te_prof_sample_event_lookahead(tsd, usize_max);
-	prof_tctx_t *tctx = prof_alloc_prep(tsd, prof_active, sample_event);
+	/* The object is resized in place, in whichever arena it is. */
+	prof_tctx_t *tctx = prof_alloc_prep(
+	    tsd, prof_active, sample_event, ARENA_IND_AUTOMATIC);
 
 	size_t usize;
 	if (unlikely(tctx != PROF_TCTX_SENTINEL)) {
@@ -4396,11 +4510,13 @@ batch_alloc(void **ptrs, size_t num, size_t size, int flags) {
 				 * additional benefit is that the tcache will
 				 * not be empty for the next allocation request.
 				 */
+				tcache_owner_enter(tcache->tcache_slow);
 				size_t n = cache_bin_alloc_batch(
 				    bin, bin_batch, ptrs + filled);
 				if (config_stats) {
 					bin->tstats.nrequests += n;
 				}
+				tcache_owner_exit(tcache->tcache_slow);
 				if (zero) {
 					for (size_t i = 0; i < n; ++i) {
 						memset(
@@ -4510,6 +4626,7 @@ _malloc_prefork(void)
 	if (have_background_thread) {
 		background_thread_prefork0(tsd_tsdn(tsd));
 	}
+	alloc_trace_prefork(tsd_tsdn(tsd));
 	prof_prefork0(tsd_tsdn(tsd));
 	if (have_background_thread) {
 		background_thread_prefork1(tsd_tsdn(tsd));
@@ -4591,6 +4708,7 @@ _malloc_postfork(void)
 		}
 	}
 	prof_postfork_parent(tsd_tsdn(tsd));
+	alloc_trace_postfork_parent(tsd_tsdn(tsd));
 	if (have_background_thread) {
 		background_thread_postfork_parent(tsd_tsdn(tsd));
 	}
@@ -4621,6 +4739,7 @@ jemalloc_postfork_child(void) {
 		}
 	}
 	prof_postfork_child(tsd_tsdn(tsd));
+	alloc_trace_postfork_child(tsd_tsdn(tsd));
 	if (have_background_thread) {
 		background_thread_postfork_child(tsd_tsdn(tsd));
 	}
@@ -3,11 +3,17 @@
 
 #include "jemalloc/internal/assert.h"
 #include "jemalloc/internal/emap.h"
+#include "jemalloc/internal/extent_dss.h"
 #include "jemalloc/internal/extent_mmap.h"
 #include "jemalloc/internal/mutex.h"
 #include "jemalloc/internal/prof_recent.h"
 #include "jemalloc/internal/util.h"
 
+/******************************************************************************/
+/* Data. */
+
+size_t opt_large_remap_threshold = LARGE_REMAP_THRESHOLD_DEFAULT;
+
 /******************************************************************************/
 
 void *
@@ -173,6 +179,75 @@ large_ralloc_no_move(tsdn_t *tsdn, edata_t *edata, size_t usize_min,
 	return true;
 }
 
+/* Whether the pages of edata may be moved around with pages_remap(). */
+static bool
+large_ralloc_remappable(edata_t *edata) {
+	return edata_pai_get(edata) == EXTENT_PAI_PAC
+	    && !edata_guarded_get(edata)
+	    && ehooks_are_default(arena_get_ehooks(arena_get_from_edata(edata)))
+	    && !extent_in_dss(edata_base_get(edata));
+}
+
+/*
+ * Moves the pages of the old allocation into the extent that was just
+ * allocated for its replacement (at *r_ptr), rather than copying them.  The
+ * replacement adopts the old allocation's offset within its first page (the
+ * two only differ due to cache-oblivious randomization), so that whole pages
+ * line up.  Returns true if the pages can't be moved, in which case nothing
+ * has changed and the caller should copy instead.
+ */
+static bool
+large_ralloc_move_remap(tsdn_t *tsdn, edata_t *old_edata, void **r_ptr,
+    size_t alignment, bool zero) {
+	size_t oldusize = edata_usize_get(old_edata);
+	if (!pages_can_remap || opt_large_remap_threshold == 0
+	    || oldusize < opt_large_remap_threshold) {
+		return true;
+	}
+	edata_t *new_edata = emap_edata_lookup(
+	    tsdn, &arena_emap_global, *r_ptr);
+	if (!large_ralloc_remappable(old_edata)
+	    || !large_ralloc_remappable(new_edata)) {
+		return true;
+	}
+	size_t usize = edata_usize_get(new_edata);
+	assert(usize > oldusize);
+
+	byte_t *old_base = edata_base_get(old_edata);
+	byte_t *new_base = edata_base_get(new_edata);
+	size_t  offset = (byte_t *)edata_addr_get(old_edata) - old_base;
+	size_t  new_offset = (byte_t *)*r_ptr - new_base;
+	if (alignment > 1 && (offset & (alignment - 1)) != 0) {
+		return true;
+	}
+	assert(offset + usize <= edata_size_get(new_edata));
+
+	size_t remap_size = PAGE_CEILING(offset + oldusize);
+	assert(remap_size <= edata_size_get(old_edata));
+	if (pages_remap(old_base, new_base, remap_size)) {
+		return true;
+	}
+	void *ret = new_base + offset;
+	edata_addr_set(new_edata, ret);
+
+	if (zero) {
+		/* Trailing bytes of the last page that was moved. */
+		byte_t *zbase = (byte_t *)ret + oldusize;
+		memset(zbase, 0, new_base + remap_size - zbase);
+		/* Bytes that the allocation didn't zero, due to the shift. */
+		byte_t *zpast = (byte_t *)ret + usize;
+		zbase = new_base + new_offset + usize;
+		if (zbase < new_base + remap_size) {
+			zbase = new_base + remap_size;
+		}
+		if (zbase < zpast) {
+			memset(zbase, 0, zpast - zbase);
+		}
+	}
+	*r_ptr = ret;
+	return false;
+}
+
 static void *
 large_ralloc_move_helper(
     tsdn_t *tsdn, arena_t *arena, size_t usize, size_t alignment, bool zero) {
@@ -212,6 +287,9 @@ large_ralloc(tsdn_t *tsdn, arena_t *arena, void *ptr, size_t usize,
 	if (ret == NULL) {
 		return NULL;
 	}
+	/* Growing allocations are where copying hurts; try to avoid it. */
+	bool moved = usize > oldusize
+	    && !large_ralloc_move_remap(tsdn, edata, &ret, alignment, zero);
 
 	hook_invoke_alloc(
 	    hook_args->is_realloc ? hook_alloc_realloc : hook_alloc_rallocx,
@@ -220,8 +298,10 @@ large_ralloc(tsdn_t *tsdn, arena_t *arena, void *ptr, size_t usize,
 	    hook_args->is_realloc ? hook_dalloc_realloc : hook_dalloc_rallocx,
 	    ptr, hook_args->args);
 
-	size_t copysize = (usize < oldusize) ? usize : oldusize;
-	memcpy(ret, edata_addr_get(edata), copysize);
+	if (!moved) {
+		size_t copysize = (usize < oldusize) ? usize : oldusize;
+		memcpy(ret, edata_addr_get(edata), copysize);
+	}
 	isdalloct(tsdn, edata_addr_get(edata), oldusize, tcache, NULL, true);
 	return ret;
 }
@@ -5,6 +5,11 @@
 #include "jemalloc/internal/malloc_io.h"
 #include "jemalloc/internal/spin.h"
 
+#ifdef JEMALLOC_MUTEX_FUTEX
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#endif
+
 #if defined(_WIN32) && !defined(_CRT_SPINCOUNT)
 #	define _CRT_SPINCOUNT 4000
 #endif
@@ -15,6 +20,65 @@
  */
 int64_t opt_mutex_max_spin = 600;
 
+/*
+ * Time one in every opt_mutex_hold_sample holds of each mutex; 0 disables hold
+ * time sampling.  Only effective with stats enabled.
+ */
+unsigned opt_mutex_hold_sample = 0;
+
+/*
+ * Per witness rank overrides of opt_mutex_max_spin, set through
+ * opt.mutex_max_spin_ranks.  Written only during option parsing, before any
+ * mutex is contended.
+ */
+static int64_t mutex_max_spin_ranks[MUTEX_SPIN_RANK_NSLOTS];
+static bool    mutex_max_spin_ranks_set[MUTEX_SPIN_RANK_NSLOTS];
+
+typedef struct mutex_rank_name_s mutex_rank_name_t;
+struct mutex_rank_name_s {
+	const char    *name;
+	witness_rank_t rank;
+};
+
+static const mutex_rank_name_t mutex_rank_names[] = {
+    {"init", WITNESS_RANK_INIT},
+    {"ctl", WITNESS_RANK_CTL},
+    {"tcaches", WITNESS_RANK_TCACHES},
+    {"arenas", WITNESS_RANK_ARENAS},
+    {"background_thread_global", WITNESS_RANK_BACKGROUND_THREAD_GLOBAL},
+    {"alloc_trace", WITNESS_RANK_ALLOC_TRACE},
+    {"alloc_trace_tbuf", WITNESS_RANK_ALLOC_TRACE_TBUF},
+    {"alloc_trace_file", WITNESS_RANK_ALLOC_TRACE_FILE},
+    {"prof_dump", WITNESS_RANK_PROF_DUMP},
+    {"prof_recent_dump", WITNESS_RANK_PROF_RECENT_DUMP},
+    {"prof_recent_alloc", WITNESS_RANK_PROF_RECENT_ALLOC},
+    {"prof_bt2gctx", WITNESS_RANK_PROF_BT2GCTX},
+    {"prof_bt2gctx_stripe", WITNESS_RANK_PROF_BT2GCTX_STRIPE},
+    {"prof_tdatas", WITNESS_RANK_PROF_TDATAS},
+    {"prof_tdata", WITNESS_RANK_PROF_TDATA},
+    {"prof_log_stream", WITNESS_RANK_PROF_LOG_STREAM},
+    {"prof_log", WITNESS_RANK_PROF_LOG},
+    {"prof_gctx", WITNESS_RANK_PROF_GCTX},
+    {"background_thread", WITNESS_RANK_BACKGROUND_THREAD},
+    {"decay", WITNESS_RANK_DECAY},
+    {"tcache_ql", WITNESS_RANK_TCACHE_QL},
+    {"sec_shard", WITNESS_RANK_SEC_SHARD},
+    {"arena_hugepage_slabs", WITNESS_RANK_ARENA_HUGEPAGE_SLABS},
+    {"extent_grow", WITNESS_RANK_EXTENT_GROW},
+    {"extents", WITNESS_RANK_EXTENTS},
+    {"hpa_shard", WITNESS_RANK_HPA_SHARD},
+    {"hpa_central_grow", WITNESS_RANK_HPA_CENTRAL_GROW},
+    {"hpa_central", WITNESS_RANK_HPA_CENTRAL},
+    {"edata_cache", WITNESS_RANK_EDATA_CACHE},
+    {"rtree", WITNESS_RANK_RTREE},
+    {"base", WITNESS_RANK_BASE},
+    {"arena_large", WITNESS_RANK_ARENA_LARGE},
+    {"hook", WITNESS_RANK_HOOK},
+    /* All leaf locks (bins, stats, ...) share a single slot. */
+    {"leaf", WITNESS_RANK_LEAF},
+    {"bin", WITNESS_RANK_BIN},
+};
+
 /******************************************************************************/
 /* Data. */
 
@@ -48,10 +112,128 @@ JEMALLOC_EXPORT int _pthread_mutex_init_calloc_cb(
     pthread_mutex_t *mutex, void *(calloc_cb)(size_t, size_t));
 #endif
 
+static unsigned
+mutex_spin_rank_slot(witness_rank_t rank) {
+	return (rank < MUTEX_SPIN_RANK_NSLOTS - 1) ? (unsigned)rank
+	                                           : MUTEX_SPIN_RANK_NSLOTS - 1;
+}
+
+static int64_t
+mutex_max_spin_slot_get(unsigned slot) {
+	assert(slot < MUTEX_SPIN_RANK_NSLOTS);
+	return mutex_max_spin_ranks_set[slot] ? mutex_max_spin_ranks[slot]
+	                                      : opt_mutex_max_spin;
+}
+
+int64_t
+malloc_mutex_max_spin_get(witness_rank_t rank) {
+	return mutex_max_spin_slot_get(mutex_spin_rank_slot(rank));
+}
+
+/*
+ * Parses "<rank name>:<max spin>|<rank name>:<max spin>|...", where max spin
+ * follows the opt.mutex_max_spin conventions (-1 means spin indefinitely).
+ * Returns true on error; earlier settings in the list remain applied.
+ */
+bool
+malloc_mutex_max_spin_ranks_parse(const char *v, size_t vlen) {
+	const char *cur = v;
+	const char *end = v + vlen;
+	while (cur < end) {
+		const char *sep = memchr(cur, '|', (size_t)(end - cur));
+		const char *seg_end = (sep == NULL) ? end : sep;
+		const char *colon = memchr(cur, ':', (size_t)(seg_end - cur));
+		if (colon == NULL || colon == cur || colon + 1 == seg_end) {
+			return true;
+		}
+
+		size_t                   name_len = (size_t)(colon - cur);
+		const mutex_rank_name_t *entry = NULL;
+		for (size_t i = 0; i < sizeof(mutex_rank_names)
+		         / sizeof(mutex_rank_names[0]);
+		     i++) {
+			if (strlen(mutex_rank_names[i].name) == name_len
+			    && strncmp(mutex_rank_names[i].name, cur, name_len)
+			        == 0) {
+				entry = &mutex_rank_names[i];
+				break;
+			}
+		}
+		if (entry == NULL) {
+			return true;
+		}
+
+		set_errno(0);
+		char   *num_end;
+		int64_t spin = (int64_t)malloc_strtoumax(
+		    colon + 1, &num_end, 0);
+		if (get_errno() != 0 || num_end != seg_end || spin < -1) {
+			return true;
+		}
+		unsigned slot = mutex_spin_rank_slot(entry->rank);
+		mutex_max_spin_ranks[slot] = spin;
+		mutex_max_spin_ranks_set[slot] = true;
+
+		if (sep != NULL && sep + 1 == end) {
+			/* Trailing separator. */
+			return true;
+		}
+		cur = (sep == NULL) ? end : sep + 1;
+	}
+	return false;
+}
+
+#ifdef JEMALLOC_MUTEX_FUTEX
+int
+malloc_futex_wait(
+    atomic_u32_t *word, uint32_t val, const struct timespec *deadline) {
+	int saved_errno = get_errno();
+	int err = 0;
+	/*
+	 * FUTEX_WAIT takes a relative timeout; the bitset variant is the one
+	 * that accepts an absolute CLOCK_REALTIME deadline, as
+	 * pthread_cond_timedwait() does.
+	 */
+	if (syscall(SYS_futex, (uint32_t *)word,
+	        FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME, val, deadline,
+	        NULL, FUTEX_BITSET_MATCH_ANY)
+	        != 0
+	    && get_errno() == ETIMEDOUT) {
+		err = ETIMEDOUT;
+	}
+	set_errno(saved_errno);
+	return err;
+}
+
+void
+malloc_futex_wake(atomic_u32_t *word, int nwake) {
+	int saved_errno = get_errno();
+	syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, nwake, NULL,
+	    NULL, 0);
+	set_errno(saved_errno);
+}
+
+void
+malloc_mutex_futex_lock_slow(atomic_u32_t *lock) {
+	/*
+	 * Mark the lock contended before sleeping, so that the owner's unlock
+	 * wakes us.  Having been woken, we can't tell whether other sleepers
+	 * remain, so we conservatively keep the contended state.
+	 */
+	while (atomic_exchange_u32(lock, MALLOC_MUTEX_FUTEX_CONTENDED,
+	           ATOMIC_ACQUIRE)
+	    != MALLOC_MUTEX_FUTEX_UNLOCKED) {
+		malloc_futex_wait(lock, MALLOC_MUTEX_FUTEX_CONTENDED, NULL);
+	}
+}
+#endif
+
 void
 malloc_mutex_lock_slow(malloc_mutex_t *mutex) {
 	mutex_prof_data_t *data = &mutex->prof_data;
 	nstime_t           before;
+	int64_t            max_spin = mutex_max_spin_slot_get(
+            mutex->spin_rank_slot);
 
 	if (ncpus == 1) {
 		goto label_spin_done;
@@ -65,7 +247,7 @@ malloc_mutex_lock_slow(malloc_mutex_t *mutex) {
 			data->n_spin_acquired++;
 			return;
 		}
-	} while (cnt++ < opt_mutex_max_spin || opt_mutex_max_spin == -1);
+	} while (cnt++ < max_spin || max_spin == -1);
 
 	if (!config_stats) {
 		/* Only spin is useful when stats is off. */
@@ -107,11 +289,56 @@ label_spin_done:
 	}
 }
 
+void
+malloc_mutex_hold_sample_begin(malloc_mutex_t *mutex) {
+	mutex_prof_data_t *data = &mutex->prof_data;
+	assert(opt_mutex_hold_sample != 0);
+	data->hold_sample_countdown = opt_mutex_hold_sample - 1;
+	data->hold_sampled = true;
+	nstime_init_update(&data->hold_start);
+}
+
+static unsigned
+mutex_hold_hist_bucket(uint64_t ns) {
+	if (ns < (UINT64_C(1) << MUTEX_PROF_HOLD_HIST_LG_MIN)) {
+		return 0;
+	}
+	unsigned bucket = fls_u64(ns) - MUTEX_PROF_HOLD_HIST_LG_MIN + 1;
+	return (bucket < MUTEX_PROF_HOLD_HIST_NBUCKETS)
+	    ? bucket
+	    : MUTEX_PROF_HOLD_HIST_NBUCKETS - 1;
+}
+
+void
+malloc_mutex_hold_sample_end(malloc_mutex_t *mutex) {
+	mutex_prof_data_t *data = &mutex->prof_data;
+	assert(data->hold_sampled);
+	data->hold_sampled = false;
+
+	nstime_t delta;
+	nstime_init_update(&delta);
+	/* Guard against clock skew, as nstime_subtract() requires. */
+	if (nstime_compare(&delta, &data->hold_start) < 0) {
+		nstime_copy(&delta, &data->hold_start);
+	}
+	nstime_subtract(&delta, &data->hold_start);
+
+	data->n_hold_samples++;
+	nstime_add(&data->tot_hold_time, &delta);
+	if (nstime_compare(&data->max_hold_time, &delta) < 0) {
+		nstime_copy(&data->max_hold_time, &delta);
+	}
+	data->hold_hist[mutex_hold_hist_bucket(nstime_ns(&delta))]++;
+}
+
 static void
 mutex_prof_data_init(mutex_prof_data_t *data) {
 	memset(data, 0, sizeof(mutex_prof_data_t));
 	nstime_init_zero(&data->max_wait_time);
 	nstime_init_zero(&data->tot_wait_time);
+	nstime_init_zero(&data->tot_hold_time);
+	nstime_init_zero(&data->max_hold_time);
+	nstime_init_zero(&data->hold_start);
 	data->prev_owner = NULL;
 }
 
@@ -141,6 +368,7 @@ bool
 malloc_mutex_init(malloc_mutex_t *mutex, const char *name, witness_rank_t rank,
     malloc_mutex_lock_order_t lock_order) {
 	mutex_prof_data_init(&mutex->prof_data);
+	mutex->spin_rank_slot = (uint8_t)mutex_spin_rank_slot(rank);
 #ifdef _WIN32
 #	if _WIN32_WINNT >= 0x0600
 	InitializeSRWLock(&mutex->lock);
@@ -152,6 +380,8 @@ malloc_mutex_init(malloc_mutex_t *mutex, const char *name, witness_rank_t rank,
 #	endif
 #elif (defined(JEMALLOC_OS_UNFAIR_LOCK))
 	mutex->lock = OS_UNFAIR_LOCK_INIT;
+#elif (defined(JEMALLOC_MUTEX_FUTEX))
+	atomic_store_u32(&mutex->lock, MALLOC_MUTEX_FUTEX_UNLOCKED, ATOMIC_RELAXED);
 #elif (defined(JEMALLOC_MUTEX_INIT_CB))
 	if (postpone_init) {
 		mutex->postponed_next = postponed_mutexes;
@@ -203,6 +433,8 @@ malloc_mutex_postfork_child(tsdn_t *tsdn, malloc_mutex_t *mutex) {
 #ifdef JEMALLOC_MUTEX_INIT_CB
 	malloc_mutex_unlock(tsdn, mutex);
 #else
+	/* The witness rank is only recorded in debug builds. */
+	uint8_t spin_rank_slot = mutex->spin_rank_slot;
 	if (malloc_mutex_init(mutex, mutex->witness.name, mutex->witness.rank,
 	        mutex->lock_order)) {
 		malloc_printf(
@@ -212,6 +444,7 @@ malloc_mutex_postfork_child(tsdn_t *tsdn, malloc_mutex_t *mutex) {
 			abort();
 		}
 	}
+	mutex->spin_rank_slot = spin_rank_slot;
 #endif
 }
 
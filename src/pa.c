@@ -39,6 +39,10 @@ pa_shard_init(tsdn_t *tsdn, pa_shard_t *shard, pa_central_t *central,
 	if (edata_cache_init(&shard->edata_cache, base)) {
 		return true;
 	}
+	if (edata_cache_percpu_init(
+	        tsdn, &shard->edata_cache, opt_edata_cache_percpu_max)) {
+		return true;
+	}
 
 	if (pac_init(tsdn, &shard->pac, base, emap, &shard->edata_cache,
 	        cur_time, pac_oversize_threshold, dirty_decay_ms,
@@ -98,11 +102,6 @@ pa_shard_reset(tsdn_t *tsdn, pa_shard_t *shard) {
 	}
 }
 
-static bool
-pa_shard_uses_hpa(pa_shard_t *shard) {
-	return atomic_load_b(&shard->use_hpa, ATOMIC_RELAXED);
-}
-
 void
 pa_shard_destroy(tsdn_t *tsdn, pa_shard_t *shard) {
 	pac_destroy(tsdn, &shard->pac);
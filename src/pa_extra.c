@@ -110,8 +110,8 @@ pa_shard_stats_merge(tsdn_t *tsdn, pa_shard_t *shard,
 
 	pa_shard_stats_out->pac_stats.retained +=
 	    ecache_npages_get(&shard->pac.ecache_retained) << LG_PAGE;
-	pa_shard_stats_out->edata_avail += atomic_load_zu(
-	    &shard->edata_cache.count, ATOMIC_RELAXED);
+	pa_shard_stats_out->edata_avail += edata_cache_navail(
+	    &shard->edata_cache);
 
 	size_t resident_pgs = 0;
 	resident_pgs += pa_shard_nactive(shard);
@@ -187,6 +187,8 @@ pa_shard_mtx_stats_read(tsdn_t *tsdn, pa_shard_t *shard,
     mutex_prof_data_t mutex_prof_data[mutex_prof_num_arena_mutexes]) {
 	pa_shard_mtx_stats_read_single(tsdn, mutex_prof_data,
 	    &shard->edata_cache.mtx, arena_prof_mutex_extent_avail);
+	edata_cache_percpu_mutex_stats_read(tsdn, &shard->edata_cache,
+	    &mutex_prof_data[arena_prof_mutex_edata_cache_percpu]);
 	pa_shard_mtx_stats_read_single(tsdn, mutex_prof_data,
 	    &shard->pac.ecache_dirty.mtx, arena_prof_mutex_extents_dirty);
 	pa_shard_mtx_stats_read_single(tsdn, mutex_prof_data,
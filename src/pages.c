@@ -518,6 +518,48 @@ pages_purge_forced(void *addr, size_t size) {
 #endif
 }
 
+#ifdef PAGES_CAN_REMAP
+static atomic_b_t pages_remap_gate = ATOMIC_INIT(true);
+#endif
+
+/*
+ * Moves the pages backing [old_addr, old_addr + size) to new_addr, replacing
+ * whatever was mapped there, and leaves the old range mapped but demand-zeroed.
+ * Both ranges must belong to committed, non-overlapping anonymous mappings.
+ */
+bool
+pages_remap(void *old_addr, void *new_addr, size_t size) {
+	assert(PAGE_ADDR2BASE(old_addr) == old_addr);
+	assert(PAGE_ADDR2BASE(new_addr) == new_addr);
+	assert(PAGE_CEILING(size) == size);
+	assert((byte_t *)old_addr + size <= (byte_t *)new_addr
+	    || (byte_t *)new_addr + size <= (byte_t *)old_addr);
+
+	if (!pages_can_remap) {
+		return true;
+	}
+
+#ifdef PAGES_CAN_REMAP
+	if (!atomic_load_b(&pages_remap_gate, ATOMIC_RELAXED)) {
+		return true;
+	}
+	/* Keeps the old range mapped, as fresh pages. */
+	void *result = mremap(old_addr, size, size,
+	    MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP, new_addr);
+	if (result == MAP_FAILED) {
+		if (get_errno() == EINVAL) {
+			/* The kernel can't do MREMAP_DONTUNMAP; stop trying. */
+			atomic_store_b(&pages_remap_gate, false, ATOMIC_RELAXED);
+		}
+		return true;
+	}
+	assert(result == new_addr);
+	return false;
+#else
+	not_reached();
+#endif
+}
+
 static bool
 pages_huge_impl(void *addr, size_t size, bool aligned) {
 	if (aligned) {
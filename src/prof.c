@@ -38,11 +38,33 @@ bool     opt_prof_accum = false;
 bool     opt_prof_pid_namespace = false;
 char     opt_prof_prefix[PROF_DUMP_FILENAME_LEN];
 bool     opt_prof_sys_thread_name = false;
+bool     opt_prof_unwind_validate = false;
+bool     opt_prof_lifetime = false;
+bool     opt_prof_per_arena = false;
+unsigned opt_prof_leak_epochs = 0;
+uint64_t opt_prof_leak_epoch_ms = PROF_LEAK_EPOCH_MS_DEFAULT;
 bool     opt_prof_unbias = true;
 
+prof_dump_format_t opt_prof_dump_format = prof_dump_format_text;
+const char *const  prof_dump_format_names[] = {
+    "text",
+    "binary",
+};
+
 /* Accessed via prof_sample_event_handler(). */
 static counter_accum_t prof_idump_accumulated;
 
+/*
+ * Time (in ms, wrapping) at which the current leak detection epoch ends, if
+ * opt_prof_leak_epoch_ms is nonzero.  Updated under prof_dump_mtx.
+ */
+static atomic_zu_t prof_leak_epoch_deadline;
+/*
+ * Set by sampled allocations that find the current leak detection epoch due;
+ * they leave ending it to prof_leak_epoch_deferred_work().
+ */
+static atomic_b_t prof_leak_epoch_due;
+
 /*
  * Initialized as opt_prof_active, and accessed via
  * prof_active_[gs]et{_unlocked,}().
@@ -88,6 +110,20 @@ static atomic_p_t prof_sample_free_hook;
 
 /******************************************************************************/
 
+/*
+ * Marks gctx as changed since the last delta dump.  Called with a tctx of gctx
+ * pinned, and under its tdata's lock.
+ */
+static inline void
+prof_gctx_delta_dirty_set(prof_gctx_t *gctx) {
+	/* Avoid dirtying the cache line if the flag is already set. */
+	if (atomic_load_b(&prof_dump_delta_tracking, ATOMIC_RELAXED)
+	    && !atomic_load_b(&gctx->delta_dirty, ATOMIC_RELAXED)
+	    && !atomic_exchange_b(&gctx->delta_dirty, true, ATOMIC_ACQ_REL)) {
+		prof_gctx_delta_dirty_push(gctx);
+	}
+}
+
 void
 prof_alloc_rollback(tsd_t *tsd, prof_tctx_t *tctx) {
 	cassert(config_prof);
@@ -112,6 +148,29 @@ prof_alloc_rollback(tsd_t *tsd, prof_tctx_t *tctx) {
 	}
 }
 
+/*
+ * Returns the tctx to charge a sampled object in arena arena_ind to.  That is
+ * tctx itself, unless the object came from another arena than the one
+ * prof_alloc_prep() expected (e.g. the huge arena, or the arena an object was
+ * resized in place in).
+ */
+static prof_tctx_t *
+prof_tctx_arena_fix(tsd_t *tsd, prof_tctx_t *tctx, unsigned arena_ind) {
+	if (likely(tctx->gctx->bt.arena_ind == arena_ind)) {
+		return tctx;
+	}
+	/* The prepared tctx keeps gctx, and thus bt.vec, alive. */
+	prof_bt_t bt = tctx->gctx->bt;
+	bt.arena_ind = arena_ind;
+	prof_tctx_t *ret = prof_lookup(tsd, &bt);
+	if (ret == NULL) {
+		/* Charge the expected arena rather than losing the sample. */
+		return tctx;
+	}
+	prof_alloc_rollback(tsd, tctx);
+	return ret;
+}
+
 void
 prof_malloc_sample_object(
     tsd_t *tsd, const void *ptr, size_t size, size_t usize, prof_tctx_t *tctx) {
@@ -123,6 +182,10 @@ prof_malloc_sample_object(
 
 	edata_t *edata = emap_edata_lookup(
 	    tsd_tsdn(tsd), &arena_emap_global, ptr);
+	if (opt_prof_per_arena) {
+		tctx = prof_tctx_arena_fix(
+		    tsd, tctx, edata_arena_ind_get(edata));
+	}
 	prof_info_set(tsd, edata, tctx, size);
 
 	szind_t szind = sz_size2index(usize);
@@ -150,6 +213,7 @@ prof_malloc_sample_object(
 		tctx->cnts.accumbytes += usize;
 		tctx->cnts.accumbytes_unbiased += unbiased_bytes;
 	}
+	prof_gctx_delta_dirty_set(tctx->gctx);
 	bool record_recent = prof_recent_alloc_prepare(tsd, tctx);
 	tctx->prepared = false;
 	malloc_mutex_unlock(tsd_tsdn(tsd), tctx->tdata->lock);
@@ -206,10 +270,20 @@ prof_free_sampled_object(
 	tctx->cnts.curobjs_shifted_unbiased -= prof_shifted_unbiased_cnt[szind];
 	tctx->cnts.curbytes -= usize;
 	tctx->cnts.curbytes_unbiased -= prof_unbiased_sz[szind];
+	if (opt_prof_lifetime) {
+		prof_gctx_lifetime_record(
+		    tsd_tsdn(tsd), tctx->gctx, &prof_info->alloc_time);
+	}
+	prof_gctx_delta_dirty_set(tctx->gctx);
 
 	prof_try_log(tsd, usize, prof_info);
 
 	prof_tctx_try_destroy(tsd, tctx);
+	/*
+	 * Written out here, after the locks above have been dropped, unless
+	 * another thread is writing already.
+	 */
+	prof_log_stream_flush(tsd);
 
 	if (opt_prof_stats) {
 		prof_stats_dec(tsd, szind, prof_info->alloc_size);
@@ -217,7 +291,7 @@ prof_free_sampled_object(
 }
 
 prof_tctx_t *
-prof_tctx_create(tsd_t *tsd) {
+prof_tctx_create(tsd_t *tsd, unsigned arena_ind) {
 	if (!tsd_nominal(tsd) || tsd_reentrancy_level_get(tsd) > 0) {
 		return NULL;
 	}
@@ -230,6 +304,13 @@ prof_tctx_create(tsd_t *tsd) {
 	prof_bt_t bt;
 	bt_init(&bt, tdata->vec);
 	prof_backtrace(tsd, &bt);
+	if (opt_prof_per_arena) {
+		if (arena_ind == ARENA_IND_AUTOMATIC) {
+			arena_t *arena = tsd_arena_get(tsd);
+			arena_ind = (arena == NULL) ? 0 : arena_ind_get(arena);
+		}
+		bt.arena_ind = arena_ind;
+	}
 	return prof_lookup(tsd, &bt);
 }
 
@@ -292,10 +373,113 @@ prof_sample_new_event_wait(tsd_t *tsd) {
 #endif
 }
 
+static size_t
+prof_leak_now_ms(void) {
+	nstime_t now;
+	nstime_init_update(&now);
+	return (size_t)nstime_ms(&now);
+}
+
+static bool
+prof_leak_epoch_timed(void) {
+	return opt_prof && prof_booted && opt_prof_leak_epochs != 0
+	    && opt_prof_leak_epoch_ms != 0;
+}
+
+/* Returns the time (in ms) left in the current leak detection epoch. */
+static ssize_t
+prof_leak_epoch_ms_left(void) {
+	return (ssize_t)(atomic_load_zu(
+	                     &prof_leak_epoch_deadline, ATOMIC_RELAXED)
+	    - prof_leak_now_ms());
+}
+
+/*
+ * Ends the current leak detection epoch; if wait is false, only if no dump is
+ * in progress and the epoch is due.  Internal threads, such as background
+ * threads, have no tdata.
+ */
+static bool
+prof_leak_epoch_end_impl(tsd_t *tsd, bool wait) {
+	prof_tdata_t *tdata = NULL;
+	if (tsd_nominal(tsd)) {
+		assert(tsd_reentrancy_level_get(tsd) == 0);
+		tdata = prof_tdata_get(tsd, true);
+		if (tdata == NULL) {
+			return true;
+		}
+	}
+	pre_reentrancy(tsd, NULL);
+	if (wait) {
+		malloc_mutex_lock(tsd_tsdn(tsd), &prof_dump_mtx);
+	} else if (malloc_mutex_trylock(tsd_tsdn(tsd), &prof_dump_mtx)) {
+		post_reentrancy(tsd);
+		return true;
+	}
+	if (!wait && prof_leak_epoch_ms_left() > 0) {
+		/* Another thread got here first; the flag may be stale. */
+		atomic_store_b(&prof_leak_epoch_due, false, ATOMIC_RELAXED);
+		malloc_mutex_unlock(tsd_tsdn(tsd), &prof_dump_mtx);
+		post_reentrancy(tsd);
+		return true;
+	}
+	atomic_store_zu(&prof_leak_epoch_deadline,
+	    prof_leak_now_ms() + (size_t)opt_prof_leak_epoch_ms,
+	    ATOMIC_RELAXED);
+	atomic_store_b(&prof_leak_epoch_due, false, ATOMIC_RELAXED);
+	prof_leak_epoch_end(tsd, tdata);
+	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_dump_mtx);
+	post_reentrancy(tsd);
+	return false;
+}
+
+uint64_t
+prof_leak_epoch_ns_until_due(void) {
+	cassert(config_prof);
+
+	if (!prof_leak_epoch_timed()) {
+		return UINT64_MAX;
+	}
+	if (atomic_load_b(&prof_leak_epoch_due, ATOMIC_RELAXED)) {
+		return 0;
+	}
+	ssize_t ms_left = prof_leak_epoch_ms_left();
+	return ms_left > 0 ? (uint64_t)ms_left * 1000 * 1000 : 0;
+}
+
+void
+prof_leak_epoch_deferred_work(tsd_t *tsd) {
+	cassert(config_prof);
+
+	if (prof_leak_epoch_ns_until_due() == 0) {
+		prof_leak_epoch_end_impl(tsd, /* wait */ false);
+	}
+}
+
+void
+prof_background_work(tsd_t *tsd) {
+	cassert(config_prof);
+
+	prof_log_stream_flush(tsd);
+	prof_leak_epoch_deferred_work(tsd);
+}
+
 void
 prof_sample_event_handler(tsd_t *tsd) {
 	cassert(config_prof);
-	if (prof_interval == 0 || !prof_active_get_unlocked()) {
+	if (!prof_active_get_unlocked()) {
+		return;
+	}
+	/*
+	 * Ending an epoch takes as long as a dump; only flag it here, for the
+	 * background thread or the next prof.leak_* mallctl.
+	 */
+	if (opt_prof_leak_epochs != 0 && opt_prof_leak_epoch_ms != 0
+	    && !atomic_load_b(&prof_leak_epoch_due, ATOMIC_RELAXED)
+	    && prof_leak_epoch_ms_left() <= 0) {
+		atomic_store_b(&prof_leak_epoch_due, true, ATOMIC_RELAXED);
+	}
+	if (prof_interval == 0) {
 		return;
 	}
 	uint64_t last_event = thread_allocated_last_event_get(tsd);
@@ -400,6 +584,51 @@ prof_mdump(tsd_t *tsd, const char *filename) {
 	return prof_mdump_impl(tsd, filename);
 }
 
+bool
+prof_ddump(tsd_t *tsd, const char *filename) {
+	cassert(config_prof);
+	assert(tsd_reentrancy_level_get(tsd) == 0);
+
+	if (!opt_prof || !prof_booted) {
+		return true;
+	}
+
+	return prof_ddump_impl(tsd, filename);
+}
+
+bool
+prof_leak_epoch_advance(tsd_t *tsd) {
+	cassert(config_prof);
+
+	if (!opt_prof || !prof_booted || opt_prof_leak_epochs == 0) {
+		return true;
+	}
+
+	return prof_leak_epoch_end_impl(tsd, /* wait */ true);
+}
+
+bool
+prof_leak_report(tsd_t *tsd, write_cb_t *write_cb, void *cbopaque) {
+	cassert(config_prof);
+	assert(tsd_reentrancy_level_get(tsd) == 0);
+
+	if (!opt_prof || !prof_booted || opt_prof_leak_epochs == 0) {
+		return true;
+	}
+	prof_tdata_t *tdata = prof_tdata_get(tsd, true);
+	if (tdata == NULL) {
+		return true;
+	}
+
+	prof_leak_epoch_deferred_work(tsd);
+	pre_reentrancy(tsd, NULL);
+	malloc_mutex_lock(tsd_tsdn(tsd), &prof_dump_mtx);
+	prof_leak_report_write(tsd, tdata, write_cb, cbopaque);
+	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_dump_mtx);
+	post_reentrancy(tsd);
+	return false;
+}
+
 void
 prof_gdump(tsdn_t *tsdn) {
 	tsd_t        *tsd;
@@ -729,6 +958,9 @@ prof_boot2(tsd_t *tsd, base_t *base) {
 		if (prof_idump_accum_init()) {
 			return true;
 		}
+		atomic_store_zu(&prof_leak_epoch_deadline,
+		    prof_leak_now_ms() + (size_t)opt_prof_leak_epoch_ms,
+		    ATOMIC_RELAXED);
 
 		if (opt_prof_final && opt_prof_prefix[0] != '\0'
 		    && atexit(prof_fdump) != 0) {
@@ -748,6 +980,21 @@ prof_boot2(tsd_t *tsd, base_t *base) {
 
 		prof_base = base;
 
+		bt2gctx_locks = (malloc_mutex_t *)base_alloc(tsd_tsdn(tsd),
+		    base, PROF_BT2GCTX_NSTRIPES * sizeof(malloc_mutex_t),
+		    CACHELINE);
+		if (bt2gctx_locks == NULL) {
+			return true;
+		}
+		for (unsigned i = 0; i < PROF_BT2GCTX_NSTRIPES; i++) {
+			if (malloc_mutex_init(&bt2gctx_locks[i],
+			        "prof_bt2gctx_stripe",
+			        WITNESS_RANK_PROF_BT2GCTX_STRIPE,
+			        malloc_mutex_address_ordered)) {
+				return true;
+			}
+		}
+
 		gctx_locks = (malloc_mutex_t *)base_alloc(tsd_tsdn(tsd), base,
 		    PROF_NCTX_LOCKS * sizeof(malloc_mutex_t), CACHELINE);
 		if (gctx_locks == NULL) {
@@ -788,16 +1035,21 @@ prof_prefork0(tsdn_t *tsdn) {
 		unsigned i;
 
 		malloc_mutex_prefork(tsdn, &prof_dump_mtx);
+		malloc_mutex_prefork(tsdn, &prof_recent_dump_mtx);
+		malloc_mutex_prefork(tsdn, &prof_recent_alloc_mtx);
 		malloc_mutex_prefork(tsdn, &bt2gctx_mtx);
+		for (i = 0; i < PROF_BT2GCTX_NSTRIPES; i++) {
+			malloc_mutex_prefork(tsdn, &bt2gctx_locks[i]);
+		}
 		malloc_mutex_prefork(tsdn, &tdatas_mtx);
 		for (i = 0; i < PROF_NTDATA_LOCKS; i++) {
 			malloc_mutex_prefork(tsdn, &tdata_locks[i]);
 		}
+		malloc_mutex_prefork(tsdn, &log_stream_mtx);
 		malloc_mutex_prefork(tsdn, &log_mtx);
 		for (i = 0; i < PROF_NCTX_LOCKS; i++) {
 			malloc_mutex_prefork(tsdn, &gctx_locks[i]);
 		}
-		malloc_mutex_prefork(tsdn, &prof_recent_dump_mtx);
 	}
 }
 
@@ -808,7 +1060,6 @@ prof_prefork1(tsdn_t *tsdn) {
 		malloc_mutex_prefork(tsdn, &prof_active_mtx);
 		malloc_mutex_prefork(tsdn, &prof_dump_filename_mtx);
 		malloc_mutex_prefork(tsdn, &prof_gdump_mtx);
-		malloc_mutex_prefork(tsdn, &prof_recent_alloc_mtx);
 		malloc_mutex_prefork(tsdn, &prof_stats_mtx);
 		malloc_mutex_prefork(tsdn, &next_thr_uid_mtx);
 		malloc_mutex_prefork(tsdn, &prof_thread_active_init_mtx);
@@ -824,21 +1075,25 @@ prof_postfork_parent(tsdn_t *tsdn) {
 		    tsdn, &prof_thread_active_init_mtx);
 		malloc_mutex_postfork_parent(tsdn, &next_thr_uid_mtx);
 		malloc_mutex_postfork_parent(tsdn, &prof_stats_mtx);
-		malloc_mutex_postfork_parent(tsdn, &prof_recent_alloc_mtx);
 		malloc_mutex_postfork_parent(tsdn, &prof_gdump_mtx);
 		malloc_mutex_postfork_parent(tsdn, &prof_dump_filename_mtx);
 		malloc_mutex_postfork_parent(tsdn, &prof_active_mtx);
 		counter_postfork_parent(tsdn, &prof_idump_accumulated);
-		malloc_mutex_postfork_parent(tsdn, &prof_recent_dump_mtx);
 		for (i = 0; i < PROF_NCTX_LOCKS; i++) {
 			malloc_mutex_postfork_parent(tsdn, &gctx_locks[i]);
 		}
 		malloc_mutex_postfork_parent(tsdn, &log_mtx);
+		malloc_mutex_postfork_parent(tsdn, &log_stream_mtx);
 		for (i = 0; i < PROF_NTDATA_LOCKS; i++) {
 			malloc_mutex_postfork_parent(tsdn, &tdata_locks[i]);
 		}
 		malloc_mutex_postfork_parent(tsdn, &tdatas_mtx);
+		for (i = 0; i < PROF_BT2GCTX_NSTRIPES; i++) {
+			malloc_mutex_postfork_parent(tsdn, &bt2gctx_locks[i]);
+		}
 		malloc_mutex_postfork_parent(tsdn, &bt2gctx_mtx);
+		malloc_mutex_postfork_parent(tsdn, &prof_recent_alloc_mtx);
+		malloc_mutex_postfork_parent(tsdn, &prof_recent_dump_mtx);
 		malloc_mutex_postfork_parent(tsdn, &prof_dump_mtx);
 	}
 }
@@ -851,21 +1106,26 @@ prof_postfork_child(tsdn_t *tsdn) {
 		malloc_mutex_postfork_child(tsdn, &prof_thread_active_init_mtx);
 		malloc_mutex_postfork_child(tsdn, &next_thr_uid_mtx);
 		malloc_mutex_postfork_child(tsdn, &prof_stats_mtx);
-		malloc_mutex_postfork_child(tsdn, &prof_recent_alloc_mtx);
 		malloc_mutex_postfork_child(tsdn, &prof_gdump_mtx);
 		malloc_mutex_postfork_child(tsdn, &prof_dump_filename_mtx);
 		malloc_mutex_postfork_child(tsdn, &prof_active_mtx);
 		counter_postfork_child(tsdn, &prof_idump_accumulated);
-		malloc_mutex_postfork_child(tsdn, &prof_recent_dump_mtx);
 		for (i = 0; i < PROF_NCTX_LOCKS; i++) {
 			malloc_mutex_postfork_child(tsdn, &gctx_locks[i]);
 		}
 		malloc_mutex_postfork_child(tsdn, &log_mtx);
+		malloc_mutex_postfork_child(tsdn, &log_stream_mtx);
 		for (i = 0; i < PROF_NTDATA_LOCKS; i++) {
 			malloc_mutex_postfork_child(tsdn, &tdata_locks[i]);
 		}
 		malloc_mutex_postfork_child(tsdn, &tdatas_mtx);
+		for (i = 0; i < PROF_BT2GCTX_NSTRIPES; i++) {
+			malloc_mutex_postfork_child(tsdn, &bt2gctx_locks[i]);
+		}
 		malloc_mutex_postfork_child(tsdn, &bt2gctx_mtx);
+		malloc_mutex_postfork_child(tsdn, &prof_recent_alloc_mtx);
+		malloc_mutex_postfork_child(tsdn, &prof_recent_dump_mtx);
+		prof_data_postfork_child();
 		malloc_mutex_postfork_child(tsdn, &prof_dump_mtx);
 	}
 }
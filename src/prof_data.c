@@ -2,10 +2,13 @@
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
 #include "jemalloc/internal/assert.h"
+#include "jemalloc/internal/buf_writer.h"
 #include "jemalloc/internal/ckh.h"
+#include "jemalloc/internal/emitter.h"
 #include "jemalloc/internal/hash.h"
 #include "jemalloc/internal/malloc_io.h"
 #include "jemalloc/internal/prof_data.h"
+#include "jemalloc/internal/spin.h"
 
 /*
  * This file defines and manages the core profiling data structures.
@@ -50,8 +53,51 @@ malloc_mutex_t *tdata_locks;
 /*
  * Global hash of (prof_bt_t *)-->(prof_gctx_t *).  This is the master data
  * structure that knows about all backtraces currently captured.
+ *
+ * It is an open addressing table with linear probing, whose slots point
+ * directly at the gctx's.  Lookups probe it without taking any lock.  Inserting
+ * or removing a backtrace takes the stripe lock (bt2gctx_locks) selected by its
+ * hash; rebuilding the table, and preparing a dump, take bt2gctx_mtx and then
+ * every stripe lock.  Removal leaves a tombstone behind, so that concurrent
+ * probes for other backtraces are never cut short.
+ *
+ * Because lookups hold no lock, a removed gctx (or a replaced table) must not
+ * be freed while a lookup that started before the removal may still be looking
+ * at it.  Lookups are therefore counted in per-epoch reader counters, and
+ * deallocation first waits in prof_bt2gctx_synchronize() for the readers of the
+ * previous epoch to drain.  Removed gctx's are retired in batches, so that the
+ * wait is amortized.
  */
-static ckh_t bt2gctx;
+#define PROF_BT2GCTX_LG_MINSLOTS 10
+#define PROF_BT2GCTX_TOMBSTONE ((prof_gctx_t *)(uintptr_t)1)
+#define PROF_BT2GCTX_NREADER_SLOTS 32
+#define PROF_BT2GCTX_RETIRE_BATCH 32
+
+typedef struct prof_bt2gctx_table_s prof_bt2gctx_table_t;
+struct prof_bt2gctx_table_s {
+	unsigned lg_nslots;
+	/* Number of non-empty slots, tombstones included. */
+	atomic_zu_t nused;
+	atomic_p_t  slots[1];
+};
+
+typedef struct prof_bt2gctx_readers_s prof_bt2gctx_readers_t;
+struct prof_bt2gctx_readers_s {
+	/* In-progress lookups, by the parity of the epoch they started in. */
+	JEMALLOC_ALIGNED(CACHELINE)
+	atomic_zu_t nreaders[2];
+};
+
+static atomic_p_t      bt2gctx;
+static atomic_zu_t     bt2gctx_nlive;
+static atomic_u_t      bt2gctx_epoch;
+static prof_bt2gctx_readers_t bt2gctx_readers[PROF_BT2GCTX_NREADER_SLOTS];
+/* Removed gctx's awaiting deallocation; protected by bt2gctx_mtx. */
+static prof_gctx_t *bt2gctx_retired;
+static unsigned     bt2gctx_nretired;
+
+/* Stripe locks for writers to bt2gctx, indexed by backtrace hash. */
+malloc_mutex_t *bt2gctx_locks;
 
 /*
  * Tree of all extant prof_tdata_t structures, regardless of state,
@@ -59,6 +105,35 @@ static ckh_t bt2gctx;
  */
 static prof_tdata_tree_t tdatas;
 
+/*
+ * Counts dump preparations; gctx->dump_epoch tells whether a gctx is part of
+ * the dump being prepared.  Protected by bt2gctx_mtx.
+ */
+static uint64_t prof_dump_epoch;
+
+/*
+ * Sequence number of the next delta dump, and whether it must be a complete
+ * snapshot (as the first one is, the first one after a reset, and the one after
+ * a failed delta dump).  Protected by prof_dump_mtx.
+ */
+static uint64_t prof_dump_delta_seq;
+static bool     prof_dump_delta_full = true;
+
+/*
+ * Set by the first delta dump; from then on, the contexts that change between
+ * delta dumps are pushed onto prof_gctx_delta_list, so that a delta dump only
+ * visits those.  The list is only ever emptied as a whole, by a delta dump, so
+ * pushes can't suffer from ABA.
+ */
+atomic_b_t        prof_dump_delta_tracking = ATOMIC_INIT(false);
+static atomic_p_t prof_gctx_delta_list = ATOMIC_INIT(NULL);
+
+/*
+ * Number of leak detection epochs that have ended (opt.prof_leak_epochs).
+ * Only advanced under prof_dump_mtx, but read without it.
+ */
+static atomic_u_t prof_leak_epoch = ATOMIC_INIT(0);
+
 size_t prof_unbiased_sz[PROF_SC_NSIZES];
 size_t prof_shifted_unbiased_cnt[PROF_SC_NSIZES];
 
@@ -98,6 +173,11 @@ rb_gen(static UNUSED, tctx_tree_, prof_tctx_tree_t, prof_tctx_t, tctx_link,
 	if (ret == 0) {
 		ret = (a_len > b_len) - (a_len < b_len);
 	}
+	if (ret == 0) {
+		unsigned a_arena = a->bt.arena_ind;
+		unsigned b_arena = b->bt.arena_ind;
+		ret = (a_arena > b_arena) - (a_arena < b_arena);
+	}
 	return ret;
 }
 
@@ -139,11 +219,197 @@ prof_tdata_mutex_choose(uint64_t thr_uid) {
 	return &tdata_locks[thr_uid % PROF_NTDATA_LOCKS];
 }
 
+static malloc_mutex_t *
+prof_bt2gctx_mutex_choose(size_t hash) {
+	return &bt2gctx_locks[hash % PROF_BT2GCTX_NSTRIPES];
+}
+
+static prof_bt2gctx_table_t *
+prof_bt2gctx_table_new(tsdn_t *tsdn, unsigned lg_nslots) {
+	size_t size = offsetof(prof_bt2gctx_table_t, slots)
+	    + (ZU(1) << lg_nslots) * sizeof(atomic_p_t);
+	size_t usize = sz_sa2u(size, CACHELINE);
+	if (unlikely(usize == 0 || usize > SC_LARGE_MAXCLASS)) {
+		return NULL;
+	}
+	prof_bt2gctx_table_t *table = (prof_bt2gctx_table_t *)ipallocztm(tsdn,
+	    usize, CACHELINE, true, NULL, true, arena_get(TSDN_NULL, 0, true));
+	if (table == NULL) {
+		return NULL;
+	}
+	table->lg_nslots = lg_nslots;
+	atomic_store_zu(&table->nused, 0, ATOMIC_RELAXED);
+	return table;
+}
+
+/*
+ * Must be called within a read section, or with the stripe lock for hash held;
+ * either keeps the gctx's that the probe passes over from being freed.
+ */
+static prof_gctx_t *
+prof_bt2gctx_search(prof_bt2gctx_table_t *table, prof_bt_t *bt, size_t hash) {
+	size_t mask = (ZU(1) << table->lg_nslots) - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		prof_gctx_t *gctx = (prof_gctx_t *)atomic_load_p(
+		    &table->slots[i], ATOMIC_ACQUIRE);
+		if (gctx == NULL) {
+			return NULL;
+		}
+		if (gctx != PROF_BT2GCTX_TOMBSTONE && gctx->bt_hash == hash
+		    && prof_bt_keycomp(bt, &gctx->bt)) {
+			return gctx;
+		}
+	}
+}
+
+/*
+ * Inserts gctx, whose stripe lock must be held.  Returns true if the table is
+ * too full, in which case it must be rebuilt before retrying.  Writers of the
+ * other stripes may insert concurrently; each checks the load factor before
+ * claiming a slot, so the table never has fewer than
+ * (nslots / 4 - PROF_BT2GCTX_NSTRIPES) empty slots.
+ */
+static bool
+prof_bt2gctx_insert(prof_bt2gctx_table_t *table, prof_gctx_t *gctx) {
+	size_t nslots = ZU(1) << table->lg_nslots;
+	if ((atomic_load_zu(&table->nused, ATOMIC_RELAXED) + 1) * 4
+	    > nslots * 3) {
+		return true;
+	}
+	size_t mask = nslots - 1;
+	for (size_t i = gctx->bt_hash & mask;; i = (i + 1) & mask) {
+		void *cur = atomic_load_p(&table->slots[i], ATOMIC_RELAXED);
+		if ((cur == NULL || cur == PROF_BT2GCTX_TOMBSTONE)
+		    && atomic_compare_exchange_strong_p(&table->slots[i], &cur,
+		        gctx, ATOMIC_RELEASE, ATOMIC_RELAXED)) {
+			if (cur == NULL) {
+				atomic_fetch_add_zu(
+				    &table->nused, 1, ATOMIC_RELAXED);
+			}
+			break;
+		}
+	}
+	atomic_fetch_add_zu(&bt2gctx_nlive, 1, ATOMIC_RELAXED);
+	return false;
+}
+
+/* Removes gctx, whose stripe lock must be held. */
+static void
+prof_bt2gctx_remove(prof_bt2gctx_table_t *table, prof_gctx_t *gctx) {
+	size_t mask = (ZU(1) << table->lg_nslots) - 1;
+	for (size_t i = gctx->bt_hash & mask;; i = (i + 1) & mask) {
+		void *cur = atomic_load_p(&table->slots[i], ATOMIC_RELAXED);
+		assert(cur != NULL);
+		if (cur == gctx) {
+			atomic_store_p(&table->slots[i], PROF_BT2GCTX_TOMBSTONE,
+			    ATOMIC_RELEASE);
+			break;
+		}
+	}
+	atomic_fetch_sub_zu(&bt2gctx_nlive, 1, ATOMIC_RELAXED);
+}
+
+static void
+prof_bt2gctx_lock_all(tsdn_t *tsdn) {
+	for (unsigned i = 0; i < PROF_BT2GCTX_NSTRIPES; i++) {
+		malloc_mutex_lock(tsdn, &bt2gctx_locks[i]);
+	}
+}
+
+static void
+prof_bt2gctx_unlock_all(tsdn_t *tsdn) {
+	for (unsigned i = 0; i < PROF_BT2GCTX_NSTRIPES; i++) {
+		malloc_mutex_unlock(tsdn, &bt2gctx_locks[i]);
+	}
+}
+
+static atomic_zu_t *
+prof_bt2gctx_read_begin(prof_tdata_t *tdata) {
+	prof_bt2gctx_readers_t *readers =
+	    &bt2gctx_readers[tdata->thr_uid % PROF_BT2GCTX_NREADER_SLOTS];
+	while (true) {
+		unsigned     epoch = atomic_load_u(&bt2gctx_epoch, ATOMIC_SEQ_CST);
+		atomic_zu_t *nreaders = &readers->nreaders[epoch & 1];
+		atomic_fetch_add_zu(nreaders, 1, ATOMIC_SEQ_CST);
+		/*
+		 * Recheck, so that a reader counted in an epoch that has since
+		 * been synchronized past does not go on to read.
+		 */
+		if (atomic_load_u(&bt2gctx_epoch, ATOMIC_SEQ_CST) == epoch) {
+			return nreaders;
+		}
+		atomic_fetch_sub_zu(nreaders, 1, ATOMIC_RELEASE);
+	}
+}
+
+static void
+prof_bt2gctx_read_end(atomic_zu_t *nreaders) {
+	atomic_fetch_sub_zu(nreaders, 1, ATOMIC_RELEASE);
+}
+
+/*
+ * Waits until every read section that could have observed bt2gctx before the
+ * call has ended.  The caller must not be in a read section, nor hold a stripe
+ * or gctx lock.
+ */
+static void
+prof_bt2gctx_synchronize(tsdn_t *tsdn) {
+	malloc_mutex_assert_owner(tsdn, &bt2gctx_mtx);
+	unsigned epoch = atomic_fetch_add_u(&bt2gctx_epoch, 1, ATOMIC_SEQ_CST);
+	for (unsigned i = 0; i < PROF_BT2GCTX_NREADER_SLOTS; i++) {
+		spin_t spinner = SPIN_INITIALIZER;
+		while (atomic_load_zu(&bt2gctx_readers[i].nreaders[epoch & 1],
+		           ATOMIC_SEQ_CST)
+		    != 0) {
+			spin_adaptive(&spinner);
+		}
+	}
+}
+
+static void
+prof_gctx_retire(tsdn_t *tsdn, prof_gctx_t *gctx) {
+	prof_gctx_t *to_free = NULL;
+
+	malloc_mutex_lock(tsdn, &bt2gctx_mtx);
+	gctx->retired_next = bt2gctx_retired;
+	bt2gctx_retired = gctx;
+	if (++bt2gctx_nretired == PROF_BT2GCTX_RETIRE_BATCH) {
+		prof_bt2gctx_synchronize(tsdn);
+		to_free = bt2gctx_retired;
+		bt2gctx_retired = NULL;
+		bt2gctx_nretired = 0;
+	}
+	malloc_mutex_unlock(tsdn, &bt2gctx_mtx);
+
+	while (to_free != NULL) {
+		prof_gctx_t *next = to_free->retired_next;
+		idalloctm(tsdn, to_free, NULL, NULL, true, true);
+		to_free = next;
+	}
+}
+
 bool
 prof_data_init(tsd_t *tsd) {
 	tdata_tree_new(&tdatas);
-	return ckh_new(
-	    tsd, &bt2gctx, PROF_CKH_MINITEMS, prof_bt_hash, prof_bt_keycomp);
+	assert((ZU(1) << PROF_BT2GCTX_LG_MINSLOTS) / 4 > PROF_BT2GCTX_NSTRIPES);
+	prof_bt2gctx_table_t *table = prof_bt2gctx_table_new(
+	    tsd_tsdn(tsd), PROF_BT2GCTX_LG_MINSLOTS);
+	if (table == NULL) {
+		return true;
+	}
+	atomic_store_p(&bt2gctx, table, ATOMIC_RELEASE);
+	return false;
+}
+
+void
+prof_data_postfork_child(void) {
+	/* Lookups that were in progress in other threads are gone. */
+	for (unsigned i = 0; i < PROF_BT2GCTX_NREADER_SLOTS; i++) {
+		atomic_store_zu(&bt2gctx_readers[i].nreaders[0], 0,
+		    ATOMIC_RELAXED);
+		atomic_store_zu(&bt2gctx_readers[i].nreaders[1], 0,
+		    ATOMIC_RELAXED);
+	}
 }
 
 static void
@@ -186,11 +452,17 @@ prof_leave(tsd_t *tsd, prof_tdata_t *tdata) {
 }
 
 static prof_gctx_t *
-prof_gctx_create(tsdn_t *tsdn, prof_bt_t *bt) {
+prof_gctx_create(tsdn_t *tsdn, prof_bt_t *bt, size_t hash) {
 	/*
-	 * Create a single allocation that has space for vec of length bt->len.
+	 * Create a single allocation that has space for vec of length bt->len,
+	 * followed by the lifetime histogram if enabled.
 	 */
 	size_t size = offsetof(prof_gctx_t, vec) + (bt->len * sizeof(void *));
+	size_t lifetimes_offset = ALIGNMENT_CEILING(size, sizeof(uint64_t));
+	if (opt_prof_lifetime) {
+		size = lifetimes_offset
+		    + PROF_LIFETIME_NBUCKETS * sizeof(uint64_t);
+	}
 	prof_gctx_t *gctx = (prof_gctx_t *)iallocztm(tsdn, size,
 	    sz_size2index(size), false, NULL, true,
 	    arena_get(TSDN_NULL, 0, true), true);
@@ -204,15 +476,35 @@ prof_gctx_create(tsdn_t *tsdn, prof_bt_t *bt) {
 	 */
 	gctx->nlimbo = 1;
 	tctx_tree_new(&gctx->tctxs);
+	gctx->unlinked = false;
+	gctx->retired_next = NULL;
+	gctx->bt_hash = hash;
+	if (opt_prof_lifetime) {
+		gctx->lifetimes = (uint64_t *)((uintptr_t)gctx
+		    + lifetimes_offset);
+		memset(gctx->lifetimes, 0,
+		    PROF_LIFETIME_NBUCKETS * sizeof(uint64_t));
+	} else {
+		gctx->lifetimes = NULL;
+	}
+	/* Its first sampled object marks it as changed. */
+	atomic_store_b(&gctx->delta_dirty, false, ATOMIC_RELAXED);
+	gctx->delta_next = NULL;
+	gctx->delta_reported = false;
+	gctx->dump_epoch = 0;
+	gctx->leak_nepochs = 0;
+	gctx->leak_bytes = 0;
+	gctx->leak_base_bytes = 0;
 	/* Duplicate bt. */
 	memcpy(gctx->vec, bt->vec, bt->len * sizeof(void *));
 	gctx->bt.vec = gctx->vec;
 	gctx->bt.len = bt->len;
+	gctx->bt.arena_ind = bt->arena_ind;
 	return gctx;
 }
 
 static void
-prof_gctx_try_destroy(tsd_t *tsd, prof_tdata_t *tdata_self, prof_gctx_t *gctx) {
+prof_gctx_try_destroy(tsd_t *tsd, prof_gctx_t *gctx) {
 	cassert(config_prof);
 
 	/*
@@ -222,18 +514,23 @@ prof_gctx_try_destroy(tsd_t *tsd, prof_tdata_t *tdata_self, prof_gctx_t *gctx) {
 	 * avoid a race between the main body of prof_tctx_destroy() and entry
 	 * into this function.
 	 */
-	prof_enter(tsd, tdata_self);
+	malloc_mutex_t *stripe = prof_bt2gctx_mutex_choose(gctx->bt_hash);
+	malloc_mutex_lock(tsd_tsdn(tsd), stripe);
 	malloc_mutex_lock(tsd_tsdn(tsd), gctx->lock);
 	assert(gctx->nlimbo != 0);
-	if (tctx_tree_empty(&gctx->tctxs) && gctx->nlimbo == 1) {
+	if (tctx_tree_empty(&gctx->tctxs) && gctx->nlimbo == 1
+	    && !gctx->delta_reported
+	    && !atomic_load_b(&gctx->delta_dirty, ATOMIC_ACQUIRE)) {
 		/* Remove gctx from bt2gctx. */
-		if (ckh_remove(tsd, &bt2gctx, &gctx->bt, NULL, NULL)) {
-			not_reached();
-		}
-		prof_leave(tsd, tdata_self);
-		/* Destroy gctx. */
+		prof_bt2gctx_remove(
+		    (prof_bt2gctx_table_t *)atomic_load_p(
+			&bt2gctx, ATOMIC_ACQUIRE),
+		    gctx);
+		gctx->unlinked = true;
 		malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
-		idalloctm(tsd_tsdn(tsd), gctx, NULL, NULL, true, true);
+		malloc_mutex_unlock(tsd_tsdn(tsd), stripe);
+		/* Destroy gctx once no lookup can be looking at it. */
+		prof_gctx_retire(tsd_tsdn(tsd), gctx);
 	} else {
 		/*
 		 * Compensate for increment in prof_tctx_destroy() or
@@ -241,13 +538,14 @@ prof_gctx_try_destroy(tsd_t *tsd, prof_tdata_t *tdata_self, prof_gctx_t *gctx) {
 		 */
 		gctx->nlimbo--;
 		malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
-		prof_leave(tsd, tdata_self);
+		malloc_mutex_unlock(tsd_tsdn(tsd), stripe);
 	}
 }
 
 static bool
 prof_gctx_should_destroy(prof_gctx_t *gctx) {
-	if (opt_prof_accum) {
+	/* Like the accumulated counters, lifetime histograms are kept. */
+	if (opt_prof_accum || opt_prof_lifetime) {
 		return false;
 	}
 	if (!tctx_tree_empty(&gctx->tctxs)) {
@@ -256,70 +554,163 @@ prof_gctx_should_destroy(prof_gctx_t *gctx) {
 	if (gctx->nlimbo != 0) {
 		return false;
 	}
+	/*
+	 * Keep it until a delta dump has reported that it is gone, and while
+	 * it is on the list of changed contexts.
+	 */
+	if (gctx->delta_reported
+	    || atomic_load_b(&gctx->delta_dirty, ATOMIC_ACQUIRE)) {
+		return false;
+	}
 	return true;
 }
 
+void
+prof_gctx_lifetime_record(
+    tsdn_t *tsdn, prof_gctx_t *gctx, const nstime_t *alloc_time) {
+	assert(opt_prof_lifetime);
+	nstime_t now;
+	nstime_prof_init_update(&now);
+	/* The clock may have gone backwards. */
+	uint64_t ns = (nstime_compare(&now, alloc_time) > 0)
+	    ? nstime_ns(&now) - nstime_ns(alloc_time)
+	    : 0;
+	unsigned bucket = prof_lifetime_bucket(ns);
+
+	malloc_mutex_lock(tsdn, gctx->lock);
+	gctx->lifetimes[bucket]++;
+	malloc_mutex_unlock(tsdn, gctx->lock);
+}
+
+/*
+ * Replaces bt2gctx with a table sized for the live gctx's, which also drops the
+ * tombstones.  Returns true on OOM.
+ */
 static bool
-prof_lookup_global(tsd_t *tsd, prof_bt_t *bt, prof_tdata_t *tdata,
-    void **p_btkey, prof_gctx_t **p_gctx, bool *p_new_gctx) {
-	union {
-		prof_gctx_t *p;
-		void        *v;
-	} gctx, tgctx;
-	union {
-		prof_bt_t *p;
-		void      *v;
-	} btkey;
-	bool new_gctx;
+prof_bt2gctx_rebuild(tsd_t *tsd, prof_tdata_t *tdata) {
+	tsdn_t *tsdn = tsd_tsdn(tsd);
 
 	prof_enter(tsd, tdata);
-	if (ckh_search(&bt2gctx, bt, &btkey.v, &gctx.v)) {
-		/* bt has never been seen before.  Insert it. */
-		prof_leave(tsd, tdata);
-		tgctx.p = prof_gctx_create(tsd_tsdn(tsd), bt);
-		if (tgctx.v == NULL) {
+	prof_bt2gctx_lock_all(tsdn);
+	prof_bt2gctx_table_t *old = (prof_bt2gctx_table_t *)atomic_load_p(
+	    &bt2gctx, ATOMIC_RELAXED);
+	size_t                nslots = ZU(1) << old->lg_nslots;
+	prof_bt2gctx_table_t *table = NULL;
+	/* Another thread may have rebuilt it in the meantime. */
+	if ((atomic_load_zu(&old->nused, ATOMIC_RELAXED) + 1) * 4 > nslots * 3) {
+		size_t   nlive = atomic_load_zu(&bt2gctx_nlive, ATOMIC_RELAXED);
+		unsigned lg_nslots = PROF_BT2GCTX_LG_MINSLOTS;
+		while ((ZU(1) << lg_nslots) < (nlive + 1) * 4) {
+			lg_nslots++;
+		}
+		table = prof_bt2gctx_table_new(tsdn, lg_nslots);
+		if (table == NULL) {
+			prof_bt2gctx_unlock_all(tsdn);
+			prof_leave(tsd, tdata);
 			return true;
 		}
-		prof_enter(tsd, tdata);
-		if (ckh_search(&bt2gctx, bt, &btkey.v, &gctx.v)) {
-			gctx.p = tgctx.p;
-			btkey.p = &gctx.p->bt;
-			if (ckh_insert(tsd, &bt2gctx, btkey.v, gctx.v)) {
-				/* OOM. */
-				prof_leave(tsd, tdata);
-				idalloctm(tsd_tsdn(tsd), gctx.v, NULL, NULL,
-				    true, true);
-				return true;
+		size_t mask = (ZU(1) << lg_nslots) - 1;
+		for (size_t i = 0; i < nslots; i++) {
+			prof_gctx_t *gctx = (prof_gctx_t *)atomic_load_p(
+			    &old->slots[i], ATOMIC_RELAXED);
+			if (gctx == NULL || gctx == PROF_BT2GCTX_TOMBSTONE) {
+				continue;
 			}
-			new_gctx = true;
-		} else {
-			new_gctx = false;
+			size_t j = gctx->bt_hash & mask;
+			while (atomic_load_p(&table->slots[j], ATOMIC_RELAXED)
+			    != NULL) {
+				j = (j + 1) & mask;
+			}
+			atomic_store_p(&table->slots[j], gctx, ATOMIC_RELAXED);
 		}
-	} else {
-		tgctx.v = NULL;
-		new_gctx = false;
+		atomic_store_zu(&table->nused, nlive, ATOMIC_RELAXED);
+		atomic_store_p(&bt2gctx, table, ATOMIC_RELEASE);
+	}
+	prof_bt2gctx_unlock_all(tsdn);
+	if (table != NULL) {
+		/* Lookups may still be probing the old table. */
+		prof_bt2gctx_synchronize(tsdn);
+		idalloctm(tsdn, old, NULL, NULL, true, true);
 	}
+	prof_leave(tsd, tdata);
+	return false;
+}
 
-	if (!new_gctx) {
+static bool
+prof_lookup_global(tsd_t *tsd, prof_bt_t *bt, prof_tdata_t *tdata,
+    void **p_btkey, prof_gctx_t **p_gctx, bool *p_new_gctx) {
+	tsdn_t      *tsdn = tsd_tsdn(tsd);
+	prof_gctx_t *gctx, *tgctx;
+	bool         new_gctx = false;
+	size_t       hash[2];
+
+	prof_bt_hash(bt, hash);
+
+	atomic_zu_t *nreaders = prof_bt2gctx_read_begin(tdata);
+	gctx = prof_bt2gctx_search(
+	    (prof_bt2gctx_table_t *)atomic_load_p(&bt2gctx, ATOMIC_ACQUIRE), bt,
+	    hash[0]);
+	if (gctx != NULL) {
 		/*
 		 * Increment nlimbo, in order to avoid a race condition with
-		 * prof_tctx_destroy()/prof_gctx_try_destroy().
+		 * prof_tctx_destroy()/prof_gctx_try_destroy().  A gctx that has
+		 * been removed in the meantime only stays valid until the end
+		 * of the read section; skip it.
 		 */
-		malloc_mutex_lock(tsd_tsdn(tsd), gctx.p->lock);
-		gctx.p->nlimbo++;
-		malloc_mutex_unlock(tsd_tsdn(tsd), gctx.p->lock);
-		new_gctx = false;
-
-		if (tgctx.v != NULL) {
-			/* Lost race to insert. */
-			idalloctm(
-			    tsd_tsdn(tsd), tgctx.v, NULL, NULL, true, true);
+		malloc_mutex_lock(tsdn, gctx->lock);
+		if (gctx->unlinked) {
+			malloc_mutex_unlock(tsdn, gctx->lock);
+			gctx = NULL;
+		} else {
+			gctx->nlimbo++;
+			malloc_mutex_unlock(tsdn, gctx->lock);
 		}
 	}
-	prof_leave(tsd, tdata);
+	prof_bt2gctx_read_end(nreaders);
+
+	tgctx = NULL;
+	while (gctx == NULL) {
+		/* bt has never been seen before.  Insert it. */
+		if (tgctx == NULL) {
+			tgctx = prof_gctx_create(tsdn, bt, hash[0]);
+			if (tgctx == NULL) {
+				return true;
+			}
+		}
+		malloc_mutex_t *stripe = prof_bt2gctx_mutex_choose(hash[0]);
+		nreaders = prof_bt2gctx_read_begin(tdata);
+		malloc_mutex_lock(tsdn, stripe);
+		prof_bt2gctx_table_t *table = (prof_bt2gctx_table_t *)
+		    atomic_load_p(&bt2gctx, ATOMIC_ACQUIRE);
+		bool full = false;
+		gctx = prof_bt2gctx_search(table, bt, hash[0]);
+		if (gctx != NULL) {
+			/* Lost race to insert; gctx can't be removed yet. */
+			malloc_mutex_lock(tsdn, gctx->lock);
+			assert(!gctx->unlinked);
+			gctx->nlimbo++;
+			malloc_mutex_unlock(tsdn, gctx->lock);
+		} else if (!(full = prof_bt2gctx_insert(table, tgctx))) {
+			gctx = tgctx;
+			tgctx = NULL;
+			new_gctx = true;
+		}
+		malloc_mutex_unlock(tsdn, stripe);
+		prof_bt2gctx_read_end(nreaders);
+
+		if (full && prof_bt2gctx_rebuild(tsd, tdata)) {
+			/* OOM. */
+			idalloctm(tsdn, tgctx, NULL, NULL, true, true);
+			return true;
+		}
+	}
+	if (tgctx != NULL) {
+		/* Lost race to insert. */
+		idalloctm(tsdn, tgctx, NULL, NULL, true, true);
+	}
 
-	*p_btkey = btkey.v;
-	*p_gctx = gctx.p;
+	*p_btkey = (void *)&gctx->bt;
+	*p_gctx = gctx;
 	*p_new_gctx = new_gctx;
 	return false;
 }
@@ -364,7 +755,7 @@ prof_lookup(tsd_t *tsd, prof_bt_t *bt) {
 		    arena_ichoose(tsd, NULL), true);
 		if (ret.p == NULL) {
 			if (new_gctx) {
-				prof_gctx_try_destroy(tsd, tdata, gctx);
+				prof_gctx_try_destroy(tsd, gctx);
 			}
 			return NULL;
 		}
@@ -382,7 +773,7 @@ prof_lookup(tsd_t *tsd, prof_bt_t *bt) {
 		malloc_mutex_unlock(tsd_tsdn(tsd), tdata->lock);
 		if (error) {
 			if (new_gctx) {
-				prof_gctx_try_destroy(tsd, tdata, gctx);
+				prof_gctx_try_destroy(tsd, gctx);
 			}
 			idalloctm(tsd_tsdn(tsd), ret.v, NULL, NULL, true, true);
 			return NULL;
@@ -436,13 +827,88 @@ prof_bt_count(void) {
 		return 0;
 	}
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &bt2gctx_mtx);
-	bt_count = ckh_count(&bt2gctx);
-	malloc_mutex_unlock(tsd_tsdn(tsd), &bt2gctx_mtx);
+	bt_count = atomic_load_zu(&bt2gctx_nlive, ATOMIC_RELAXED);
 
 	return bt_count;
 }
 
+/*
+ * Used in unit tests.  Looks bt up the way prof_lookup() does; the gctx
+ * returned is not kept alive, so it may only be compared against.
+ */
+prof_gctx_t *
+prof_bt2gctx_lookup(tsd_t *tsd, prof_bt_t *bt) {
+	prof_tdata_t *tdata = prof_tdata_get(tsd, true);
+	if (tdata == NULL) {
+		return NULL;
+	}
+	size_t hash[2];
+	prof_bt_hash(bt, hash);
+
+	atomic_zu_t *nreaders = prof_bt2gctx_read_begin(tdata);
+	prof_gctx_t *gctx = prof_bt2gctx_search(
+	    (prof_bt2gctx_table_t *)atomic_load_p(&bt2gctx, ATOMIC_ACQUIRE), bt,
+	    hash[0]);
+	prof_bt2gctx_read_end(nreaders);
+
+	return gctx;
+}
+
+/*
+ * Used in unit tests.  With all writers locked out, checks that every gctx in
+ * bt2gctx can be found by its backtrace and has not been removed, that the
+ * counts match the slots, and that no gctx awaiting deallocation can be found.
+ * Returns true on inconsistency.
+ */
+bool
+prof_bt2gctx_validate(tsd_t *tsd, size_t *r_nslots, size_t *r_nused) {
+	tsdn_t *tsdn = tsd_tsdn(tsd);
+	bool    err = false;
+
+	malloc_mutex_lock(tsdn, &bt2gctx_mtx);
+	prof_bt2gctx_lock_all(tsdn);
+	prof_bt2gctx_table_t *table = (prof_bt2gctx_table_t *)atomic_load_p(
+	    &bt2gctx, ATOMIC_RELAXED);
+	size_t nslots = ZU(1) << table->lg_nslots;
+	size_t nused = 0;
+	size_t nlive = 0;
+	for (size_t i = 0; i < nslots; i++) {
+		prof_gctx_t *gctx = (prof_gctx_t *)atomic_load_p(
+		    &table->slots[i], ATOMIC_RELAXED);
+		if (gctx == NULL) {
+			continue;
+		}
+		nused++;
+		if (gctx == PROF_BT2GCTX_TOMBSTONE) {
+			continue;
+		}
+		nlive++;
+		if (gctx->unlinked
+		    || prof_bt2gctx_search(table, &gctx->bt, gctx->bt_hash)
+		        != gctx) {
+			err = true;
+		}
+	}
+	if (nused != atomic_load_zu(&table->nused, ATOMIC_RELAXED)
+	    || nlive != atomic_load_zu(&bt2gctx_nlive, ATOMIC_RELAXED)) {
+		err = true;
+	}
+	for (prof_gctx_t *gctx = bt2gctx_retired; gctx != NULL;
+	    gctx = gctx->retired_next) {
+		if (!gctx->unlinked
+		    || prof_bt2gctx_search(table, &gctx->bt, gctx->bt_hash)
+		        == gctx) {
+			err = true;
+		}
+	}
+	prof_bt2gctx_unlock_all(tsdn);
+	malloc_mutex_unlock(tsdn, &bt2gctx_mtx);
+
+	*r_nslots = nslots;
+	*r_nused = nused;
+	return err;
+}
+
 static void
 prof_thread_name_write_tdata(prof_tdata_t *tdata, const char *thread_name) {
 	strncpy(tdata->thread_name, thread_name, PROF_THREAD_NAME_MAX_LEN);
@@ -617,27 +1083,30 @@ prof_do_unbias(uint64_t c_out_shifted_i, uint64_t s_out_i, uint64_t *r_c_in,
 #endif
 }
 
+/* Counts as written to dumps: curobjs, curbytes, accumobjs, accumbytes. */
 static void
-prof_dump_print_cnts(
-    write_cb_t *prof_dump_write, void *cbopaque, const prof_cnt_t *cnts) {
-	uint64_t curobjs;
-	uint64_t curbytes;
-	uint64_t accumobjs;
-	uint64_t accumbytes;
+prof_dump_cnts_get(const prof_cnt_t *cnts, uint64_t r_cnts[4]) {
 	if (opt_prof_unbias) {
 		prof_do_unbias(cnts->curobjs_shifted_unbiased,
-		    cnts->curbytes_unbiased, &curobjs, &curbytes);
+		    cnts->curbytes_unbiased, &r_cnts[0], &r_cnts[1]);
 		prof_do_unbias(cnts->accumobjs_shifted_unbiased,
-		    cnts->accumbytes_unbiased, &accumobjs, &accumbytes);
+		    cnts->accumbytes_unbiased, &r_cnts[2], &r_cnts[3]);
 	} else {
-		curobjs = cnts->curobjs;
-		curbytes = cnts->curbytes;
-		accumobjs = cnts->accumobjs;
-		accumbytes = cnts->accumbytes;
+		r_cnts[0] = cnts->curobjs;
+		r_cnts[1] = cnts->curbytes;
+		r_cnts[2] = cnts->accumobjs;
+		r_cnts[3] = cnts->accumbytes;
 	}
+}
+
+static void
+prof_dump_print_cnts(
+    write_cb_t *prof_dump_write, void *cbopaque, const prof_cnt_t *cnts) {
+	uint64_t dump_cnts[4];
+	prof_dump_cnts_get(cnts, dump_cnts);
 	prof_dump_printf(prof_dump_write, cbopaque,
-	    "%" FMTu64 ": %" FMTu64 " [%" FMTu64 ": %" FMTu64 "]", curobjs,
-	    curbytes, accumobjs, accumbytes);
+	    "%" FMTu64 ": %" FMTu64 " [%" FMTu64 ": %" FMTu64 "]", dump_cnts[0],
+	    dump_cnts[1], dump_cnts[2], dump_cnts[3]);
 }
 
 static void
@@ -725,6 +1194,7 @@ struct prof_dump_iter_arg_s {
 	tsdn_t     *tsdn;
 	write_cb_t *prof_dump_write;
 	void       *cbopaque;
+	bool        delta;
 };
 
 static prof_tctx_t *
@@ -783,6 +1253,7 @@ prof_dump_gctx_prep(tsdn_t *tsdn, prof_gctx_t *gctx, prof_gctx_tree_t *gctxs) {
 	cassert(config_prof);
 
 	malloc_mutex_lock(tsdn, gctx->lock);
+	gctx->dump_epoch = prof_dump_epoch;
 
 	/*
 	 * Increment nlimbo so that gctx won't go away before dump.
@@ -820,8 +1291,7 @@ prof_gctx_merge_iter(prof_gctx_tree_t *gctxs, prof_gctx_t *gctx, void *opaque) {
 
 static void
 prof_gctx_finish(tsd_t *tsd, prof_gctx_tree_t *gctxs) {
-	prof_tdata_t *tdata = prof_tdata_get(tsd, false);
-	prof_gctx_t  *gctx;
+	prof_gctx_t *gctx;
 
 	/*
 	 * Standard tree iteration won't work here, because as soon as we
@@ -856,7 +1326,7 @@ prof_gctx_finish(tsd_t *tsd, prof_gctx_tree_t *gctxs) {
 		if (prof_gctx_should_destroy(gctx)) {
 			gctx->nlimbo++;
 			malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
-			prof_gctx_try_destroy(tsd, tdata, gctx);
+			prof_gctx_try_destroy(tsd, gctx);
 		} else {
 			malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
 		}
@@ -887,6 +1357,10 @@ prof_tdata_merge_iter(
 		memset(&tdata->cnt_summed, 0, sizeof(prof_cnt_t));
 		for (tabind = 0;
 		     !ckh_iter(&tdata->bt2tctx, &tabind, NULL, &tctx.v);) {
+			/* Skip contexts left out of a delta dump. */
+			if (tctx.p->gctx->dump_epoch != prof_dump_epoch) {
+				continue;
+			}
 			prof_tctx_merge_tdata(arg->tsdn, tctx.p, tdata);
 		}
 
@@ -933,6 +1407,54 @@ prof_tdata_dump_iter(
 	return NULL;
 }
 
+void
+prof_gctx_delta_dirty_push(prof_gctx_t *gctx) {
+	prof_gctx_t *head = (prof_gctx_t *)atomic_load_p(
+	    &prof_gctx_delta_list, ATOMIC_RELAXED);
+	do {
+		gctx->delta_next = head;
+	} while (!atomic_compare_exchange_weak_p(&prof_gctx_delta_list,
+	    (void **)&head, gctx, ATOMIC_RELEASE, ATOMIC_RELAXED));
+}
+
+/*
+ * A delta dump that was not written out completely has still consumed the
+ * changes it covered; make the next one a complete snapshot instead.
+ */
+void
+prof_dump_delta_failed(tsdn_t *tsdn) {
+	malloc_mutex_assert_owner(tsdn, &prof_dump_mtx);
+	prof_dump_delta_full = true;
+}
+
+/*
+ * Formats the command line that starts a delta dump, and advances the delta
+ * sequence.  Returns the length written to buf, which is 0 for full dumps.
+ */
+static size_t
+prof_dump_delta_header(tsdn_t *tsdn, bool delta, char *buf, size_t len) {
+	malloc_mutex_assert_owner(tsdn, &prof_dump_mtx);
+	if (!delta) {
+		return 0;
+	}
+	size_t ret = malloc_snprintf(buf, len, "%%delta %" FMTu64 "%s\n",
+	    prof_dump_delta_seq, prof_dump_delta_full ? " full" : "");
+	prof_dump_delta_seq++;
+	prof_dump_delta_full = false;
+	return ret;
+}
+
+/*
+ * Whether a delta dump that included gctx has to report it, even if empty,
+ * and records that it did.
+ */
+static bool
+prof_dump_gctx_delta_report(prof_gctx_t *gctx, bool empty) {
+	bool ret = !empty || gctx->delta_reported;
+	gctx->delta_reported = !empty;
+	return ret;
+}
+
 static void
 prof_dump_header(prof_dump_iter_arg_t *arg, const prof_cnt_t *cnt_all) {
 	prof_dump_printf(arg->prof_dump_write, arg->cbopaque,
@@ -945,13 +1467,29 @@ prof_dump_header(prof_dump_iter_arg_t *arg, const prof_cnt_t *cnt_all) {
 	malloc_mutex_unlock(arg->tsdn, &tdatas_mtx);
 }
 
-static void
-prof_dump_gctx(prof_dump_iter_arg_t *arg, prof_gctx_t *gctx,
-    const prof_bt_t *bt, prof_gctx_tree_t *gctxs) {
-	cassert(config_prof);
-	malloc_mutex_assert_owner(arg->tsdn, gctx->lock);
+/*
+ * Returns the number of lifetime histogram buckets of gctx up to the last
+ * nonzero one.
+ */
+static unsigned
+prof_dump_lifetimes_len(const prof_gctx_t *gctx) {
+	unsigned len = 0;
+	if (gctx->lifetimes != NULL) {
+		for (unsigned i = 0; i < PROF_LIFETIME_NBUCKETS; i++) {
+			if (gctx->lifetimes[i] != 0) {
+				len = i + 1;
+			}
+		}
+	}
+	return len;
+}
 
-	/* Avoid dumping such gctx's that have no useful data. */
+/* Whether the gctx has no useful data, and is left out of dumps. */
+static bool
+prof_dump_gctx_empty(const prof_gctx_t *gctx) {
+	if (prof_dump_lifetimes_len(gctx) != 0) {
+		return false;
+	}
 	if ((!opt_prof_accum && gctx->cnt_summed.curobjs == 0)
 	    || (opt_prof_accum && gctx->cnt_summed.accumobjs == 0)) {
 		assert(gctx->cnt_summed.curobjs == 0);
@@ -966,6 +1504,23 @@ prof_dump_gctx(prof_dump_iter_arg_t *arg, prof_gctx_t *gctx,
 		assert(gctx->cnt_summed.accumobjs_shifted_unbiased == 0);
 		assert(gctx->cnt_summed.accumbytes == 0);
 		assert(gctx->cnt_summed.accumbytes_unbiased == 0);
+		return true;
+	}
+	return false;
+}
+
+static void
+prof_dump_gctx(prof_dump_iter_arg_t *arg, prof_gctx_t *gctx,
+    const prof_bt_t *bt, prof_gctx_tree_t *gctxs) {
+	cassert(config_prof);
+	malloc_mutex_assert_owner(arg->tsdn, gctx->lock);
+
+	/*
+	 * Avoid dumping such gctx's that have no useful data, unless a delta
+	 * dump has to report that the data went away.
+	 */
+	bool empty = prof_dump_gctx_empty(gctx);
+	if (arg->delta ? !prof_dump_gctx_delta_report(gctx, empty) : empty) {
 		return;
 	}
 
@@ -980,6 +1535,24 @@ prof_dump_gctx(prof_dump_iter_arg_t *arg, prof_gctx_t *gctx,
 	    arg->prof_dump_write, arg->cbopaque, &gctx->cnt_summed);
 	arg->prof_dump_write(arg->cbopaque, "\n");
 
+	if (opt_prof_per_arena) {
+		prof_dump_printf(arg->prof_dump_write, arg->cbopaque,
+		    "  a%u: ", bt->arena_ind);
+		prof_dump_print_cnts(
+		    arg->prof_dump_write, arg->cbopaque, &gctx->cnt_summed);
+		arg->prof_dump_write(arg->cbopaque, "\n");
+	}
+
+	unsigned lifetimes_len = prof_dump_lifetimes_len(gctx);
+	if (lifetimes_len != 0) {
+		arg->prof_dump_write(arg->cbopaque, "  lifetimes:");
+		for (unsigned i = 0; i < lifetimes_len; i++) {
+			prof_dump_printf(arg->prof_dump_write, arg->cbopaque,
+			    " %" FMTu64, gctx->lifetimes[i]);
+		}
+		arg->prof_dump_write(arg->cbopaque, "\n");
+	}
+
 	tctx_tree_iter(&gctx->tctxs, NULL, prof_tctx_dump_iter, arg);
 }
 
@@ -1038,24 +1611,55 @@ prof_gctx_dump_iter(prof_gctx_tree_t *gctxs, prof_gctx_t *gctx, void *opaque) {
 	return NULL;
 }
 
+/*
+ * Gathers the gctx's to dump into gctxs, and sums their counters.  A delta dump
+ * (unless it has to be a complete snapshot) only gathers the gctx's on the list
+ * of those that changed since the previous delta dump, and leaves the tctx's of
+ * the others alone.
+ */
 static void
 prof_dump_prep(tsd_t *tsd, prof_tdata_t *tdata, prof_cnt_t *cnt_all,
-    size_t *leak_ngctx, prof_gctx_tree_t *gctxs) {
-	size_t tabind;
-	union {
-		prof_gctx_t *p;
-		void        *v;
-	} gctx;
-
+    size_t *leak_ngctx, prof_gctx_tree_t *gctxs, bool delta) {
 	prof_enter(tsd, tdata);
+	/* Keep bt2gctx from changing until all tctx's have been merged. */
+	prof_bt2gctx_lock_all(tsd_tsdn(tsd));
+	prof_dump_epoch++;
 
 	/*
 	 * Put gctx's in limbo and clear their counters in preparation for
 	 * summing.
 	 */
 	gctx_tree_new(gctxs);
-	for (tabind = 0; !ckh_iter(&bt2gctx, &tabind, NULL, &gctx.v);) {
-		prof_dump_gctx_prep(tsd_tsdn(tsd), gctx.p, gctxs);
+	if (delta) {
+		/*
+		 * Changes made from here on are either merged below, or push
+		 * their gctx for the next delta dump; the tdata locks order
+		 * the flag against the counters.
+		 */
+		atomic_store_b(&prof_dump_delta_tracking, true, ATOMIC_RELAXED);
+		prof_gctx_t *gctx = (prof_gctx_t *)atomic_exchange_p(
+		    &prof_gctx_delta_list, NULL, ATOMIC_ACQUIRE);
+		while (gctx != NULL) {
+			prof_gctx_t *next = gctx->delta_next;
+			atomic_store_b(
+			    &gctx->delta_dirty, false, ATOMIC_RELEASE);
+			if (!prof_dump_delta_full) {
+				prof_dump_gctx_prep(tsd_tsdn(tsd), gctx, gctxs);
+			}
+			gctx = next;
+		}
+	}
+	if (!delta || prof_dump_delta_full) {
+		prof_bt2gctx_table_t *table = (prof_bt2gctx_table_t *)
+		    atomic_load_p(&bt2gctx, ATOMIC_RELAXED);
+		for (size_t i = 0; i < (ZU(1) << table->lg_nslots); i++) {
+			prof_gctx_t *gctx = (prof_gctx_t *)atomic_load_p(
+			    &table->slots[i], ATOMIC_RELAXED);
+			if (gctx == NULL || gctx == PROF_BT2GCTX_TOMBSTONE) {
+				continue;
+			}
+			prof_dump_gctx_prep(tsd_tsdn(tsd), gctx, gctxs);
+		}
 	}
 
 	/*
@@ -1077,19 +1681,25 @@ prof_dump_prep(tsd_t *tsd, prof_tdata_t *tdata, prof_cnt_t *cnt_all,
 	gctx_tree_iter(
 	    gctxs, NULL, prof_gctx_merge_iter, &prof_gctx_merge_iter_arg);
 
+	prof_bt2gctx_unlock_all(tsd_tsdn(tsd));
 	prof_leave(tsd, tdata);
 }
 
 void
 prof_dump_impl(tsd_t *tsd, write_cb_t *prof_dump_write, void *cbopaque,
-    prof_tdata_t *tdata, bool leakcheck) {
+    prof_tdata_t *tdata, bool leakcheck, bool delta) {
 	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_dump_mtx);
 	prof_cnt_t       cnt_all;
 	size_t           leak_ngctx;
 	prof_gctx_tree_t gctxs;
-	prof_dump_prep(tsd, tdata, &cnt_all, &leak_ngctx, &gctxs);
+	prof_dump_prep(tsd, tdata, &cnt_all, &leak_ngctx, &gctxs, delta);
+	char delta_header[PROF_PRINTF_BUFSIZE];
+	if (prof_dump_delta_header(tsd_tsdn(tsd), delta, delta_header,
+	        sizeof(delta_header)) != 0) {
+		prof_dump_write(cbopaque, delta_header);
+	}
 	prof_dump_iter_arg_t prof_dump_iter_arg = {
-	    tsd_tsdn(tsd), prof_dump_write, cbopaque};
+	    tsd_tsdn(tsd), prof_dump_write, cbopaque, delta};
 	prof_dump_header(&prof_dump_iter_arg, &cnt_all);
 	gctx_tree_iter(&gctxs, NULL, prof_gctx_dump_iter, &prof_dump_iter_arg);
 	prof_gctx_finish(tsd, &gctxs);
@@ -1098,6 +1708,308 @@ prof_dump_impl(tsd_t *tsd, write_cb_t *prof_dump_write, void *cbopaque,
 	}
 }
 
+/*
+ * The binary ("heap_v2b") dump format.  Records are buffered in
+ * prof_dump_bin_t, which hands them to the writer in chunks.
+ */
+#define PROF_DUMP_BIN_TOTAL 'T'
+#define PROF_DUMP_BIN_STACK 'S'
+#define PROF_DUMP_BIN_LIFETIMES 'L'
+#define PROF_DUMP_BIN_ARENA 'A'
+
+/*
+ * Lifetime histograms copied out along with a batch of counters; too large for
+ * the stack.  Protected by prof_dump_mtx.
+ */
+static uint64_t prof_dump_bin_lifetimes[PROF_DUMP_BATCH]
+                                       [PROF_LIFETIME_NBUCKETS];
+
+typedef struct prof_dump_bin_s prof_dump_bin_t;
+struct prof_dump_bin_s {
+	prof_dump_bin_write_t *prof_dump_write;
+	void                  *cbopaque;
+	/*
+	 * Maps frame addresses already written to their frame ids; frames are
+	 * written again (under a new id) if it couldn't be allocated.
+	 */
+	ckh_t    frames;
+	bool     frames_init;
+	uint64_t nframes;
+	size_t   len;
+	uint8_t  buf[256];
+};
+
+static void
+prof_dump_bin_flush(prof_dump_bin_t *bin) {
+	if (bin->len != 0) {
+		bin->prof_dump_write(bin->cbopaque, bin->buf, bin->len);
+		bin->len = 0;
+	}
+}
+
+static void
+prof_dump_bin_tag(prof_dump_bin_t *bin, char tag) {
+	if (bin->len == sizeof(bin->buf)) {
+		prof_dump_bin_flush(bin);
+	}
+	bin->buf[bin->len++] = (uint8_t)tag;
+}
+
+/* Big-endian base 128, as read by Perl's unpack("w"). */
+static void
+prof_dump_bin_uint(prof_dump_bin_t *bin, uint64_t v) {
+	uint8_t  tmp[10];
+	unsigned n = 0;
+	do {
+		tmp[n++] = (uint8_t)(v & 0x7f);
+		v >>= 7;
+	} while (v != 0);
+	if (bin->len + n > sizeof(bin->buf)) {
+		prof_dump_bin_flush(bin);
+	}
+	while (n > 1) {
+		bin->buf[bin->len++] = tmp[--n] | 0x80;
+	}
+	bin->buf[bin->len++] = tmp[0];
+}
+
+static void
+prof_dump_bin_cnts(prof_dump_bin_t *bin, const prof_cnt_t *cnts) {
+	uint64_t dump_cnts[4];
+	prof_dump_cnts_get(cnts, dump_cnts);
+	for (unsigned i = 0; i < 4; i++) {
+		prof_dump_bin_uint(bin, dump_cnts[i]);
+	}
+}
+
+/*
+ * A frame seen before is written as its id + 1; a new one as 0 followed by its
+ * address, and takes the next id.
+ */
+static void
+prof_dump_bin_frame(tsd_t *tsd, prof_dump_bin_t *bin, void *frame) {
+	void *id;
+	if (bin->frames_init && !ckh_search(&bin->frames, frame, NULL, &id)) {
+		prof_dump_bin_uint(bin, (uint64_t)(uintptr_t)id + 1);
+		return;
+	}
+	prof_dump_bin_uint(bin, 0);
+	prof_dump_bin_uint(bin, (uint64_t)(uintptr_t)frame);
+	uint64_t frame_id = bin->nframes++;
+	if (bin->frames_init) {
+		/* On failure the frame is just written out again next time. */
+		ckh_insert(tsd, &bin->frames, frame, (void *)(uintptr_t)frame_id);
+	}
+}
+
+static void
+prof_dump_bin_stack(tsd_t *tsd, prof_dump_bin_t *bin, const prof_bt_t *bt,
+    const prof_cnt_t *cnts, const uint64_t *lifetimes,
+    unsigned lifetimes_len) {
+	prof_dump_bin_tag(bin, PROF_DUMP_BIN_STACK);
+	prof_dump_bin_uint(bin, bt->len);
+	for (unsigned i = 0; i < bt->len; i++) {
+		prof_dump_bin_frame(tsd, bin, bt->vec[i]);
+	}
+	prof_dump_bin_cnts(bin, cnts);
+	if (lifetimes_len != 0) {
+		prof_dump_bin_tag(bin, PROF_DUMP_BIN_LIFETIMES);
+		prof_dump_bin_uint(bin, lifetimes_len);
+		for (unsigned i = 0; i < lifetimes_len; i++) {
+			prof_dump_bin_uint(bin, lifetimes[i]);
+		}
+	}
+	if (opt_prof_per_arena) {
+		prof_dump_bin_tag(bin, PROF_DUMP_BIN_ARENA);
+		prof_dump_bin_uint(bin, bt->arena_ind);
+	}
+}
+
+void
+prof_dump_binary_impl(tsd_t *tsd, prof_dump_bin_write_t *prof_dump_write,
+    void *cbopaque, prof_tdata_t *tdata, bool leakcheck, bool delta) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_dump_mtx);
+	prof_cnt_t       cnt_all;
+	size_t           leak_ngctx;
+	prof_gctx_tree_t gctxs;
+	prof_dump_prep(tsd, tdata, &cnt_all, &leak_ngctx, &gctxs, delta);
+
+	prof_dump_bin_t bin;
+	bin.prof_dump_write = prof_dump_write;
+	bin.cbopaque = cbopaque;
+	bin.frames_init = !ckh_new(tsd, &bin.frames, PROF_CKH_MINITEMS,
+	    ckh_pointer_hash, ckh_pointer_keycomp);
+	bin.nframes = 0;
+	bin.len = 0;
+
+	char   header[2 * PROF_PRINTF_BUFSIZE];
+	size_t header_len = prof_dump_delta_header(
+	    tsd_tsdn(tsd), delta, header, sizeof(header));
+	header_len += malloc_snprintf(header + header_len,
+	    sizeof(header) - header_len, "heap_v2b/%" FMTu64 "\n",
+	    ((uint64_t)1U << lg_prof_sample));
+	prof_dump_write(cbopaque, header, header_len);
+	prof_dump_bin_tag(&bin, PROF_DUMP_BIN_TOTAL);
+	prof_dump_bin_cnts(&bin, &cnt_all);
+
+	/*
+	 * The gctx's stay in limbo until prof_gctx_finish(), so their
+	 * backtraces can be read without their locks; only the counters are
+	 * copied out under them.
+	 */
+	prof_gctx_t *batch[PROF_DUMP_BATCH];
+	prof_cnt_t   batch_cnts[PROF_DUMP_BATCH];
+	unsigned     batch_lifetimes_len[PROF_DUMP_BATCH];
+	prof_gctx_t *gctx = gctx_tree_first(&gctxs);
+	while (gctx != NULL) {
+		unsigned n = 0;
+		for (; gctx != NULL && n < PROF_DUMP_BATCH;
+		     gctx = gctx_tree_next(&gctxs, gctx)) {
+			malloc_mutex_lock(tsd_tsdn(tsd), gctx->lock);
+			bool empty = prof_dump_gctx_empty(gctx);
+			if (delta ? prof_dump_gctx_delta_report(gctx, empty)
+			          : !empty) {
+				batch[n] = gctx;
+				batch_cnts[n] = gctx->cnt_summed;
+				unsigned lifetimes_len =
+				    prof_dump_lifetimes_len(gctx);
+				batch_lifetimes_len[n] = lifetimes_len;
+				if (lifetimes_len != 0) {
+					memcpy(prof_dump_bin_lifetimes[n],
+					    gctx->lifetimes,
+					    lifetimes_len * sizeof(uint64_t));
+				}
+				n++;
+			}
+			malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
+		}
+		for (unsigned i = 0; i < n; i++) {
+			prof_dump_bin_stack(tsd, &bin, &batch[i]->bt,
+			    &batch_cnts[i], prof_dump_bin_lifetimes[i],
+			    batch_lifetimes_len[i]);
+		}
+	}
+	prof_dump_bin_flush(&bin);
+
+	if (bin.frames_init) {
+		ckh_delete(tsd, &bin.frames);
+	}
+	prof_gctx_finish(tsd, &gctxs);
+	if (leakcheck) {
+		prof_leakcheck(&cnt_all, leak_ngctx);
+	}
+}
+
+unsigned
+prof_leak_epoch_get(void) {
+	cassert(config_prof);
+	return atomic_load_u(&prof_leak_epoch, ATOMIC_ACQUIRE);
+}
+
+/*
+ * Ends the current leak detection epoch.  Each gctx whose live sampled bytes
+ * grew during the epoch extends its streak of growing epochs; any other gctx
+ * starts a new streak from its current size.
+ */
+void
+prof_leak_epoch_end(tsd_t *tsd, prof_tdata_t *tdata) {
+	cassert(config_prof);
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_dump_mtx);
+	prof_cnt_t       cnt_all;
+	size_t           leak_ngctx;
+	prof_gctx_tree_t gctxs;
+	prof_dump_prep(tsd, tdata, &cnt_all, &leak_ngctx, &gctxs, false);
+	for (prof_gctx_t *gctx = gctx_tree_first(&gctxs); gctx != NULL;
+	     gctx = gctx_tree_next(&gctxs, gctx)) {
+		malloc_mutex_lock(tsd_tsdn(tsd), gctx->lock);
+		uint64_t bytes = gctx->cnt_summed.curbytes;
+		if (bytes > gctx->leak_bytes) {
+			gctx->leak_nepochs++;
+		} else {
+			gctx->leak_nepochs = 0;
+			gctx->leak_base_bytes = bytes;
+		}
+		gctx->leak_bytes = bytes;
+		malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
+	}
+	prof_gctx_finish(tsd, &gctxs);
+	atomic_store_u(&prof_leak_epoch,
+	    atomic_load_u(&prof_leak_epoch, ATOMIC_RELAXED) + 1,
+	    ATOMIC_RELEASE);
+}
+
+static void
+prof_leak_report_gctx(emitter_t *emitter, prof_gctx_t *gctx) {
+	emitter_json_object_begin(emitter);
+	emitter_json_kv(
+	    emitter, "epochs", emitter_type_unsigned, &gctx->leak_nepochs);
+	if (opt_prof_per_arena) {
+		emitter_json_kv(emitter, "arena", emitter_type_unsigned,
+		    &gctx->bt.arena_ind);
+	}
+	uint64_t growth = gctx->leak_bytes - gctx->leak_base_bytes;
+	emitter_json_kv(emitter, "growth_bytes", emitter_type_uint64, &growth);
+	uint64_t cnts[4];
+	prof_dump_cnts_get(&gctx->cnt_summed, cnts);
+	emitter_json_kv(emitter, "live_objs", emitter_type_uint64, &cnts[0]);
+	emitter_json_kv(emitter, "live_bytes", emitter_type_uint64, &cnts[1]);
+	emitter_json_array_kv_begin(emitter, "trace");
+	char  bt_buf[2 * sizeof(intptr_t) + 3];
+	char *s = bt_buf;
+	for (unsigned i = 0; i < gctx->bt.len; i++) {
+		malloc_snprintf(bt_buf, sizeof(bt_buf), "%p", gctx->bt.vec[i]);
+		emitter_json_value(emitter, emitter_type_string, &s);
+	}
+	emitter_json_array_end(emitter);
+	emitter_json_object_end(emitter);
+}
+
+#define PROF_LEAK_REPORT_BUFSIZE 4096
+/*
+ * Writes, in JSON, the backtraces whose live sampled bytes grew during each of
+ * the last opt_prof_leak_epochs epochs.
+ */
+void
+prof_leak_report_write(tsd_t *tsd, prof_tdata_t *tdata, write_cb_t *write_cb,
+    void *cbopaque) {
+	cassert(config_prof);
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_dump_mtx);
+	prof_cnt_t       cnt_all;
+	size_t           leak_ngctx;
+	prof_gctx_tree_t gctxs;
+	prof_dump_prep(tsd, tdata, &cnt_all, &leak_ngctx, &gctxs, false);
+
+	buf_writer_t buf_writer;
+	buf_writer_init(tsd_tsdn(tsd), &buf_writer, write_cb, cbopaque, NULL,
+	    PROF_LEAK_REPORT_BUFSIZE);
+	emitter_t emitter;
+	emitter_init(
+	    &emitter, emitter_output_json_compact, buf_writer_cb, &buf_writer);
+	emitter_begin(&emitter);
+	unsigned epoch = atomic_load_u(&prof_leak_epoch, ATOMIC_RELAXED);
+	emitter_json_kv(&emitter, "epoch", emitter_type_unsigned, &epoch);
+	emitter_json_kv(&emitter, "epochs_threshold", emitter_type_unsigned,
+	    &opt_prof_leak_epochs);
+	uint64_t sample_interval = (uint64_t)1U << lg_prof_sample;
+	emitter_json_kv(
+	    &emitter, "sample_interval", emitter_type_uint64, &sample_interval);
+	emitter_json_array_kv_begin(&emitter, "leaks");
+	for (prof_gctx_t *gctx = gctx_tree_first(&gctxs); gctx != NULL;
+	     gctx = gctx_tree_next(&gctxs, gctx)) {
+		malloc_mutex_lock(tsd_tsdn(tsd), gctx->lock);
+		if (gctx->leak_nepochs >= opt_prof_leak_epochs) {
+			prof_leak_report_gctx(&emitter, gctx);
+		}
+		malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
+	}
+	emitter_json_array_end(&emitter);
+	emitter_end(&emitter);
+	buf_writer_terminate(tsd_tsdn(tsd), &buf_writer);
+
+	prof_gctx_finish(tsd, &gctxs);
+}
+#undef PROF_LEAK_REPORT_BUFSIZE
+
 /* Used in unit tests. */
 void
 prof_cnt_all(prof_cnt_t *cnt_all) {
@@ -1108,7 +2020,8 @@ prof_cnt_all(prof_cnt_t *cnt_all) {
 	} else {
 		size_t           leak_ngctx;
 		prof_gctx_tree_t gctxs;
-		prof_dump_prep(tsd, tdata, cnt_all, &leak_ngctx, &gctxs);
+		prof_dump_prep(
+		    tsd, tdata, cnt_all, &leak_ngctx, &gctxs, false);
 		prof_gctx_finish(tsd, &gctxs);
 	}
 }
@@ -1119,7 +2032,12 @@ prof_bt_hash(const void *key, size_t r_hash[2]) {
 
 	cassert(config_prof);
 
-	hash(bt->vec, bt->len * sizeof(void *), 0x94122f33U, r_hash);
+	/*
+	 * With opt.prof_per_arena, one backtrace is a key per arena; seed with
+	 * the arena so that those don't all collide in the same buckets.
+	 */
+	hash(bt->vec, bt->len * sizeof(void *), 0x94122f33U ^ bt->arena_ind,
+	    r_hash);
 }
 
 bool
@@ -1129,12 +2047,40 @@ prof_bt_keycomp(const void *k1, const void *k2) {
 
 	cassert(config_prof);
 
-	if (bt1->len != bt2->len) {
+	if (bt1->len != bt2->len || bt1->arena_ind != bt2->arena_ind) {
 		return false;
 	}
 	return (memcmp(bt1->vec, bt2->vec, bt1->len * sizeof(void *)) == 0);
 }
 
+typedef struct prof_tdata_foreach_arg_s prof_tdata_foreach_arg_t;
+struct prof_tdata_foreach_arg_s {
+	tsdn_t             *tsdn;
+	prof_tdata_visit_t *visit;
+	void               *arg;
+};
+
+static prof_tdata_t *
+prof_tdata_foreach_iter(
+    prof_tdata_tree_t *tdatas_ptr, prof_tdata_t *tdata, void *opaque) {
+	prof_tdata_foreach_arg_t *arg = (prof_tdata_foreach_arg_t *)opaque;
+	arg->visit(arg->tsdn, tdata, arg->arg);
+	return NULL;
+}
+
+/*
+ * Visits every tdata, including the expired and detached ones, none of which
+ * can be destroyed meanwhile.
+ */
+void
+prof_tdata_foreach(tsdn_t *tsdn, prof_tdata_visit_t *visit, void *arg) {
+	prof_tdata_foreach_arg_t foreach_arg = {tsdn, visit, arg};
+	malloc_mutex_lock(tsdn, &tdatas_mtx);
+	tdata_tree_iter(
+	    &tdatas, NULL, prof_tdata_foreach_iter, (void *)&foreach_arg);
+	malloc_mutex_unlock(tsdn, &tdatas_mtx);
+}
+
 prof_tdata_t *
 prof_tdata_init_impl(tsd_t *tsd, uint64_t thr_uid, uint64_t thr_discrim,
     char *thread_name, bool active) {
@@ -1180,6 +2126,7 @@ prof_tdata_init_impl(tsd_t *tsd, uint64_t thr_uid, uint64_t thr_discrim,
 
 	tdata->dumping = false;
 	tdata->active = active;
+	ql_new(&tdata->recent_allocs);
 
 	malloc_mutex_lock(tsd_tsdn(tsd), &tdatas_mtx);
 	tdata_tree_insert(&tdatas, tdata);
@@ -1215,6 +2162,8 @@ prof_tdata_destroy_locked(
 
 	tdata_tree_remove(&tdatas, tdata);
 	assert(prof_tdata_should_destroy_unlocked(tdata, even_if_attached));
+	/* The records hold the tctx's of the tdata. */
+	assert(ql_empty(&tdata->recent_allocs));
 
 	ckh_delete(tsd, &tdata->bt2tctx);
 	idalloctm(tsd_tsdn(tsd), tdata, NULL, NULL, true, true);
@@ -1268,6 +2217,27 @@ prof_tdata_expire(tsdn_t *tsdn, prof_tdata_t *tdata) {
 	return destroy_tdata;
 }
 
+static void
+prof_gctx_lifetimes_reset(tsdn_t *tsdn) {
+	malloc_mutex_lock(tsdn, &bt2gctx_mtx);
+	prof_bt2gctx_lock_all(tsdn);
+	prof_bt2gctx_table_t *table = (prof_bt2gctx_table_t *)atomic_load_p(
+	    &bt2gctx, ATOMIC_RELAXED);
+	for (size_t i = 0; i < (ZU(1) << table->lg_nslots); i++) {
+		prof_gctx_t *gctx = (prof_gctx_t *)atomic_load_p(
+		    &table->slots[i], ATOMIC_RELAXED);
+		if (gctx == NULL || gctx == PROF_BT2GCTX_TOMBSTONE) {
+			continue;
+		}
+		malloc_mutex_lock(tsdn, gctx->lock);
+		memset(gctx->lifetimes, 0,
+		    PROF_LIFETIME_NBUCKETS * sizeof(uint64_t));
+		malloc_mutex_unlock(tsdn, gctx->lock);
+	}
+	prof_bt2gctx_unlock_all(tsdn);
+	malloc_mutex_unlock(tsdn, &bt2gctx_mtx);
+}
+
 static prof_tdata_t *
 prof_tdata_reset_iter(
     prof_tdata_tree_t *tdatas_ptr, prof_tdata_t *tdata, void *arg) {
@@ -1283,10 +2253,15 @@ prof_reset(tsd_t *tsd, size_t lg_sample) {
 	assert(lg_sample < (sizeof(uint64_t) << 3));
 
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_dump_mtx);
+	if (opt_prof_lifetime) {
+		prof_gctx_lifetimes_reset(tsd_tsdn(tsd));
+	}
 	malloc_mutex_lock(tsd_tsdn(tsd), &tdatas_mtx);
 
 	lg_prof_sample = lg_sample;
 	prof_unbias_map_init();
+	/* The counters of the expired tdata's are gone from later dumps. */
+	prof_dump_delta_full = true;
 
 	next = NULL;
 	do {
@@ -1409,7 +2384,7 @@ prof_tctx_destroy(tsd_t *tsd, prof_tctx_t *tctx) {
 	}
 	malloc_mutex_unlock(tsd_tsdn(tsd), gctx->lock);
 	if (destroy_gctx) {
-		prof_gctx_try_destroy(tsd, prof_tdata_get(tsd, false), gctx);
+		prof_gctx_try_destroy(tsd, gctx);
 	}
 	if (destroy_tctx) {
 		idalloctm(tsd_tsdn(tsd), tctx, NULL, NULL, true, true);
@@ -13,6 +13,8 @@
 #include "jemalloc/internal/prof_sys.h"
 
 bool                              opt_prof_log = false;
+bool                              opt_prof_log_stream = false;
+size_t opt_prof_log_stream_buf_size = PROF_LOG_STREAM_BUF_SIZE_DEFAULT;
 typedef enum prof_logging_state_e prof_logging_state_t;
 enum prof_logging_state_e {
 	prof_logging_state_stopped,
@@ -52,7 +54,9 @@ typedef struct prof_bt_node_s prof_bt_node_t;
 struct prof_bt_node_s {
 	prof_bt_node_t *next;
 	size_t          index;
-	prof_bt_t       bt;
+	/* Whether the backtrace has been streamed to the log file. */
+	bool      emitted;
+	prof_bt_t bt;
 	/* Variable size backtrace vector pointed to by bt. */
 	void *vec[1];
 };
@@ -62,7 +66,9 @@ typedef struct prof_thr_node_s prof_thr_node_t;
 struct prof_thr_node_s {
 	prof_thr_node_t *next;
 	size_t           index;
-	uint64_t         thr_uid;
+	/* Whether the thread has been streamed to the log file. */
+	bool     emitted;
+	uint64_t thr_uid;
 	/* Variable size based on thr_name_sz. */
 	char name[1];
 };
@@ -106,6 +112,34 @@ static prof_alloc_node_t *log_alloc_last = NULL;
 /* Protects the prof_logging_state and any log_{...} variable. */
 malloc_mutex_t log_mtx;
 
+/*
+ * Streaming (opt.prof_log_stream): rather than being kept in memory until
+ * prof_log_stop, each allocation is written out as a line of JSON, preceded
+ * by lines for the thread and backtraces it refers to the first time they
+ * appear.  Lines are formatted into the active one of two buffers; once it
+ * can't take the next record, the buffers are swapped, and the full one is
+ * written to the log file by the next thread to free a sampled object, after
+ * it has dropped its locks.  Records that arrive while both buffers are full
+ * are dropped and counted.
+ *
+ * log_stream_mtx serializes writing to the log file.  The remaining variables
+ * are protected by log_mtx, except that the buffer being written out is
+ * owned by the writer.
+ */
+malloc_mutex_t    log_stream_mtx;
+static bool       log_streaming = false;
+static int        log_stream_fd;
+static char      *log_stream_bufs[2];
+static size_t     log_stream_lens[2];
+static unsigned   log_stream_active;
+/* Whether the inactive buffer holds lines that haven't been written yet. */
+static bool       log_stream_full;
+static atomic_b_t log_stream_flush_pending;
+/* Set when the active buffer couldn't take the line being formatted. */
+static bool     log_stream_overflow;
+static bool     log_stream_failed;
+static uint64_t log_stream_ndropped = 0;
+
 /******************************************************************************/
 /*
  * Function prototypes for static functions that are referenced prior to
@@ -118,15 +152,19 @@ static bool prof_thr_node_keycomp(const void *k1, const void *k2);
 static void prof_bt_node_hash(const void *key, size_t r_hash[2]);
 static bool prof_bt_node_keycomp(const void *k1, const void *k2);
 
+static bool prof_log_stream_start(tsdn_t *tsdn);
+
 /******************************************************************************/
 
-static size_t
-prof_log_bt_index(tsd_t *tsd, prof_bt_t *bt) {
+static prof_bt_node_t *
+prof_log_bt_node(tsd_t *tsd, prof_bt_t *bt) {
 	assert(prof_logging_state == prof_logging_state_started);
 	malloc_mutex_assert_owner(tsd_tsdn(tsd), &log_mtx);
 
 	prof_bt_node_t dummy_node;
 	dummy_node.bt = *bt;
+	/* The log lists stacks only, whatever arena they allocated from. */
+	dummy_node.bt.arena_ind = 0;
 	prof_bt_node_t *node;
 
 	/* See if this backtrace is already cached in the table. */
@@ -147,6 +185,7 @@ prof_log_bt_index(tsd_t *tsd, prof_bt_t *bt) {
 
 		new_node->next = NULL;
 		new_node->index = log_bt_index;
+		new_node->emitted = false;
 		/*
 		 * Copy the backtrace: bt is inside a tdata or gctx, which
 		 * might die before prof_log_stop is called.
@@ -154,17 +193,18 @@ prof_log_bt_index(tsd_t *tsd, prof_bt_t *bt) {
 		new_node->bt.len = bt->len;
 		memcpy(new_node->vec, bt->vec, bt->len * sizeof(void *));
 		new_node->bt.vec = new_node->vec;
+		new_node->bt.arena_ind = 0;
 
 		log_bt_index++;
 		ckh_insert(tsd, &log_bt_node_set, (void *)new_node, NULL);
-		return new_node->index;
+		return new_node;
 	} else {
-		return node->index;
+		return node;
 	}
 }
 
-static size_t
-prof_log_thr_index(tsd_t *tsd, uint64_t thr_uid, const char *name) {
+static prof_thr_node_t *
+prof_log_thr_node(tsd_t *tsd, uint64_t thr_uid, const char *name) {
 	assert(prof_logging_state == prof_logging_state_started);
 	malloc_mutex_assert_owner(tsd_tsdn(tsd), &log_mtx);
 
@@ -189,15 +229,184 @@ prof_log_thr_index(tsd_t *tsd, uint64_t thr_uid, const char *name) {
 
 		new_node->next = NULL;
 		new_node->index = log_thr_index;
+		new_node->emitted = false;
 		new_node->thr_uid = thr_uid;
 		strcpy(new_node->name, name);
 
 		log_thr_index++;
 		ckh_insert(tsd, &log_thr_node_set, (void *)new_node, NULL);
-		return new_node->index;
+		return new_node;
 	} else {
-		return node->index;
+		return node;
+	}
+}
+
+static void
+prof_log_stream_write_cb(void *opaque, const char *to_write) {
+	size_t  len = strlen(to_write);
+	char   *buf = log_stream_bufs[log_stream_active];
+	size_t *buf_len = &log_stream_lens[log_stream_active];
+	if (log_stream_overflow
+	    || *buf_len + len > opt_prof_log_stream_buf_size) {
+		log_stream_overflow = true;
+		return;
 	}
+	memcpy(buf + *buf_len, to_write, len);
+	*buf_len += len;
+}
+
+static void
+prof_log_stream_line_begin(emitter_t *emitter, const char *key) {
+	emitter_init(emitter, emitter_output_json_compact,
+	    prof_log_stream_write_cb, NULL);
+	emitter_begin(emitter);
+	emitter_json_object_kv_begin(emitter, key);
+}
+
+static void
+prof_log_stream_line_end(emitter_t *emitter) {
+	emitter_json_object_end(emitter);
+	emitter_end(emitter);
+	prof_log_stream_write_cb(NULL, "\n");
+}
+
+static void
+prof_log_stream_emit_thr(prof_thr_node_t *node) {
+	emitter_t emitter;
+	prof_log_stream_line_begin(&emitter, "thread");
+	emitter_json_kv(&emitter, "index", emitter_type_size, &node->index);
+	emitter_json_kv(
+	    &emitter, "thr_uid", emitter_type_uint64, &node->thr_uid);
+	char *thr_name = node->name;
+	emitter_json_kv(&emitter, "thr_name", emitter_type_string, &thr_name);
+	prof_log_stream_line_end(&emitter);
+}
+
+static void
+prof_log_stream_emit_bt(prof_bt_node_t *node) {
+	emitter_t emitter;
+	/* As in prof_log_emit_traces. */
+	char   buf[2 * sizeof(intptr_t) + 3];
+	size_t buf_sz = sizeof(buf);
+	prof_log_stream_line_begin(&emitter, "stack_trace");
+	emitter_json_kv(&emitter, "index", emitter_type_size, &node->index);
+	emitter_json_array_kv_begin(&emitter, "frames");
+	for (size_t i = 0; i < node->bt.len; i++) {
+		malloc_snprintf(buf, buf_sz, "%p", node->bt.vec[i]);
+		char *trace_str = buf;
+		emitter_json_value(&emitter, emitter_type_string, &trace_str);
+	}
+	emitter_json_array_end(&emitter);
+	prof_log_stream_line_end(&emitter);
+}
+
+/*
+ * Appends the lines of an allocation record to the active buffer.  Returns
+ * true, leaving the buffer as it was, if they don't fit.
+ */
+static bool
+prof_log_stream_append(prof_alloc_node_t *record, prof_thr_node_t *thrs[2],
+    prof_bt_node_t *bts[2]) {
+	size_t len = log_stream_lens[log_stream_active];
+	log_stream_overflow = false;
+	for (unsigned i = 0; i < 2; i++) {
+		/* The second one may be the same as the first. */
+		if (!thrs[i]->emitted && (i == 0 || thrs[1] != thrs[0])) {
+			prof_log_stream_emit_thr(thrs[i]);
+		}
+		if (!bts[i]->emitted && (i == 0 || bts[1] != bts[0])) {
+			prof_log_stream_emit_bt(bts[i]);
+		}
+	}
+
+	emitter_t emitter;
+	prof_log_stream_line_begin(&emitter, "allocation");
+	emitter_json_kv(&emitter, "alloc_thread", emitter_type_size,
+	    &record->alloc_thr_ind);
+	emitter_json_kv(&emitter, "free_thread", emitter_type_size,
+	    &record->free_thr_ind);
+	emitter_json_kv(&emitter, "alloc_trace", emitter_type_size,
+	    &record->alloc_bt_ind);
+	emitter_json_kv(&emitter, "free_trace", emitter_type_size,
+	    &record->free_bt_ind);
+	emitter_json_kv(&emitter, "alloc_timestamp", emitter_type_uint64,
+	    &record->alloc_time_ns);
+	emitter_json_kv(&emitter, "free_timestamp", emitter_type_uint64,
+	    &record->free_time_ns);
+	emitter_json_kv(&emitter, "usize", emitter_type_size, &record->usize);
+	prof_log_stream_line_end(&emitter);
+
+	if (log_stream_overflow) {
+		log_stream_lens[log_stream_active] = len;
+		return true;
+	}
+	for (unsigned i = 0; i < 2; i++) {
+		thrs[i]->emitted = true;
+		bts[i]->emitted = true;
+	}
+	return false;
+}
+
+static void
+prof_log_stream_record(prof_alloc_node_t *record, prof_thr_node_t *thrs[2],
+    prof_bt_node_t *bts[2]) {
+	if (!prof_log_stream_append(record, thrs, bts)) {
+		return;
+	}
+	/* Hand the active buffer off for writing, unless it's empty. */
+	if (!log_stream_full && log_stream_lens[log_stream_active] != 0) {
+		log_stream_full = true;
+		log_stream_active ^= 1;
+		atomic_store_b(&log_stream_flush_pending, true, ATOMIC_RELEASE);
+		if (!prof_log_stream_append(record, thrs, bts)) {
+			return;
+		}
+	}
+	log_stream_ndropped++;
+}
+
+static void
+prof_log_stream_write(const char *buf, size_t len) {
+	if (prof_log_dummy || len == 0) {
+		return;
+	}
+	if (prof_dump_write_file(log_stream_fd, buf, len) == -1) {
+		log_stream_failed = true;
+	}
+}
+
+void
+prof_log_stream_flush(tsd_t *tsd) {
+	cassert(config_prof);
+	if (!atomic_load_b(&log_stream_flush_pending, ATOMIC_ACQUIRE)) {
+		return;
+	}
+
+	tsdn_t *tsdn = tsd_tsdn(tsd);
+	/*
+	 * This runs on the free path, so don't wait out a write in progress:
+	 * the thread doing it checks again before letting go, and whatever it
+	 * misses is left to the next flush, or to the background thread.
+	 */
+	if (malloc_mutex_trylock(tsdn, &log_stream_mtx)) {
+		return;
+	}
+	while (atomic_load_b(&log_stream_flush_pending, ATOMIC_ACQUIRE)) {
+		atomic_store_b(
+		    &log_stream_flush_pending, false, ATOMIC_RELAXED);
+		malloc_mutex_lock(tsdn, &log_mtx);
+		unsigned full = log_stream_active ^ 1;
+		malloc_mutex_unlock(tsdn, &log_mtx);
+
+		prof_log_stream_write(
+		    log_stream_bufs[full], log_stream_lens[full]);
+
+		malloc_mutex_lock(tsdn, &log_mtx);
+		log_stream_lens[full] = 0;
+		log_stream_full = false;
+		malloc_mutex_unlock(tsdn, &log_mtx);
+	}
+	malloc_mutex_unlock(tsdn, &log_stream_mtx);
 }
 
 JEMALLOC_COLD
@@ -238,11 +447,6 @@ prof_try_log(tsd_t *tsd, size_t usize, prof_info_t *prof_info) {
 	nstime_t free_time;
 	nstime_prof_init_update(&free_time);
 
-	size_t             sz = sizeof(prof_alloc_node_t);
-	prof_alloc_node_t *new_node = (prof_alloc_node_t *)iallocztm(
-	    tsd_tsdn(tsd), sz, sz_size2index(sz), false, NULL, true,
-	    arena_get(TSDN_NULL, 0, true), true);
-
 	const char *prod_thr_name = tctx->tdata->thread_name;
 	const char *cons_thr_name = prof_thread_name_get(tsd);
 
@@ -255,16 +459,32 @@ prof_try_log(tsd_t *tsd, size_t usize, prof_info_t *prof_info) {
 	/* We haven't destroyed tctx yet, so gctx should be good to read. */
 	prof_bt_t *prod_bt = &tctx->gctx->bt;
 
-	new_node->next = NULL;
-	new_node->alloc_thr_ind = prof_log_thr_index(
-	    tsd, tctx->tdata->thr_uid, prod_thr_name);
-	new_node->free_thr_ind = prof_log_thr_index(
-	    tsd, cons_tdata->thr_uid, cons_thr_name);
-	new_node->alloc_bt_ind = prof_log_bt_index(tsd, prod_bt);
-	new_node->free_bt_ind = prof_log_bt_index(tsd, cons_bt);
-	new_node->alloc_time_ns = nstime_ns(&alloc_time);
-	new_node->free_time_ns = nstime_ns(&free_time);
-	new_node->usize = usize;
+	prof_thr_node_t *thrs[2] = {
+	    prof_log_thr_node(tsd, tctx->tdata->thr_uid, prod_thr_name),
+	    prof_log_thr_node(tsd, cons_tdata->thr_uid, cons_thr_name)};
+	prof_bt_node_t *bts[2] = {
+	    prof_log_bt_node(tsd, prod_bt), prof_log_bt_node(tsd, cons_bt)};
+
+	prof_alloc_node_t record;
+	record.next = NULL;
+	record.alloc_thr_ind = thrs[0]->index;
+	record.free_thr_ind = thrs[1]->index;
+	record.alloc_bt_ind = bts[0]->index;
+	record.free_bt_ind = bts[1]->index;
+	record.alloc_time_ns = nstime_ns(&alloc_time);
+	record.free_time_ns = nstime_ns(&free_time);
+	record.usize = usize;
+
+	if (log_streaming) {
+		prof_log_stream_record(&record, thrs, bts);
+		goto label_done;
+	}
+
+	size_t             sz = sizeof(prof_alloc_node_t);
+	prof_alloc_node_t *new_node = (prof_alloc_node_t *)iallocztm(
+	    tsd_tsdn(tsd), sz, sz_size2index(sz), false, NULL, true,
+	    arena_get(TSDN_NULL, 0, true), true);
+	*new_node = record;
 
 	if (log_alloc_first == NULL) {
 		log_alloc_first = new_node;
@@ -462,6 +682,10 @@ prof_log_start(tsdn_t *tsdn, const char *filename) {
 	if (!ret) {
 		nstime_prof_init_update(&log_start_timestamp);
 	}
+	if (!ret && opt_prof_log_stream && prof_log_stream_start(tsdn)) {
+		prof_logging_state = prof_logging_state_stopped;
+		ret = true;
+	}
 label_done:
 	malloc_mutex_unlock(tsdn, &log_mtx);
 
@@ -541,8 +765,13 @@ prof_log_emit_traces(tsd_t *tsd, emitter_t *emitter) {
 	emitter_json_array_end(emitter);
 }
 
+/*
+ * If lifetimes isn't NULL, the lifetime of each allocation is also added to the
+ * histogram of its allocation backtrace, at lifetimes[alloc_bt_ind *
+ * PROF_LIFETIME_NBUCKETS].
+ */
 static void
-prof_log_emit_allocs(tsd_t *tsd, emitter_t *emitter) {
+prof_log_emit_allocs(tsd_t *tsd, emitter_t *emitter, uint64_t *lifetimes) {
 	emitter_json_array_kv_begin(emitter, "allocations");
 	prof_alloc_node_t *alloc_node = log_alloc_first;
 	prof_alloc_node_t *alloc_old_node;
@@ -572,6 +801,14 @@ prof_log_emit_allocs(tsd_t *tsd, emitter_t *emitter) {
 
 		emitter_json_object_end(emitter);
 
+		if (lifetimes != NULL) {
+			unsigned bucket = prof_lifetime_bucket(
+			    alloc_node->free_time_ns
+			    - alloc_node->alloc_time_ns);
+			lifetimes[alloc_node->alloc_bt_ind
+			    * PROF_LIFETIME_NBUCKETS + bucket]++;
+		}
+
 		alloc_old_node = alloc_node;
 		alloc_node = alloc_node->next;
 		idalloctm(
@@ -580,15 +817,55 @@ prof_log_emit_allocs(tsd_t *tsd, emitter_t *emitter) {
 	emitter_json_array_end(emitter);
 }
 
+/*
+ * Emits the lifetime histogram of each backtrace that allocated logged objects,
+ * up to its last nonzero bucket.
+ */
 static void
-prof_log_emit_metadata(emitter_t *emitter) {
-	emitter_json_object_kv_begin(emitter, "info");
+prof_log_emit_lifetimes(emitter_t *emitter, const uint64_t *lifetimes,
+    size_t bt_count) {
+	emitter_json_array_kv_begin(emitter, "lifetime_histograms");
+	for (size_t i = 0; i < bt_count; i++) {
+		const uint64_t *hist = &lifetimes[i * PROF_LIFETIME_NBUCKETS];
+		unsigned        len = 0;
+		for (unsigned j = 0; j < PROF_LIFETIME_NBUCKETS; j++) {
+			if (hist[j] != 0) {
+				len = j + 1;
+			}
+		}
+		if (len == 0) {
+			continue;
+		}
+		emitter_json_object_begin(emitter);
+		emitter_json_kv(emitter, "alloc_trace", emitter_type_size, &i);
+		emitter_json_array_kv_begin(emitter, "counts");
+		for (unsigned j = 0; j < len; j++) {
+			emitter_json_value(
+			    emitter, emitter_type_uint64, &hist[j]);
+		}
+		emitter_json_array_end(emitter);
+		emitter_json_object_end(emitter);
+	}
+	emitter_json_array_end(emitter);
+}
 
+static uint64_t
+prof_log_duration_ns(void) {
 	nstime_t now;
 
 	nstime_prof_init_update(&now);
-	uint64_t ns = nstime_ns(&now) - nstime_ns(&log_start_timestamp);
-	emitter_json_kv(emitter, "duration", emitter_type_uint64, &ns);
+	return nstime_ns(&now) - nstime_ns(&log_start_timestamp);
+}
+
+/* Streamed logs have their duration on their last line instead. */
+static void
+prof_log_emit_metadata(emitter_t *emitter, bool duration) {
+	emitter_json_object_kv_begin(emitter, "info");
+
+	if (duration) {
+		uint64_t ns = prof_log_duration_ns();
+		emitter_json_kv(emitter, "duration", emitter_type_uint64, &ns);
+	}
 
 	char *vers = JEMALLOC_VERSION;
 	emitter_json_kv(emitter, "version", emitter_type_string, &vers);
@@ -606,6 +883,153 @@ prof_log_emit_metadata(emitter_t *emitter) {
 	emitter_json_object_end(emitter);
 }
 
+static void
+prof_log_reset(tsd_t *tsd) {
+	/* Reset global state. */
+	if (log_tables_initialized) {
+		ckh_delete(tsd, &log_bt_node_set);
+		ckh_delete(tsd, &log_thr_node_set);
+	}
+	log_tables_initialized = false;
+	log_bt_index = 0;
+	log_thr_index = 0;
+	log_bt_first = NULL;
+	log_bt_last = NULL;
+	log_thr_first = NULL;
+	log_thr_last = NULL;
+	log_alloc_first = NULL;
+	log_alloc_last = NULL;
+
+	malloc_mutex_lock(tsd_tsdn(tsd), &log_mtx);
+	prof_logging_state = prof_logging_state_stopped;
+	malloc_mutex_unlock(tsd_tsdn(tsd), &log_mtx);
+}
+
+JEMALLOC_COLD
+static bool
+prof_log_stream_start(tsdn_t *tsdn) {
+	malloc_mutex_assert_owner(tsdn, &log_mtx);
+
+	size_t sz = opt_prof_log_stream_buf_size;
+	for (unsigned i = 0; i < 2; i++) {
+		log_stream_bufs[i] = (char *)iallocztm(tsdn, sz,
+		    sz_size2index(sz), false, NULL, true,
+		    arena_get(TSDN_NULL, 0, true), true);
+		if (log_stream_bufs[i] == NULL) {
+			if (i == 1) {
+				idalloctm(tsdn, log_stream_bufs[0], NULL, NULL,
+				    true, true);
+			}
+			return true;
+		}
+	}
+
+	if (prof_log_dummy) {
+		log_stream_fd = 0;
+	} else {
+		log_stream_fd = prof_dump_open_file(log_filename, 0644);
+	}
+	if (log_stream_fd == -1) {
+		malloc_printf(
+		    "<jemalloc>: creat() for log file \"%s\" "
+		    " failed with %d\n",
+		    log_filename, errno);
+		if (opt_abort) {
+			abort();
+		}
+		for (unsigned i = 0; i < 2; i++) {
+			idalloctm(
+			    tsdn, log_stream_bufs[i], NULL, NULL, true, true);
+		}
+		return true;
+	}
+
+	log_streaming = true;
+	log_stream_lens[0] = 0;
+	log_stream_lens[1] = 0;
+	log_stream_active = 0;
+	log_stream_full = false;
+	log_stream_failed = false;
+	log_stream_ndropped = 0;
+	atomic_store_b(&log_stream_flush_pending, false, ATOMIC_RELAXED);
+
+	/* The header goes out along with the first records. */
+	emitter_t emitter;
+	log_stream_overflow = false;
+	emitter_init(&emitter, emitter_output_json_compact,
+	    prof_log_stream_write_cb, NULL);
+	emitter_begin(&emitter);
+	prof_log_emit_metadata(&emitter, false);
+	emitter_end(&emitter);
+	prof_log_stream_write_cb(NULL, "\n");
+	return false;
+}
+
+JEMALLOC_COLD
+static bool
+prof_log_stream_stop(tsd_t *tsd) {
+	tsdn_t *tsdn = tsd_tsdn(tsd);
+
+	/*
+	 * Wait for any write in progress.  No records are added while dumping,
+	 * so the buffers are ours afterwards.
+	 */
+	malloc_mutex_lock(tsdn, &log_stream_mtx);
+	atomic_store_b(&log_stream_flush_pending, false, ATOMIC_RELAXED);
+	unsigned active = log_stream_active;
+	if (log_stream_full) {
+		prof_log_stream_write(
+		    log_stream_bufs[active ^ 1], log_stream_lens[active ^ 1]);
+	}
+	prof_log_stream_write(log_stream_bufs[active], log_stream_lens[active]);
+
+	emitter_t emitter;
+	log_stream_lens[active] = 0;
+	log_stream_overflow = false;
+	prof_log_stream_line_begin(&emitter, "end");
+	uint64_t ns = prof_log_duration_ns();
+	emitter_json_kv(&emitter, "duration", emitter_type_uint64, &ns);
+	emitter_json_kv(
+	    &emitter, "dropped", emitter_type_uint64, &log_stream_ndropped);
+	prof_log_stream_line_end(&emitter);
+	prof_log_stream_write(log_stream_bufs[active], log_stream_lens[active]);
+	malloc_mutex_unlock(tsdn, &log_stream_mtx);
+
+	for (unsigned i = 0; i < 2; i++) {
+		idalloctm(tsdn, log_stream_bufs[i], NULL, NULL, true, true);
+	}
+	/* The threads and backtraces have been written out with the records. */
+	prof_thr_node_t *thr_node = log_thr_first;
+	while (thr_node != NULL) {
+		prof_thr_node_t *thr_old_node = thr_node;
+		thr_node = thr_node->next;
+		idalloctm(tsdn, thr_old_node, NULL, NULL, true, true);
+	}
+	prof_bt_node_t *bt_node = log_bt_first;
+	while (bt_node != NULL) {
+		prof_bt_node_t *bt_old_node = bt_node;
+		bt_node = bt_node->next;
+		idalloctm(tsdn, bt_old_node, NULL, NULL, true, true);
+	}
+	bool failed = log_stream_failed;
+	log_streaming = false;
+	prof_log_reset(tsd);
+
+	if (prof_log_dummy) {
+		return false;
+	}
+	return close(log_stream_fd) || failed;
+}
+
+uint64_t
+prof_log_dropped_get(tsdn_t *tsdn) {
+	cassert(config_prof);
+	malloc_mutex_lock(tsdn, &log_mtx);
+	uint64_t ret = log_stream_ndropped;
+	malloc_mutex_unlock(tsdn, &log_mtx);
+	return ret;
+}
+
 #define PROF_LOG_STOP_BUFSIZE PROF_DUMP_BUFSIZE
 JEMALLOC_COLD
 bool
@@ -631,6 +1055,10 @@ prof_log_stop(tsdn_t *tsdn) {
 	prof_logging_state = prof_logging_state_dumping;
 	malloc_mutex_unlock(tsdn, &log_mtx);
 
+	if (log_streaming) {
+		return prof_log_stream_stop(tsd);
+	}
+
 	emitter_t emitter;
 
 	/* Create a file. */
@@ -673,33 +1101,30 @@ prof_log_stop(tsdn_t *tsdn) {
 	emitter_init(
 	    &emitter, emitter_output_json_compact, buf_writer_cb, &buf_writer);
 
+	/* Histograms are skipped if there is no memory for them. */
+	uint64_t *lifetimes = NULL;
+	size_t    lifetimes_sz = log_bt_index * PROF_LIFETIME_NBUCKETS
+	    * sizeof(uint64_t);
+	if (opt_prof_lifetime && lifetimes_sz != 0) {
+		lifetimes = (uint64_t *)iallocztm(tsdn, lifetimes_sz,
+		    sz_size2index(lifetimes_sz), true, NULL, true,
+		    arena_get(TSDN_NULL, 0, true), true);
+	}
+
 	emitter_begin(&emitter);
-	prof_log_emit_metadata(&emitter);
+	prof_log_emit_metadata(&emitter, true);
 	prof_log_emit_threads(tsd, &emitter);
 	prof_log_emit_traces(tsd, &emitter);
-	prof_log_emit_allocs(tsd, &emitter);
+	prof_log_emit_allocs(tsd, &emitter, lifetimes);
+	if (lifetimes != NULL) {
+		prof_log_emit_lifetimes(&emitter, lifetimes, log_bt_index);
+		idalloctm(tsdn, lifetimes, NULL, NULL, true, true);
+	}
 	emitter_end(&emitter);
 
 	buf_writer_terminate(tsdn, &buf_writer);
 
-	/* Reset global state. */
-	if (log_tables_initialized) {
-		ckh_delete(tsd, &log_bt_node_set);
-		ckh_delete(tsd, &log_thr_node_set);
-	}
-	log_tables_initialized = false;
-	log_bt_index = 0;
-	log_thr_index = 0;
-	log_bt_first = NULL;
-	log_bt_last = NULL;
-	log_thr_first = NULL;
-	log_thr_last = NULL;
-	log_alloc_first = NULL;
-	log_alloc_last = NULL;
-
-	malloc_mutex_lock(tsdn, &log_mtx);
-	prof_logging_state = prof_logging_state_stopped;
-	malloc_mutex_unlock(tsdn, &log_mtx);
+	prof_log_reset(tsd);
 
 	if (prof_log_dummy) {
 		return false;
@@ -716,6 +1141,10 @@ prof_log_init(tsd_t *tsd) {
 	        malloc_mutex_rank_exclusive)) {
 		return true;
 	}
+	if (malloc_mutex_init(&log_stream_mtx, "prof_log_stream",
+	        WITNESS_RANK_PROF_LOG_STREAM, malloc_mutex_rank_exclusive)) {
+		return true;
+	}
 
 	if (opt_prof_log) {
 		prof_log_start(tsd_tsdn(tsd), NULL);
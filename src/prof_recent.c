@@ -7,11 +7,30 @@
 #include "jemalloc/internal/prof_data.h"
 #include "jemalloc/internal/prof_recent.h"
 
-ssize_t            opt_prof_recent_alloc_max = PROF_RECENT_ALLOC_MAX_DEFAULT;
-malloc_mutex_t     prof_recent_alloc_mtx; /* Protects the fields below */
+ssize_t opt_prof_recent_alloc_max = PROF_RECENT_ALLOC_MAX_DEFAULT;
+
+/*
+ * Records live in the rings of the tdata's of the allocating threads, and are
+ * protected by their tdata->lock, so that neither sampled allocations nor the
+ * frees of recorded objects need any global lock.  A global sequence number
+ * orders the records: the last max ones are those within max of the next
+ * sequence number, and older ones are stale.  A thread trims the stale records
+ * from its own ring when it records an allocation, and sweeps trim those of
+ * all the rings.
+ */
+malloc_mutex_t     prof_recent_alloc_mtx; /* Serializes sweeps. */
 static atomic_zd_t prof_recent_alloc_max;
-static ssize_t     prof_recent_alloc_count = 0;
-prof_recent_list_t prof_recent_alloc_list;
+/* Sequence number of the next record. */
+static atomic_zu_t prof_recent_alloc_seq;
+/*
+ * Records with lower sequence numbers are stale regardless of the max, so that
+ * raising the max doesn't bring back records which already fell out.
+ */
+static atomic_zu_t prof_recent_alloc_floor;
+/* Number of records in all the rings, including the stale ones. */
+static atomic_zu_t prof_recent_alloc_count;
+/* No record is removed while set, so that it can be dumped without locks. */
+static atomic_b_t  prof_recent_alloc_dumping;
 
 malloc_mutex_t prof_recent_dump_mtx; /* Protects dumping. */
 
@@ -26,20 +45,37 @@ prof_recent_alloc_max_get_no_lock(void) {
 	return atomic_load_zd(&prof_recent_alloc_max, ATOMIC_RELAXED);
 }
 
-static inline ssize_t
-prof_recent_alloc_max_get(tsd_t *tsd) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	return prof_recent_alloc_max_get_no_lock();
-}
-
 static inline ssize_t
 prof_recent_alloc_max_update(tsd_t *tsd, ssize_t max) {
 	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	ssize_t old_max = prof_recent_alloc_max_get(tsd);
+	ssize_t old_max = prof_recent_alloc_max_get_no_lock();
+	if (old_max != -1) {
+		/* Whatever is stale now stays so. */
+		size_t seq = atomic_load_zu(
+		    &prof_recent_alloc_seq, ATOMIC_RELAXED);
+		size_t floor = atomic_load_zu(
+		    &prof_recent_alloc_floor, ATOMIC_RELAXED);
+		if (seq - floor > (size_t)old_max) {
+			atomic_store_zu(&prof_recent_alloc_floor,
+			    seq - (size_t)old_max, ATOMIC_RELAXED);
+		}
+	}
 	atomic_store_zd(&prof_recent_alloc_max, max, ATOMIC_RELAXED);
 	return old_max;
 }
 
+/*
+ * Whether a record is no longer one of the last max ones, given the next
+ * sequence number.  Ages are compared rather than sequence numbers, so that
+ * wrapping around is harmless.
+ */
+static inline bool
+prof_recent_alloc_stale(const prof_recent_t *n, size_t seq, ssize_t max) {
+	size_t age = seq - n->seq;
+	size_t floor = atomic_load_zu(&prof_recent_alloc_floor, ATOMIC_RELAXED);
+	return age > seq - floor || (max != -1 && age > (size_t)max);
+}
+
 static prof_recent_t *
 prof_recent_allocate_node(tsdn_t *tsdn) {
 	return (prof_recent_t *)iallocztm(tsdn, sizeof(prof_recent_t),
@@ -68,13 +104,7 @@ prof_recent_alloc_prepare(tsd_t *tsd, prof_tctx_t *tctx) {
 	malloc_mutex_assert_owner(tsd_tsdn(tsd), tctx->tdata->lock);
 	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
 
-	/*
-	 * Check whether last-N mode is turned on without trying to acquire the
-	 * lock, so as to optimize for the following two scenarios:
-	 * (1) Last-N mode is switched off;
-	 * (2) Dumping, during which last-N mode is temporarily turned off so
-	 *     as not to block sampled allocations.
-	 */
+	/* Check whether last-N mode is turned on. */
 	if (prof_recent_alloc_max_get_no_lock() == 0) {
 		return false;
 	}
@@ -82,8 +112,8 @@ prof_recent_alloc_prepare(tsd_t *tsd, prof_tctx_t *tctx) {
 	/*
 	 * Increment recent_count to hold the tctx so that it won't be gone
 	 * even after tctx->tdata->lock is released.  This acts as a
-	 * "placeholder"; the real recording of the allocation requires a lock
-	 * on prof_recent_alloc_mtx and is done in prof_recent_alloc (when
+	 * "placeholder"; the real recording of the allocation may need to
+	 * allocate a record, and is done in prof_recent_alloc (when
 	 * tctx->tdata->lock has been released).
 	 */
 	increment_recent_count(tsd, tctx);
@@ -112,14 +142,16 @@ prof_recent_alloc_edata_get_no_lock_test(const prof_recent_t *n) {
 }
 
 static inline edata_t *
-prof_recent_alloc_edata_get(tsd_t *tsd, const prof_recent_t *n) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+prof_recent_alloc_edata_get(
+    tsd_t *tsd, prof_tdata_t *tdata, const prof_recent_t *n) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), tdata->lock);
 	return prof_recent_alloc_edata_get_no_lock(n);
 }
 
 static void
-prof_recent_alloc_edata_set(tsd_t *tsd, prof_recent_t *n, edata_t *edata) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+prof_recent_alloc_edata_set(
+    tsd_t *tsd, prof_tdata_t *tdata, prof_recent_t *n, edata_t *edata) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), tdata->lock);
 	atomic_store_p(&n->alloc_edata, edata, ATOMIC_RELEASE);
 }
 
@@ -142,46 +174,48 @@ edata_prof_recent_alloc_get_no_lock_test(const edata_t *edata) {
 }
 
 static inline prof_recent_t *
-edata_prof_recent_alloc_get(tsd_t *tsd, const edata_t *edata) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+edata_prof_recent_alloc_get(
+    tsd_t *tsd, prof_tdata_t *tdata, const edata_t *edata) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), tdata->lock);
 	prof_recent_t *recent_alloc = edata_prof_recent_alloc_get_no_lock(
 	    edata);
 	assert(recent_alloc == NULL
-	    || prof_recent_alloc_edata_get(tsd, recent_alloc) == edata);
+	    || prof_recent_alloc_edata_get(tsd, tdata, recent_alloc) == edata);
 	return recent_alloc;
 }
 
 static prof_recent_t *
-edata_prof_recent_alloc_update_internal(
-    tsd_t *tsd, edata_t *edata, prof_recent_t *recent_alloc) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+edata_prof_recent_alloc_update_internal(tsd_t *tsd, prof_tdata_t *tdata,
+    edata_t *edata, prof_recent_t *recent_alloc) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), tdata->lock);
 	prof_recent_t *old_recent_alloc = edata_prof_recent_alloc_get(
-	    tsd, edata);
+	    tsd, tdata, edata);
 	edata_prof_recent_alloc_set_dont_call_directly(edata, recent_alloc);
 	return old_recent_alloc;
 }
 
 static void
-edata_prof_recent_alloc_set(
-    tsd_t *tsd, edata_t *edata, prof_recent_t *recent_alloc) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+edata_prof_recent_alloc_set(tsd_t *tsd, prof_tdata_t *tdata, edata_t *edata,
+    prof_recent_t *recent_alloc) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), tdata->lock);
 	assert(recent_alloc != NULL);
 	prof_recent_t *old_recent_alloc =
-	    edata_prof_recent_alloc_update_internal(tsd, edata, recent_alloc);
+	    edata_prof_recent_alloc_update_internal(
+	        tsd, tdata, edata, recent_alloc);
 	assert(old_recent_alloc == NULL);
-	prof_recent_alloc_edata_set(tsd, recent_alloc, edata);
+	prof_recent_alloc_edata_set(tsd, tdata, recent_alloc, edata);
 }
 
 static void
-edata_prof_recent_alloc_reset(
-    tsd_t *tsd, edata_t *edata, prof_recent_t *recent_alloc) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+edata_prof_recent_alloc_reset(tsd_t *tsd, prof_tdata_t *tdata, edata_t *edata,
+    prof_recent_t *recent_alloc) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), tdata->lock);
 	assert(recent_alloc != NULL);
 	prof_recent_t *old_recent_alloc =
-	    edata_prof_recent_alloc_update_internal(tsd, edata, NULL);
+	    edata_prof_recent_alloc_update_internal(tsd, tdata, edata, NULL);
 	assert(old_recent_alloc == recent_alloc);
-	assert(edata == prof_recent_alloc_edata_get(tsd, recent_alloc));
-	prof_recent_alloc_edata_set(tsd, recent_alloc, NULL);
+	assert(edata == prof_recent_alloc_edata_get(tsd, tdata, recent_alloc));
+	prof_recent_alloc_edata_set(tsd, tdata, recent_alloc, NULL);
 }
 
 /*
@@ -203,7 +237,8 @@ prof_recent_alloc_reset(tsd_t *tsd, edata_t *edata) {
 		return;
 	}
 
-	prof_tctx_t *dalloc_tctx = prof_tctx_create(tsd);
+	prof_tctx_t *dalloc_tctx = prof_tctx_create(
+	    tsd, edata_arena_ind_get(edata));
 	/*
 	 * In case dalloc_tctx is NULL, e.g. due to OOM, we will not record the
 	 * deallocation time / tctx, which is handled later, after we check
@@ -217,9 +252,14 @@ prof_recent_alloc_reset(tsd_t *tsd, edata_t *edata) {
 		malloc_mutex_unlock(tsd_tsdn(tsd), dalloc_tctx->tdata->lock);
 	}
 
-	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	/*
+	 * The record is in the ring of the allocating thread, which the tctx
+	 * of the allocation keeps alive.
+	 */
+	prof_tdata_t *tdata = edata_prof_tctx_get(edata)->tdata;
+	malloc_mutex_lock(tsd_tsdn(tsd), tdata->lock);
 	/* Check again after acquiring the lock.  */
-	prof_recent_t *recent = edata_prof_recent_alloc_get(tsd, edata);
+	prof_recent_t *recent = edata_prof_recent_alloc_get(tsd, tdata, edata);
 	if (recent != NULL) {
 		assert(nstime_equals_zero(&recent->dalloc_time));
 		assert(recent->dalloc_tctx == NULL);
@@ -228,9 +268,9 @@ prof_recent_alloc_reset(tsd_t *tsd, edata_t *edata) {
 			recent->dalloc_tctx = dalloc_tctx;
 			dalloc_tctx = NULL;
 		}
-		edata_prof_recent_alloc_reset(tsd, edata, recent);
+		edata_prof_recent_alloc_reset(tsd, tdata, edata, recent);
 	}
-	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	malloc_mutex_unlock(tsd_tsdn(tsd), tdata->lock);
 
 	if (dalloc_tctx != NULL) {
 		/* We lost the rase - the allocation record was just gone. */
@@ -239,141 +279,175 @@ prof_recent_alloc_reset(tsd_t *tsd, edata_t *edata) {
 }
 
 static void
-prof_recent_alloc_evict_edata(tsd_t *tsd, prof_recent_t *recent_alloc) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	edata_t *edata = prof_recent_alloc_edata_get(tsd, recent_alloc);
+prof_recent_alloc_evict_edata(
+    tsd_t *tsd, prof_tdata_t *tdata, prof_recent_t *recent_alloc) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), tdata->lock);
+	edata_t *edata = prof_recent_alloc_edata_get(tsd, tdata, recent_alloc);
 	if (edata != NULL) {
-		edata_prof_recent_alloc_reset(tsd, edata, recent_alloc);
+		edata_prof_recent_alloc_reset(tsd, tdata, edata, recent_alloc);
 	}
 }
 
-static bool
-prof_recent_alloc_is_empty(tsd_t *tsd) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	if (ql_empty(&prof_recent_alloc_list)) {
-		assert(prof_recent_alloc_count == 0);
-		return true;
-	} else {
-		assert(prof_recent_alloc_count > 0);
-		return false;
+/* Moves the stale records at the head of the ring of tdata to to_delete. */
+static void
+prof_recent_alloc_trim_locked(tsd_t *tsd, prof_tdata_t *tdata, size_t seq,
+    ssize_t max, prof_recent_list_t *to_delete) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), tdata->lock);
+	prof_recent_t *node;
+	while ((node = ql_first(&tdata->recent_allocs)) != NULL
+	    && prof_recent_alloc_stale(node, seq, max)) {
+		ql_remove(&tdata->recent_allocs, node, link);
+		prof_recent_alloc_evict_edata(tsd, tdata, node);
+		ql_tail_insert(to_delete, node, link);
 	}
 }
 
 static void
-prof_recent_alloc_assert_count(tsd_t *tsd) {
+prof_recent_alloc_async_cleanup(tsd_t *tsd, prof_recent_list_t *to_delete) {
+	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_dump_mtx);
+	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	while (!ql_empty(to_delete)) {
+		prof_recent_t *node = ql_first(to_delete);
+		ql_remove(to_delete, node, link);
+		decrement_recent_count(tsd, node->alloc_tctx);
+		if (node->dalloc_tctx != NULL) {
+			decrement_recent_count(tsd, node->dalloc_tctx);
+		}
+		prof_recent_free_node(tsd_tsdn(tsd), node);
+		atomic_fetch_sub_zu(&prof_recent_alloc_count, 1, ATOMIC_RELAXED);
+	}
+}
+
+static void
+prof_recent_alloc_sweep_visit(tsdn_t *tsdn, prof_tdata_t *tdata, void *arg) {
+	tsd_t *tsd = tsdn_tsd(tsdn);
+	prof_recent_list_t *to_delete = (prof_recent_list_t *)arg;
+	malloc_mutex_lock(tsdn, tdata->lock);
+	prof_recent_alloc_trim_locked(tsd, tdata,
+	    atomic_load_zu(&prof_recent_alloc_seq, ATOMIC_RELAXED),
+	    prof_recent_alloc_max_get_no_lock(), to_delete);
+	malloc_mutex_unlock(tsdn, tdata->lock);
+}
+
+/*
+ * Moves the stale records of all the rings to to_delete, unless a dump is
+ * going on, which sweeps once it's done.
+ */
+static void
+prof_recent_alloc_sweep_locked(tsd_t *tsd, prof_recent_list_t *to_delete) {
 	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	if (!config_debug) {
+	ql_new(to_delete);
+	if (atomic_load_b(&prof_recent_alloc_dumping, ATOMIC_RELAXED)) {
 		return;
 	}
-	ssize_t        count = 0;
-	prof_recent_t *n;
-	ql_foreach (n, &prof_recent_alloc_list, link) {
-		++count;
+	prof_tdata_foreach(
+	    tsd_tsdn(tsd), prof_recent_alloc_sweep_visit, (void *)to_delete);
+}
+
+/*
+ * Stale records of threads which no longer allocate are only trimmed by
+ * sweeps; have one once there are as many of them as live ones.
+ */
+static void
+prof_recent_alloc_maybe_sweep(tsd_t *tsd) {
+	ssize_t max = prof_recent_alloc_max_get_no_lock();
+	if (max <= 0
+	    || atomic_load_zu(&prof_recent_alloc_count, ATOMIC_RELAXED)
+	        <= 2 * (size_t)max) {
+		return;
 	}
-	assert(count == prof_recent_alloc_count);
-	assert(prof_recent_alloc_max_get(tsd) == -1
-	    || count <= prof_recent_alloc_max_get(tsd));
+	/* Someone else is sweeping already. */
+	if (malloc_mutex_trylock(tsd_tsdn(tsd), &prof_recent_alloc_mtx)) {
+		return;
+	}
+	prof_recent_list_t to_delete;
+	prof_recent_alloc_sweep_locked(tsd, &to_delete);
+	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	prof_recent_alloc_async_cleanup(tsd, &to_delete);
 }
 
 void
 prof_recent_alloc(tsd_t *tsd, edata_t *edata, size_t size, size_t usize) {
 	cassert(config_prof);
 	assert(edata != NULL);
-	prof_tctx_t *tctx = edata_prof_tctx_get(edata);
+	prof_tctx_t  *tctx = edata_prof_tctx_get(edata);
+	prof_tdata_t *tdata = tctx->tdata;
 
-	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), tctx->tdata->lock);
-	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_alloc_assert_count(tsd);
+	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), tdata->lock);
+	malloc_mutex_lock(tsd_tsdn(tsd), tdata->lock);
 
 	/*
-	 * Reserve a new prof_recent_t node if needed.  If needed, we release
-	 * the prof_recent_alloc_mtx lock and allocate.  Then, rather than
-	 * immediately checking for OOM, we regain the lock and try to make use
-	 * of the reserve node if needed.  There are six scenarios:
-	 *
-	 *          \ now | no need | need but OOMed | need and allocated
-	 *     later \    |         |                |
-	 *    ------------------------------------------------------------
-	 *     no need    |   (1)   |      (2)       |         (3)
-	 *    ------------------------------------------------------------
-	 *     need       |   (4)   |      (5)       |         (6)
-	 *
-	 * First, "(4)" never happens, because we don't release the lock in the
-	 * middle if there's no need for a new node; in such cases "(1)" always
-	 * takes place, which is trivial.
-	 *
-	 * Out of the remaining four scenarios, "(6)" is the common case and is
-	 * trivial.  "(5)" is also trivial, in which case we'll rollback the
-	 * effect of prof_recent_alloc_prepare() as expected.
-	 *
-	 * "(2)" / "(3)" occurs when the need for a new node is gone after we
-	 * regain the lock.  If the new node is successfully allocated, i.e. in
-	 * the case of "(3)", we'll release it in the end; otherwise, i.e. in
-	 * the case of "(2)", we do nothing - we're lucky that the OOM ends up
-	 * doing no harm at all.
-	 *
-	 * Therefore, the only performance cost of the "release lock" ->
-	 * "allocate" -> "regain lock" design is the "(3)" case, but it happens
-	 * very rarely, so the cost is relatively small compared to the gain of
-	 * not having to have the lock order of prof_recent_alloc_mtx above all
-	 * the allocation locks.
+	 * The record takes the place of the oldest stale one in the ring of the
+	 * thread, if any; otherwise a new one is reserved, for which we release
+	 * the lock and allocate.  Then, rather than immediately checking for
+	 * OOM, we regain the lock and make use of whichever is available:
+	 * while the lock is released, only the free of a recorded object can
+	 * change the ring, and the max or a dump can come and go, so the need
+	 * for the new record can either appear or vanish.  The latter is rare
+	 * and only costs an allocation, which is much better than having the
+	 * lock order of tdata->lock above all the allocation locks.
 	 */
 	prof_recent_t *reserve = NULL;
-	if (prof_recent_alloc_max_get(tsd) == -1
-	    || prof_recent_alloc_count < prof_recent_alloc_max_get(tsd)) {
-		assert(prof_recent_alloc_max_get(tsd) != 0);
-		malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	prof_recent_t *head = ql_first(&tdata->recent_allocs);
+	if (head == NULL
+	    || atomic_load_b(&prof_recent_alloc_dumping, ATOMIC_ACQUIRE)
+	    || !prof_recent_alloc_stale(head,
+	        atomic_load_zu(&prof_recent_alloc_seq, ATOMIC_RELAXED) + 1,
+	        prof_recent_alloc_max_get_no_lock())) {
+		malloc_mutex_unlock(tsd_tsdn(tsd), tdata->lock);
 		reserve = prof_recent_allocate_node(tsd_tsdn(tsd));
-		malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-		prof_recent_alloc_assert_count(tsd);
+		malloc_mutex_lock(tsd_tsdn(tsd), tdata->lock);
 	}
 
-	if (prof_recent_alloc_max_get(tsd) == 0) {
-		assert(prof_recent_alloc_is_empty(tsd));
+	ssize_t max = prof_recent_alloc_max_get_no_lock();
+	if (max == 0) {
 		goto label_rollback;
 	}
+	/*
+	 * Nothing is trimmed while dumping; the dump reads the records without
+	 * holding the lock.
+	 */
+	prof_recent_list_t to_delete;
+	ql_new(&to_delete);
+	if (!atomic_load_b(&prof_recent_alloc_dumping, ATOMIC_ACQUIRE)) {
+		prof_recent_alloc_trim_locked(tsd, tdata,
+		    atomic_load_zu(&prof_recent_alloc_seq, ATOMIC_RELAXED) + 1,
+		    max, &to_delete);
+	}
 
-	prof_tctx_t *old_alloc_tctx, *old_dalloc_tctx;
-	if (prof_recent_alloc_count == prof_recent_alloc_max_get(tsd)) {
-		/* If upper limit is reached, rotate the head. */
-		assert(prof_recent_alloc_max_get(tsd) != -1);
-		assert(!prof_recent_alloc_is_empty(tsd));
-		prof_recent_t *head = ql_first(&prof_recent_alloc_list);
-		old_alloc_tctx = head->alloc_tctx;
+	prof_tctx_t   *old_alloc_tctx, *old_dalloc_tctx;
+	prof_recent_t *node;
+	if (!ql_empty(&to_delete)) {
+		/* Reuse the newest stale record. */
+		node = ql_last(&to_delete, link);
+		ql_remove(&to_delete, node, link);
+		old_alloc_tctx = node->alloc_tctx;
 		assert(old_alloc_tctx != NULL);
-		old_dalloc_tctx = head->dalloc_tctx;
-		prof_recent_alloc_evict_edata(tsd, head);
-		ql_rotate(&prof_recent_alloc_list, link);
+		old_dalloc_tctx = node->dalloc_tctx;
 	} else {
-		/* Otherwise make use of the new node. */
-		assert(prof_recent_alloc_max_get(tsd) == -1
-		    || prof_recent_alloc_count
-		        < prof_recent_alloc_max_get(tsd));
 		if (reserve == NULL) {
 			goto label_rollback;
 		}
-		ql_elm_new(reserve, link);
-		ql_tail_insert(&prof_recent_alloc_list, reserve, link);
+		node = reserve;
 		reserve = NULL;
 		old_alloc_tctx = NULL;
 		old_dalloc_tctx = NULL;
-		++prof_recent_alloc_count;
-	}
-
-	/* Fill content into the tail node. */
-	prof_recent_t *tail = ql_last(&prof_recent_alloc_list, link);
-	assert(tail != NULL);
-	tail->size = size;
-	tail->usize = usize;
-	nstime_copy(&tail->alloc_time, edata_prof_alloc_time_get(edata));
-	tail->alloc_tctx = tctx;
-	nstime_init_zero(&tail->dalloc_time);
-	tail->dalloc_tctx = NULL;
-	edata_prof_recent_alloc_set(tsd, edata, tail);
-
-	assert(!prof_recent_alloc_is_empty(tsd));
-	prof_recent_alloc_assert_count(tsd);
-	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+		atomic_fetch_add_zu(&prof_recent_alloc_count, 1, ATOMIC_RELAXED);
+	}
+
+	/* Fill content into the node, and append it to the ring. */
+	node->seq = atomic_fetch_add_zu(
+	    &prof_recent_alloc_seq, 1, ATOMIC_RELAXED);
+	node->size = size;
+	node->usize = usize;
+	nstime_copy(&node->alloc_time, edata_prof_alloc_time_get(edata));
+	node->alloc_tctx = tctx;
+	nstime_init_zero(&node->dalloc_time);
+	node->dalloc_tctx = NULL;
+	ql_elm_new(node, link);
+	ql_tail_insert(&tdata->recent_allocs, node, link);
+	edata_prof_recent_alloc_set(tsd, tdata, edata, node);
+	malloc_mutex_unlock(tsd_tsdn(tsd), tdata->lock);
 
 	if (reserve != NULL) {
 		prof_recent_free_node(tsd_tsdn(tsd), reserve);
@@ -381,9 +455,7 @@ prof_recent_alloc(tsd_t *tsd, edata_t *edata, size_t size, size_t usize) {
 
 	/*
 	 * Asynchronously handle the tctx of the old node, so that there's no
-	 * simultaneous holdings of prof_recent_alloc_mtx and tdata->lock.
-	 * In the worst case this may delay the tctx release but it's better
-	 * than holding prof_recent_alloc_mtx for longer.
+	 * simultaneous holdings of tdata->lock of different threads.
 	 */
 	if (old_alloc_tctx != NULL) {
 		decrement_recent_count(tsd, old_alloc_tctx);
@@ -391,12 +463,13 @@ prof_recent_alloc(tsd_t *tsd, edata_t *edata, size_t size, size_t usize) {
 	if (old_dalloc_tctx != NULL) {
 		decrement_recent_count(tsd, old_dalloc_tctx);
 	}
+	prof_recent_alloc_async_cleanup(tsd, &to_delete);
+	prof_recent_alloc_maybe_sweep(tsd);
 	return;
 
 label_rollback:
-	assert(edata_prof_recent_alloc_get(tsd, edata) == NULL);
-	prof_recent_alloc_assert_count(tsd);
-	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	assert(edata_prof_recent_alloc_get(tsd, tdata, edata) == NULL);
+	malloc_mutex_unlock(tsd_tsdn(tsd), tdata->lock);
 	if (reserve != NULL) {
 		prof_recent_free_node(tsd_tsdn(tsd), reserve);
 	}
@@ -410,67 +483,88 @@ prof_recent_alloc_max_ctl_read(void) {
 	return prof_recent_alloc_max_get_no_lock();
 }
 
-static void
-prof_recent_alloc_restore_locked(tsd_t *tsd, prof_recent_list_t *to_delete) {
-	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	ssize_t max = prof_recent_alloc_max_get(tsd);
-	if (max == -1 || prof_recent_alloc_count <= max) {
-		/* Easy case - no need to alter the list. */
-		ql_new(to_delete);
-		prof_recent_alloc_assert_count(tsd);
-		return;
-	}
-
-	prof_recent_t *node;
-	ql_foreach (node, &prof_recent_alloc_list, link) {
-		if (prof_recent_alloc_count == max) {
-			break;
-		}
-		prof_recent_alloc_evict_edata(tsd, node);
-		--prof_recent_alloc_count;
-	}
-	assert(prof_recent_alloc_count == max);
-
-	ql_move(to_delete, &prof_recent_alloc_list);
-	if (max == 0) {
-		assert(node == NULL);
-	} else {
-		assert(node != NULL);
-		ql_split(to_delete, node, &prof_recent_alloc_list, link);
-	}
-	assert(!ql_empty(to_delete));
-	prof_recent_alloc_assert_count(tsd);
-}
-
-static void
-prof_recent_alloc_async_cleanup(tsd_t *tsd, prof_recent_list_t *to_delete) {
-	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_dump_mtx);
-	malloc_mutex_assert_not_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	while (!ql_empty(to_delete)) {
-		prof_recent_t *node = ql_first(to_delete);
-		ql_remove(to_delete, node, link);
-		decrement_recent_count(tsd, node->alloc_tctx);
-		if (node->dalloc_tctx != NULL) {
-			decrement_recent_count(tsd, node->dalloc_tctx);
-		}
-		prof_recent_free_node(tsd_tsdn(tsd), node);
-	}
-}
-
 ssize_t
 prof_recent_alloc_max_ctl_write(tsd_t *tsd, ssize_t max) {
 	cassert(config_prof);
 	assert(max >= -1);
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_alloc_assert_count(tsd);
 	const ssize_t      old_max = prof_recent_alloc_max_update(tsd, max);
 	prof_recent_list_t to_delete;
-	prof_recent_alloc_restore_locked(tsd, &to_delete);
+	prof_recent_alloc_sweep_locked(tsd, &to_delete);
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
 	prof_recent_alloc_async_cleanup(tsd, &to_delete);
 	return old_max;
 }
 
+typedef struct prof_recent_alloc_collect_s prof_recent_alloc_collect_t;
+struct prof_recent_alloc_collect_s {
+	/* The records with sequence numbers in [seq_min, seq_max). */
+	size_t          seq_min;
+	size_t          seq_max;
+	ssize_t         max;
+	prof_recent_t **records;
+};
+
+static void
+prof_recent_alloc_collect_visit(tsdn_t *tsdn, prof_tdata_t *tdata, void *arg) {
+	prof_recent_alloc_collect_t *collect =
+	    (prof_recent_alloc_collect_t *)arg;
+	malloc_mutex_lock(tsdn, tdata->lock);
+	prof_recent_t *node;
+	ql_foreach (node, &tdata->recent_allocs, link) {
+		size_t offset = node->seq - collect->seq_min;
+		if (offset >= collect->seq_max - collect->seq_min
+		    || prof_recent_alloc_stale(
+		        node, collect->seq_max, collect->max)) {
+			continue;
+		}
+		assert(collect->records[offset] == NULL);
+		collect->records[offset] = node;
+	}
+	malloc_mutex_unlock(tsdn, tdata->lock);
+}
+
+/*
+ * Merges the last max records of all the rings, oldest first, into an array
+ * which the caller frees.  Sets *nrecords to their number.  The records can
+ * only be read as long as none is removed, i.e. while dumping, or in tests
+ * which don't allocate meanwhile.
+ */
+static prof_recent_t **
+prof_recent_alloc_collect(tsd_t *tsd, size_t *nrecords) {
+	malloc_mutex_assert_owner(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	prof_recent_alloc_collect_t collect;
+	collect.max = prof_recent_alloc_max_get_no_lock();
+	collect.seq_max = atomic_load_zu(&prof_recent_alloc_seq, ATOMIC_RELAXED);
+	collect.seq_min = atomic_load_zu(
+	    &prof_recent_alloc_floor, ATOMIC_RELAXED);
+	if (collect.max != -1
+	    && collect.seq_max - collect.seq_min > (size_t)collect.max) {
+		collect.seq_min = collect.seq_max - (size_t)collect.max;
+	}
+	*nrecords = 0;
+	/* Every sequence number in range has one record, barring OOMs. */
+	size_t n = collect.seq_max - collect.seq_min;
+	if (n == 0) {
+		return NULL;
+	}
+	collect.records = (prof_recent_t **)iallocztm(tsd_tsdn(tsd),
+	    n * sizeof(prof_recent_t *),
+	    sz_size2index(n * sizeof(prof_recent_t *)), true, NULL, true,
+	    arena_get(tsd_tsdn(tsd), 0, false), true);
+	if (collect.records == NULL) {
+		return NULL;
+	}
+	prof_tdata_foreach(
+	    tsd_tsdn(tsd), prof_recent_alloc_collect_visit, (void *)&collect);
+	for (size_t i = 0; i < n; i++) {
+		if (collect.records[i] != NULL) {
+			collect.records[(*nrecords)++] = collect.records[i];
+		}
+	}
+	return collect.records;
+}
+
 static void
 prof_recent_alloc_dump_bt(emitter_t *emitter, prof_tctx_t *tctx) {
 	char  bt_buf[2 * sizeof(intptr_t) + 3];
@@ -542,15 +636,16 @@ prof_recent_alloc_dump(tsd_t *tsd, write_cb_t *write_cb, void *cbopaque) {
 	emitter_t emitter;
 	emitter_init(
 	    &emitter, emitter_output_json_compact, buf_writer_cb, &buf_writer);
-	prof_recent_list_t temp_list;
 
+	/*
+	 * Records keep being added while dumping, but none is removed until
+	 * the dump is done, so that they can be read without any lock.
+	 */
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_alloc_assert_count(tsd);
-	ssize_t dump_max = prof_recent_alloc_max_get(tsd);
-	ql_move(&temp_list, &prof_recent_alloc_list);
-	ssize_t dump_count = prof_recent_alloc_count;
-	prof_recent_alloc_count = 0;
-	prof_recent_alloc_assert_count(tsd);
+	atomic_store_b(&prof_recent_alloc_dumping, true, ATOMIC_RELEASE);
+	ssize_t         dump_max = prof_recent_alloc_max_get_no_lock();
+	size_t          nrecords;
+	prof_recent_t **records = prof_recent_alloc_collect(tsd, &nrecords);
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
 
 	emitter_begin(&emitter);
@@ -560,32 +655,55 @@ prof_recent_alloc_dump(tsd_t *tsd, write_cb_t *write_cb, void *cbopaque) {
 	emitter_json_kv(
 	    &emitter, "recent_alloc_max", emitter_type_ssize, &dump_max);
 	emitter_json_array_kv_begin(&emitter, "recent_alloc");
-	prof_recent_t *node;
-	ql_foreach (node, &temp_list, link) {
-		prof_recent_alloc_dump_node(&emitter, node);
+	for (size_t i = 0; i < nrecords; i++) {
+		prof_recent_alloc_dump_node(&emitter, records[i]);
 	}
 	emitter_json_array_end(&emitter);
 	emitter_end(&emitter);
 
+	if (records != NULL) {
+		idalloctm(tsd_tsdn(tsd), records, NULL, NULL, true, true);
+	}
+	prof_recent_list_t to_delete;
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
-	prof_recent_alloc_assert_count(tsd);
-	ql_concat(&temp_list, &prof_recent_alloc_list, link);
-	ql_move(&prof_recent_alloc_list, &temp_list);
-	prof_recent_alloc_count += dump_count;
-	prof_recent_alloc_restore_locked(tsd, &temp_list);
+	atomic_store_b(&prof_recent_alloc_dumping, false, ATOMIC_RELEASE);
+	prof_recent_alloc_sweep_locked(tsd, &to_delete);
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
 
 	buf_writer_terminate(tsd_tsdn(tsd), &buf_writer);
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_dump_mtx);
 
-	prof_recent_alloc_async_cleanup(tsd, &temp_list);
+	prof_recent_alloc_async_cleanup(tsd, &to_delete);
 }
 #undef PROF_RECENT_PRINT_BUFSIZE
 
+/* Used in unit tests. */
+size_t
+prof_recent_alloc_records_test(prof_recent_t **records, size_t limit) {
+	cassert(config_prof);
+	tsd_t *tsd = tsd_fetch();
+	malloc_mutex_lock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	size_t          nrecords;
+	prof_recent_t **all = prof_recent_alloc_collect(tsd, &nrecords);
+	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_recent_alloc_mtx);
+	if (nrecords > limit) {
+		nrecords = limit;
+	}
+	if (all != NULL) {
+		memcpy(records, all, nrecords * sizeof(prof_recent_t *));
+		idalloctm(tsd_tsdn(tsd), all, NULL, NULL, true, true);
+	}
+	return nrecords;
+}
+
 bool
 prof_recent_init(void) {
 	cassert(config_prof);
 	prof_recent_alloc_max_init();
+	atomic_store_zu(&prof_recent_alloc_seq, 0, ATOMIC_RELAXED);
+	atomic_store_zu(&prof_recent_alloc_floor, 0, ATOMIC_RELAXED);
+	atomic_store_zu(&prof_recent_alloc_count, 0, ATOMIC_RELAXED);
+	atomic_store_b(&prof_recent_alloc_dumping, false, ATOMIC_RELAXED);
 
 	if (malloc_mutex_init(&prof_recent_alloc_mtx, "prof_recent_alloc",
 	        WITNESS_RANK_PROF_RECENT_ALLOC, malloc_mutex_rank_exclusive)) {
@@ -597,7 +715,5 @@ prof_recent_init(void) {
 		return true;
 	}
 
-	ql_new(&prof_recent_alloc_list);
-
 	return false;
 }
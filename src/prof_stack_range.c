@@ -154,7 +154,17 @@ prof_thread_stack_range(uintptr_t fp, uintptr_t *low, uintptr_t *high) {
 	char maps_path[64]; // "/proc/<pid>/task/<tid>/maps"
 	malloc_snprintf(maps_path, sizeof(maps_path), "/proc/%d/task/%d/maps",
 	    getpid(), gettid());
-	return prof_mapping_containing_addr(fp, maps_path, low, high);
+	int ret = prof_mapping_containing_addr(fp, maps_path, low, high);
+	if (ret != 0) {
+		/*
+		 * Some sandboxes don't expose the per-task maps files.  All
+		 * threads share the address space, so the process-wide map
+		 * lists the same mappings.
+		 */
+		ret = prof_mapping_containing_addr(
+		    fp, "/proc/self/maps", low, high);
+	}
+	return ret;
 }
 
 #else
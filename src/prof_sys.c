@@ -40,6 +40,7 @@ malloc_mutex_t prof_dump_filename_mtx;
 static uint64_t prof_dump_seq;
 static uint64_t prof_dump_iseq;
 static uint64_t prof_dump_mseq;
+static uint64_t prof_dump_dseq;
 static uint64_t prof_dump_useq;
 
 static char *prof_prefix = NULL;
@@ -53,6 +54,7 @@ bt_init(prof_bt_t *bt, void **vec) {
 
 	bt->vec = vec;
 	bt->len = 0;
+	bt->arena_ind = 0;
 }
 
 #ifdef JEMALLOC_PROF_MSVC
@@ -76,7 +78,7 @@ prof_backtrace_impl(void **vec, unsigned *len, unsigned max_len) {
 
 #ifdef JEMALLOC_PROF_LIBUNWIND
 static void
-prof_backtrace_impl(void **vec, unsigned *len, unsigned max_len) {
+prof_backtrace_libunwind(void **vec, unsigned *len, unsigned max_len) {
 	int nframes;
 
 	cassert(config_prof);
@@ -90,7 +92,9 @@ prof_backtrace_impl(void **vec, unsigned *len, unsigned max_len) {
 	}
 	*len = nframes;
 }
-#elif (defined(JEMALLOC_PROF_LIBGCC))
+#endif
+
+#ifdef JEMALLOC_PROF_LIBGCC
 static _Unwind_Reason_Code
 prof_unwind_init_callback(struct _Unwind_Context *context, void *arg) {
 	cassert(config_prof);
@@ -119,7 +123,7 @@ prof_unwind_callback(struct _Unwind_Context *context, void *arg) {
 }
 
 static void
-prof_backtrace_impl(void **vec, unsigned *len, unsigned max_len) {
+prof_backtrace_libgcc(void **vec, unsigned *len, unsigned max_len) {
 	prof_unwind_data_t data = {vec, len, max_len};
 
 	cassert(config_prof);
@@ -128,103 +132,151 @@ prof_backtrace_impl(void **vec, unsigned *len, unsigned max_len) {
 
 	_Unwind_Backtrace(prof_unwind_callback, &data);
 }
-#elif (defined(JEMALLOC_PROF_FRAME_POINTER))
+#endif
+
+/*
+ * The frame pointer unwinder comes first: when jemalloc is built with frame
+ * pointers it is by far the cheapest way to capture a backtrace, and whichever
+ * DWARF based unwinder is also available serves as its fallback.
+ */
+#if defined(JEMALLOC_PROF_FRAME_POINTER)
 JEMALLOC_DIAGNOSTIC_PUSH
 JEMALLOC_DIAGNOSTIC_IGNORE_FRAME_ADDRESS
 
-struct stack_range {
-	uintptr_t start;
-	uintptr_t end;
-};
+/* Unwinds without relying on frame pointers, for when they can't be trusted. */
+static void
+prof_backtrace_fallback(void **vec, unsigned *len, unsigned max_len) {
+#	if defined(JEMALLOC_PROF_LIBUNWIND)
+	prof_backtrace_libunwind(vec, len, max_len);
+#	elif defined(JEMALLOC_PROF_LIBGCC)
+	prof_backtrace_libgcc(vec, len, max_len);
+#	else
+	/*
+	 * Using the backtrace from execinfo.h here.  Note that it may get
+	 * redirected to libunwind when a libunwind not built with build-time
+	 * flag --disable-weak-backtrace is linked.
+	 */
+	int nframes = backtrace(vec, max_len);
+	if (nframes > 0) {
+		*len = nframes;
+	} else {
+		*len = 0;
+	}
+#	endif
+}
 
-struct thread_unwind_info {
-	struct stack_range stack_range;
-	bool               fallback;
-};
-static __thread struct thread_unwind_info unwind_info = {
-    .stack_range =
-        {
-            .start = 0,
-            .end = 0,
-        },
-    .fallback = false,
-}; /* thread local */
+/*
+ * A frame that a well-formed frame pointer chain could not have produced: the
+ * caller's frame must be above (the stack grows down) and aligned, and the
+ * return address can't point into the first page.  A caller frame outside of
+ * the stack isn't suspicious by itself; it ends the walk, as it does for the
+ * outermost frames of threads whose entry points omit frame pointers.
+ */
+static bool
+prof_frame_suspicious(const prof_stack_range_t *stack_range, uintptr_t fp,
+    uintptr_t next_fp, void *ip) {
+	if ((uintptr_t)ip < PAGE) {
+		return true;
+	}
+	if (next_fp < stack_range->low || next_fp >= stack_range->high) {
+		return false;
+	}
+	return next_fp <= fp || (next_fp & (sizeof(void *) - 1)) != 0;
+}
 
 static void
 prof_backtrace_impl(void **vec, unsigned *len, unsigned max_len) {
 	/* fp: 		current stack frame pointer
 	 *
-	 * stack_range:	readable stack memory range for the current thread.
+	 * stack_range:	readable stack memory range for the current thread,
+	 *		cached in tsd the first time the thread unwinds.
 	 *		Used to validate frame addresses during stack unwinding.
 	 *		For most threads there is a single valid stack range
 	 *		that is fixed at thread creation time.  This may not be
 	 *		the case when folly fibers or boost contexts are used.
-	 *		In those cases fall back to using execinfo backtrace()
-	 *		(DWARF unwind).
+	 *		In those cases fall back to DWARF unwinding.
 	 */
+	cassert(config_prof);
+	assert(vec != NULL);
+	assert(max_len <= PROF_BT_MAX_LIMIT);
 
 	/* always safe to get the current stack frame address */
-	uintptr_t fp = (uintptr_t)__builtin_frame_address(0);
+	uintptr_t           fp = (uintptr_t)__builtin_frame_address(0);
+	prof_stack_range_t *stack_range = tsd_prof_stack_rangep_get(
+	    tsd_fetch());
 
 	/* new thread - get the stack range */
-	if (!unwind_info.fallback
-	    && unwind_info.stack_range.start == unwind_info.stack_range.end) {
-		if (prof_thread_stack_range(fp, &unwind_info.stack_range.start,
-		        &unwind_info.stack_range.end)
+	if (!stack_range->fallback && stack_range->low == stack_range->high) {
+		if (prof_thread_stack_range(
+		        fp, &stack_range->low, &stack_range->high)
 		    != 0) {
-			unwind_info.fallback = true;
+			stack_range->fallback = true;
 		} else {
-			assert(fp >= unwind_info.stack_range.start
-			    && fp < unwind_info.stack_range.end);
+			assert(fp >= stack_range->low && fp < stack_range->high);
 		}
 	}
 
-	if (unwind_info.fallback) {
+	if (stack_range->fallback) {
 		goto label_fallback;
 	}
 
 	unsigned ii = 0;
 	while (ii < max_len && fp != 0) {
-		if (fp < unwind_info.stack_range.start
-		    || fp >= unwind_info.stack_range.end) {
+		if (fp < stack_range->low
+		    || fp + 2 * sizeof(void *) > stack_range->high) {
+			if (ii != 0) {
+				/* Walked past the outermost frame. */
+				break;
+			}
 			/*
 			 * Determining the stack range from procfs can be
 			 * relatively expensive especially for programs with
 			 * many threads / shared libraries.  If the stack
 			 * range has changed, it is likely to change again
 			 * in the future (fibers or some other stack
-			 * manipulation).  So fall back to backtrace for this
-			 * thread.
+			 * manipulation).  So fall back for this thread.
 			 */
-			unwind_info.fallback = true;
+			stack_range->fallback = true;
 			goto label_fallback;
 		}
 		void *ip = ((void **)fp)[1];
 		if (ip == 0) {
 			break;
 		}
+		uintptr_t next_fp = ((uintptr_t *)fp)[0];
+		if (opt_prof_unwind_validate
+		    && prof_frame_suspicious(stack_range, fp, next_fp, ip)) {
+			/*
+			 * Most likely a frame of code built without frame
+			 * pointers.  Only this sample is affected, so don't
+			 * give up on frame pointers for the thread.
+			 */
+			*len = 0;
+			prof_backtrace_fallback(vec, len, max_len);
+			return;
+		}
 		vec[ii++] = ip;
-		fp = ((uintptr_t *)fp)[0];
+		fp = next_fp;
 	}
 	*len = ii;
 	return;
 
 label_fallback:
-	/*
-	 * Using the backtrace from execinfo.h here.  Note that it may get
-	 * redirected to libunwind when a libunwind not built with build-time
-	 * flag --disable-weak-backtrace is linked.
-	 */
-	assert(unwind_info.fallback);
-	int nframes = backtrace(vec, max_len);
-	if (nframes > 0) {
-		*len = nframes;
-	} else {
-		*len = 0;
-	}
+	assert(stack_range->fallback);
+	prof_backtrace_fallback(vec, len, max_len);
 }
 
 JEMALLOC_DIAGNOSTIC_POP
+#elif defined(JEMALLOC_PROF_LIBUNWIND)
+static void
+prof_backtrace_impl(void **vec, unsigned *len, unsigned max_len) {
+	prof_backtrace_libunwind(vec, len, max_len);
+}
+#elif defined(JEMALLOC_PROF_LIBGCC)
+static void
+prof_backtrace_impl(void **vec, unsigned *len, unsigned max_len) {
+	prof_backtrace_libgcc(vec, len, max_len);
+}
 #elif (defined(JEMALLOC_PROF_GCC))
 JEMALLOC_DIAGNOSTIC_PUSH
 JEMALLOC_DIAGNOSTIC_IGNORE_FRAME_ADDRESS
@@ -736,6 +788,48 @@ prof_dump_flush(void *opaque, const char *s) {
 	}
 }
 
+/*
+ * Binary dumps can't go through buf_writer_t, which deals in strings; they are
+ * buffered in prof_dump_buf directly.
+ */
+typedef struct prof_dump_bin_arg_s prof_dump_bin_arg_t;
+struct prof_dump_bin_arg_s {
+	prof_dump_arg_t *arg;
+	size_t           buf_end;
+};
+
+static void
+prof_dump_bin_flush(prof_dump_bin_arg_t *bin_arg) {
+	prof_dump_arg_t *arg = bin_arg->arg;
+	if (!arg->error && bin_arg->buf_end != 0) {
+		ssize_t err = prof_dump_write_file(
+		    arg->prof_dump_fd, prof_dump_buf, bin_arg->buf_end);
+		prof_dump_check_possible_error(arg, err == -1,
+		    "<jemalloc>: failed to write during heap profile flush\n");
+	}
+	bin_arg->buf_end = 0;
+}
+
+static void
+prof_dump_bin_write(void *opaque, const void *buf, size_t len) {
+	cassert(config_prof);
+	prof_dump_bin_arg_t *bin_arg = (prof_dump_bin_arg_t *)opaque;
+	const char          *s = (const char *)buf;
+	while (len > 0) {
+		if (bin_arg->buf_end == PROF_DUMP_BUFSIZE) {
+			prof_dump_bin_flush(bin_arg);
+		}
+		size_t n = PROF_DUMP_BUFSIZE - bin_arg->buf_end;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(prof_dump_buf + bin_arg->buf_end, s, n);
+		bin_arg->buf_end += n;
+		s += n;
+		len -= n;
+	}
+}
+
 static void
 prof_dump_close(prof_dump_arg_t *arg) {
 	if (arg->prof_dump_fd != -1) {
@@ -921,8 +1015,8 @@ prof_dump_maps(buf_writer_t *buf_writer) {
 #endif /* __APPLE__ */
 
 static bool
-prof_dump(
-    tsd_t *tsd, bool propagate_err, const char *filename, bool leakcheck) {
+prof_dump(tsd_t *tsd, bool propagate_err, const char *filename, bool leakcheck,
+    bool delta) {
 	cassert(config_prof);
 	assert(tsd_reentrancy_level_get(tsd) == 0);
 
@@ -938,14 +1032,27 @@ prof_dump(
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_dump_mtx);
 
 	prof_dump_open(&arg, filename);
+	if (opt_prof_dump_format == prof_dump_format_binary) {
+		prof_dump_bin_arg_t bin_arg = {&arg, 0};
+		prof_dump_binary_impl(tsd, prof_dump_bin_write, &bin_arg,
+		    tdata, leakcheck, delta);
+		prof_dump_bin_flush(&bin_arg);
+	}
 	buf_writer_t buf_writer;
 	bool err = buf_writer_init(tsd_tsdn(tsd), &buf_writer, prof_dump_flush,
 	    &arg, prof_dump_buf, PROF_DUMP_BUFSIZE);
 	assert(!err);
-	prof_dump_impl(tsd, buf_writer_cb, &buf_writer, tdata, leakcheck);
+	if (opt_prof_dump_format == prof_dump_format_text) {
+		prof_dump_impl(tsd, buf_writer_cb, &buf_writer, tdata,
+		    leakcheck, delta);
+	}
+	/* In binary dumps, the newline ending the records comes from here. */
 	prof_dump_maps(&buf_writer);
 	buf_writer_terminate(tsd_tsdn(tsd), &buf_writer);
 	prof_dump_close(&arg);
+	if (delta && arg.error) {
+		prof_dump_delta_failed(tsd_tsdn(tsd));
+	}
 
 	prof_dump_hook_t dump_hook = prof_dump_hook_get();
 	if (dump_hook != NULL) {
@@ -1049,7 +1156,7 @@ prof_fdump_impl(tsd_t *tsd) {
 	malloc_mutex_lock(tsd_tsdn(tsd), &prof_dump_filename_mtx);
 	prof_dump_filename(tsd, filename, 'f', VSEQ_INVALID);
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_dump_filename_mtx);
-	prof_dump(tsd, false, filename, opt_prof_leak);
+	prof_dump(tsd, false, filename, opt_prof_leak, false);
 }
 
 bool
@@ -1091,11 +1198,11 @@ prof_idump_impl(tsd_t *tsd) {
 	prof_dump_filename(tsd, filename, 'i', prof_dump_iseq);
 	prof_dump_iseq++;
 	malloc_mutex_unlock(tsd_tsdn(tsd), &prof_dump_filename_mtx);
-	prof_dump(tsd, false, filename, false);
+	prof_dump(tsd, false, filename, false, false);
 }
 
-bool
-prof_mdump_impl(tsd_t *tsd, const char *filename) {
+static bool
+prof_mdump_common(tsd_t *tsd, const char *filename, bool delta) {
 	char filename_buf[DUMP_FILENAME_BUFSIZE];
 	if (filename == NULL) {
 		/* No filename specified, so automatically generate one. */
@@ -1105,12 +1212,29 @@ prof_mdump_impl(tsd_t *tsd, const char *filename) {
 			    tsd_tsdn(tsd), &prof_dump_filename_mtx);
 			return true;
 		}
-		prof_dump_filename(tsd, filename_buf, 'm', prof_dump_mseq);
-		prof_dump_mseq++;
+		if (delta) {
+			prof_dump_filename(
+			    tsd, filename_buf, 'd', prof_dump_dseq);
+			prof_dump_dseq++;
+		} else {
+			prof_dump_filename(
+			    tsd, filename_buf, 'm', prof_dump_mseq);
+			prof_dump_mseq++;
+		}
 		malloc_mutex_unlock(tsd_tsdn(tsd), &prof_dump_filename_mtx);
 		filename = filename_buf;
 	}
-	return prof_dump(tsd, true, filename, false);
+	return prof_dump(tsd, true, filename, false, delta);
+}
+
+bool
+prof_mdump_impl(tsd_t *tsd, const char *filename) {
+	return prof_mdump_common(tsd, filename, false);
+}
+
+bool
+prof_ddump_impl(tsd_t *tsd, const char *filename) {
+	return prof_mdump_common(tsd, filename, true);
 }
 
 void
@@ -1125,5 +1249,5 @@ prof_gdump_impl(tsd_t *tsd) {
 	prof_dump_filename(tsd, filename, 'u', prof_dump_useq);
 	prof_dump_useq++;
 	malloc_mutex_unlock(tsdn, &prof_dump_filename_mtx);
-	prof_dump(tsd, false, filename, false);
+	prof_dump(tsd, false, filename, false, false);
 }
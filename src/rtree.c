@@ -180,6 +180,7 @@ rtree_leaf_elm_lookup_hard(tsdn_t *tsdn, rtree_t *rtree, rtree_ctx_t *rtree_ctx,
 			assert(rtree_ctx->l2_cache[i].leafkey != leafkey);
 		}
 	}
+	RTREE_CTX_STATS_INC(rtree_ctx, misses);
 
 #define RTREE_GET_CHILD(level)                                                 \
 	{                                                                      \
@@ -214,6 +215,11 @@ rtree_leaf_elm_lookup_hard(tsdn_t *tsdn, rtree_t *rtree, rtree_ctx_t *rtree_ctx,
 		if (!dependent && unlikely(!rtree_leaf_valid(leaf))) {         \
 			return NULL;                                           \
 		}                                                              \
+		if (config_rtree_ctx_stats                                     \
+		    && rtree_ctx->l2_cache[RTREE_CTX_NCACHE_L2 - 1].leafkey    \
+		        != RTREE_LEAFKEY_INVALID) {                            \
+			RTREE_CTX_STATS_INC(rtree_ctx, evictions);             \
+		}                                                              \
 		if (RTREE_CTX_NCACHE_L2 > 1) {                                 \
 			memmove(&rtree_ctx->l2_cache[1],                       \
 			    &rtree_ctx->l2_cache[0],                           \
@@ -259,4 +265,23 @@ rtree_ctx_data_init(rtree_ctx_t *ctx) {
 		cache->leafkey = RTREE_LEAFKEY_INVALID;
 		cache->leaf = NULL;
 	}
+	rtree_ctx_stats_reset(ctx);
+}
+
+bool
+rtree_ctx_stats_read(rtree_ctx_t *ctx, rtree_ctx_stats_t *r_stats) {
+#ifdef JEMALLOC_RTREE_CTX_STATS
+	*r_stats = ctx->stats;
+	return false;
+#else
+	memset(r_stats, 0, sizeof(*r_stats));
+	return true;
+#endif
+}
+
+void
+rtree_ctx_stats_reset(rtree_ctx_t *ctx) {
+#ifdef JEMALLOC_RTREE_CTX_STATS
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+#endif
 }
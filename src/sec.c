@@ -325,6 +325,11 @@ sec_shard_dalloc_and_unlock(
 	 * reasonable.
 	 */
 	sec_bin_t *bin = &shard->bins[pszind];
+	/*
+	 * The owner may have written to the extent, so it no longer reads as
+	 * zero, whatever the fallback said when it handed it out.
+	 */
+	edata_zeroed_set(edata, false);
 	edata_list_active_prepend(&bin->freelist, edata);
 	bin->bytes_cur += size;
 	shard->bytes_cur += size;
@@ -147,12 +147,35 @@ mutex_stats_init_cols(emitter_row_t *row, const char *table_name,
 	col_uint64_t[mutex_counter_total_wait_time_ps].width = 10;
 }
 
+/*
+ * Reads the hold time histogram of the mutex whose node is at mib[0..miblen);
+ * it is only queried if any holds were sampled.
+ */
+static void
+mutex_stats_read_hold_hist(size_t mib[], size_t miblen,
+    uint64_t num_hold_samples,
+    uint64_t hold_hist[MUTEX_PROF_HOLD_HIST_NBUCKETS]) {
+	memset(hold_hist, 0, sizeof(uint64_t) * MUTEX_PROF_HOLD_HIST_NBUCKETS);
+	if (num_hold_samples == 0) {
+		return;
+	}
+	size_t hist_mib[CTL_MAX_DEPTH];
+	memcpy(hist_mib, mib, sizeof(size_t) * miblen);
+	CTL_LEAF_PREPARE(hist_mib, miblen, "hold_hist");
+	for (unsigned k = 0; k < MUTEX_PROF_HOLD_HIST_NBUCKETS; k++) {
+		hist_mib[miblen + 1] = k;
+		size_t sz = sizeof(uint64_t);
+		xmallctlbymib(
+		    hist_mib, miblen + 2, (void *)&hold_hist[k], &sz, NULL, 0);
+	}
+}
+
 static void
 mutex_stats_read_global(size_t mib[], size_t miblen, const char *name,
     emitter_col_t *col_name,
     emitter_col_t  col_uint64_t[mutex_prof_num_uint64_t_counters],
     emitter_col_t  col_uint32_t[mutex_prof_num_uint32_t_counters],
-    uint64_t       uptime) {
+    uint64_t hold_hist[MUTEX_PROF_HOLD_HIST_NBUCKETS], uint64_t uptime) {
 	CTL_LEAF_PREPARE(mib, miblen, name);
 	size_t miblen_name = miblen + 1;
 
@@ -177,6 +200,9 @@ mutex_stats_read_global(size_t mib[], size_t miblen, const char *name,
 #undef OP
 #undef EMITTER_TYPE_uint32_t
 #undef EMITTER_TYPE_uint64_t
+
+	mutex_stats_read_hold_hist(mib, miblen_name,
+	    col_uint64_t[mutex_counter_num_hold_samples].uint64_val, hold_hist);
 }
 
 static void
@@ -184,7 +210,7 @@ mutex_stats_read_arena(size_t mib[], size_t miblen, const char *name,
     emitter_col_t *col_name,
     emitter_col_t  col_uint64_t[mutex_prof_num_uint64_t_counters],
     emitter_col_t  col_uint32_t[mutex_prof_num_uint32_t_counters],
-    uint64_t       uptime) {
+    uint64_t hold_hist[MUTEX_PROF_HOLD_HIST_NBUCKETS], uint64_t uptime) {
 	CTL_LEAF_PREPARE(mib, miblen, name);
 	size_t miblen_name = miblen + 1;
 
@@ -209,13 +235,16 @@ mutex_stats_read_arena(size_t mib[], size_t miblen, const char *name,
 #undef OP
 #undef EMITTER_TYPE_uint32_t
 #undef EMITTER_TYPE_uint64_t
+
+	mutex_stats_read_hold_hist(mib, miblen_name,
+	    col_uint64_t[mutex_counter_num_hold_samples].uint64_val, hold_hist);
 }
 
 static void
 mutex_stats_read_arena_bin(size_t mib[], size_t miblen,
     emitter_col_t col_uint64_t[mutex_prof_num_uint64_t_counters],
     emitter_col_t col_uint32_t[mutex_prof_num_uint32_t_counters],
-    uint64_t      uptime) {
+    uint64_t hold_hist[MUTEX_PROF_HOLD_HIST_NBUCKETS], uint64_t uptime) {
 	CTL_LEAF_PREPARE(mib, miblen, "mutex");
 	size_t miblen_mutex = miblen + 1;
 
@@ -239,28 +268,63 @@ mutex_stats_read_arena_bin(size_t mib[], size_t miblen,
 #undef OP
 #undef EMITTER_TYPE_uint32_t
 #undef EMITTER_TYPE_uint64_t
+
+	mutex_stats_read_hold_hist(mib, miblen_mutex,
+	    col_uint64_t[mutex_counter_num_hold_samples].uint64_val, hold_hist);
+}
+
+/* Prints the non-empty hold time histogram buckets on one table line. */
+static void
+mutex_stats_hold_hist_print(
+    emitter_t *emitter, const uint64_t hold_hist[MUTEX_PROF_HOLD_HIST_NBUCKETS]) {
+	bool empty = true;
+	for (unsigned k = 0; k < MUTEX_PROF_HOLD_HIST_NBUCKETS; k++) {
+		if (hold_hist[k] != 0) {
+			empty = false;
+			break;
+		}
+	}
+	if (empty) {
+		return;
+	}
+	emitter_table_printf(emitter, "%21s", "hold_ns:");
+	for (unsigned k = 0; k < MUTEX_PROF_HOLD_HIST_NBUCKETS; k++) {
+		if (hold_hist[k] == 0) {
+			continue;
+		}
+		uint64_t lower = (k == 0)
+		    ? 0
+		    : UINT64_C(1) << (MUTEX_PROF_HOLD_HIST_LG_MIN + k - 1);
+		if (k == MUTEX_PROF_HOLD_HIST_NBUCKETS - 1) {
+			emitter_table_printf(emitter, " [%" FMTu64 ",):%" FMTu64,
+			    lower, hold_hist[k]);
+		} else {
+			emitter_table_printf(emitter,
+			    " [%" FMTu64 ",%" FMTu64 "):%" FMTu64, lower,
+			    UINT64_C(1) << (MUTEX_PROF_HOLD_HIST_LG_MIN + k),
+			    hold_hist[k]);
+		}
+	}
+	emitter_table_printf(emitter, "\n");
 }
 
 /* "row" can be NULL to avoid emitting in table mode. */
 static void
 mutex_stats_emit(emitter_t *emitter, emitter_row_t *row,
     emitter_col_t col_uint64_t[mutex_prof_num_uint64_t_counters],
-    emitter_col_t col_uint32_t[mutex_prof_num_uint32_t_counters]) {
+    emitter_col_t col_uint32_t[mutex_prof_num_uint32_t_counters],
+    const uint64_t hold_hist[MUTEX_PROF_HOLD_HIST_NBUCKETS]) {
 	if (row != NULL) {
 		emitter_table_row(emitter, row);
 	}
 
-	mutex_prof_uint64_t_counter_ind_t k_uint64_t = 0;
-	mutex_prof_uint32_t_counter_ind_t k_uint32_t = 0;
-
 	emitter_col_t *col;
 
 #define EMITTER_TYPE_uint32_t emitter_type_uint32
 #define EMITTER_TYPE_uint64_t emitter_type_uint64
 #define OP(counter, type, human, derived, base_counter)                        \
 	if (!derived) {                                                        \
-		col = &col_##type[k_##type];                                   \
-		++k_##type;                                                    \
+		col = &col_##type[mutex_counter_##counter];                    \
 		emitter_json_kv(emitter, #counter, EMITTER_TYPE_##type,        \
 		    (const void *)&col->bool_val);                             \
 	}
@@ -268,6 +332,15 @@ mutex_stats_emit(emitter_t *emitter, emitter_row_t *row,
 #undef OP
 #undef EMITTER_TYPE_uint32_t
 #undef EMITTER_TYPE_uint64_t
+
+	emitter_json_array_kv_begin(emitter, "hold_hist");
+	for (unsigned k = 0; k < MUTEX_PROF_HOLD_HIST_NBUCKETS; k++) {
+		emitter_json_value(emitter, emitter_type_uint64, &hold_hist[k]);
+	}
+	emitter_json_array_end(emitter);
+	if (row != NULL) {
+		mutex_stats_hold_hist_print(emitter, hold_hist);
+	}
 }
 
 #define COL_DECLARE(column_name) emitter_col_t col_##column_name;
@@ -320,6 +393,12 @@ stats_arena_bins_print(
 
 	bool prof_stats_on = config_prof && opt_prof && opt_prof_stats
 	    && i == MALLCTL_ARENAS_ALL;
+	bool hugepage_slabs_on = false;
+	for (j = 0; j < nbins; j++) {
+		if (arena_slab_hugepage_regions[j] != 0) {
+			hugepage_slabs_on = true;
+		}
+	}
 
 	COL_HDR(row, size, NULL, right, 20, size)
 	COL_HDR(row, ind, NULL, right, 4, unsigned)
@@ -344,6 +423,15 @@ stats_arena_bins_print(
 	COL_HDR(row, curregs, NULL, right, 13, size)
 	COL_HDR(row, curslabs, NULL, right, 13, size)
 	COL_HDR(row, nonfull_slabs, NULL, right, 15, size)
+	COL_HDR_DECLARE(hugepage_regions);
+	COL_HDR_DECLARE(hugepage_curslabs);
+	COL_HDR_DECLARE(hugepage_unused_bytes);
+	if (hugepage_slabs_on) {
+		COL_HDR_INIT(row, hugepage_regions, NULL, right, 17, size)
+		COL_HDR_INIT(row, hugepage_curslabs, NULL, right, 18, size)
+		COL_HDR_INIT(
+		    row, hugepage_unused_bytes, NULL, right, 22, size)
+	}
 	COL_HDR(row, regs, NULL, right, 5, unsigned)
 	COL_HDR(row, pgs, NULL, right, 4, size)
 	/* To buffer a right- and left-justified column. */
@@ -366,6 +454,7 @@ stats_arena_bins_print(
 
 	emitter_col_t header_mutex64[mutex_prof_num_uint64_t_counters];
 	emitter_col_t header_mutex32[mutex_prof_num_uint32_t_counters];
+	uint64_t      hold_hist_mutex[MUTEX_PROF_HOLD_HIST_NBUCKETS];
 
 	if (mutex) {
 		mutex_stats_init_cols(
@@ -401,6 +490,8 @@ stats_arena_bins_print(
 		size_t       reg_size, slab_size, curregs;
 		size_t       curslabs;
 		size_t       nonfull_slabs;
+		size_t       hugepage_regions, hugepage_curslabs;
+		size_t       hugepage_unused_bytes;
 		uint32_t     nregs, nshards;
 		uint64_t     nmalloc, ndalloc, nrequests, nfills, nflushes;
 		uint64_t     nreslabs;
@@ -451,10 +542,16 @@ stats_arena_bins_print(
 		CTL_LEAF(stats_arenas_mib, 5, "curslabs", &curslabs, size_t);
 		CTL_LEAF(stats_arenas_mib, 5, "nonfull_slabs", &nonfull_slabs,
 		    size_t);
+		CTL_LEAF(stats_arenas_mib, 5, "hugepage_regions",
+		    &hugepage_regions, size_t);
+		CTL_LEAF(stats_arenas_mib, 5, "hugepage_curslabs",
+		    &hugepage_curslabs, size_t);
+		CTL_LEAF(stats_arenas_mib, 5, "hugepage_unused_bytes",
+		    &hugepage_unused_bytes, size_t);
 
 		if (mutex) {
 			mutex_stats_read_arena_bin(stats_arenas_mib, 5,
-			    col_mutex64, col_mutex32, uptime);
+			    col_mutex64, col_mutex32, hold_hist_mutex, uptime);
 		}
 
 		emitter_json_object_begin(emitter);
@@ -486,10 +583,16 @@ stats_arena_bins_print(
 		    emitter, "curslabs", emitter_type_size, &curslabs);
 		emitter_json_kv(emitter, "nonfull_slabs", emitter_type_size,
 		    &nonfull_slabs);
+		emitter_json_kv(emitter, "hugepage_regions", emitter_type_size,
+		    &hugepage_regions);
+		emitter_json_kv(emitter, "hugepage_curslabs", emitter_type_size,
+		    &hugepage_curslabs);
+		emitter_json_kv(emitter, "hugepage_unused_bytes",
+		    emitter_type_size, &hugepage_unused_bytes);
 		if (mutex) {
 			emitter_json_object_kv_begin(emitter, "mutex");
-			mutex_stats_emit(
-			    emitter, NULL, col_mutex64, col_mutex32);
+			mutex_stats_emit(emitter, NULL, col_mutex64,
+			    col_mutex32, hold_hist_mutex);
 			emitter_json_object_end(emitter);
 		}
 		emitter_json_object_end(emitter);
@@ -534,6 +637,12 @@ stats_arena_bins_print(
 		col_curregs.size_val = curregs;
 		col_curslabs.size_val = curslabs;
 		col_nonfull_slabs.size_val = nonfull_slabs;
+		if (hugepage_slabs_on) {
+			col_hugepage_regions.size_val = hugepage_regions;
+			col_hugepage_curslabs.size_val = hugepage_curslabs;
+			col_hugepage_unused_bytes.size_val =
+			    hugepage_unused_bytes;
+		}
 		col_regs.unsigned_val = nregs;
 		col_pgs.size_val = slab_size / page;
 		col_util.str_val = util;
@@ -1102,6 +1211,7 @@ stats_arena_mutexes_print(
 	emitter_col_t col_name;
 	emitter_col_t col64[mutex_prof_num_uint64_t_counters];
 	emitter_col_t col32[mutex_prof_num_uint32_t_counters];
+	uint64_t      hold_hist[MUTEX_PROF_HOLD_HIST_NBUCKETS];
 
 	emitter_row_init(&row);
 	mutex_stats_init_cols(&row, "", &col_name, col64, col32);
@@ -1118,9 +1228,9 @@ stats_arena_mutexes_print(
 	     i++) {
 		const char *name = arena_mutex_names[i];
 		emitter_json_object_kv_begin(emitter, name);
-		mutex_stats_read_arena(
-		    stats_arenas_mib, 4, name, &col_name, col64, col32, uptime);
-		mutex_stats_emit(emitter, &row, col64, col32);
+		mutex_stats_read_arena(stats_arenas_mib, 4, name, &col_name,
+		    col64, col32, hold_hist, uptime);
+		mutex_stats_emit(emitter, &row, col64, col32, hold_hist);
 		emitter_json_object_end(emitter); /* Close the mutex dict. */
 	}
 	emitter_json_object_end(emitter); /* End "mutexes". */
@@ -1137,7 +1247,7 @@ stats_arena_print(emitter_t *emitter, unsigned i, bool bins, bool large,
 	ssize_t     dirty_decay_ms, muzzy_decay_ms;
 	size_t      page, pactive, pdirty, pmuzzy, mapped, retained;
 	size_t      base, internal, resident, metadata_edata, metadata_rtree,
-	    metadata_thp, extent_avail;
+	    metadata_thp, metadata_reclaimable, extent_avail;
 	uint64_t dirty_npurge, dirty_nmadvise, dirty_purged;
 	uint64_t muzzy_npurge, muzzy_nmadvise, muzzy_purged;
 	size_t   small_allocated;
@@ -1145,8 +1255,10 @@ stats_arena_print(emitter_t *emitter, unsigned i, bool bins, bool large,
 	    small_nflushes;
 	size_t   large_allocated;
 	uint64_t large_nmalloc, large_ndalloc, large_nrequests, large_nfills,
-	    large_nflushes;
+	    large_nflushes, large_zeroed_bytes, large_zero_skipped_bytes;
 	size_t   tcache_bytes, tcache_stashed_bytes, abandoned_vm;
+	uint64_t tcache_gc_nflushes_avoided, tcache_gc_bytes_saved;
+	uint64_t tcache_steal_attempts, tcache_steal_successes;
 	uint64_t uptime;
 
 	CTL_GET("arenas.page", &page, size_t);
@@ -1378,6 +1490,16 @@ stats_arena_print(emitter_t *emitter, unsigned i, bool bins, bool large,
 	    col_count_nflushes.uint64_val, uptime);
 
 	emitter_table_row(emitter, &alloc_count_row);
+
+	/* Zeroing stats are emitted in table mode with the memory stats below. */
+	CTL_M2_GET("stats.arenas.0.large.zeroed_bytes", i, &large_zeroed_bytes,
+	    uint64_t);
+	emitter_json_kv(emitter, "zeroed_bytes", emitter_type_uint64,
+	    &large_zeroed_bytes);
+	CTL_M2_GET("stats.arenas.0.large.zero_skipped_bytes", i,
+	    &large_zero_skipped_bytes, uint64_t);
+	emitter_json_kv(emitter, "zero_skipped_bytes", emitter_type_uint64,
+	    &large_zero_skipped_bytes);
 	emitter_json_object_end(emitter); /* Close "large". */
 
 #undef GET_AND_EMIT_ALLOC_STAT
@@ -1441,6 +1563,7 @@ stats_arena_print(emitter_t *emitter, unsigned i, bool bins, bool large,
 	GET_AND_EMIT_MEM_STAT(metadata_edata)
 	GET_AND_EMIT_MEM_STAT(metadata_rtree)
 	GET_AND_EMIT_MEM_STAT(metadata_thp)
+	GET_AND_EMIT_MEM_STAT(metadata_reclaimable)
 	GET_AND_EMIT_MEM_STAT(tcache_bytes)
 	GET_AND_EMIT_MEM_STAT(tcache_stashed_bytes)
 	GET_AND_EMIT_MEM_STAT(resident)
@@ -1448,6 +1571,44 @@ stats_arena_print(emitter_t *emitter, unsigned i, bool bins, bool large,
 	GET_AND_EMIT_MEM_STAT(extent_avail)
 #undef GET_AND_EMIT_MEM_STAT
 
+	mem_count_val.type = emitter_type_uint64;
+	mem_count_title.str_val = "large zeroed:";
+	mem_count_val.uint64_val = large_zeroed_bytes;
+	emitter_table_row(emitter, &mem_count_row);
+	mem_count_title.str_val = "large zero skipped:";
+	mem_count_val.uint64_val = large_zero_skipped_bytes;
+	emitter_table_row(emitter, &mem_count_row);
+
+	CTL_M2_GET("stats.arenas.0.tcache_gc_nflushes_avoided", i,
+	    &tcache_gc_nflushes_avoided, uint64_t);
+	emitter_json_kv(emitter, "tcache_gc_nflushes_avoided",
+	    emitter_type_uint64, &tcache_gc_nflushes_avoided);
+	CTL_M2_GET("stats.arenas.0.tcache_gc_bytes_saved", i,
+	    &tcache_gc_bytes_saved, uint64_t);
+	emitter_json_kv(emitter, "tcache_gc_bytes_saved", emitter_type_uint64,
+	    &tcache_gc_bytes_saved);
+	mem_count_title.str_val = "tcache gc flushes avoided:";
+	mem_count_val.uint64_val = tcache_gc_nflushes_avoided;
+	emitter_table_row(emitter, &mem_count_row);
+	mem_count_title.str_val = "tcache gc bytes saved:";
+	mem_count_val.uint64_val = tcache_gc_bytes_saved;
+	emitter_table_row(emitter, &mem_count_row);
+
+	CTL_M2_GET("stats.arenas.0.tcache_steal_attempts", i,
+	    &tcache_steal_attempts, uint64_t);
+	emitter_json_kv(emitter, "tcache_steal_attempts", emitter_type_uint64,
+	    &tcache_steal_attempts);
+	CTL_M2_GET("stats.arenas.0.tcache_steal_successes", i,
+	    &tcache_steal_successes, uint64_t);
+	emitter_json_kv(emitter, "tcache_steal_successes", emitter_type_uint64,
+	    &tcache_steal_successes);
+	mem_count_title.str_val = "tcache steal attempts:";
+	mem_count_val.uint64_val = tcache_steal_attempts;
+	emitter_table_row(emitter, &mem_count_row);
+	mem_count_title.str_val = "tcache steal successes:";
+	mem_count_val.uint64_val = tcache_steal_successes;
+	emitter_table_row(emitter, &mem_count_row);
+
 	if (mutex) {
 		stats_arena_mutexes_print(emitter, i, uptime);
 	}
@@ -1610,6 +1771,7 @@ stats_general_print(emitter_t *emitter) {
 	OPT_WRITE_UNSIGNED("narenas")
 	OPT_WRITE_CHAR_P("percpu_arena")
 	OPT_WRITE_SIZE_T("oversize_threshold")
+	OPT_WRITE_SIZE_T("large_remap_threshold")
 	OPT_WRITE_BOOL("hpa")
 	OPT_WRITE_SIZE_T("hpa_slab_max_alloc")
 	OPT_WRITE_SIZE_T("hpa_hugification_threshold")
@@ -1645,19 +1807,29 @@ stats_general_print(emitter_t *emitter) {
 	OPT_WRITE_SIZE_T("hpa_sec_batch_fill_extra")
 	OPT_WRITE_BOOL("huge_arena_pac_thp")
 	OPT_WRITE_CHAR_P("metadata_thp")
+	OPT_WRITE_BOOL("metadata_reclaim")
 	OPT_WRITE_INT64("mutex_max_spin")
+	OPT_WRITE_UNSIGNED("mutex_hold_sample")
 	OPT_WRITE_BOOL_MUTABLE("background_thread", "background_thread")
 	OPT_WRITE_SSIZE_T_MUTABLE("dirty_decay_ms", "arenas.dirty_decay_ms")
 	OPT_WRITE_SSIZE_T_MUTABLE("muzzy_decay_ms", "arenas.muzzy_decay_ms")
 	OPT_WRITE_SIZE_T("lg_extent_max_active_fit")
+	OPT_WRITE_SIZE_T("edata_cache_percpu_max")
 	OPT_WRITE_CHAR_P("junk")
 	OPT_WRITE_BOOL("zero")
 	OPT_WRITE_BOOL("utrace")
 	OPT_WRITE_BOOL("xmalloc")
 	OPT_WRITE_BOOL("experimental_infallible_new")
 	OPT_WRITE_BOOL("experimental_tcache_gc")
+	OPT_WRITE_BOOL("experimental_tcache_gc_reuse")
+	OPT_WRITE_SSIZE_T("tcache_idle_reclaim_ms")
+	OPT_WRITE_SSIZE_T("tcache_ncached_max_learn_ms")
 	OPT_WRITE_BOOL("tcache")
 	OPT_WRITE_SIZE_T("tcache_max")
+	OPT_WRITE_SIZE_T("tcache_large_cache_bytes")
+	OPT_WRITE_SIZE_T("tcache_large_cache_max")
+	OPT_WRITE_BOOL("tcache_steal")
+	OPT_WRITE_BOOL("tcache_fill_sort")
 	OPT_WRITE_UNSIGNED("tcache_nslots_small_min")
 	OPT_WRITE_UNSIGNED("tcache_nslots_small_max")
 	OPT_WRITE_UNSIGNED("tcache_nslots_large")
@@ -1681,6 +1853,13 @@ stats_general_print(emitter_t *emitter) {
 	OPT_WRITE_BOOL("prof_final")
 	OPT_WRITE_BOOL("prof_leak")
 	OPT_WRITE_BOOL("prof_leak_error")
+	OPT_WRITE_CHAR_P("prof_dump_format")
+	OPT_WRITE_BOOL("prof_lifetime")
+	OPT_WRITE_BOOL("prof_per_arena")
+	OPT_WRITE_BOOL("prof_log_stream")
+	OPT_WRITE_SIZE_T("prof_log_stream_buf_size")
+	OPT_WRITE_UNSIGNED("prof_leak_epochs")
+	OPT_WRITE_UINT64("prof_leak_epoch_ms")
 	OPT_WRITE_BOOL("stats_print")
 	OPT_WRITE_CHAR_P("stats_print_opts")
 	OPT_WRITE_BOOL("stats_print")
@@ -1688,6 +1867,7 @@ stats_general_print(emitter_t *emitter) {
 	OPT_WRITE_INT64("stats_interval")
 	OPT_WRITE_CHAR_P("stats_interval_opts")
 	OPT_WRITE_CHAR_P("zero_realloc")
+	OPT_WRITE_CHAR_P("alloc_trace")
 	OPT_WRITE_SIZE_T("process_madvise_max_batch")
 	OPT_WRITE_BOOL("disable_large_size_classes")
 
@@ -1764,6 +1944,14 @@ stats_general_print(emitter_t *emitter) {
 		    "Maximum thread-cached size class", emitter_type_size, &sv);
 	}
 
+	const char *learned;
+	size_t      learned_sz = sizeof(learned);
+	if (je_mallctl("tcache.ncached_max_learned", (void *)&learned,
+	        &learned_sz, NULL, 0) == 0) {
+		emitter_kv(emitter, "tcache_ncached_max_learned",
+		    "Learned tcache_ncached_max", emitter_type_string, &learned);
+	}
+
 	unsigned arenas_nbins;
 	CTL_GET("arenas.nbins", &arenas_nbins, unsigned);
 	emitter_kv(emitter, "nbins", "Number of bin size classes",
@@ -1841,9 +2029,10 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 	 * the transition to the emitter code.
 	 */
 	size_t allocated, active, metadata, metadata_edata, metadata_rtree,
-	    metadata_thp, resident, mapped, retained;
+	    metadata_thp, metadata_reclaimable, metadata_pinned, resident,
+	    mapped, retained;
 	size_t   num_background_threads;
-	size_t   zero_reallocs;
+	size_t   zero_reallocs, tcache_idle_reclaimed;
 	uint64_t background_thread_num_runs, background_thread_run_interval;
 
 	CTL_GET("stats.allocated", &allocated, size_t);
@@ -1852,11 +2041,15 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 	CTL_GET("stats.metadata_edata", &metadata_edata, size_t);
 	CTL_GET("stats.metadata_rtree", &metadata_rtree, size_t);
 	CTL_GET("stats.metadata_thp", &metadata_thp, size_t);
+	CTL_GET("stats.metadata_reclaimable", &metadata_reclaimable, size_t);
+	CTL_GET("stats.metadata_pinned", &metadata_pinned, size_t);
 	CTL_GET("stats.resident", &resident, size_t);
 	CTL_GET("stats.mapped", &mapped, size_t);
 	CTL_GET("stats.retained", &retained, size_t);
 
 	CTL_GET("stats.zero_reallocs", &zero_reallocs, size_t);
+	CTL_GET("stats.tcache_idle_reclaimed_bytes", &tcache_idle_reclaimed,
+	    size_t);
 
 	if (have_background_thread) {
 		CTL_GET("stats.background_thread.num_threads",
@@ -1882,22 +2075,31 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 	    emitter, "metadata_rtree", emitter_type_size, &metadata_rtree);
 	emitter_json_kv(
 	    emitter, "metadata_thp", emitter_type_size, &metadata_thp);
+	emitter_json_kv(emitter, "metadata_reclaimable", emitter_type_size,
+	    &metadata_reclaimable);
+	emitter_json_kv(
+	    emitter, "metadata_pinned", emitter_type_size, &metadata_pinned);
 	emitter_json_kv(emitter, "resident", emitter_type_size, &resident);
 	emitter_json_kv(emitter, "mapped", emitter_type_size, &mapped);
 	emitter_json_kv(emitter, "retained", emitter_type_size, &retained);
 	emitter_json_kv(
 	    emitter, "zero_reallocs", emitter_type_size, &zero_reallocs);
+	emitter_json_kv(emitter, "tcache_idle_reclaimed_bytes",
+	    emitter_type_size, &tcache_idle_reclaimed);
 
 	emitter_table_printf(emitter,
 	    "Allocated: %zu, active: %zu, "
-	    "metadata: %zu (n_thp %zu, edata %zu, rtree %zu), resident: %zu, "
-	    "mapped: %zu, retained: %zu\n",
+	    "metadata: %zu (n_thp %zu, edata %zu, rtree %zu, reclaimable %zu, "
+	    "pinned %zu), resident: %zu, mapped: %zu, retained: %zu\n",
 	    allocated, active, metadata, metadata_thp, metadata_edata,
-	    metadata_rtree, resident, mapped, retained);
+	    metadata_rtree, metadata_reclaimable, metadata_pinned, resident,
+	    mapped, retained);
 
 	/* Strange behaviors */
 	emitter_table_printf(emitter,
 	    "Count of realloc(non-null-ptr, 0) calls: %zu\n", zero_reallocs);
+	emitter_table_printf(emitter,
+	    "Bytes reclaimed from idle tcaches: %zu\n", tcache_idle_reclaimed);
 
 	/* Background thread stats. */
 	emitter_json_object_kv_begin(emitter, "background_thread");
@@ -1920,6 +2122,7 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 		emitter_col_t name;
 		emitter_col_t col64[mutex_prof_num_uint64_t_counters];
 		emitter_col_t col32[mutex_prof_num_uint32_t_counters];
+		uint64_t      hold_hist[MUTEX_PROF_HOLD_HIST_NBUCKETS];
 		uint64_t      uptime;
 
 		emitter_row_init(&row);
@@ -1934,10 +2137,12 @@ stats_print_helper(emitter_t *emitter, bool merged, bool destroyed,
 		CTL_LEAF_PREPARE(stats_mutexes_mib, 0, "stats.mutexes");
 		for (int i = 0; i < mutex_prof_num_global_mutexes; i++) {
 			mutex_stats_read_global(stats_mutexes_mib, 2,
-			    global_mutex_names[i], &name, col64, col32, uptime);
+			    global_mutex_names[i], &name, col64, col32, hold_hist,
+			    uptime);
 			emitter_json_object_kv_begin(
 			    emitter, global_mutex_names[i]);
-			mutex_stats_emit(emitter, &row, col64, col32);
+			mutex_stats_emit(
+			    emitter, &row, col64, col32, hold_hist);
 			emitter_json_object_end(emitter);
 		}
 
@@ -7,6 +7,12 @@
 #include "jemalloc/internal/safety_check.h"
 #include "jemalloc/internal/san.h"
 #include "jemalloc/internal/sc.h"
+#include "jemalloc/internal/spin.h"
+
+#ifdef JEMALLOC_HAVE_MEMBARRIER
+#	include <linux/membarrier.h>
+#	include <sys/syscall.h>
+#endif
 
 /******************************************************************************/
 /* Data. */
@@ -58,6 +64,45 @@ size_t opt_tcache_gc_delay_bytes = 0;
 unsigned opt_lg_tcache_flush_small_div = 1;
 unsigned opt_lg_tcache_flush_large_div = 1;
 
+/*
+ * Size small bins by their observed reuse distance rather than by the
+ * low-water mark alone; see tcache_gc_small_reuse_nflush().
+ */
+bool opt_experimental_tcache_gc_reuse = false;
+
+/*
+ * Flush the whole tcache of a thread that has neither allocated nor
+ * deallocated for this many milliseconds; -1 disables.  See
+ * tcache_idle_reclaim_scan().
+ */
+ssize_t opt_tcache_idle_reclaim_ms = -1;
+
+atomic_zu_t tcache_idle_reclaimed_bytes = ATOMIC_INIT(0);
+bool        tcache_idle_reclaim_remote = false;
+/* When the next idle scan is due; claimed by CAS so only one thread scans. */
+static atomic_u64_t tcache_idle_scan_next_ns = ATOMIC_INIT(0);
+
+/*
+ * Per thread byte budget for large extents above tcache_max, and the largest
+ * size cached that way; 0 bytes disables.  See tcache_large_cache_alloc().
+ */
+size_t opt_tcache_large_cache_bytes = 0;
+size_t opt_tcache_large_cache_max = ((size_t)1) << 20;
+
+unsigned tcache_large_cache_nbins = 0;
+
+/*
+ * Hand the items an over-full small bin would flush to a thread whose bin ran
+ * empty, through the arena's tcache_handoff slots.
+ */
+bool opt_tcache_steal = false;
+
+/*
+ * Sort each small bin fill by address, so that consecutive allocations from
+ * the tcache return address-adjacent regions.
+ */
+bool opt_tcache_fill_sort = false;
+
 /*
  * Number of cache bins enabled, including both large and small.  This value
  * is only used to initialize tcache_nbins in the per-thread tcache.
@@ -83,6 +128,149 @@ static cache_bin_info_t opt_tcache_ncached_max[TCACHE_NBINS_MAX] = {{0}};
  */
 static bool opt_tcache_ncached_max_set[TCACHE_NBINS_MAX] = {0};
 
+/*
+ * ncached_max learning (opt.tcache_ncached_max_learn_ms).  For the first
+ * opt.tcache_ncached_max_learn_ms after boot, count per small bin how often
+ * tcaches had to go to the arena because a bin was empty (fills) or full
+ * (overflow flushes), and how many items GC found unused.  Once the window is
+ * over, the default ncached_max of bins that kept hitting the arena is grown,
+ * and that of bins which never did but held unused items is shrunk.  The
+ * result becomes the default for tcaches created from then on, and is
+ * available as a tcache_ncached_max setting string to be passed back in via
+ * malloc_conf.
+ */
+ssize_t opt_tcache_ncached_max_learn_ms = -1;
+
+#define TCACHE_LEARN_OFF 0
+#define TCACHE_LEARN_WARMUP 1
+#define TCACHE_LEARN_DONE 2
+/* Arena trips per second above which a bin's capacity is doubled. */
+#define TCACHE_LEARN_GROW_RATE 64
+/* Room for a "start-end:ncached_max|" setting per small bin. */
+#define TCACHE_LEARN_SETTINGS_BUFSIZE (SC_NBINS * 32)
+
+static atomic_u_t   tcache_learn_state = ATOMIC_INIT(TCACHE_LEARN_OFF);
+static uint64_t     tcache_learn_end_ns;
+static atomic_u64_t tcache_learn_nfills[SC_NBINS];
+static atomic_u64_t tcache_learn_noverflows[SC_NBINS];
+static atomic_u64_t tcache_learn_ngc_items[SC_NBINS];
+static cache_bin_info_t tcache_ncached_max_learned[TCACHE_NBINS_MAX];
+static char tcache_ncached_max_learned_settings[TCACHE_LEARN_SETTINGS_BUFSIZE];
+/* What new tcaches use; switched to the learned table once it's ready. */
+static atomic_p_t tcache_default_bin_info = ATOMIC_INIT(NULL);
+
+static bool
+tcache_ncached_max_learning(void) {
+	return atomic_load_u(&tcache_learn_state, ATOMIC_RELAXED)
+	    == TCACHE_LEARN_WARMUP;
+}
+
+static void
+tcache_learn_count(atomic_u64_t *counters, szind_t binind, uint64_t n) {
+	assert(binind < SC_NBINS);
+	if (unlikely(tcache_ncached_max_learning())) {
+		atomic_fetch_add_u64(&counters[binind], n, ATOMIC_RELAXED);
+	}
+}
+
+void
+tcache_ncached_max_learn_overflow(szind_t binind) {
+	tcache_learn_count(tcache_learn_noverflows, binind, 1);
+}
+
+static cache_bin_sz_t
+tcache_ncached_max_learn_bin(szind_t i, cache_bin_sz_t ncached_max,
+    uint64_t window_ms) {
+	uint64_t ntrips = atomic_load_u64(&tcache_learn_nfills[i],
+	                      ATOMIC_RELAXED)
+	    + atomic_load_u64(&tcache_learn_noverflows[i], ATOMIC_RELAXED);
+	uint64_t ngc_items = atomic_load_u64(
+	    &tcache_learn_ngc_items[i], ATOMIC_RELAXED);
+	unsigned learned = ncached_max;
+	if (ntrips * 1000 >= TCACHE_LEARN_GROW_RATE * window_ms) {
+		/* Double the capacity, twice if the bin was really busy. */
+		learned <<= 1;
+		if (ntrips * 1000 >= 16 * TCACHE_LEARN_GROW_RATE * window_ms) {
+			learned <<= 1;
+		}
+	} else if (ntrips == 0 && ngc_items > 0) {
+		learned >>= 1;
+	}
+	/* Keep it even and non-zero, like tcache_ncached_max_compute(). */
+	learned &= ~1U;
+	if (learned < 2) {
+		learned = 2;
+	}
+	if (learned > CACHE_BIN_NCACHED_MAX) {
+		learned = CACHE_BIN_NCACHED_MAX & ~1U;
+	}
+	return (cache_bin_sz_t)learned;
+}
+
+static void
+tcache_ncached_max_learn_finish(void) {
+	const cache_bin_info_t *defaults = opt_tcache_ncached_max;
+	uint64_t window_ms = opt_tcache_ncached_max_learn_ms > 0
+	    ? (uint64_t)opt_tcache_ncached_max_learn_ms
+	    : 1;
+	memcpy(tcache_ncached_max_learned, defaults,
+	    sizeof(tcache_ncached_max_learned));
+	char  *buf = tcache_ncached_max_learned_settings;
+	size_t len = 0;
+	buf[0] = '\0';
+	for (szind_t i = 0; i < SC_NBINS; i++) {
+		cache_bin_sz_t ncached_max = defaults[i].ncached_max;
+		/* Leave alone what malloc_conf asked for, and disabled bins. */
+		if (!opt_tcache_ncached_max_set[i] && ncached_max > 0) {
+			ncached_max = tcache_ncached_max_learn_bin(
+			    i, ncached_max, window_ms);
+			cache_bin_info_init(
+			    &tcache_ncached_max_learned[i], ncached_max);
+		}
+		/* Coalesce runs of bins with the same setting. */
+		szind_t j = i;
+		while (j + 1 < SC_NBINS && !opt_tcache_ncached_max_set[j + 1]
+		    && defaults[j + 1].ncached_max > 0
+		    && tcache_ncached_max_learn_bin(j + 1,
+		           defaults[j + 1].ncached_max, window_ms)
+		        == ncached_max) {
+			j++;
+			cache_bin_info_init(
+			    &tcache_ncached_max_learned[j], ncached_max);
+		}
+		len += malloc_snprintf(buf + len,
+		    TCACHE_LEARN_SETTINGS_BUFSIZE - len, "%s%zu-%zu:%u",
+		    len == 0 ? "" : "|", sz_index2size(i), sz_index2size(j),
+		    (unsigned)ncached_max);
+		assert(len < TCACHE_LEARN_SETTINGS_BUFSIZE);
+		i = j;
+	}
+	atomic_store_p(&tcache_default_bin_info, tcache_ncached_max_learned,
+	    ATOMIC_RELEASE);
+}
+
+static void
+tcache_ncached_max_learn_check(void) {
+	nstime_t now;
+	nstime_init_update(&now);
+	if (nstime_ns(&now) < tcache_learn_end_ns) {
+		return;
+	}
+	unsigned state = TCACHE_LEARN_WARMUP;
+	if (atomic_compare_exchange_strong_u(&tcache_learn_state, &state,
+	        TCACHE_LEARN_DONE, ATOMIC_ACQ_REL, ATOMIC_RELAXED)) {
+		tcache_ncached_max_learn_finish();
+	}
+}
+
+const char *
+tcache_ncached_max_learned_get(void) {
+	if (atomic_load_p(&tcache_default_bin_info, ATOMIC_ACQUIRE) == NULL) {
+		return NULL;
+	}
+	return tcache_ncached_max_learned_settings;
+}
+
 tcaches_t *tcaches;
 
 /* Index of first element within tcaches that has never been used. */
@@ -371,6 +559,109 @@ tcache_gc_small_bin_shuffle(cache_bin_t *cache_bin, cache_bin_sz_t nremote,
 	}
 }
 
+/*
+ * Reuse distance GC.  The cache bin is a LIFO stack, so an item freed and then
+ * reallocated after k more allocations than frees sits at depth k when it is
+ * reused.  Within a GC period, the stack never got deeper than the bin's
+ * ncached at the start of the period minus the low-water mark, while the items
+ * below the low-water mark sat idle for the whole period.  GC periods don't
+ * line up with the application's alloc / free cycles, so a single period may
+ * see only part of one; we track a peak envelope of the depth per bin instead
+ * of a plain average: it jumps up to any deeper reuse (or past the old target
+ * when the bin ran dry and needed a refill), and decays slowly otherwise.  The
+ * envelope plus some headroom acts as a soft ncached_max: GC flushes the idle
+ * items above it, and fills don't exceed it.  Unlike flushing a fixed fraction
+ * of the low-water items, this keeps items around for bursty bins that keep
+ * coming back to them, and keeps trimming bins whose demand drifts down.
+ */
+#define TCACHE_GC_REUSE_LG_FP 4
+#define TCACHE_GC_REUSE_LG_WEIGHT 3
+
+static void
+tcache_gc_reuse_init(tcache_slow_t *tcache_slow, szind_t szind,
+    cache_bin_sz_t ncached_max) {
+	assert(szind < SC_NBINS);
+	/* Start out conservatively, from the full capacity. */
+	tcache_slow->bin_reuse_depth_fp[szind] = (uint32_t)ncached_max
+	    << TCACHE_GC_REUSE_LG_FP;
+	tcache_slow->bin_gc_target[szind] = ncached_max;
+	tcache_slow->bin_gc_ncached[szind] = 0;
+}
+
+static cache_bin_sz_t
+tcache_gc_small_reuse_nflush(tcache_slow_t *tcache_slow,
+    cache_bin_t *cache_bin, szind_t szind, bool refilled,
+    cache_bin_sz_t ncached, cache_bin_sz_t low_water) {
+	cache_bin_sz_t ncached_max = cache_bin_ncached_max_get(cache_bin);
+	uint32_t       target = tcache_slow->bin_gc_target[szind];
+	cache_bin_sz_t start = tcache_slow->bin_gc_ncached[szind];
+	uint32_t       depth = start > low_water ? start - low_water : 0;
+	if (refilled) {
+		uint32_t grown = target + (target >> 1) + 1;
+		if (depth < grown) {
+			depth = grown;
+		}
+	}
+	if (depth > ncached_max) {
+		depth = ncached_max;
+	}
+
+	uint32_t *env = &tcache_slow->bin_reuse_depth_fp[szind];
+	uint32_t  depth_fp = depth << TCACHE_GC_REUSE_LG_FP;
+	if (depth_fp >= *env) {
+		*env = depth_fp;
+	} else {
+		*env -= (*env - depth_fp) >> TCACHE_GC_REUSE_LG_WEIGHT;
+	}
+	uint32_t env_items = *env >> TCACHE_GC_REUSE_LG_FP;
+	/* 25% headroom, and always room for at least one item. */
+	target = env_items + (env_items >> 2) + 1;
+	if (target > ncached_max) {
+		target = ncached_max;
+	}
+	tcache_slow->bin_gc_target[szind] = (cache_bin_sz_t)target;
+
+	/* Only ever flush items that went unused in this period. */
+	cache_bin_sz_t nflush = 0;
+	if (ncached > target) {
+		nflush = ncached - (cache_bin_sz_t)target;
+		if (nflush > low_water) {
+			nflush = low_water;
+		}
+	}
+
+	return nflush;
+}
+
+/*
+ * Compares what a reuse distance GC flushed with what the low-water policy
+ * would have flushed, after the same flush delay and remote pointer
+ * adjustments.
+ */
+static void
+tcache_gc_reuse_stats_update(tsd_t *tsd, tcache_slow_t *tcache_slow,
+    szind_t szind, cache_bin_sz_t nflush, cache_bin_sz_t nflush_low_water) {
+	if (!config_stats || !opt_experimental_tcache_gc_reuse) {
+		return;
+	}
+	if (nflush == 0 ? nflush_low_water == 0 : nflush <= nflush_low_water) {
+		return;
+	}
+	tsdn_t  *tsdn = tsd_tsdn(tsd);
+	arena_t *arena = tcache_slow->arena;
+	LOCKEDINT_MTX_LOCK(tsdn, arena->stats.mtx);
+	if (nflush == 0) {
+		locked_inc_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+		    &arena->stats.tcache_gc_nflushes_avoided, 1);
+	} else {
+		locked_inc_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+		    &arena->stats.tcache_gc_bytes_saved,
+		    (uint64_t)(nflush - nflush_low_water)
+		        * sz_index2size(szind));
+	}
+	LOCKEDINT_MTX_UNLOCK(tsdn, arena->stats.mtx);
+}
+
 static bool
 tcache_gc_small(
     tsd_t *tsd, tcache_slow_t *tcache_slow, tcache_t *tcache, szind_t szind) {
@@ -384,6 +675,7 @@ tcache_gc_small(
 	assert(!tcache_bin_disabled(szind, cache_bin, tcache->tcache_slow));
 	cache_bin_sz_t ncached = cache_bin_ncached_get_local(cache_bin);
 	cache_bin_sz_t low_water = cache_bin_low_water_get(cache_bin);
+	bool           refilled = tcache_slow->bin_refilled[szind];
 	if (low_water > 0) {
 		/*
 		 * There is unused items within the GC period => reduce fill count.
@@ -392,7 +684,7 @@ tcache_gc_small(
 		 */
 		tcache_nfill_small_gc_update(tcache_slow, szind,
 		    /* limit */ cache_bin_ncached_max_get(cache_bin));
-	} else if (tcache_slow->bin_refilled[szind]) {
+	} else if (refilled) {
 		/*
 		 * There has been refills within the GC period => increase fill count.
 		 * limit field set to 0 is borrowed to indicate that the fill count
@@ -404,11 +696,21 @@ tcache_gc_small(
 	assert(!tcache_slow->bin_refilled[szind]);
 
 	cache_bin_sz_t nflush = low_water - (low_water >> 2);
+	/* What the low-water policy flushes; only kept for the stats. */
+	cache_bin_sz_t nflush_low_water = nflush;
+	if (opt_experimental_tcache_gc_reuse) {
+		nflush = tcache_gc_small_reuse_nflush(tcache_slow, cache_bin,
+		    szind, refilled, ncached, low_water);
+	}
 	/*
 	 * When the new tcache gc is not enabled, keep the flush delay logic,
 	 * and directly flush the bottom nflush items if needed.
 	 */
 	if (!opt_experimental_tcache_gc) {
+		cache_bin_sz_t delay = tcache_slow->bin_flush_delay_items[szind];
+		if (nflush_low_water < delay) {
+			nflush_low_water = 0;
+		}
 		if (nflush < tcache_slow->bin_flush_delay_items[szind]) {
 			/* Workaround for a conversion warning. */
 			uint8_t nflush_uint8 = (uint8_t)nflush;
@@ -416,6 +718,9 @@ tcache_gc_small(
 			    == sizeof(nflush_uint8));
 			tcache_slow->bin_flush_delay_items[szind] -=
 			    nflush_uint8;
+			tcache_slow->bin_gc_ncached[szind] = ncached;
+			tcache_gc_reuse_stats_update(
+			    tsd, tcache_slow, szind, 0, nflush_low_water);
 			return false;
 		}
 
@@ -451,6 +756,9 @@ tcache_gc_small(
 	if (nremote > nflush) {
 		nflush = nremote;
 	}
+	if (nremote > nflush_low_water) {
+		nflush_low_water = nremote;
+	}
 	/*
 	 * When entering the locality check, nflush should be less than ncached,
 	 * otherwise the entire bin should be flushed regardless. The only case
@@ -473,8 +781,13 @@ tcache_gc_small(
 	tcache_gc_small_bin_shuffle(cache_bin, nremote, addr_min, addr_max);
 
 label_flush:
+	tcache_gc_reuse_stats_update(
+	    tsd, tcache_slow, szind, nflush, nflush_low_water);
+	/* The bin's low-water mark gets reset to what remains after GC. */
+	tcache_slow->bin_gc_ncached[szind] = ncached - nflush;
+	tcache_learn_count(tcache_learn_ngc_items, szind, nflush);
 	if (nflush == 0) {
-		assert(low_water == 0);
+		assert(low_water == 0 || opt_experimental_tcache_gc_reuse);
 		return false;
 	}
 	assert(nflush <= ncached);
@@ -503,6 +816,163 @@ tcache_gc_large(
 	return true;
 }
 
+/*
+ * Large extents above tcache_max.  Giving each of those size classes a cache
+ * bin would reserve ncached_max slots per class in every thread's cache bin
+ * stack, most of them never used; instead they share TCACHE_LARGE_CACHE_NSLOTS
+ * slots and a byte budget, looked up linearly.  Items are keyed by usize rather
+ * than szind, as without large size classes (opt.disable_large_size_classes)
+ * many usizes share a szind.
+ */
+static void
+tcache_large_cache_stats_merge(
+    tsdn_t *tsdn, tcache_slow_t *tcache_slow, arena_t *arena) {
+	cassert(config_stats);
+	for (szind_t i = SC_NBINS; i < tcache_large_cache_nbins; i++) {
+		uint64_t *nrequests =
+		    &tcache_slow->large_cache_nrequests[i - SC_NBINS];
+		if (*nrequests == 0) {
+			continue;
+		}
+		arena_stats_large_flush_nrequests_add(
+		    tsdn, &arena->stats, i, *nrequests);
+		*nrequests = 0;
+	}
+}
+
+static void
+tcache_large_cache_remove(
+    tcache_slow_t *tcache_slow, unsigned start, unsigned n) {
+	unsigned nitems = tcache_slow->large_cache_nitems;
+	assert(start + n <= nitems);
+	size_t nbytes = atomic_load_zu(
+	    &tcache_slow->large_cache_nbytes, ATOMIC_RELAXED);
+	for (unsigned i = start; i < start + n; i++) {
+		nbytes -= tcache_slow->large_cache_usizes[i];
+	}
+	atomic_store_zu(
+	    &tcache_slow->large_cache_nbytes, nbytes, ATOMIC_RELAXED);
+	unsigned nafter = nitems - start - n;
+	memmove(&tcache_slow->large_cache_ptrs[start],
+	    &tcache_slow->large_cache_ptrs[start + n], nafter * sizeof(void *));
+	memmove(&tcache_slow->large_cache_usizes[start],
+	    &tcache_slow->large_cache_usizes[start + n],
+	    nafter * sizeof(size_t));
+	nitems -= n;
+	tcache_slow->large_cache_nitems = nitems;
+	if (tcache_slow->large_cache_low_water > nitems) {
+		tcache_slow->large_cache_low_water = nitems;
+	}
+}
+
+/* Frees the nflush oldest items. */
+static void
+tcache_large_cache_flush(
+    tsd_t *tsd, tcache_slow_t *tcache_slow, unsigned nflush) {
+	if (nflush == 0) {
+		return;
+	}
+	/* Take the items out first; freeing them may end up back in here. */
+	void *ptrs[TCACHE_LARGE_CACHE_NSLOTS];
+	memcpy(ptrs, tcache_slow->large_cache_ptrs, nflush * sizeof(void *));
+	tcache_large_cache_remove(tcache_slow, 0, nflush);
+
+	tsdn_t *tsdn = tsd_tsdn(tsd);
+	for (unsigned i = 0; i < nflush; i++) {
+		edata_t *edata = emap_edata_lookup(
+		    tsdn, &arena_emap_global, ptrs[i]);
+		large_dalloc(tsdn, edata);
+	}
+}
+
+static void *
+tcache_large_cache_alloc_impl(
+    tcache_slow_t *tcache_slow, size_t usize, szind_t szind, bool zero) {
+	assert(szind >= SC_NBINS && tcache_large_cache_enabled(szind));
+	/* Newest first, as it's the most likely to still be in CPU cache. */
+	for (unsigned i = tcache_slow->large_cache_nitems; i-- > 0;) {
+		if (tcache_slow->large_cache_usizes[i] != usize) {
+			continue;
+		}
+		void *ret = tcache_slow->large_cache_ptrs[i];
+		tcache_large_cache_remove(tcache_slow, i, 1);
+		if (unlikely(zero)) {
+			memset(ret, 0, usize);
+		}
+		if (config_stats) {
+			tcache_slow->large_cache_nrequests[szind - SC_NBINS]++;
+		}
+		return ret;
+	}
+	return NULL;
+}
+
+void *
+tcache_large_cache_alloc(
+    tcache_t *tcache, size_t usize, szind_t szind, bool zero) {
+	tcache_slow_t *tcache_slow = tcache->tcache_slow;
+	tcache_owner_enter(tcache_slow);
+	void *ret = tcache_large_cache_alloc_impl(
+	    tcache_slow, usize, szind, zero);
+	tcache_owner_exit(tcache_slow);
+	return ret;
+}
+
+static bool
+tcache_large_cache_dalloc_impl(tsd_t *tsd, tcache_slow_t *tcache_slow,
+    void *ptr, size_t usize, szind_t szind) {
+	assert(szind >= SC_NBINS && tcache_large_cache_enabled(szind));
+	if (usize > opt_tcache_large_cache_max
+	    || usize > opt_tcache_large_cache_bytes) {
+		return false;
+	}
+	/* Make room by dropping the oldest items. */
+	unsigned nflush = 0;
+	size_t   nbytes = atomic_load_zu(
+	    &tcache_slow->large_cache_nbytes, ATOMIC_RELAXED);
+	while (tcache_slow->large_cache_nitems - nflush
+	        == TCACHE_LARGE_CACHE_NSLOTS
+	    || nbytes + usize > opt_tcache_large_cache_bytes) {
+		nbytes -= tcache_slow->large_cache_usizes[nflush];
+		nflush++;
+	}
+	tcache_large_cache_flush(tsd, tcache_slow, nflush);
+
+	unsigned i = tcache_slow->large_cache_nitems++;
+	assert(i < TCACHE_LARGE_CACHE_NSLOTS);
+	tcache_slow->large_cache_ptrs[i] = ptr;
+	tcache_slow->large_cache_usizes[i] = usize;
+	nbytes = atomic_load_zu(
+	    &tcache_slow->large_cache_nbytes, ATOMIC_RELAXED);
+	atomic_store_zu(
+	    &tcache_slow->large_cache_nbytes, nbytes + usize, ATOMIC_RELAXED);
+	return true;
+}
+
+bool
+tcache_large_cache_dalloc(
+    tsd_t *tsd, tcache_t *tcache, void *ptr, size_t usize, szind_t szind) {
+	tcache_slow_t *tcache_slow = tcache->tcache_slow;
+	tcache_owner_enter(tcache_slow);
+	bool ret = tcache_large_cache_dalloc_impl(
+	    tsd, tcache_slow, ptr, usize, szind);
+	tcache_owner_exit(tcache_slow);
+	return ret;
+}
+
+/* Like the large bins, flush 3/4 of the items untouched since the last GC. */
+static void
+tcache_large_cache_gc(tsd_t *tsd, tcache_slow_t *tcache_slow) {
+	unsigned low_water = tcache_slow->large_cache_low_water;
+	tcache_large_cache_flush(
+	    tsd, tcache_slow, low_water - (low_water >> 2));
+	if (config_stats) {
+		tcache_large_cache_stats_merge(
+		    tsd_tsdn(tsd), tcache_slow, tcache_slow->arena);
+	}
+	tcache_slow->large_cache_low_water = tcache_slow->large_cache_nitems;
+}
+
 /* Try to gc one bin by szind, return true if there is item flushed. */
 static bool
 tcache_try_gc_bin(
@@ -521,15 +991,320 @@ tcache_try_gc_bin(
 	return ret;
 }
 
+/*
+ * Idle tcache reclamation.  A tcache is idle once its owner has neither
+ * allocated nor deallocated anything for opt.tcache_idle_reclaim_ms, going by
+ * the owner's allocation counters.  The owner touches its cache bins without
+ * synchronization, on the malloc and free fast paths and in the slow paths
+ * bracketed by tcache_owner_enter() and tcache_owner_exit(), so the scan can
+ * only flush an idle tcache after keeping the owner out of all of them:
+ *
+ * - The scan moves reclaim_state from NONE to REQUESTED, and zeroes the
+ *   owner's event thresholds, which sends it down the slow paths.
+ * - membarrier(2) orders those stores against the owner's stores to
+ *   tcache_fastpath_busy and owner_depth, so that the owner doesn't need a
+ *   fence of its own: either the scan sees the owner busy and calls the
+ *   request off, or the owner sees the request in tcache_owner_enter() and
+ *   calls it off, or the owner doesn't touch its bins again before the scan
+ *   is done with them.
+ * - The scan then moves the tcache to RUNNING and flushes it.  An owner
+ *   coming back in the meantime waits in tcache_owner_enter(), and stays on
+ *   the slow paths if it gets to tsd_slow_update() first, in which case the
+ *   scan leaves DONE_SLOW behind for it to find.
+ *
+ * Without membarrier(2), the scan sets idle_reclaim_pending instead, and the
+ * owner flushes its tcache at its next GC event.
+ */
+static size_t
+tcache_cached_bytes_remote(tcache_slow_t *tcache_slow) {
+	cache_bin_t *bins = tcache_slow->cache_bin_array_descriptor.bins;
+	size_t       nbytes = 0;
+	for (szind_t i = 0; i < TCACHE_NBINS_MAX; i++) {
+		cache_bin_t *cache_bin = &bins[i];
+		if (cache_bin_disabled(cache_bin)) {
+			continue;
+		}
+		cache_bin_sz_t ncached, nstashed;
+		cache_bin_nitems_get_remote(cache_bin, &ncached, &nstashed);
+		nbytes += (size_t)(ncached + nstashed) * sz_index2size(i);
+	}
+	return nbytes;
+}
+
+/* How many idle tcaches a scan flushes remotely, at most. */
+#define TCACHE_IDLE_RECLAIM_MAX 16
+
+static void tcache_flush_cache(tsd_t *tsd, tcache_t *tcache);
+
+/* Returns true if the owner's fence couldn't be issued. */
+static bool
+tcache_idle_reclaim_fence(void) {
+#ifdef JEMALLOC_HAVE_MEMBARRIER
+	return syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0)
+	    != 0;
+#else
+	return true;
+#endif
+}
+
+/* Returns true if remote flushes were requested. */
+static bool
+tcache_idle_scan_arena(
+    tsdn_t *tsdn, arena_t *arena, uint64_t now_ns, uint64_t idle_ns) {
+	bool requested = false;
+	malloc_mutex_lock(tsdn, &arena->tcache_ql_mtx);
+	tcache_slow_t *tcache_slow;
+	ql_foreach (tcache_slow, &arena->tcache_ql, link) {
+		tsd_t *tsd = tcache_slow->tsd;
+		/* Explicit tcaches have no owner to watch. */
+		if (tsd == NULL || tsd == tsdn_tsd(tsdn)) {
+			continue;
+		}
+		uint64_t nbytes = *tsd_thread_allocatedp_get_unsafe(tsd)
+		    + *tsd_thread_deallocatedp_get_unsafe(tsd);
+		if (tcache_slow->idle_since_ns == 0
+		    || nbytes != tcache_slow->idle_seen_nbytes) {
+			tcache_slow->idle_seen_nbytes = nbytes;
+			tcache_slow->idle_since_ns = now_ns;
+			continue;
+		}
+		if (now_ns - tcache_slow->idle_since_ns < idle_ns
+		    || tcache_cached_bytes_remote(tcache_slow) == 0) {
+			continue;
+		}
+		uint32_t expected = TCACHE_RECLAIM_NONE;
+		if (!tcache_idle_reclaim_remote) {
+			atomic_store_b(&tcache_slow->idle_reclaim_pending, true,
+			    ATOMIC_RELAXED);
+		} else if (atomic_compare_exchange_strong_u32(
+		               &tcache_slow->reclaim_state, &expected,
+		               TCACHE_RECLAIM_REQUESTED, ATOMIC_RELAXED,
+		               ATOMIC_RELAXED)) {
+			if (tsd_force_recompute_one(tsdn, tsd)) {
+				requested = true;
+			} else {
+				atomic_store_u32(&tcache_slow->reclaim_state,
+				    TCACHE_RECLAIM_NONE, ATOMIC_RELAXED);
+			}
+		}
+	}
+	malloc_mutex_unlock(tsdn, &arena->tcache_ql_mtx);
+	return requested;
+}
+
+/*
+ * Claims the requested tcaches whose owners stayed away from their bins, and
+ * calls the other requests off.  Returns the new number of victims.
+ */
+static unsigned
+tcache_idle_claim_arena(tsdn_t *tsdn, arena_t *arena, bool fence_failed,
+    tcache_slow_t **victims, unsigned nvictims) {
+	malloc_mutex_lock(tsdn, &arena->tcache_ql_mtx);
+	tcache_slow_t *tcache_slow;
+	ql_foreach (tcache_slow, &arena->tcache_ql, link) {
+		if (atomic_load_u32(&tcache_slow->reclaim_state, ATOMIC_RELAXED)
+		    != TCACHE_RECLAIM_REQUESTED) {
+			continue;
+		}
+		bool busy = atomic_load_b(
+		                tsd_tcache_fastpath_busyp_get_unsafe(
+		                    tcache_slow->tsd),
+		                ATOMIC_ACQUIRE)
+		    || atomic_load_u32(&tcache_slow->owner_depth, ATOMIC_ACQUIRE)
+		        != 0;
+		bool     claim = !fence_failed && !busy
+		    && nvictims < TCACHE_IDLE_RECLAIM_MAX;
+		uint32_t expected = TCACHE_RECLAIM_REQUESTED;
+		if (claim
+		    && atomic_compare_exchange_strong_u32(
+		        &tcache_slow->reclaim_state, &expected,
+		        TCACHE_RECLAIM_RUNNING, ATOMIC_ACQUIRE,
+		        ATOMIC_RELAXED)) {
+			victims[nvictims++] = tcache_slow;
+			continue;
+		}
+		expected = TCACHE_RECLAIM_REQUESTED;
+		if (atomic_compare_exchange_strong_u32(
+		        &tcache_slow->reclaim_state, &expected,
+		        TCACHE_RECLAIM_NONE, ATOMIC_RELAXED, ATOMIC_RELAXED)
+		    && fence_failed) {
+			atomic_store_b(&tcache_slow->idle_reclaim_pending, true,
+			    ATOMIC_RELAXED);
+		}
+	}
+	malloc_mutex_unlock(tsdn, &arena->tcache_ql_mtx);
+	return nvictims;
+}
+
 static void
-tcache_gc_event(tsd_t *tsd) {
-	tcache_t *tcache = tcache_get(tsd);
-	if (tcache == NULL) {
+tcache_idle_flush_remote(tsdn_t *tsdn, tcache_slow_t *tcache_slow) {
+	size_t nbytes = 0;
+	if (config_stats) {
+		nbytes = tcache_cached_bytes_remote(tcache_slow)
+		    + atomic_load_zu(
+		        &tcache_slow->large_cache_nbytes, ATOMIC_RELAXED);
+	}
+	tcache_flush_cache(tsdn_tsd(tsdn), tcache_slow->tcache);
+	if (config_stats) {
+		atomic_fetch_add_zu(
+		    &tcache_idle_reclaimed_bytes, nbytes, ATOMIC_RELAXED);
+	}
+	/*
+	 * Once out of RUNNING, the owner may be gone, along with tcache_slow.
+	 */
+	uint32_t expected = TCACHE_RECLAIM_RUNNING;
+	if (!atomic_compare_exchange_strong_u32(&tcache_slow->reclaim_state,
+	        &expected, TCACHE_RECLAIM_NONE, ATOMIC_RELEASE,
+	        ATOMIC_RELAXED)) {
+		assert(expected == TCACHE_RECLAIM_RUNNING_SLOW);
+		atomic_store_u32(&tcache_slow->reclaim_state,
+		    TCACHE_RECLAIM_DONE_SLOW, ATOMIC_RELEASE);
+	}
+}
+
+void
+tcache_idle_reclaim_scan(tsdn_t *tsdn) {
+	if (opt_tcache_idle_reclaim_ms < 0) {
+		return;
+	}
+	assert(!tsdn_null(tsdn));
+	nstime_t now;
+	nstime_init_update(&now);
+	uint64_t now_ns = nstime_ns(&now);
+	uint64_t next_ns = atomic_load_u64(
+	    &tcache_idle_scan_next_ns, ATOMIC_RELAXED);
+	if (now_ns < next_ns) {
+		return;
+	}
+	/* Scan twice per idle period, so that idleness is caught in time. */
+	uint64_t idle_ns = (uint64_t)opt_tcache_idle_reclaim_ms * 1000 * 1000;
+	if (!atomic_compare_exchange_strong_u64(&tcache_idle_scan_next_ns,
+	        &next_ns, now_ns + idle_ns / 2 + 1, ATOMIC_RELAXED,
+	        ATOMIC_RELAXED)) {
+		/* Someone else is scanning. */
 		return;
 	}
 
-	tcache_slow_t *tcache_slow = tsd_tcache_slowp_get(tsd);
-	assert(tcache_slow != NULL);
+	unsigned narenas = narenas_total_get();
+	bool     requested = false;
+	for (unsigned i = 0; i < narenas; i++) {
+		arena_t *arena = arena_get(tsdn, i, false);
+		if (arena != NULL) {
+			requested |= tcache_idle_scan_arena(
+			    tsdn, arena, now_ns, idle_ns);
+		}
+	}
+	if (!requested) {
+		return;
+	}
+
+	bool           fence_failed = tcache_idle_reclaim_fence();
+	tcache_slow_t *victims[TCACHE_IDLE_RECLAIM_MAX];
+	unsigned       nvictims = 0;
+	for (unsigned i = 0; i < narenas; i++) {
+		arena_t *arena = arena_get(tsdn, i, false);
+		if (arena != NULL) {
+			nvictims = tcache_idle_claim_arena(
+			    tsdn, arena, fence_failed, victims, nvictims);
+		}
+	}
+	/*
+	 * Not under tcache_ql_mtx, which ranks below most of what a flush
+	 * takes; the owners can't get rid of their tcaches before the state
+	 * is back to NONE.
+	 */
+	for (unsigned i = 0; i < nvictims; i++) {
+		tcache_idle_flush_remote(tsdn, victims[i]);
+	}
+}
+
+/*
+ * Called by the owner on its way back to the fast paths, which have to stay
+ * closed while a remote flush is running.
+ */
+bool
+tcache_owner_reclaim_running(tcache_slow_t *tcache_slow) {
+	uint32_t state = atomic_load_u32(
+	    &tcache_slow->reclaim_state, ATOMIC_ACQUIRE);
+	while (true) {
+		uint32_t desired;
+		switch (state) {
+		case TCACHE_RECLAIM_NONE:
+			return false;
+		case TCACHE_RECLAIM_RUNNING_SLOW:
+			return true;
+		case TCACHE_RECLAIM_RUNNING:
+			desired = TCACHE_RECLAIM_RUNNING_SLOW;
+			break;
+		default:
+			/* REQUESTED is called off; DONE_SLOW is over. */
+			desired = TCACHE_RECLAIM_NONE;
+			break;
+		}
+		if (atomic_compare_exchange_weak_u32(&tcache_slow->reclaim_state,
+		        &state, desired, ATOMIC_ACQUIRE, ATOMIC_ACQUIRE)) {
+			return desired != TCACHE_RECLAIM_NONE;
+		}
+	}
+}
+
+/* The slow path of tcache_owner_enter(). */
+void
+tcache_owner_wait(tcache_slow_t *tcache_slow) {
+	spin_t spinner = SPIN_INITIALIZER;
+	while (true) {
+		uint32_t state = atomic_load_u32(
+		    &tcache_slow->reclaim_state, ATOMIC_ACQUIRE);
+		if (state == TCACHE_RECLAIM_NONE) {
+			return;
+		}
+		if (state == TCACHE_RECLAIM_RUNNING
+		    || state == TCACHE_RECLAIM_RUNNING_SLOW) {
+			spin_adaptive(&spinner);
+			continue;
+		}
+		if (atomic_compare_exchange_weak_u32(&tcache_slow->reclaim_state,
+		        &state, TCACHE_RECLAIM_NONE, ATOMIC_ACQUIRE,
+		        ATOMIC_RELAXED)
+		    && state == TCACHE_RECLAIM_DONE_SLOW) {
+			/* Back to the fast paths, at the next recompute. */
+			tsd_t *tsd = tcache_slow->tsd;
+			tsd_force_recompute_one(tsd_tsdn(tsd), tsd);
+		}
+	}
+}
+
+/* Returns true if the tcache was found idle, and flushed. */
+static bool
+tcache_idle_reclaim(tsd_t *tsd, tcache_slow_t *tcache_slow, tcache_t *tcache) {
+	bool reclaimed = false;
+	if (atomic_load_b(&tcache_slow->idle_reclaim_pending, ATOMIC_RELAXED)) {
+		atomic_store_b(
+		    &tcache_slow->idle_reclaim_pending, false, ATOMIC_RELAXED);
+		size_t nbytes = config_stats
+		    ? tcache_cached_bytes_remote(tcache_slow)
+		    : 0;
+		tcache_flush_cache(tsd, tcache);
+		if (config_stats) {
+			atomic_fetch_add_zu(&tcache_idle_reclaimed_bytes,
+			    nbytes, ATOMIC_RELAXED);
+		}
+		reclaimed = true;
+	}
+	/* Without background threads, active threads take turns scanning. */
+	tcache_idle_reclaim_scan(tsd_tsdn(tsd));
+	return reclaimed;
+}
+
+static void
+tcache_gc_event_impl(tsd_t *tsd, tcache_slow_t *tcache_slow, tcache_t *tcache) {
+	if (unlikely(tcache_ncached_max_learning())) {
+		tcache_ncached_max_learn_check();
+	}
+	if (opt_tcache_idle_reclaim_ms >= 0
+	    && tcache_idle_reclaim(tsd, tcache_slow, tcache)) {
+		return;
+	}
 
 	/* When the new tcache gc is not enabled, GC one bin at a time. */
 	if (!opt_experimental_tcache_gc) {
@@ -538,6 +1313,9 @@ tcache_gc_event(tsd_t *tsd) {
 		tcache_slow->next_gc_bin++;
 		if (tcache_slow->next_gc_bin == tcache_nbins_get(tcache_slow)) {
 			tcache_slow->next_gc_bin = 0;
+			if (tcache_large_cache_nbins > 0) {
+				tcache_large_cache_gc(tsd, tcache_slow);
+			}
 		}
 		return;
 	}
@@ -572,6 +1350,10 @@ tcache_gc_event(tsd_t *tsd) {
 		}
 		if (++szind_small == small_nbins) {
 			szind_small = 0;
+			/* The large cache goes once per sweep of the small bins. */
+			if (tcache_large_cache_nbins > 0) {
+				tcache_large_cache_gc(tsd, tcache_slow);
+			}
 		}
 	}
 	tcache_slow->next_gc_bin_small = szind_small;
@@ -595,6 +1377,131 @@ tcache_gc_event(tsd_t *tsd) {
 	tcache_slow->next_gc_bin_large = szind_large;
 }
 
+static void
+tcache_gc_event(tsd_t *tsd) {
+	tcache_t *tcache = tcache_get(tsd);
+	if (tcache == NULL) {
+		return;
+	}
+
+	tcache_slow_t *tcache_slow = tsd_tcache_slowp_get(tsd);
+	assert(tcache_slow != NULL);
+	tcache_owner_enter(tcache_slow);
+	tcache_gc_event_impl(tsd, tcache_slow, tcache);
+	tcache_owner_exit(tcache_slow);
+}
+
+/*
+ * Publishes the bottom (oldest) items of a full bin, which would otherwise be
+ * flushed down to rem, in the tcache arena's handoff slot for the size class.
+ * Fails without touching the bin if the slot is taken.
+ */
+bool
+tcache_bin_donate_small(tsd_t *tsd, tcache_t *tcache, cache_bin_t *cache_bin,
+    szind_t binind, unsigned rem) {
+	assert(binind < SC_NBINS);
+	arena_t    *arena = tcache->tcache_slow->arena;
+	atomic_p_t *handoff = &arena->tcache_handoff[binind];
+	if (atomic_load_p(handoff, ATOMIC_RELAXED) != NULL
+	    || cache_bin_nstashed_get_local(cache_bin) != 0) {
+		return false;
+	}
+	cache_bin_sz_t ncached = cache_bin_ncached_get_local(cache_bin);
+	assert(rem < ncached);
+	cache_bin_sz_t ndonate = ncached - (cache_bin_sz_t)rem;
+	CACHE_BIN_PTR_ARRAY_DECLARE(ptrs, ndonate);
+	cache_bin_init_ptr_array_for_flush(cache_bin, &ptrs, ndonate);
+	for (cache_bin_sz_t i = 0; i < ndonate; i++) {
+		*(void **)ptrs.ptr[i] = (i + 1 < ndonate) ? ptrs.ptr[i + 1]
+		                                          : NULL;
+	}
+	size_t nbytes = ndonate * sz_index2size(binind);
+	atomic_fetch_add_u(
+	    &arena->tcache_handoff_gen[binind], 1, ATOMIC_RELAXED);
+	atomic_fetch_add_zu(
+	    &arena->tcache_handoff_nbytes, nbytes, ATOMIC_RELAXED);
+	void *expected = NULL;
+	if (!atomic_compare_exchange_strong_p(handoff, &expected, ptrs.ptr[0],
+	        ATOMIC_RELEASE, ATOMIC_RELAXED)) {
+		atomic_fetch_sub_zu(
+		    &arena->tcache_handoff_nbytes, nbytes, ATOMIC_RELAXED);
+		return false;
+	}
+	/* Nothing was merged into the arena; keep the bin's stats. */
+	cache_bin_stats_t tstats = cache_bin->tstats;
+	cache_bin_finish_flush(cache_bin, &ptrs, ndonate);
+	cache_bin->tstats = tstats;
+	tcache_nfill_small_burst_reset(tcache->tcache_slow, binind);
+	return true;
+}
+
+/*
+ * Takes the batch in the arena's handoff slot for binind, if any, filling up
+ * to nfill_max items; the rest of the batch goes back.
+ */
+static cache_bin_sz_t
+tcache_steal_small(tsdn_t *tsdn, arena_t *arena, szind_t binind,
+    cache_bin_ptr_array_t *ptrs, cache_bin_sz_t nfill_max) {
+	atomic_p_t *handoff = &arena->tcache_handoff[binind];
+	void       *head = NULL;
+	if (atomic_load_p(handoff, ATOMIC_RELAXED) != NULL) {
+		head = atomic_exchange_p(handoff, NULL, ATOMIC_ACQUIRE);
+	}
+	cache_bin_sz_t n = 0;
+	while (head != NULL && n < nfill_max) {
+		ptrs->ptr[n++] = head;
+		head = *(void **)head;
+	}
+	if (head != NULL) {
+		void *tail = head;
+		while (*(void **)tail != NULL) {
+			tail = *(void **)tail;
+		}
+		void *cur = atomic_load_p(handoff, ATOMIC_RELAXED);
+		do {
+			*(void **)tail = cur;
+		} while (!atomic_compare_exchange_weak_p(handoff, &cur, head,
+		    ATOMIC_RELEASE, ATOMIC_RELAXED));
+	}
+	if (n > 0) {
+		atomic_fetch_sub_zu(&arena->tcache_handoff_nbytes,
+		    n * sz_index2size(binind), ATOMIC_RELAXED);
+	}
+	if (config_stats) {
+		LOCKEDINT_MTX_LOCK(tsdn, arena->stats.mtx);
+		locked_inc_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+		    &arena->stats.tcache_steal_attempts, 1);
+		if (n > 0) {
+			locked_inc_u64(tsdn, LOCKEDINT_MTX(arena->stats.mtx),
+			    &arena->stats.tcache_steal_successes, 1);
+		}
+		LOCKEDINT_MTX_UNLOCK(tsdn, arena->stats.mtx);
+	}
+	return n;
+}
+
+/*
+ * Insertion sort; its cost is n plus the number of out of order pairs.  Arena
+ * fills are a concatenation of ascending runs (one per slab), so a fill from a
+ * single slab is linear, but a run of n2 items from a slab below the previous
+ * run's n1 items costs n1 * n2 moves, and many runs are quadratic in n.  A
+ * merge sort would bound this at n log(nruns), at the price of a scratch array
+ * as large as the fill; fills are at most ncached_max items and rarely span
+ * more than a couple of slabs, so this isn't done.
+ */
+static void
+tcache_ptr_array_sort(void **ptrs, cache_bin_sz_t n) {
+	for (cache_bin_sz_t i = 1; i < n; i++) {
+		void          *ptr = ptrs[i];
+		cache_bin_sz_t j = i;
+		while (j > 0 && (uintptr_t)ptrs[j - 1] > (uintptr_t)ptr) {
+			ptrs[j] = ptrs[j - 1];
+			j--;
+		}
+		ptrs[j] = ptr;
+	}
+}
+
 void *
 tcache_alloc_small_hard(tsdn_t *tsdn, arena_t *arena, tcache_t *tcache,
     cache_bin_t *cache_bin, szind_t binind, bool *tcache_success) {
@@ -606,6 +1513,10 @@ tcache_alloc_small_hard(tsdn_t *tsdn, arena_t *arena, tcache_t *tcache,
 	assert(cache_bin_ncached_get_local(cache_bin) == 0);
 	cache_bin_sz_t nfill = cache_bin_ncached_max_get(cache_bin)
 	    >> tcache_nfill_small_lg_div_get(tcache_slow, binind);
+	if (opt_experimental_tcache_gc_reuse
+	    && nfill > tcache_slow->bin_gc_target[binind]) {
+		nfill = tcache_slow->bin_gc_target[binind];
+	}
 	if (nfill == 0) {
 		nfill = 1;
 	}
@@ -616,14 +1527,27 @@ tcache_alloc_small_hard(tsdn_t *tsdn, arena_t *arena, tcache_t *tcache,
 	CACHE_BIN_PTR_ARRAY_DECLARE(ptrs, nfill_max);
 	cache_bin_init_ptr_array_for_fill(cache_bin, &ptrs, nfill_max);
 
-	cache_bin_sz_t filled = arena_ptr_array_fill_small(tsdn, arena, binind,
-	    &ptrs, /* nfill_min */ nfill_min, /* nfill_max */ nfill_max,
-	    cache_bin->tstats);
+	cache_bin_sz_t filled = 0;
+	if (opt_tcache_steal) {
+		filled = tcache_steal_small(
+		    tsdn, tcache_slow->arena, binind, &ptrs, nfill_max);
+	}
+	if (filled == 0) {
+		filled = arena_ptr_array_fill_small(tsdn, arena, binind, &ptrs,
+		    /* nfill_min */ nfill_min, /* nfill_max */ nfill_max,
+		    cache_bin->tstats);
+		assert(filled >= nfill_min);
+	}
+	if (opt_tcache_fill_sort) {
+		/* The bin pops ptrs.ptr[0] first. */
+		tcache_ptr_array_sort(ptrs.ptr, filled);
+	}
 	cache_bin_finish_fill(cache_bin, &ptrs, filled);
-	assert(filled >= nfill_min && filled <= nfill_max);
+	assert(filled > 0 && filled <= nfill_max);
 	assert(cache_bin_ncached_get_local(cache_bin) == filled);
 
 	tcache_slow->bin_refilled[binind] = true;
+	tcache_learn_count(tcache_learn_nfills, binind, 1);
 	tcache_nfill_small_burst_prepare(tcache_slow, binind);
 	ret = cache_bin_alloc(cache_bin, tcache_success);
 
@@ -726,7 +1650,9 @@ tcache_get_default_ncached_max_set(szind_t ind) {
 
 JET_EXTERN const cache_bin_info_t *
 tcache_get_default_ncached_max(void) {
-	return opt_tcache_ncached_max;
+	const cache_bin_info_t *info = (const cache_bin_info_t *)atomic_load_p(
+	    &tcache_default_bin_info, ATOMIC_ACQUIRE);
+	return info != NULL ? info : opt_tcache_ncached_max;
 }
 
 bool
@@ -758,7 +1684,7 @@ tcache_arena_associate(tsdn_t *tsdn, tcache_slow_t *tcache_slow,
 	assert(tcache_slow->arena == NULL);
 	tcache_slow->arena = arena;
 
-	if (config_stats) {
+	if (tcache_ql_enabled()) {
 		/* Link into list of extant tcaches. */
 		malloc_mutex_lock(tsdn, &arena->tcache_ql_mtx);
 
@@ -778,7 +1704,7 @@ tcache_arena_dissociate(
     tsdn_t *tsdn, tcache_slow_t *tcache_slow, tcache_t *tcache) {
 	arena_t *arena = tcache_slow->arena;
 	assert(arena != NULL);
-	if (config_stats) {
+	if (tcache_ql_enabled()) {
 		/* Unlink from list of extant tcaches. */
 		malloc_mutex_lock(tsdn, &arena->tcache_ql_mtx);
 		if (config_debug) {
@@ -795,7 +1721,16 @@ tcache_arena_dissociate(
 		ql_remove(&arena->tcache_ql, tcache_slow, link);
 		ql_remove(&arena->cache_bin_array_descriptor_ql,
 		    &tcache_slow->cache_bin_array_descriptor, link);
-		tcache_stats_merge(tsdn, tcache_slow->tcache, arena);
+		/* The owner is in, so no remote flush can be running. */
+		assert(atomic_load_u32(&tcache_slow->reclaim_state,
+		           ATOMIC_RELAXED) == TCACHE_RECLAIM_NONE
+		    || atomic_load_u32(&tcache_slow->reclaim_state,
+		           ATOMIC_RELAXED) == TCACHE_RECLAIM_REQUESTED);
+		atomic_store_u32(&tcache_slow->reclaim_state,
+		    TCACHE_RECLAIM_NONE, ATOMIC_RELAXED);
+		if (config_stats) {
+			tcache_stats_merge(tsdn, tcache_slow->tcache, arena);
+		}
 		malloc_mutex_unlock(tsdn, &arena->tcache_ql_mtx);
 	}
 	tcache_slow->arena = NULL;
@@ -804,8 +1739,10 @@ tcache_arena_dissociate(
 void
 tcache_arena_reassociate(tsdn_t *tsdn, tcache_slow_t *tcache_slow,
     tcache_t *tcache, arena_t *arena) {
+	tcache_owner_enter(tcache_slow);
 	tcache_arena_dissociate(tsdn, tcache_slow, tcache);
 	tcache_arena_associate(tsdn, tcache_slow, tcache, arena);
+	tcache_owner_exit(tcache_slow);
 }
 
 static void
@@ -824,6 +1761,18 @@ tcache_init(tsd_t *tsd, tcache_slow_t *tcache_slow, tcache_t *tcache, void *mem,
 
 	memset(&tcache_slow->link, 0, sizeof(ql_elm(tcache_t)));
 	nstime_init_zero(&tcache_slow->last_gc_time);
+	/* owner_depth is left alone, as the owner may be in already. */
+	tcache_slow->tsd = NULL;
+	atomic_store_u32(
+	    &tcache_slow->reclaim_state, TCACHE_RECLAIM_NONE, ATOMIC_RELAXED);
+	atomic_store_b(&tcache_slow->idle_reclaim_pending, false, ATOMIC_RELAXED);
+	tcache_slow->idle_seen_nbytes = 0;
+	tcache_slow->idle_since_ns = 0;
+	tcache_slow->large_cache_nitems = 0;
+	tcache_slow->large_cache_low_water = 0;
+	atomic_store_zu(&tcache_slow->large_cache_nbytes, 0, ATOMIC_RELAXED);
+	memset(tcache_slow->large_cache_nrequests, 0,
+	    sizeof(tcache_slow->large_cache_nrequests));
 	tcache_slow->next_gc_bin = 0;
 	tcache_slow->next_gc_bin_small = 0;
 	tcache_slow->next_gc_bin_large = SC_NBINS;
@@ -845,6 +1794,8 @@ tcache_init(tsd_t *tsd, tcache_slow_t *tcache_slow, tcache_t *tcache, void *mem,
 			tcache_slow->bin_refilled[i] = false;
 			tcache_slow->bin_flush_delay_items[i] =
 			    tcache_gc_item_delay_compute(i);
+			tcache_gc_reuse_init(
+			    tcache_slow, i, tcache_bin_info[i].ncached_max);
 		}
 		cache_bin_t *cache_bin = &tcache->bins[i];
 		if (tcache_bin_info[i].ncached_max > 0) {
@@ -978,6 +1929,7 @@ tsd_tcache_data_init_impl(
 	}
 
 	tcache_init(tsd, tcache_slow, tcache, mem, tcache_bin_info);
+	tcache_slow->tsd = tsd;
 	/*
 	 * Initialization is a bit tricky here.  After malloc init is done, all
 	 * threads can rely on arena_choose and associate tcache accordingly.
@@ -1024,9 +1976,12 @@ tcache_create_explicit(tsd_t *tsd) {
 	 * the cache bins have the requested alignment.
 	 */
 	unsigned tcache_nbins = global_do_not_change_tcache_nbins;
-	size_t   tcache_size, alignment;
-	cache_bin_info_compute_alloc(tcache_get_default_ncached_max(),
-	    tcache_nbins, &tcache_size, &alignment);
+	/* Read once; the default may switch to a learned one concurrently. */
+	const cache_bin_info_t *tcache_bin_info =
+	    tcache_get_default_ncached_max();
+	size_t tcache_size, alignment;
+	cache_bin_info_compute_alloc(
+	    tcache_bin_info, tcache_nbins, &tcache_size, &alignment);
 
 	size_t size = tcache_size + sizeof(tcache_t) + sizeof(tcache_slow_t);
 	/* Naturally align the pointer stacks. */
@@ -1042,8 +1997,7 @@ tcache_create_explicit(tsd_t *tsd) {
 	tcache_slow_t *tcache_slow = (void *)((byte_t *)mem + tcache_size
 	    + sizeof(tcache_t));
 	tcache_default_settings_init(tcache_slow);
-	tcache_init(
-	    tsd, tcache_slow, tcache, mem, tcache_get_default_ncached_max());
+	tcache_init(tsd, tcache_slow, tcache, mem, tcache_bin_info);
 
 	tcache_arena_associate(
 	    tsd_tsdn(tsd), tcache_slow, tcache, arena_ichoose(tsd, NULL));
@@ -1203,12 +2157,21 @@ tcache_flush_cache(tsd_t *tsd, tcache_t *tcache) {
 			assert(cache_bin->tstats.nrequests == 0);
 		}
 	}
+	tcache_large_cache_flush(
+	    tsd, tcache_slow, tcache_slow->large_cache_nitems);
+	if (config_stats) {
+		tcache_large_cache_stats_merge(
+		    tsd_tsdn(tsd), tcache_slow, tcache_slow->arena);
+	}
 }
 
 void
 tcache_flush(tsd_t *tsd) {
 	assert(tcache_available(tsd));
+	tcache_slow_t *tcache_slow = tsd_tcache_slowp_get(tsd);
+	tcache_owner_enter(tcache_slow);
 	tcache_flush_cache(tsd, tsd_tcachep_get(tsd));
+	tcache_owner_exit(tcache_slow);
 }
 
 static void
@@ -1261,9 +2224,12 @@ tcache_cleanup(tsd_t *tsd) {
 	assert(tsd_tcache_enabled_get(tsd));
 	assert(!cache_bin_still_zero_initialized(&tcache->bins[0]));
 
+	tcache_slow_t *tcache_slow = tsd_tcache_slowp_get(tsd);
+	tcache_owner_enter(tcache_slow);
 	tcache_destroy(tsd, tcache, true);
 	/* Make sure all bins used are reinitialized to the clean state. */
 	memset(tcache->bins, 0, sizeof(cache_bin_t) * TCACHE_NBINS_MAX);
+	tcache_owner_exit(tcache_slow);
 }
 
 void
@@ -1287,6 +2253,7 @@ tcache_stats_merge(tsdn_t *tsdn, tcache_t *tcache, arena_t *arena) {
 		}
 		cache_bin->tstats.nrequests = 0;
 	}
+	tcache_large_cache_stats_merge(tsdn, tcache->tcache_slow, arena);
 }
 
 static bool
@@ -1410,6 +2377,28 @@ tcache_boot(tsdn_t *tsdn, base_t *base) {
 	 * accessed using tcache_get_default_ncached_max.
 	 */
 	tcache_bin_info_compute(opt_tcache_ncached_max);
+	if (opt_tcache_large_cache_bytes > 0
+	    && opt_tcache_large_cache_max >= SC_LARGE_MINCLASS) {
+		/* A first cut; usizes get checked against the max when freed. */
+		szind_t szind = sz_size2index(opt_tcache_large_cache_max);
+		assert(szind < TCACHE_LARGE_CACHE_NBINS_MAX);
+		tcache_large_cache_nbins = szind + 1;
+	}
+	if (opt_tcache_ncached_max_learn_ms >= 0) {
+		nstime_t now;
+		nstime_init_update(&now);
+		tcache_learn_end_ns = nstime_ns(&now)
+		    + (uint64_t)opt_tcache_ncached_max_learn_ms * 1000 * 1000;
+		atomic_store_u(
+		    &tcache_learn_state, TCACHE_LEARN_WARMUP, ATOMIC_RELEASE);
+	}
+
+#ifdef JEMALLOC_HAVE_MEMBARRIER
+	if (opt_tcache_idle_reclaim_ms >= 0) {
+		tcache_idle_reclaim_remote = (syscall(SYS_membarrier,
+		    MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0);
+	}
+#endif
 
 	if (malloc_mutex_init(&tcaches_mtx, "tcaches", WITNESS_RANK_TCACHES,
 	        malloc_mutex_rank_exclusive)) {
@@ -1421,17 +2410,21 @@ tcache_boot(tsdn_t *tsdn, base_t *base) {
 
 void
 tcache_prefork(tsdn_t *tsdn) {
+	/* A remote flush of our tcache mustn't straddle the fork. */
+	tcache_owner_enter(tsd_tcache_slowp_get_unsafe(tsdn_tsd(tsdn)));
 	malloc_mutex_prefork(tsdn, &tcaches_mtx);
 }
 
 void
 tcache_postfork_parent(tsdn_t *tsdn) {
 	malloc_mutex_postfork_parent(tsdn, &tcaches_mtx);
+	tcache_owner_exit(tsd_tcache_slowp_get_unsafe(tsdn_tsd(tsdn)));
 }
 
 void
 tcache_postfork_child(tsdn_t *tsdn) {
 	malloc_mutex_postfork_child(tsdn, &tcaches_mtx);
+	tcache_owner_exit(tsd_tcache_slowp_get_unsafe(tsdn_tsd(tsdn)));
 }
 
 void
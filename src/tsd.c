@@ -2,6 +2,7 @@
 #include "jemalloc/internal/jemalloc_internal_includes.h"
 
 #include "jemalloc/internal/assert.h"
+#include "jemalloc/internal/alloc_trace.h"
 #include "jemalloc/internal/san.h"
 #include "jemalloc/internal/mutex.h"
 #include "jemalloc/internal/rtree.h"
@@ -125,6 +126,23 @@ tsd_force_recompute(tsdn_t *tsdn) {
 	malloc_mutex_unlock(tsdn, &tsd_nominal_tsds_lock);
 }
 
+bool
+tsd_force_recompute_one(tsdn_t *tsdn, tsd_t *remote_tsd) {
+	/* See tsd_force_recompute(). */
+	atomic_fence(ATOMIC_RELEASE);
+	malloc_mutex_lock(tsdn, &tsd_nominal_tsds_lock);
+	bool nominal = tsd_atomic_load(&remote_tsd->state, ATOMIC_RELAXED)
+	    <= tsd_state_nominal_max;
+	if (nominal) {
+		tsd_atomic_store(&remote_tsd->state,
+		    tsd_state_nominal_recompute, ATOMIC_RELAXED);
+		atomic_fence(ATOMIC_SEQ_CST);
+		te_next_event_fast_set_non_nominal(remote_tsd);
+	}
+	malloc_mutex_unlock(tsdn, &tsd_nominal_tsds_lock);
+	return nominal;
+}
+
 void
 tsd_global_slow_inc(tsdn_t *tsdn) {
 	atomic_fetch_add_u32(&tsd_global_slow_count, 1, ATOMIC_RELAXED);
@@ -149,7 +167,8 @@ tsd_global_slow_dec(tsdn_t *tsdn) {
 static bool
 tsd_local_slow(tsd_t *tsd) {
 	return !tsd_tcache_enabled_get(tsd)
-	    || tsd_reentrancy_level_get(tsd) > 0;
+	    || tsd_reentrancy_level_get(tsd) > 0
+	    || tcache_owner_reclaim_running(tsd_tcache_slowp_get_unsafe(tsd));
 }
 
 bool
@@ -256,6 +275,7 @@ assert_tsd_data_cleanup_done(tsd_t *tsd) {
 	assert(*tsd_iarenap_get_unsafe(tsd) == NULL);
 	assert(*tsd_tcache_enabledp_get_unsafe(tsd) == false);
 	assert(*tsd_prof_tdatap_get_unsafe(tsd) == NULL);
+	assert(*tsd_alloc_trace_tbufp_get_unsafe(tsd) == NULL);
 }
 
 static bool
@@ -397,6 +417,7 @@ _malloc_tsd_cleanup_register(bool (*f)(void)) {
 static void
 tsd_do_data_cleanup(tsd_t *tsd) {
 	prof_tdata_cleanup(tsd);
+	alloc_trace_tsd_cleanup(tsd);
 	iarena_cleanup(tsd);
 	arena_cleanup(tsd);
 	tcache_cleanup(tsd);
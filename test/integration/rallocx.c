@@ -163,6 +163,69 @@ TEST_BEGIN(test_zero) {
 }
 TEST_END
 
+/*
+ * Grow large allocations past opt.large_remap_threshold, where they may be
+ * moved by remapping pages rather than by copying, and make sure their contents
+ * end up in the right place.
+ */
+TEST_BEGIN(test_grow_large) {
+	void *volatile p, *volatile q;
+	size_t threshold, sz;
+#define MAX_GROW_SZ ZU(64 * 1024 * 1024)
+
+	sz = sizeof(threshold);
+	expect_d_eq(mallctl("opt.large_remap_threshold", (void *)&threshold,
+	                &sz, NULL, 0),
+	    0, "Unexpected mallctl() error");
+	if (threshold < SC_LARGE_MINCLASS) {
+		threshold = SC_LARGE_MINCLASS;
+	}
+
+	for (unsigned i = 0; i < 2; i++) {
+		int    flags = (i == 0) ? 0 : MALLOCX_ZERO;
+		size_t psz;
+
+		p = mallocx(threshold, flags);
+		expect_ptr_not_null(p, "Unexpected mallocx() error");
+		psz = sallocx(p, 0);
+		for (size_t j = 0; j < psz / sizeof(size_t); j++) {
+			((size_t *)p)[j] = j;
+		}
+		while (psz < MAX_GROW_SZ) {
+			/* Occupy the space after p, so that growing moves it. */
+			void *blocker = mallocx(SC_LARGE_MINCLASS, 0);
+			expect_ptr_not_null(blocker, "Unexpected mallocx() error");
+
+			q = rallocx(p, psz * 2, flags);
+			expect_ptr_not_null(q, "Unexpected rallocx() error");
+			size_t qsz = sallocx(q, 0);
+			expect_zu_ge(qsz, psz * 2, "Unexpected rallocx() size");
+			for (size_t j = 0; j < psz / sizeof(size_t); j++) {
+				if (((size_t *)q)[j] != j) {
+					expect_zu_eq(((size_t *)q)[j], j,
+					    "Contents lost growing %zu to %zu",
+					    psz, qsz);
+					break;
+				}
+			}
+			if (flags & MALLOCX_ZERO) {
+				expect_false(validate_fill(q, 0, psz, qsz - psz),
+				    "Expected zeroed memory");
+			}
+			for (size_t j = psz / sizeof(size_t);
+			     j < qsz / sizeof(size_t); j++) {
+				((size_t *)q)[j] = j;
+			}
+			dallocx(blocker, 0);
+			p = q;
+			psz = qsz;
+		}
+		dallocx(p, 0);
+	}
+#undef MAX_GROW_SZ
+}
+TEST_END
+
 TEST_BEGIN(test_align) {
 	void  *p, *q;
 	size_t align;
@@ -301,6 +364,6 @@ JEMALLOC_DIAGNOSTIC_POP
 
 int
 main(void) {
-	return test(test_grow_and_shrink, test_zero, test_align,
+	return test(test_grow_and_shrink, test_zero, test_grow_large, test_align,
 	    test_align_enum, test_lg_align_and_zero, test_overflow);
 }
@@ -0,0 +1,674 @@
+#include "test/jemalloc_test.h"
+#include "test/bench.h"
+
+#include "jemalloc/internal/alloc_trace.h"
+#include "jemalloc/internal/spin.h"
+
+/*
+ * Replays an allocation trace recorded with opt.alloc_trace (or the
+ * experimental.alloc_trace.{start,stop} mallctls) through the public API, and
+ * reports the throughput, and the memory usage and fragmentation of the heap
+ * left behind at the end of the trace.  Unlike pa/pa_microbench.c, which
+ * replays page allocator traces against a PA shard of its own, this exercises
+ * the whole allocator: tcaches, bins, arenas and the page allocators.
+ *
+ * Calls are replayed in the order of their sequence numbers.  By default they
+ * all run on one thread; with -t, every recorded thread gets a thread of its
+ * own, and the threads take turns in trace order, so that objects go through
+ * the same threads' tcaches and arenas as they did when recording (the
+ * handoffs between threads are then part of the time measured).
+ *
+ * Objects allocated before tracing started are unknown to the replay, so the
+ * calls that free or resize them are skipped, and counted as unmatched.
+ * Arenas that calls chose explicitly are recreated with arenas.create, and
+ * explicit tcaches are replaced with the thread's own.  memalign(), valloc()
+ * and pvalloc() aren't necessarily exported, so they're replayed as aligned
+ * mallocx() calls.
+ *
+ * Memory of the replay itself comes from an arena of its own, which the
+ * allocator stats reported leave out.
+ */
+
+#define REPLAY_MAP_MINSIZE 1024
+
+typedef struct replay_op_s replay_op_t;
+struct replay_op_s {
+	size_t size;
+	/* Alignment, number of elements, or extra. */
+	size_t arg;
+	/* Usable size after xallocx() when recording. */
+	size_t   usize;
+	uint32_t obj;
+	uint32_t thread;
+	int      flags;
+	uint8_t  op;
+};
+
+typedef struct replay_event_s replay_event_t;
+struct replay_event_s {
+	alloc_trace_event_t event;
+	uint32_t            thread;
+};
+
+/* Open-addressing map from recorded addresses (never 0) to indices. */
+typedef struct replay_map_s replay_map_t;
+struct replay_map_s {
+	uint64_t *keys;
+	uint32_t *vals;
+	size_t    mask;
+	size_t    count;
+};
+
+typedef struct replay_thd_s replay_thd_t;
+struct replay_thd_s {
+	size_t *ops;
+	size_t  nops;
+};
+
+typedef struct heap_stats_s heap_stats_t;
+struct heap_stats_s {
+	size_t allocated;
+	size_t active;
+	size_t resident;
+	size_t mapped;
+};
+
+static unsigned tool_arena;
+
+static replay_op_t *ops;
+static size_t       nops;
+static void       **objs;
+static bool        *objs_resized;
+static size_t       nobjs;
+static uint32_t     nthreads;
+static size_t       nunmatched;
+static size_t       nfailed;
+static size_t       nresize_mismatches;
+static atomic_zu_t  replay_turn;
+
+static void *
+tool_alloc(size_t size) {
+	void *p = mallocx(size == 0 ? 1 : size,
+	    MALLOCX_ARENA(tool_arena) | MALLOCX_TCACHE_NONE | MALLOCX_ZERO);
+	assert_ptr_not_null(p, "Unexpected mallocx() failure");
+	return p;
+}
+
+static void
+tool_free(void *p) {
+	dallocx(p, MALLOCX_ARENA(tool_arena) | MALLOCX_TCACHE_NONE);
+}
+
+static size_t
+replay_map_home(const replay_map_t *map, uint64_t key) {
+	return (size_t)((key * UINT64_C(0x9e3779b97f4a7c15)) >> 16) & map->mask;
+}
+
+static void
+replay_map_init(replay_map_t *map, size_t size) {
+	map->keys = tool_alloc(size * sizeof(uint64_t));
+	map->vals = tool_alloc(size * sizeof(uint32_t));
+	map->mask = size - 1;
+	map->count = 0;
+}
+
+static size_t
+replay_map_find(const replay_map_t *map, uint64_t key) {
+	size_t i = replay_map_home(map, key);
+	while (map->keys[i] != 0 && map->keys[i] != key) {
+		i = (i + 1) & map->mask;
+	}
+	return i;
+}
+
+static void
+replay_map_insert(replay_map_t *map, uint64_t key, uint32_t val) {
+	if (2 * (map->count + 1) > map->mask + 1) {
+		replay_map_t grown;
+		replay_map_init(&grown, 2 * (map->mask + 1));
+		for (size_t i = 0; i <= map->mask; i++) {
+			if (map->keys[i] != 0) {
+				replay_map_insert(&grown, map->keys[i],
+				    map->vals[i]);
+			}
+		}
+		tool_free(map->keys);
+		tool_free(map->vals);
+		*map = grown;
+	}
+	size_t i = replay_map_find(map, key);
+	if (map->keys[i] == 0) {
+		map->keys[i] = key;
+		map->count++;
+	}
+	map->vals[i] = val;
+}
+
+/* Returns whether key was missing; removes it otherwise. */
+static bool
+replay_map_remove(replay_map_t *map, uint64_t key, uint32_t *val) {
+	size_t i = replay_map_find(map, key);
+	if (map->keys[i] == 0) {
+		return true;
+	}
+	*val = map->vals[i];
+	/* Shift back the entries that probed past the removed one. */
+	for (size_t j = (i + 1) & map->mask; map->keys[j] != 0;
+	     j = (j + 1) & map->mask) {
+		size_t k = replay_map_home(map, map->keys[j]);
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+			continue;
+		}
+		map->keys[i] = map->keys[j];
+		map->vals[i] = map->vals[j];
+		i = j;
+	}
+	map->keys[i] = 0;
+	map->count--;
+	return false;
+}
+
+static void
+replay_map_fini(replay_map_t *map) {
+	tool_free(map->keys);
+	tool_free(map->vals);
+}
+
+static int
+replay_event_comp(const void *a, const void *b) {
+	uint64_t seq_a = ((const replay_event_t *)a)->event.seq;
+	uint64_t seq_b = ((const replay_event_t *)b)->event.seq;
+	return (seq_a > seq_b) - (seq_a < seq_b);
+}
+
+/* Returns the events of the trace in sequence order, or NULL on error. */
+static replay_event_t *
+trace_load(const char *filename, size_t *nevents) {
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open trace file: %s\n", filename);
+		return NULL;
+	}
+	alloc_trace_header_t header;
+	if (fread(&header, sizeof(header), 1, f) != 1
+	    || memcmp(header.magic, ALLOC_TRACE_MAGIC,
+	           sizeof(ALLOC_TRACE_MAGIC))
+	        != 0
+	    || header.version != ALLOC_TRACE_VERSION
+	    || header.event_size != sizeof(alloc_trace_event_t)) {
+		fprintf(stderr, "Not an allocation trace: %s\n", filename);
+		fclose(f);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, sizeof(header), SEEK_SET);
+
+	/* An upper bound; blocks take up some of the length. */
+	size_t          max = (size_t)len / sizeof(alloc_trace_event_t);
+	replay_event_t *events = tool_alloc(max * sizeof(replay_event_t));
+	size_t          n = 0;
+	alloc_trace_block_t block;
+	while (fread(&block, sizeof(block), 1, f) == 1) {
+		for (uint32_t i = 0; i < block.nevents; i++) {
+			if (n == max
+			    || fread(&events[n].event,
+			           sizeof(alloc_trace_event_t), 1, f)
+			        != 1) {
+				fprintf(stderr, "Truncated trace: %s\n",
+				    filename);
+				fclose(f);
+				tool_free(events);
+				return NULL;
+			}
+			events[n++].thread = block.thread;
+		}
+	}
+	fclose(f);
+	qsort(events, n, sizeof(replay_event_t), &replay_event_comp);
+	*nevents = n;
+	return events;
+}
+
+static int
+replay_flags(int flags, unsigned *arena_map) {
+	if ((flags & MALLOCX_ARENA_MASK) != 0) {
+		unsigned ind = MALLOCX_ARENA_GET(flags);
+		if (arena_map[ind] == UINT_MAX) {
+			size_t sz = sizeof(unsigned);
+			expect_d_eq(mallctl("arenas.create", &arena_map[ind],
+			                &sz, NULL, 0),
+			    0, "Unexpected mallctl failure creating an arena");
+		}
+		flags = (flags & ~MALLOCX_ARENA_MASK)
+		    | MALLOCX_ARENA(arena_map[ind]);
+	}
+	if ((flags & MALLOCX_TCACHE_MASK) != 0
+	    && (flags & MALLOCX_TCACHE_MASK) != MALLOCX_TCACHE_NONE) {
+		flags &= ~MALLOCX_TCACHE_MASK;
+	}
+	return flags;
+}
+
+/*
+ * Turns the events into calls on objects, rather than on recorded addresses.
+ * Returns the number of calls.
+ */
+static size_t
+replay_prepare(const replay_event_t *events, size_t nevents) {
+	unsigned *arena_map = tool_alloc(
+	    MALLOCX_ARENA_LIMIT * sizeof(unsigned));
+	for (unsigned i = 0; i < MALLOCX_ARENA_LIMIT; i++) {
+		arena_map[i] = UINT_MAX;
+	}
+	replay_map_t addrs, threads;
+	replay_map_init(&addrs, REPLAY_MAP_MINSIZE);
+	replay_map_init(&threads, REPLAY_MAP_MINSIZE);
+	ops = tool_alloc(nevents * sizeof(replay_op_t));
+	nops = nobjs = nthreads = nunmatched = 0;
+
+	for (size_t i = 0; i < nevents; i++) {
+		const alloc_trace_event_t *event = &events[i].event;
+		replay_op_t               *op = &ops[nops];
+		op->op = (uint8_t)event->op;
+		op->size = (size_t)event->size;
+		op->arg = (size_t)event->arg;
+		op->usize = (size_t)event->usize;
+		op->flags = replay_flags((int)event->flags, arena_map);
+
+		uint32_t obj;
+		bool     missing = (event->old_ptr == 0)
+		        || replay_map_remove(&addrs, event->old_ptr, &obj);
+		switch (event->op) {
+		case alloc_trace_op_memalign:
+			op->op = alloc_trace_op_mallocx;
+			op->flags = MALLOCX_ALIGN(op->arg);
+			break;
+		case alloc_trace_op_valloc:
+		case alloc_trace_op_pvalloc:
+			if (event->op == alloc_trace_op_pvalloc) {
+				op->size = PAGE_CEILING(
+				    op->size == 0 ? 1 : op->size);
+			}
+			op->op = alloc_trace_op_mallocx;
+			op->flags = MALLOCX_ALIGN(PAGE);
+			break;
+		case alloc_trace_op_rallocx:
+			if (missing) {
+				op->op = alloc_trace_op_mallocx;
+			}
+			break;
+		case alloc_trace_op_realloc:
+			/* realloc(NULL, size) is simply replayed as such. */
+			if (missing && event->old_ptr != 0) {
+				nunmatched++;
+				if (event->ptr == 0) {
+					continue;
+				}
+			}
+			break;
+		case alloc_trace_op_xallocx:
+		case alloc_trace_op_free:
+		case alloc_trace_op_dallocx:
+		case alloc_trace_op_sdallocx:
+			if (missing) {
+				nunmatched++;
+				continue;
+			}
+			break;
+		default:
+			break;
+		}
+		if (missing) {
+			obj = (uint32_t)nobjs++;
+		}
+		if (event->ptr != 0) {
+			replay_map_insert(&addrs, event->ptr, obj);
+		}
+		op->obj = obj;
+
+		/* Thread 0 is valid, but 0 can't be a key. */
+		uint64_t thread = (uint64_t)events[i].thread + 1;
+		size_t   ind = replay_map_find(&threads, thread);
+		if (threads.keys[ind] == 0) {
+			replay_map_insert(&threads, thread, nthreads++);
+			ind = replay_map_find(&threads, thread);
+		}
+		op->thread = threads.vals[ind];
+		nops++;
+	}
+
+	replay_map_fini(&addrs);
+	replay_map_fini(&threads);
+	tool_free(arena_map);
+	objs = tool_alloc(nobjs * sizeof(void *));
+	objs_resized = tool_alloc(nobjs * sizeof(bool));
+	return nops;
+}
+
+static void
+replay_op(const replay_op_t *op) {
+	void **obj = &objs[op->obj];
+	void  *p;
+	switch (op->op) {
+	case alloc_trace_op_malloc:
+		*obj = malloc(op->size);
+		break;
+	case alloc_trace_op_calloc:
+		*obj = calloc(op->arg, op->size);
+		break;
+	case alloc_trace_op_posix_memalign:
+		if (posix_memalign(obj, op->arg, op->size) != 0) {
+			*obj = NULL;
+		}
+		break;
+	case alloc_trace_op_aligned_alloc:
+		*obj = aligned_alloc(op->arg, op->size);
+		break;
+	case alloc_trace_op_mallocx:
+		*obj = mallocx(op->size, op->flags);
+		break;
+	case alloc_trace_op_realloc:
+		p = realloc(*obj, op->size);
+		if (p != NULL || op->size == 0) {
+			*obj = p;
+		}
+		return;
+	case alloc_trace_op_rallocx:
+		if (*obj != NULL) {
+			p = rallocx(*obj, op->size, op->flags);
+			if (p != NULL) {
+				*obj = p;
+			}
+		}
+		return;
+	case alloc_trace_op_xallocx:
+		if (*obj != NULL
+		    && xallocx(*obj, op->size, op->arg, op->flags)
+		        != op->usize) {
+			/* Its later sdallocx() size may not fit anymore. */
+			objs_resized[op->obj] = true;
+			nresize_mismatches++;
+		}
+		return;
+	case alloc_trace_op_free:
+		free(*obj);
+		*obj = NULL;
+		return;
+	case alloc_trace_op_dallocx:
+	case alloc_trace_op_sdallocx:
+		if (*obj != NULL) {
+			if (op->op == alloc_trace_op_dallocx
+			    || objs_resized[op->obj]) {
+				dallocx(*obj, op->flags);
+			} else {
+				sdallocx(*obj, op->size, op->flags);
+			}
+			*obj = NULL;
+		}
+		return;
+	default:
+		not_reached();
+	}
+	if (*obj == NULL) {
+		nfailed++;
+	}
+}
+
+static void *
+replay_thd_start(void *arg) {
+	replay_thd_t *thd = (replay_thd_t *)arg;
+	for (size_t i = 0; i < thd->nops; i++) {
+		size_t ind = thd->ops[i];
+		for (unsigned spins = 0;
+		     atomic_load_zu(&replay_turn, ATOMIC_ACQUIRE) != ind;
+		     spins++) {
+			if (spins < 1000) {
+				spin_cpu_spinwait();
+			} else {
+				sched_yield();
+			}
+		}
+		replay_op(&ops[ind]);
+		atomic_store_zu(&replay_turn, ind + 1, ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static uint64_t
+replay_threaded(void) {
+	replay_thd_t *thds = tool_alloc(nthreads * sizeof(replay_thd_t));
+	for (size_t i = 0; i < nops; i++) {
+		thds[ops[i].thread].nops++;
+	}
+	for (uint32_t t = 0; t < nthreads; t++) {
+		thds[t].ops = tool_alloc(thds[t].nops * sizeof(size_t));
+		thds[t].nops = 0;
+	}
+	for (size_t i = 0; i < nops; i++) {
+		replay_thd_t *thd = &thds[ops[i].thread];
+		thd->ops[thd->nops++] = i;
+	}
+
+	thd_t      *thd_ids = tool_alloc(nthreads * sizeof(thd_t));
+	timedelta_t timer;
+	atomic_store_zu(&replay_turn, 0, ATOMIC_RELAXED);
+	timer_start(&timer);
+	for (uint32_t t = 0; t < nthreads; t++) {
+		thd_create(&thd_ids[t], replay_thd_start, &thds[t]);
+	}
+	for (uint32_t t = 0; t < nthreads; t++) {
+		thd_join(thd_ids[t], NULL);
+	}
+	timer_stop(&timer);
+
+	for (uint32_t t = 0; t < nthreads; t++) {
+		tool_free(thds[t].ops);
+	}
+	tool_free(thds);
+	tool_free(thd_ids);
+	return timer_usec(&timer);
+}
+
+/* Returns true if the allocator doesn't keep stats. */
+static bool
+heap_stats_get(heap_stats_t *stats) {
+	uint64_t epoch = 1;
+	size_t   sz = sizeof(epoch);
+	mallctl("epoch", &epoch, &sz, &epoch, sz);
+
+	heap_stats_t tool;
+	size_t       small, large, pactive;
+	char         name[64];
+	sz = sizeof(size_t);
+#define HEAP_STAT(field, ...)                                                  \
+	malloc_snprintf(name, sizeof(name), __VA_ARGS__);                      \
+	if (mallctl(name, field, &sz, NULL, 0) != 0) {                         \
+		return true;                                                   \
+	}
+	HEAP_STAT(&stats->allocated, "stats.allocated")
+	HEAP_STAT(&stats->active, "stats.active")
+	HEAP_STAT(&stats->resident, "stats.resident")
+	HEAP_STAT(&stats->mapped, "stats.mapped")
+	HEAP_STAT(&small, "stats.arenas.%u.small.allocated", tool_arena)
+	HEAP_STAT(&large, "stats.arenas.%u.large.allocated", tool_arena)
+	HEAP_STAT(&pactive, "stats.arenas.%u.pactive", tool_arena)
+	HEAP_STAT(&tool.resident, "stats.arenas.%u.resident", tool_arena)
+	HEAP_STAT(&tool.mapped, "stats.arenas.%u.mapped", tool_arena)
+#undef HEAP_STAT
+	stats->allocated -= small + large;
+	stats->active -= pactive * PAGE;
+	stats->resident -= tool.resident;
+	stats->mapped -= tool.mapped;
+	return false;
+}
+
+/* Resident set size of the whole process, or 0 if unknown. */
+static size_t
+rss_get(void) {
+	size_t size = 0, resident = 0;
+	FILE  *f = fopen("/proc/self/statm", "r");
+	if (f != NULL) {
+		if (fscanf(f, "%zu %zu", &size, &resident) != 2) {
+			resident = 0;
+		}
+		fclose(f);
+	}
+	return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void
+heap_stats_max(heap_stats_t *peak, const heap_stats_t *stats) {
+	if (stats->allocated > peak->allocated) {
+		peak->allocated = stats->allocated;
+	}
+	if (stats->active > peak->active) {
+		peak->active = stats->active;
+	}
+	if (stats->resident > peak->resident) {
+		peak->resident = stats->resident;
+	}
+	if (stats->mapped > peak->mapped) {
+		peak->mapped = stats->mapped;
+	}
+}
+
+static void
+heap_stats_print(const char *title, const heap_stats_t *stats) {
+	printf("%s: allocated %zu, active %zu, resident %zu, mapped %zu\n",
+	    title, stats->allocated, stats->active, stats->resident,
+	    stats->mapped);
+	if (stats->active != 0 && stats->resident != 0) {
+		printf("  fragmentation: %.2f%% of active, %.2f%% of "
+		       "resident\n",
+		    100.0 * (1.0 - (double)stats->allocated / stats->active),
+		    100.0 * (1.0 - (double)stats->allocated / stats->resident));
+	}
+}
+
+static void
+print_usage(const char *program) {
+	printf("Usage: %s [options] <trace file>\n", program);
+	printf("Options:\n");
+	printf("  -h, --help           Show this help message\n");
+	printf("  -t, --threads        Replay each recorded thread on a thread "
+	       "of its own\n");
+	printf("  -i, --interval N     Sample the heap every N calls for the "
+	       "peaks (default: 0=disable)\n");
+	printf("\nTraces are recorded with MALLOC_CONF=alloc_trace:<file>.\n");
+}
+
+int
+main(int argc, char *argv[]) {
+	const char *trace_file = NULL;
+	bool        threaded = false;
+	size_t      interval = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-h") == 0
+		    || strcmp(argv[i], "--help") == 0) {
+			print_usage(argv[0]);
+			return 0;
+		} else if (strcmp(argv[i], "-t") == 0
+		    || strcmp(argv[i], "--threads") == 0) {
+			threaded = true;
+		} else if (strcmp(argv[i], "-i") == 0
+		    || strcmp(argv[i], "--interval") == 0) {
+			if (i + 1 >= argc) {
+				fprintf(stderr,
+				    "Error: %s requires an argument\n",
+				    argv[i]);
+				return 1;
+			}
+			interval = (size_t)atol(argv[++i]);
+		} else if (argv[i][0] != '-') {
+			trace_file = argv[i];
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (trace_file == NULL) {
+		fprintf(stderr, "Error: No trace file specified\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+	if (threaded && interval != 0) {
+		fprintf(stderr, "Error: -i can't be combined with -t\n");
+		return 1;
+	}
+
+	size_t sz = sizeof(tool_arena);
+	if (mallctl("arenas.create", &tool_arena, &sz, NULL, 0) != 0) {
+		fprintf(stderr, "Failed to create an arena\n");
+		return 1;
+	}
+	size_t          nevents;
+	replay_event_t *events = trace_load(trace_file, &nevents);
+	if (events == NULL) {
+		return 1;
+	}
+	replay_prepare(events, nevents);
+	tool_free(events);
+	printf("Trace file: %s\n", trace_file);
+	printf("%zu calls from %u threads on %zu objects (%zu unmatched)\n",
+	    nops, nthreads, nobjs, nunmatched);
+
+	heap_stats_t stats, peak;
+	memset(&peak, 0, sizeof(peak));
+	bool     have_stats = !heap_stats_get(&stats);
+	uint64_t usec = 0;
+	if (threaded) {
+		usec = replay_threaded();
+	} else {
+		for (size_t i = 0; i < nops;) {
+			size_t      end = (interval == 0 || nops - i < interval)
+			         ? nops
+			         : i + interval;
+			timedelta_t timer;
+			timer_start(&timer);
+			for (; i < end; i++) {
+				replay_op(&ops[i]);
+			}
+			timer_stop(&timer);
+			usec += timer_usec(&timer);
+			if (interval != 0 && have_stats) {
+				heap_stats_get(&stats);
+				heap_stats_max(&peak, &stats);
+			}
+		}
+	}
+
+	char buf[FMT_NSECS_BUF_SIZE];
+	fmt_nsecs(usec, nops == 0 ? 1 : nops, buf);
+	printf("Replayed in %" FMTu64 "us (%s ns/call, %.0f calls/s)%s\n", usec,
+	    buf, usec == 0 ? 0.0 : (double)nops * 1000000 / usec,
+	    threaded ? " on one thread per recorded thread" : "");
+	if (nfailed != 0 || nresize_mismatches != 0) {
+		printf("%zu failed allocations, %zu xallocx() results that "
+		       "differ from the trace\n",
+		    nfailed, nresize_mismatches);
+	}
+	if (have_stats) {
+		heap_stats_get(&stats);
+		heap_stats_print("End of trace", &stats);
+		if (interval != 0) {
+			heap_stats_max(&peak, &stats);
+			heap_stats_print("Peak", &peak);
+		}
+	} else {
+		printf("No allocator stats (built without --enable-stats)\n");
+	}
+	size_t rss = rss_get();
+	if (rss != 0) {
+		printf("Process RSS: %zu\n", rss);
+	}
+
+	for (size_t i = 0; i < nobjs; i++) {
+		free(objs[i]);
+	}
+	tool_free(objs);
+	tool_free(objs_resized);
+	tool_free(ops);
+	return 0;
+}
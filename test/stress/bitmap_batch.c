@@ -0,0 +1,64 @@
+#include "test/jemalloc_test.h"
+#include "test/bench.h"
+
+/*
+ * Times extracting the free regions of a slab bitmap the way a tcache fill
+ * does, one bitmap_sfu() at a time versus bitmap_sfu_batch(), and the scalar
+ * batch versus the SIMD one picked at boot (when the CPU has one).  The bitmap
+ * is sized like the 8 byte size class, i.e. the most regions per slab.
+ */
+
+#define NBITS (ZU(1) << SC_LG_SLAB_MAXREGS)
+#define NFILL 128
+
+static bitmap_info_t binfo;
+static bitmap_t      bitmap[BITMAP_GROUPS_MAX];
+static uint32_t      bits[NBITS];
+
+static void
+bitmap_reset(void) {
+	bitmap_init(bitmap, &binfo, false);
+	/* Leave a sparse pattern of allocated regions behind. */
+	for (size_t i = 0; i < NBITS; i += 7) {
+		bitmap_set(bitmap, &binfo, i);
+	}
+}
+
+static void
+sfu_loop(void) {
+	bitmap_reset();
+	for (size_t i = 0; i < NFILL; i++) {
+		bits[i] = (uint32_t)bitmap_sfu(bitmap, &binfo);
+	}
+}
+
+static void
+sfu_batch_scalar(void) {
+	bitmap_reset();
+	bitmap_sfu_batch_simd(bitmap, &binfo, NFILL, bits, bitmap_simd_none);
+}
+
+static void
+sfu_batch(void) {
+	bitmap_reset();
+	bitmap_sfu_batch(bitmap, &binfo, NFILL, bits);
+}
+
+TEST_BEGIN(test_bitmap_sfu_batch) {
+	bitmap_info_init(&binfo, NBITS);
+	const char *names[] = {"none", "sse4.1", "avx2"};
+	assert_u_lt(bitmap_simd, sizeof(names) / sizeof(names[0]),
+	    "Unknown bitmap_simd");
+	malloc_printf("bitmap_simd: %s\n", names[bitmap_simd]);
+
+	compare_funcs(10 * 1000, 1000 * 1000, "bitmap_sfu loop", sfu_loop,
+	    "bitmap_sfu_batch (scalar)", sfu_batch_scalar);
+	compare_funcs(10 * 1000, 1000 * 1000, "bitmap_sfu_batch (scalar)",
+	    sfu_batch_scalar, "bitmap_sfu_batch", sfu_batch);
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_bitmap_sfu_batch);
+}
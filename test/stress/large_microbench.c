@@ -1,6 +1,14 @@
 #include "test/jemalloc_test.h"
 #include "test/bench.h"
 
+/*
+ * The tcache only has bins up to tcache_max; larger allocations are cached
+ * under opt.tcache_large_cache_bytes instead.
+ */
+const char *malloc_conf = "tcache_large_cache_bytes:4194304";
+
+#define LARGE_CACHE_SZ (256 * 1024)
+
 static void
 large_mallocx_free(void) {
 	/*
@@ -21,13 +29,36 @@ small_mallocx_free(void) {
 	free(p);
 }
 
+static void
+large_cached_mallocx_free(void) {
+	void *p = mallocx(LARGE_CACHE_SZ, 0);
+	assert_ptr_not_null(p, "mallocx shouldn't fail");
+	p = no_opt_ptr(p);
+	free(p);
+}
+
+static void
+large_uncached_mallocx_free(void) {
+	void *p = mallocx(LARGE_CACHE_SZ, MALLOCX_TCACHE_NONE);
+	assert_ptr_not_null(p, "mallocx shouldn't fail");
+	p = no_opt_ptr(p);
+	dallocx(p, MALLOCX_TCACHE_NONE);
+}
+
 TEST_BEGIN(test_large_vs_small) {
 	compare_funcs(100 * 1000, 1 * 1000 * 1000, "large mallocx",
 	    large_mallocx_free, "small mallocx", small_mallocx_free);
 }
 TEST_END
 
+TEST_BEGIN(test_large_cache) {
+	compare_funcs(10 * 1000, 100 * 1000, "256KiB mallocx (tcache)",
+	    large_cached_mallocx_free, "256KiB mallocx (no tcache)",
+	    large_uncached_mallocx_free);
+}
+TEST_END
+
 int
 main(void) {
-	return test_no_reentrancy(test_large_vs_small);
+	return test_no_reentrancy(test_large_vs_small, test_large_cache);
 }
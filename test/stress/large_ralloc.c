@@ -0,0 +1,75 @@
+#include "test/jemalloc_test.h"
+#include "test/bench.h"
+
+/*
+ * Grows a buffer by doubling, the way vectors and string builders do, from
+ * 1MiB up to 64MiB.  Each growth writes the new half of the buffer, and a small
+ * allocation placed behind the buffer keeps it from being expanded in place,
+ * so every rallocx() has to move it.  Moves of buffers at or above
+ * opt.large_remap_threshold remap pages rather than copy them; the baseline
+ * always copies.  Run with MALLOC_CONF=large_remap_threshold:0 to compare
+ * against the copying rallocx() path instead.
+ */
+
+#define START_SZ ZU(1 << 20)
+#define MAX_SZ ZU(64 << 20)
+
+static void *
+blocker_alloc(void) {
+	void *blocker = mallocx(SC_LARGE_MINCLASS, MALLOCX_TCACHE_NONE);
+	assert_ptr_not_null(blocker, "Unexpected mallocx() failure");
+	return blocker;
+}
+
+static void
+rallocx_doubling(void) {
+	void *p = mallocx(START_SZ, MALLOCX_TCACHE_NONE);
+	assert_ptr_not_null(p, "Unexpected mallocx() failure");
+	memset(p, 1, START_SZ);
+	for (size_t sz = START_SZ; sz < MAX_SZ; sz *= 2) {
+		void *blocker = blocker_alloc();
+		p = rallocx(p, sz * 2, MALLOCX_TCACHE_NONE);
+		assert_ptr_not_null(p, "Unexpected rallocx() failure");
+		memset((byte_t *)p + sz, 1, sz);
+		dallocx(blocker, MALLOCX_TCACHE_NONE);
+	}
+	p = no_opt_ptr(p);
+	dallocx(p, MALLOCX_TCACHE_NONE);
+}
+
+static void
+memcpy_doubling(void) {
+	void *p = mallocx(START_SZ, MALLOCX_TCACHE_NONE);
+	assert_ptr_not_null(p, "Unexpected mallocx() failure");
+	memset(p, 1, START_SZ);
+	for (size_t sz = START_SZ; sz < MAX_SZ; sz *= 2) {
+		void *blocker = blocker_alloc();
+		void *q = mallocx(sz * 2, MALLOCX_TCACHE_NONE);
+		assert_ptr_not_null(q, "Unexpected mallocx() failure");
+		memcpy(q, p, sz);
+		dallocx(p, MALLOCX_TCACHE_NONE);
+		p = q;
+		memset((byte_t *)p + sz, 1, sz);
+		dallocx(blocker, MALLOCX_TCACHE_NONE);
+	}
+	p = no_opt_ptr(p);
+	dallocx(p, MALLOCX_TCACHE_NONE);
+}
+
+TEST_BEGIN(test_rallocx_doubling) {
+	size_t threshold;
+	size_t sz = sizeof(threshold);
+	expect_d_eq(mallctl("opt.large_remap_threshold", (void *)&threshold,
+	                &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	malloc_printf("large_remap_threshold: %zu\n", threshold);
+
+	compare_funcs(2, 20, "rallocx doubling", rallocx_doubling,
+	    "malloc+memcpy doubling", memcpy_doubling);
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_rallocx_doubling);
+}
@@ -0,0 +1,125 @@
+#include "test/jemalloc_test.h"
+#include "test/bench.h"
+
+/*
+ * Builds a linked list out of malloc()ed nodes after the heap has been churned
+ * (so slabs have holes in random places), then times walking it against
+ * walking the same nodes relinked in address order, the best case for spatial
+ * locality.  Run with MALLOC_CONF=tcache_fill_sort:true to see how much of the
+ * gap address-ordered tcache fills close.
+ */
+
+#define NNODES (64 * 1024)
+#define NCHURN (4 * NNODES)
+
+typedef struct node_s node_t;
+struct node_s {
+	node_t  *next;
+	/* The same nodes, linked in address order. */
+	node_t  *next_by_addr;
+	uint64_t payload[6];
+};
+
+static node_t *list_malloc;
+static node_t *list_sorted;
+static node_t *nodes[NNODES];
+
+static int
+node_addr_comp(const void *a, const void *b) {
+	uintptr_t x = (uintptr_t)*(node_t *const *)a;
+	uintptr_t y = (uintptr_t)*(node_t *const *)b;
+	return (x > y) - (x < y);
+}
+
+static void
+heap_churn(void) {
+	void **ptrs = mallocx(NCHURN * sizeof(void *), 0);
+	assert_ptr_not_null(ptrs, "Unexpected mallocx() failure");
+	for (size_t i = 0; i < NCHURN; i++) {
+		ptrs[i] = malloc(sizeof(node_t));
+		assert_ptr_not_null(ptrs[i], "Unexpected malloc() failure");
+	}
+	/* Free in a random order, leaving every fourth node allocated. */
+	uint64_t state = 42;
+	for (size_t i = NCHURN - 1; i > 0; i--) {
+		size_t j = (size_t)prng_range_u64(&state, i + 1);
+		void  *t = ptrs[i];
+		ptrs[i] = ptrs[j];
+		ptrs[j] = t;
+	}
+	for (size_t i = 0; i < NCHURN; i++) {
+		if (i % 4 != 0) {
+			free(ptrs[i]);
+		}
+	}
+	expect_d_eq(mallctl("thread.tcache.flush", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	/* The survivors are leaked on purpose, to keep the holes in place. */
+	dallocx(ptrs, 0);
+}
+
+static void
+walk_malloc_order(void) {
+	uint64_t sum = 0;
+	for (node_t *n = no_opt_ptr(list_malloc); n != NULL; n = n->next) {
+		sum += n->payload[0];
+	}
+	expect_u64_eq(sum, NNODES, "Unexpected list contents");
+}
+
+static void
+walk_address_order(void) {
+	uint64_t sum = 0;
+	for (node_t *n = no_opt_ptr(list_sorted); n != NULL;
+	     n = n->next_by_addr) {
+		sum += n->payload[0];
+	}
+	expect_u64_eq(sum, NNODES, "Unexpected list contents");
+}
+
+TEST_BEGIN(test_list_traversal) {
+	bool   fill_sort;
+	size_t sz = sizeof(fill_sort);
+	expect_d_eq(mallctl("opt.tcache_fill_sort", (void *)&fill_sort, &sz,
+	                NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	malloc_printf("tcache_fill_sort: %s\n", fill_sort ? "true" : "false");
+
+	heap_churn();
+	for (size_t i = 0; i < NNODES; i++) {
+		nodes[i] = malloc(sizeof(node_t));
+		assert_ptr_not_null(nodes[i], "Unexpected malloc() failure");
+		nodes[i]->payload[0] = 1;
+	}
+	for (size_t i = 0; i < NNODES; i++) {
+		nodes[i]->next = (i + 1 < NNODES) ? nodes[i + 1] : NULL;
+	}
+	list_malloc = nodes[0];
+	size_t nadjacent = 0;
+	for (node_t *n = list_malloc; n->next != NULL; n = n->next) {
+		if ((uintptr_t)n->next == (uintptr_t)n + sizeof(node_t)) {
+			nadjacent++;
+		}
+	}
+	malloc_printf("address-adjacent successors: %zu of %d\n", nadjacent,
+	    NNODES - 1);
+
+	qsort(nodes, NNODES, sizeof(node_t *), node_addr_comp);
+	for (size_t i = 0; i < NNODES; i++) {
+		nodes[i]->next_by_addr = (i + 1 < NNODES) ? nodes[i + 1] : NULL;
+	}
+	list_sorted = nodes[0];
+
+	compare_funcs(10, 200, "malloc order walk", walk_malloc_order,
+	    "address order walk", walk_address_order);
+
+	for (size_t i = 0; i < NNODES; i++) {
+		free(nodes[i]);
+	}
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_list_traversal);
+}
@@ -0,0 +1,70 @@
+#include "test/jemalloc_test.h"
+#include "test/bench.h"
+
+/*
+ * Hammers a single malloc_mutex_t from 1..MAX_NTHREADS threads with a short
+ * critical section, reporting the cost per acquisition along with how the
+ * slow path resolved (spinning vs. blocking).  Build with
+ * -DJEMALLOC_ENABLE_FUTEX_MUTEX=ON to compare the futex based mutex against
+ * pthread mutexes, and vary MALLOC_CONF=mutex_max_spin (or
+ * mutex_max_spin_ranks) to see the effect of spinning.
+ */
+
+#define MAX_NTHREADS 16
+#define NOPS_PER_THREAD (200 * 1000)
+#define CS_WORK 32
+
+static malloc_mutex_t bench_mtx;
+static uint64_t       shared[CS_WORK];
+
+static void *
+thd_start(void *arg) {
+	tsdn_t *tsdn = tsdn_fetch();
+	for (unsigned i = 0; i < NOPS_PER_THREAD; i++) {
+		malloc_mutex_lock(tsdn, &bench_mtx);
+		for (unsigned j = 0; j < CS_WORK; j++) {
+			shared[j] += j;
+		}
+		malloc_mutex_unlock(tsdn, &bench_mtx);
+	}
+	return NULL;
+}
+
+static void
+bench_nthreads(unsigned nthreads) {
+	expect_false(malloc_mutex_init(&bench_mtx, "bench_mutex",
+	                 WITNESS_RANK_OMIT, malloc_mutex_rank_exclusive),
+	    "Unexpected malloc_mutex_init() failure");
+
+	thd_t       thds[MAX_NTHREADS];
+	timedelta_t timer;
+	timer_start(&timer);
+	for (unsigned i = 0; i < nthreads; i++) {
+		thd_create(&thds[i], thd_start, NULL);
+	}
+	for (unsigned i = 0; i < nthreads; i++) {
+		thd_join(thds[i], NULL);
+	}
+	timer_stop(&timer);
+
+	uint64_t nops = (uint64_t)nthreads * NOPS_PER_THREAD;
+	char     buf[FMT_NSECS_BUF_SIZE];
+	fmt_nsecs(timer_usec(&timer), nops, buf);
+	mutex_prof_data_t *data = &bench_mtx.prof_data;
+	malloc_printf("nthreads=%2u: %s ns/op, n_spin_acquired=%" FMTu64
+	              " n_wait_times=%" FMTu64 " max_n_thds=%" FMTu32 "\n",
+	    nthreads, buf, data->n_spin_acquired, data->n_wait_times,
+	    data->max_n_thds);
+}
+
+TEST_BEGIN(test_mutex_contention) {
+	for (unsigned nthreads = 1; nthreads <= MAX_NTHREADS; nthreads *= 2) {
+		bench_nthreads(nthreads);
+	}
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_mutex_contention);
+}
@@ -0,0 +1,87 @@
+#include "test/jemalloc_test.h"
+#include "test/bench.h"
+
+#include "jemalloc/internal/prof_data.h"
+
+/*
+ * Samples every allocation (lg_prof_sample:0) from 1..MAX_NTHREADS threads, and
+ * reports the cost per sampled malloc()/free() pair.  Each allocation is freed
+ * right away, so every sample creates (and destroys) a per-thread counter and
+ * goes through the global backtrace table:
+ *
+ *   shared:  all threads allocate from the same NBTS backtraces, which are kept
+ *            alive by the main thread, so the table is only read.
+ *   private: each thread allocates from backtraces of its own, which are
+ *            inserted into and removed from the table over and over.
+ */
+
+#ifdef JEMALLOC_PROF
+const char *malloc_conf = "prof:true,prof_active:true,lg_prof_sample:0";
+#endif
+
+#define MAX_NTHREADS 16
+#define NOPS_PER_THREAD (20 * 1000)
+#define NBTS 64
+
+static bool private_bts;
+
+static void *
+thd_start(void *arg) {
+	unsigned thd_ind = *(unsigned *)arg;
+	unsigned base = private_bts ? (thd_ind + 1) * NBTS : 0;
+	for (unsigned i = 0; i < NOPS_PER_THREAD; i++) {
+		void *p = btalloc(1, base + i % NBTS);
+		dallocx(p, 0);
+	}
+	return NULL;
+}
+
+static void
+bench_nthreads(unsigned nthreads) {
+	thd_t       thds[MAX_NTHREADS];
+	unsigned    thd_args[MAX_NTHREADS];
+	timedelta_t timer;
+	timer_start(&timer);
+	for (unsigned i = 0; i < nthreads; i++) {
+		thd_args[i] = i;
+		thd_create(&thds[i], thd_start, (void *)&thd_args[i]);
+	}
+	for (unsigned i = 0; i < nthreads; i++) {
+		thd_join(thds[i], NULL);
+	}
+	timer_stop(&timer);
+
+	uint64_t nops = (uint64_t)nthreads * NOPS_PER_THREAD;
+	char     buf[FMT_NSECS_BUF_SIZE];
+	fmt_nsecs(timer_usec(&timer), nops, buf);
+	malloc_printf("%s nthreads=%2u: %s ns/op, backtraces=%zu\n",
+	    private_bts ? "private" : "shared ", nthreads, buf,
+	    prof_bt_count());
+}
+
+TEST_BEGIN(test_prof_bt2gctx) {
+	test_skip_if(!config_prof);
+
+	/* Pin the shared backtraces, so that their gctx's stay around. */
+	void *pinned[NBTS];
+	for (unsigned i = 0; i < NBTS; i++) {
+		pinned[i] = btalloc(1, i);
+	}
+	private_bts = false;
+	for (unsigned nthreads = 1; nthreads <= MAX_NTHREADS; nthreads *= 2) {
+		bench_nthreads(nthreads);
+	}
+	private_bts = true;
+	for (unsigned nthreads = 1; nthreads <= MAX_NTHREADS; nthreads *= 2) {
+		bench_nthreads(nthreads);
+	}
+	for (unsigned i = 0; i < NBTS; i++) {
+		dallocx(pinned[i], 0);
+	}
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_prof_bt2gctx);
+}
@@ -0,0 +1,64 @@
+#include "test/jemalloc_test.h"
+#include "test/bench.h"
+
+/*
+ * Reports the cost of capturing one backtrace with the configured unwinder, at
+ * a few stack depths, with prof_unwind_validate off and on.  Build with
+ * -fno-omit-frame-pointer to measure the frame pointer unwinder.
+ */
+
+#ifdef JEMALLOC_PROF
+const char *malloc_conf = "prof:true,prof_active:false";
+#endif
+
+#define NITER (100 * 1000)
+
+static unsigned bt_len;
+
+/* Returns the depth, so that the recursion can't become a loop. */
+static JEMALLOC_NOINLINE unsigned
+unwind_at_depth(unsigned depth) {
+	if (depth > 0) {
+		return unwind_at_depth(depth - 1) + 1;
+	}
+	void    *vec[PROF_BT_MAX_DEFAULT];
+	unsigned len = 0;
+	prof_backtrace_hook_get()(vec, &len, PROF_BT_MAX_DEFAULT);
+	bt_len = len;
+	return 0;
+}
+
+static void
+bench_depth(unsigned depth, bool validate) {
+	opt_prof_unwind_validate = validate;
+	timedelta_t timer;
+	timer_start(&timer);
+	for (unsigned i = 0; i < NITER; i++) {
+		expect_u_eq(unwind_at_depth(depth), depth, "Unexpected depth");
+	}
+	timer_stop(&timer);
+
+	char buf[FMT_NSECS_BUF_SIZE];
+	fmt_nsecs(timer_usec(&timer), NITER, buf);
+	malloc_printf("depth=%3u validate=%d: %s ns/backtrace, frames=%u\n",
+	    depth, validate, buf, bt_len);
+}
+
+TEST_BEGIN(test_prof_unwind) {
+	test_skip_if(!config_prof);
+
+	malloc_printf("frame pointer unwinder: %s\n",
+	    config_prof_frameptr ? "yes" : "no");
+	bool validate = opt_prof_unwind_validate;
+	for (unsigned depth = 8; depth <= 64; depth *= 2) {
+		bench_depth(depth, false);
+		bench_depth(depth, true);
+	}
+	opt_prof_unwind_validate = validate;
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_prof_unwind);
+}
@@ -0,0 +1,116 @@
+#include "test/jemalloc_test.h"
+#include "test/bench.h"
+
+#include "jemalloc/internal/rtree.h"
+
+/*
+ * Sweeps the number of distinct rtree leaves touched by a lookup loop, to show
+ * where the working set stops fitting in the per-thread rtree_ctx cache
+ * (RTREE_CTX_NCACHE direct mapped + RTREE_CTX_NCACHE_L2 LRU entries).  Build
+ * with different JEMALLOC_RTREE_CTX_NCACHE{,_L2} values to compare geometries;
+ * with JEMALLOC_RTREE_CTX_STATS the hit/miss breakdown is printed as well.
+ */
+
+#define INVALID_ARENA_IND ((1U << MALLOCX_ARENA_BITS) - 1)
+#define NLOOKUPS (4 * 1000 * 1000)
+#define MAX_NLEAVES (4 * (RTREE_CTX_NCACHE + RTREE_CTX_NCACHE_L2))
+
+/* Potentially too large to safely place on the stack. */
+rtree_t bench_rtree;
+
+static uintptr_t keys[MAX_NLEAVES];
+
+static void
+bench_nleaves(tsdn_t *tsdn, rtree_t *rtree, unsigned nleaves) {
+	rtree_ctx_t rtree_ctx;
+	rtree_ctx_data_init(&rtree_ctx);
+
+	/* Warm up the cache with the working set. */
+	for (unsigned i = 0; i < nleaves; i++) {
+		rtree_read(tsdn, rtree, &rtree_ctx, keys[i]);
+	}
+	rtree_ctx_stats_reset(&rtree_ctx);
+
+	/*
+	 * Stride through the keys with a step coprime to nleaves, so that
+	 * consecutive lookups don't simply alternate between two leaves.
+	 */
+	unsigned    step = (nleaves > 2 && nleaves % 3 != 0) ? 3 : 1;
+	unsigned    ind = 0;
+	uintptr_t   sum = 0;
+	timedelta_t timer;
+	timer_start(&timer);
+	for (unsigned i = 0; i < NLOOKUPS; i++) {
+		rtree_contents_t contents = rtree_read(
+		    tsdn, rtree, &rtree_ctx, keys[ind]);
+		sum += (uintptr_t)contents.edata;
+		ind = (ind + step) % nleaves;
+	}
+	timer_stop(&timer);
+	no_opt_ptr((void *)sum);
+
+	char buf[FMT_NSECS_BUF_SIZE];
+	fmt_nsecs(timer_usec(&timer), NLOOKUPS, buf);
+	rtree_ctx_stats_t stats;
+	if (rtree_ctx_stats_read(&rtree_ctx, &stats)) {
+		malloc_printf("nleaves=%3u: %s ns/lookup\n", nleaves, buf);
+	} else {
+		malloc_printf("nleaves=%3u: %s ns/lookup, hits=%" FMTu64
+		              " l2_hits=%" FMTu64 " misses=%" FMTu64
+		              " evictions=%" FMTu64 "\n",
+		    nleaves, buf, stats.hits, stats.l2_hits, stats.misses,
+		    stats.evictions);
+	}
+}
+
+TEST_BEGIN(test_rtree_ctx_sweep) {
+	tsdn_t *tsdn = tsdn_fetch();
+	base_t *base = base_new(tsdn, 0, &ehooks_default_extent_hooks,
+	    /* metadata_use_hooks */ true);
+	expect_ptr_not_null(base, "Unexpected base_new failure");
+	rtree_t *rtree = &bench_rtree;
+	expect_false(
+	    rtree_new(rtree, base, false), "Unexpected rtree_new() failure");
+
+	edata_t *edata = mallocx(sizeof(edata_t),
+	    MALLOCX_ALIGN(EDATA_ALIGNMENT));
+	expect_ptr_not_null(edata, "Unexpected mallocx() failure");
+	edata_init(edata, INVALID_ARENA_IND, NULL, SC_LARGE_MINCLASS, false,
+	    sz_size2index(SC_LARGE_MINCLASS), 0, extent_state_active, false,
+	    false, EXTENT_PAI_PAC, EXTENT_NOT_HEAD);
+	rtree_contents_t contents;
+	contents.edata = edata;
+	contents.metadata.szind = edata_szind_get(edata);
+	contents.metadata.slab = edata_slab_get(edata);
+	contents.metadata.is_head = edata_is_head_get(edata);
+	contents.metadata.state = edata_state_get(edata);
+
+	/* One key per leaf, i.e. one key per leaf-sized span of address space. */
+	uintptr_t leaf_span = ZU(1) << rtree_leaf_maskbits();
+	rtree_ctx_t rtree_ctx;
+	rtree_ctx_data_init(&rtree_ctx);
+	for (unsigned i = 0; i < MAX_NLEAVES; i++) {
+		keys[i] = leaf_span * (i + 1) + PAGE;
+		expect_false(
+		    rtree_write(tsdn, rtree, &rtree_ctx, keys[i], contents),
+		    "Unexpected rtree_write() failure");
+	}
+
+	malloc_printf("rtree_ctx geometry: %u L1 + %u L2 entries\n",
+	    RTREE_CTX_NCACHE, RTREE_CTX_NCACHE_L2);
+	for (unsigned nleaves = 1; nleaves <= MAX_NLEAVES; nleaves *= 2) {
+		bench_nleaves(tsdn, rtree, nleaves);
+		if (nleaves * 3 / 2 <= MAX_NLEAVES && nleaves >= 2) {
+			bench_nleaves(tsdn, rtree, nleaves * 3 / 2);
+		}
+	}
+
+	dallocx(edata, 0);
+	base_delete(tsdn, base);
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_rtree_ctx_sweep);
+}
@@ -0,0 +1,307 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/alloc_trace.h"
+
+#ifndef _WIN32
+#	include <sys/resource.h>
+#endif
+
+#define MAX_EVENTS (8 * ALLOC_TRACE_TBUF_NEVENTS)
+#define NLOOP (2 * ALLOC_TRACE_TBUF_NEVENTS)
+
+static const char *test_filename = "alloc_trace.trace";
+
+/* Events of the last trace, in sequence order. */
+static alloc_trace_event_t events[MAX_EVENTS];
+static uint32_t            event_threads[MAX_EVENTS];
+static size_t              nevents;
+
+/* Bound on any wait below, in milliseconds. */
+#define WAIT_MS (10 * 1000)
+
+static atomic_b_t thd_ready;
+static mtx_t      thd_gate;
+static void      *thd_ptr;
+
+static void *
+thd_exiting_start(void *unused) {
+	void *p = malloc(20);
+	expect_ptr_not_null(p, "Unexpected malloc failure");
+	free(p);
+	return NULL;
+}
+
+static void *
+thd_waiting_start(void *unused) {
+	thd_ptr = malloc(30);
+	expect_ptr_not_null(thd_ptr, "Unexpected malloc failure");
+	atomic_store_b(&thd_ready, true, ATOMIC_RELEASE);
+	/* Block, without going through the allocator, until let go. */
+	mtx_lock(&thd_gate);
+	mtx_unlock(&thd_gate);
+	free(thd_ptr);
+	return NULL;
+}
+
+static void
+trace_start(void) {
+	expect_d_eq(mallctl("experimental.alloc_trace.start", NULL, NULL,
+	                (void *)&test_filename, sizeof(test_filename)),
+	    0, "Unexpected mallctl failure when starting tracing");
+}
+
+static void
+trace_stop(void) {
+	expect_d_eq(
+	    mallctl("experimental.alloc_trace.stop", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure when stopping tracing");
+}
+
+/* Reads the trace back, and checks that no sequence number is missing. */
+static void
+trace_read(void) {
+	static alloc_trace_event_t unsorted[MAX_EVENTS];
+	static uint32_t            unsorted_threads[MAX_EVENTS];
+	static bool                seen[MAX_EVENTS];
+
+	FILE *f = fopen(test_filename, "rb");
+	assert_ptr_not_null(f, "Unexpected fopen() failure");
+	alloc_trace_header_t header;
+	assert_zu_eq(fread(&header, sizeof(header), 1, f), 1, "Missing header");
+	expect_d_eq(memcmp(header.magic, ALLOC_TRACE_MAGIC,
+	                sizeof(ALLOC_TRACE_MAGIC)),
+	    0, "Wrong magic");
+	expect_u_eq(header.version, ALLOC_TRACE_VERSION, "Wrong version");
+	expect_u_eq(header.event_size, sizeof(alloc_trace_event_t),
+	    "Wrong event size");
+
+	nevents = 0;
+	alloc_trace_block_t block;
+	while (fread(&block, sizeof(block), 1, f) == 1) {
+		assert_u_gt(block.nevents, 0, "Empty block");
+		assert_u_le(block.nevents, ALLOC_TRACE_TBUF_NEVENTS,
+		    "Block larger than a buffer");
+		assert_zu_le(nevents + block.nevents, MAX_EVENTS,
+		    "Too many events");
+		assert_zu_eq(fread(&unsorted[nevents],
+		                 sizeof(alloc_trace_event_t), block.nevents, f),
+		    block.nevents, "Truncated block");
+		for (uint32_t i = 0; i < block.nevents; i++) {
+			unsorted_threads[nevents + i] = block.thread;
+		}
+		nevents += block.nevents;
+	}
+	fclose(f);
+	unlink(test_filename);
+
+	memset(seen, 0, sizeof(seen));
+	for (size_t i = 0; i < nevents; i++) {
+		alloc_trace_event_t *event = &unsorted[i];
+		assert_u64_lt(event->seq, nevents, "Sequence number missing");
+		expect_false(seen[event->seq], "Sequence number reused");
+		seen[event->seq] = true;
+		expect_u64_ge(event->time_ns, header.start_ns,
+		    "Event recorded before the start");
+		events[event->seq] = *event;
+		event_threads[event->seq] = unsorted_threads[i];
+	}
+}
+
+/* Returns the index of the next event of thread after *ind. */
+static size_t
+next_event(uint32_t thread, size_t *ind) {
+	while (*ind < nevents && event_threads[*ind] != thread) {
+		(*ind)++;
+	}
+	assert_zu_lt(*ind, nevents, "Missing event of thread %u", thread);
+	return (*ind)++;
+}
+
+static void
+expect_event(uint32_t thread, size_t *ind, alloc_trace_op_t op, void *ptr,
+    void *old_ptr, size_t size, size_t arg, int flags) {
+	size_t               seq = next_event(thread, ind);
+	alloc_trace_event_t *event = &events[seq];
+	expect_u_eq(event->op, op, "Wrong op of event %zu", seq);
+	expect_u64_eq(
+	    event->ptr, (uintptr_t)ptr, "Wrong pointer of event %zu", seq);
+	expect_u64_eq(event->old_ptr, (uintptr_t)old_ptr,
+	    "Wrong old pointer of event %zu", seq);
+	expect_u64_eq(event->size, size, "Wrong size of event %zu", seq);
+	expect_u64_eq(event->arg, arg, "Wrong argument of event %zu", seq);
+	expect_u_eq(
+	    event->flags, (uint32_t)flags, "Wrong flags of event %zu", seq);
+}
+
+TEST_BEGIN(test_alloc_trace) {
+	unsigned arena_ind;
+	size_t   sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", &arena_ind, &sz, NULL, 0), 0,
+	    "Unexpected mallctl failure creating an arena");
+	int arena_flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+
+	expect_d_eq(
+	    mallctl("experimental.alloc_trace.stop", NULL, NULL, NULL, 0),
+	    EFAULT,
+	    "Stopping should fail when not tracing");
+	trace_start();
+	expect_d_eq(mallctl("experimental.alloc_trace.start", NULL, NULL,
+	                (void *)&test_filename, sizeof(test_filename)),
+	    EFAULT, "Starting should fail when already tracing");
+
+	void *p = malloc(10);
+	void *q = calloc(3, 8);
+	void *r = mallocx(100, MALLOCX_ALIGN(64));
+	void *a;
+	expect_d_eq(posix_memalign(&a, 64, 200), 0, "Unexpected failure");
+	void *m = mallocx(1, arena_flags);
+	void *s = malloc(1);
+	expect_true(p != NULL && q != NULL && r != NULL && m != NULL
+	        && s != NULL,
+	    "Unexpected allocation failure");
+	/* Has to move, to a large size class. */
+	void *p2 = realloc(p, 64 * 1024);
+	expect_ptr_not_null(p2, "Unexpected realloc failure");
+	expect_zu_eq(xallocx(r, 100, 0, 0), sallocx(r, 0), "Unexpected resize");
+	sdallocx(r, 100, MALLOCX_ALIGN(64));
+	free(q);
+	dallocx(p2, 0);
+	free(a);
+	dallocx(m, arena_flags);
+	void *s2 = realloc(s, 0);
+	free(s2);
+	/* Fills up the buffer a few times. */
+	for (unsigned i = 0; i < NLOOP; i++) {
+		free(malloc(8));
+	}
+
+	thd_t thd_exiting, thd_waiting;
+	thd_create(&thd_exiting, thd_exiting_start, NULL);
+	thd_join(thd_exiting, NULL);
+	atomic_store_b(&thd_ready, false, ATOMIC_RELAXED);
+	expect_false(mtx_init(&thd_gate), "Unexpected mtx_init() failure");
+	mtx_lock(&thd_gate);
+	thd_create(&thd_waiting, thd_waiting_start, NULL);
+	unsigned i;
+	for (i = 0; i < WAIT_MS && !atomic_load_b(&thd_ready, ATOMIC_ACQUIRE);
+	     i++) {
+		sleep_ns(1000 * 1000);
+	}
+	assert_u_lt(i, WAIT_MS, "Waiting thread didn't start");
+	/* The waiting thread's buffer is written out by stopping. */
+	trace_stop();
+	mtx_unlock(&thd_gate);
+	thd_join(thd_waiting, NULL);
+	mtx_fini(&thd_gate);
+	trace_read();
+
+	size_t   ind = 0;
+	uint32_t thread = event_threads[0];
+	expect_u_ne(thread, 0, "Thread should have had a buffer of its own");
+	expect_event(thread, &ind, alloc_trace_op_malloc, p, NULL, 10, 0, 0);
+	expect_u64_eq(events[ind - 1].usize, sz_s2u(10), "Wrong usable size");
+	expect_event(thread, &ind, alloc_trace_op_calloc, q, NULL, 8, 3, 0);
+	expect_event(thread, &ind, alloc_trace_op_mallocx, r, NULL, 100, 0,
+	    MALLOCX_ALIGN(64));
+	expect_event(thread, &ind, alloc_trace_op_posix_memalign, a, NULL, 200,
+	    64, 0);
+	expect_event(thread, &ind, alloc_trace_op_mallocx, m, NULL, 1, 0,
+	    arena_flags);
+	expect_u_eq(events[ind - 1].arena, arena_ind, "Wrong arena");
+	expect_event(thread, &ind, alloc_trace_op_malloc, s, NULL, 1, 0, 0);
+	/* A moving realloc is a single event. */
+	expect_event(thread, &ind, alloc_trace_op_realloc, p2, p, 64 * 1024, 0,
+	    0);
+	expect_event(thread, &ind, alloc_trace_op_xallocx, r, r, 100, 0, 0);
+	expect_event(thread, &ind, alloc_trace_op_sdallocx, NULL, r, 100, 0,
+	    MALLOCX_ALIGN(64));
+	expect_event(thread, &ind, alloc_trace_op_free, NULL, q, 0, 0, 0);
+	expect_event(thread, &ind, alloc_trace_op_dallocx, NULL, p2, 0, 0, 0);
+	expect_event(thread, &ind, alloc_trace_op_free, NULL, a, 0, 0, 0);
+	expect_event(thread, &ind, alloc_trace_op_dallocx, NULL, m, 0, 0,
+	    arena_flags);
+	if (s2 == NULL) {
+		expect_event(thread, &ind, alloc_trace_op_realloc, NULL, s, 0,
+		    0, 0);
+	} else {
+		/* opt.zero_realloc:alloc resizes to 1 byte. */
+		expect_event(thread, &ind, alloc_trace_op_realloc, s2, s, 1, 0,
+		    0);
+		expect_event(thread, &ind, alloc_trace_op_free, NULL, s2, 0, 0,
+		    0);
+	}
+	for (unsigned i = 0; i < NLOOP; i++) {
+		void *ptr = (void *)(uintptr_t)events[ind].ptr;
+		expect_event(thread, &ind, alloc_trace_op_malloc, ptr, NULL, 8,
+		    0, 0);
+		expect_event(thread, &ind, alloc_trace_op_free, NULL, ptr, 0, 0,
+		    0);
+	}
+
+	/* The other threads' events follow, each thread with its own index. */
+	uint32_t thread_exiting = event_threads[ind];
+	expect_u_ne(thread_exiting, thread, "Threads should have own indices");
+	expect_event(thread_exiting, &ind, alloc_trace_op_malloc,
+	    (void *)(uintptr_t)events[ind].ptr, NULL, 20, 0, 0);
+	expect_event(thread_exiting, &ind, alloc_trace_op_free, NULL,
+	    (void *)(uintptr_t)events[ind - 1].ptr, 0, 0, 0);
+	uint32_t thread_waiting = event_threads[ind];
+	expect_true(
+	    thread_waiting != thread && thread_waiting != thread_exiting,
+	    "Threads should have own indices");
+	expect_event(thread_waiting, &ind, alloc_trace_op_malloc, thd_ptr, NULL,
+	    30, 0, 0);
+	expect_zu_eq(ind, nevents, "Unexpected events after the last one");
+}
+TEST_END
+
+TEST_BEGIN(test_alloc_trace_write_error) {
+#ifdef _WIN32
+	test_skip("No file size limit to hit");
+#else
+	struct rlimit limit_orig, limit;
+	assert_d_eq(getrlimit(RLIMIT_FSIZE, &limit_orig), 0,
+	    "Unexpected getrlimit() failure");
+	/* Leaves room for the header, and for part of the first block. */
+	limit = limit_orig;
+	limit.rlim_cur = sizeof(alloc_trace_header_t)
+	    + sizeof(alloc_trace_block_t) + sizeof(alloc_trace_event_t);
+	void (*sigxfsz_orig)(int) = signal(SIGXFSZ, SIG_IGN);
+	bool abort_orig = opt_abort;
+	opt_abort = false;
+
+	assert_d_eq(setrlimit(RLIMIT_FSIZE, &limit), 0,
+	    "Unexpected setrlimit() failure");
+	trace_start();
+	for (unsigned i = 0; i < NLOOP; i++) {
+		free(malloc(8));
+	}
+	expect_d_eq(
+	    mallctl("experimental.alloc_trace.stop", NULL, NULL, NULL, 0),
+	    EFAULT, "Stopping should report the failed write");
+	assert_d_eq(setrlimit(RLIMIT_FSIZE, &limit_orig), 0,
+	    "Unexpected setrlimit() failure");
+
+	/* The partial block was cut off. */
+	trace_read();
+	expect_zu_eq(nevents, 0, "No complete block should have been written");
+
+	/* Restarting clears the failure. */
+	trace_start();
+	free(malloc(8));
+	trace_stop();
+	trace_read();
+	expect_zu_eq(nevents, 2, "Events should be written again");
+
+	opt_abort = abort_orig;
+	signal(SIGXFSZ, sigxfsz_orig);
+#endif
+}
+TEST_END
+
+int
+main(void) {
+	/* Hooks aren't invoked from within other hooks. */
+	return test_no_reentrancy(
+	    test_alloc_trace, test_alloc_trace_write_error);
+}
@@ -247,10 +247,75 @@ TEST_BEGIN(test_base_ehooks_get_for_metadata_custom_hook) {
 }
 TEST_END
 
+TEST_BEGIN(test_base_edata_reclaim) {
+	test_skip_if(metadata_thp_enabled());
+	enum { NEDATA = 256 };
+	size_t slot_size = ALIGNMENT_CEILING(sizeof(edata_t), EDATA_ALIGNMENT);
+
+	tsdn_t *tsdn = tsd_tsdn(tsd_fetch());
+	bool    reclaim_orig = opt_metadata_reclaim;
+	opt_metadata_reclaim = true;
+	base_t *base = base_new(tsdn, 0,
+	    (extent_hooks_t *)&ehooks_default_extent_hooks,
+	    /* metadata_use_hooks */ true);
+	opt_metadata_reclaim = reclaim_orig;
+	assert_ptr_not_null(base, "Unexpected base_new() failure");
+	assert_true(base_edata_reclaim_enabled(base), "");
+
+	size_t allocated, edata_allocated, rtree_allocated, resident0,
+	    resident1, resident2, mapped, n_thp;
+	if (config_stats) {
+		base_stats_get(tsdn, base, &allocated, &edata_allocated,
+		    &rtree_allocated, &resident0, &mapped, &n_thp);
+	}
+
+	edata_list_inactive_t list;
+	edata_list_inactive_init(&list);
+	expect_zu_eq(base_alloc_edata_batch(tsdn, base, &list, NEDATA), NEDATA,
+	    "Unexpected base_alloc_edata_batch() failure");
+	edata_t *edata;
+	ql_foreach (edata, &list.head, ql_link_inactive) {
+		expect_ptr_eq(ALIGNMENT_ADDR2BASE(edata, BASE_EDATA_CHUNK_SIZE),
+		    ALIGNMENT_ADDR2BASE(
+		        edata_list_inactive_first(&list), BASE_EDATA_CHUNK_SIZE),
+		    "edata_t's should be packed into one chunk");
+	}
+	if (config_stats) {
+		expect_zu_eq(base_edata_reclaimable_get(tsdn, base),
+		    NEDATA * slot_size, "");
+		base_stats_get(tsdn, base, &allocated, &edata_allocated,
+		    &rtree_allocated, &resident1, &mapped, &n_thp);
+		expect_zu_ge(resident1 - resident0, NEDATA * slot_size,
+		    "Pages backing edata_t's should count as resident");
+	}
+
+	base_free_edata_batch(tsdn, base, &list);
+	expect_true(edata_list_inactive_empty(&list), "");
+	if (config_stats) {
+		expect_zu_eq(base_edata_reclaimable_get(tsdn, base), 0, "");
+		base_stats_get(tsdn, base, &allocated, &edata_allocated,
+		    &rtree_allocated, &resident2, &mapped, &n_thp);
+		if (pages_can_purge_forced) {
+			expect_zu_ge(resident1 - resident2, NEDATA * slot_size,
+			    "Fully free edata pages should have been purged");
+		}
+	}
+
+	/* Purged pages are handed out again, as demand-zeroed memory. */
+	edata = base_alloc_edata(tsdn, base);
+	expect_ptr_not_null(edata, "Unexpected base_alloc_edata() failure");
+	edata_list_inactive_append(&list, edata);
+	base_free_edata_batch(tsdn, base, &list);
+
+	base_delete(tsdn, base);
+}
+TEST_END
+
 int
 main(void) {
 	return test(test_base_hooks_default, test_base_hooks_null,
 	    test_base_hooks_not_null,
 	    test_base_ehooks_get_for_metadata_default_hook,
-	    test_base_ehooks_get_for_metadata_custom_hook);
+	    test_base_ehooks_get_for_metadata_custom_hook,
+	    test_base_edata_reclaim);
 }
@@ -340,8 +340,90 @@ TEST_BEGIN(test_bitmap_xfu) {
 }
 TEST_END
 
+static void
+test_bitmap_sfu_batch_body(const bitmap_info_t *binfo, size_t nbits,
+    bitmap_simd_t simd, uint64_t *prng_state) {
+	size_t    size = bitmap_size(binfo);
+	bitmap_t *expected = (bitmap_t *)malloc(size);
+	bitmap_t *bitmap = (bitmap_t *)malloc(size);
+	uint32_t *bits = (uint32_t *)malloc(nbits * sizeof(uint32_t));
+	expect_ptr_not_null(expected, "Unexpected malloc() failure");
+	expect_ptr_not_null(bitmap, "Unexpected malloc() failure");
+	expect_ptr_not_null(bits, "Unexpected malloc() failure");
+
+	/* Empty, then a quarter, then three quarters of the bits set. */
+	for (unsigned density = 0; density < 3; density++) {
+		bitmap_init(expected, binfo, false);
+		size_t nfree = nbits;
+		for (size_t i = 0; density > 0 && i < nbits; i++) {
+			bool set = (density == 1)
+			    ? prng_range_u64(prng_state, 4) == 0
+			    : prng_range_u64(prng_state, 4) != 0;
+			if (set) {
+				bitmap_set(expected, binfo, i);
+				nfree--;
+			}
+		}
+		if (nfree == 0) {
+			continue;
+		}
+		/* Take half the unset bits, then the rest, then all at once. */
+		size_t cnts[] = {(nfree + 1) / 2, nfree / 2};
+		memcpy(bitmap, expected, size);
+		for (unsigned k = 0; k < 2; k++) {
+			if (cnts[k] == 0) {
+				continue;
+			}
+			bitmap_sfu_batch_simd(bitmap, binfo, cnts[k], bits, simd);
+			for (size_t i = 0; i < cnts[k]; i++) {
+				expect_u_eq(bits[i],
+				    (unsigned)bitmap_sfu(expected, binfo),
+				    "Batch should match bitmap_sfu() (simd=%d)",
+				    (int)simd);
+			}
+			expect_d_eq(memcmp(bitmap, expected, size), 0,
+			    "Bitmaps diverged (simd=%d)", (int)simd);
+		}
+		expect_true(bitmap_full(bitmap, binfo), "All bits should be set");
+	}
+	bitmap_init(bitmap, binfo, false);
+	bitmap_sfu_batch_simd(bitmap, binfo, nbits, bits, simd);
+	for (size_t i = 0; i < nbits; i++) {
+		expect_u_eq(bits[i], (unsigned)i, "Bits should come in order");
+	}
+	expect_true(bitmap_full(bitmap, binfo), "All bits should be set");
+
+	free(expected);
+	free(bitmap);
+	free(bits);
+}
+
+TEST_BEGIN(test_bitmap_sfu_batch) {
+	expect_true(bitmap_simd_supported(bitmap_simd),
+	    "The selected implementation should be supported");
+	expect_true(bitmap_simd_supported(bitmap_simd_none),
+	    "The scalar implementation is always supported");
+
+	uint64_t prng_state = 42;
+	for (unsigned simd = 0; simd < bitmap_simd_limit; simd++) {
+		if (!bitmap_simd_supported((bitmap_simd_t)simd)) {
+			continue;
+		}
+		size_t nbits_max = BITMAP_MAXBITS > 1024 ? 1024
+		                                         : BITMAP_MAXBITS;
+		for (size_t nbits = 1; nbits <= nbits_max; nbits++) {
+			bitmap_info_t binfo;
+			bitmap_info_init(&binfo, nbits);
+			test_bitmap_sfu_batch_body(
+			    &binfo, nbits, (bitmap_simd_t)simd, &prng_state);
+		}
+	}
+}
+TEST_END
+
 int
 main(void) {
 	return test(test_bitmap_initializer, test_bitmap_size, test_bitmap_init,
-	    test_bitmap_set, test_bitmap_unset, test_bitmap_xfu);
+	    test_bitmap_set, test_bitmap_unset, test_bitmap_xfu,
+	    test_bitmap_sfu_batch);
 }
@@ -217,8 +217,102 @@ TEST_BEGIN(test_edata_cache_disable) {
 }
 TEST_END
 
+TEST_BEGIN(test_edata_cache_percpu) {
+	enum { NEDATA = 16, PERCPU_MAX = 4 };
+	edata_cache_t ec;
+	edata_t      *eds[NEDATA];
+
+	test_edata_cache_init(&ec);
+	assert_false(edata_cache_percpu_init(TSDN_NULL, &ec, PERCPU_MAX), "");
+	assert_ptr_not_null(ec.percpu, "");
+	assert_u_gt(ec.npercpu, 0, "");
+
+	for (int i = 0; i < NEDATA; i++) {
+		eds[i] = edata_cache_get(TSDN_NULL, &ec);
+		assert_ptr_not_null(eds[i], "");
+		for (int j = 0; j < i; j++) {
+			expect_ptr_ne(eds[i], eds[j], "Duplicate edata handed out");
+		}
+	}
+	/* Refills pre-allocate in batches, which leaves a few stashed. */
+	size_t navail = edata_cache_navail(&ec);
+	expect_zu_le(navail, ec.npercpu * PERCPU_MAX, "");
+
+	for (int i = 0; i < NEDATA; i++) {
+		edata_cache_put(TSDN_NULL, &ec, eds[i]);
+	}
+	expect_zu_eq(edata_cache_navail(&ec), navail + NEDATA, "");
+	size_t nshard = 0;
+	for (unsigned i = 0; i < ec.npercpu; i++) {
+		size_t count = atomic_load_zu(&ec.percpu[i].count,
+		    ATOMIC_RELAXED);
+		expect_zu_le(count, PERCPU_MAX, "Shard exceeded its capacity");
+		nshard += count;
+	}
+	expect_zu_eq(atomic_load_zu(&ec.count, ATOMIC_RELAXED) + nshard,
+	    navail + NEDATA, "");
+
+	/* Batch operations draw from the shard first, then the central cache. */
+	edata_list_inactive_t list;
+	edata_list_inactive_init(&list);
+	expect_zu_eq(edata_cache_get_batch(TSDN_NULL, &ec, &list, NEDATA),
+	    NEDATA, "");
+	expect_zu_eq(edata_cache_navail(&ec), navail, "");
+	edata_cache_put_batch(TSDN_NULL, &ec, &list);
+	expect_true(edata_list_inactive_empty(&list), "");
+	expect_zu_eq(edata_cache_navail(&ec), navail + NEDATA, "");
+
+	test_edata_cache_destroy(&ec);
+}
+TEST_END
+
+TEST_BEGIN(test_edata_cache_percpu_fast_flush) {
+	edata_cache_t      ec;
+	edata_cache_fast_t ecf;
+
+	test_edata_cache_init(&ec);
+	assert_false(edata_cache_percpu_init(TSDN_NULL, &ec, 4), "");
+	test_skip_if(ec.percpu == NULL);
+	edata_cache_fast_init(&ecf, &ec);
+
+	for (int i = 0; i < EDATA_CACHE_FAST_FILL; i++) {
+		edata_t *edata = edata_cache_get(TSDN_NULL, &ec);
+		expect_ptr_not_null(edata, "");
+		edata_cache_fast_put(TSDN_NULL, &ecf, edata);
+	}
+	size_t central = atomic_load_zu(&ec.count, ATOMIC_RELAXED);
+	edata_cache_fast_disable(TSDN_NULL, &ecf);
+	/* The flush skips the shards, to land in the address-ordered heap. */
+	expect_zu_eq(central + EDATA_CACHE_FAST_FILL,
+	    atomic_load_zu(&ec.count, ATOMIC_RELAXED),
+	    "Flushed edatas should go to the central cache");
+
+	test_edata_cache_destroy(&ec);
+}
+TEST_END
+
+TEST_BEGIN(test_edata_cache_percpu_arena0) {
+	test_skip_if(opt_edata_cache_percpu_max == 0);
+	test_skip_if(ncpus == 0);
+
+	arena_t *arena = arena_get(TSDN_NULL, 0, false);
+	assert_ptr_not_null(arena, "");
+	edata_cache_t *ec = &arena->pa_shard.edata_cache;
+	expect_ptr_not_null(ec->percpu,
+	    "Arena 0 should have per-CPU shards once ncpus is known");
+	expect_u_eq(ec->npercpu,
+	    ncpus < EDATA_CACHE_PERCPU_NSHARDS_MAX
+	        ? ncpus
+	        : EDATA_CACHE_PERCPU_NSHARDS_MAX,
+	    "");
+	expect_zu_eq(ec->percpu_max, opt_edata_cache_percpu_max, "");
+}
+TEST_END
+
 int
 main(void) {
 	return test(test_edata_cache, test_edata_cache_fast_simple,
-	    test_edata_cache_fill, test_edata_cache_disable);
+	    test_edata_cache_fill, test_edata_cache_disable,
+	    test_edata_cache_percpu, test_edata_cache_percpu_fast_flush,
+	    test_edata_cache_percpu_arena0);
 }
@@ -221,6 +221,52 @@ node_remove(mem_tree_t *tree, edata_t *edata) {
 	mem_tree_remove(tree, contents);
 }
 
+static void
+expect_zeroed(const edata_t *edata) {
+	const unsigned char *p = (const unsigned char *)edata_base_get(edata);
+	for (size_t i = 0; i < edata_size_get(edata); i++) {
+		if (p[i] != 0) {
+			expect_u_eq(p[i], 0, "Nonzero byte at offset %zu", i);
+			return;
+		}
+	}
+}
+
+TEST_BEGIN(test_alloc_zero) {
+	test_skip_if(!hpa_supported());
+
+	/* Defer purging, so that freed pages stay dirty. */
+	hpa_shard_opts_t opts = test_hpa_shard_opts_default;
+	opts.deferral_allowed = true;
+	hpa_shard_t *shard = create_test_data(&hpa_hooks_default, &opts);
+	tsdn_t *tsdn = tsd_tsdn(tsd_fetch());
+
+	/* Untouched pages of a fresh pageslab need no zeroing. */
+	bool     deferred_work_generated = false;
+	edata_t *edata = pai_alloc(tsdn, &shard->pai, 4 * PAGE, PAGE,
+	    /* zero */ true, /* guarded */ false, /* frequent_reuse */ false,
+	    &deferred_work_generated);
+	expect_ptr_not_null(edata, "Unexpected null edata");
+	expect_true(edata_zeroed_get(edata), "Fresh pages should be zeroed");
+	expect_zeroed(edata);
+
+	/* Dirty pages, even if only some of them, have to be zeroed. */
+	memset(edata_base_get(edata), 0xa5, edata_size_get(edata));
+	void *addr = edata_base_get(edata);
+	pai_dalloc(tsdn, &shard->pai, edata, &deferred_work_generated);
+	edata = pai_alloc(tsdn, &shard->pai, 8 * PAGE, PAGE, /* zero */ true,
+	    /* guarded */ false, /* frequent_reuse */ false,
+	    &deferred_work_generated);
+	expect_ptr_not_null(edata, "Unexpected null edata");
+	expect_ptr_eq(addr, edata_base_get(edata), "Expected first-fit reuse");
+	expect_false(edata_zeroed_get(edata), "Dirty pages reported zeroed");
+	expect_zeroed(edata);
+	pai_dalloc(tsdn, &shard->pai, edata, &deferred_work_generated);
+
+	destroy_test_data(shard);
+}
+TEST_END
+
 TEST_BEGIN(test_stress) {
 	test_skip_if(!hpa_supported());
 
@@ -402,11 +448,12 @@ defer_test_unmap(void *ptr, size_t size) {
 
 static size_t ndefer_purge_calls = 0;
 static size_t npurge_size = 0;
-static void
+static bool
 defer_test_purge(void *ptr, size_t size) {
 	(void)ptr;
 	npurge_size = size;
 	++ndefer_purge_calls;
+	return false;
 }
 
 static bool defer_vectorized_purge_called = false;
@@ -1455,7 +1502,7 @@ main(void) {
 	(void)mem_tree_iter;
 	(void)mem_tree_reverse_iter;
 	(void)mem_tree_destroy;
-	return test_no_reentrancy(test_alloc_max, test_stress,
+	return test_no_reentrancy(test_alloc_max, test_alloc_zero, test_stress,
 	    test_alloc_dalloc_batch, test_defer_time,
 	    test_purge_no_infinite_loop, test_no_min_purge_interval,
 	    test_min_purge_interval, test_purge,
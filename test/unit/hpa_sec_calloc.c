@@ -0,0 +1,45 @@
+#include "test/jemalloc_test.h"
+
+#define NITER 16
+
+TEST_BEGIN(test_calloc_after_dirty_free) {
+	bool   hpa;
+	size_t nshards;
+	size_t sz = sizeof(hpa);
+	expect_d_eq(mallctl("opt.hpa", &hpa, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	test_skip_if(!hpa);
+	sz = sizeof(nshards);
+	expect_d_eq(mallctl("opt.hpa_sec_nshards", &nshards, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	test_skip_if(nshards == 0);
+
+	/* Small enough for the SEC to cache, and to skip the calloc madvise. */
+	size_t size = SC_LARGE_MINCLASS;
+	assert_zu_le(size + sz_large_pad, opt_hpa_sec_opts.max_alloc,
+	    "The SEC should cache the extent");
+	assert_zu_lt(size, opt_calloc_madvise_threshold, "");
+
+	for (unsigned i = 0; i < NITER; i++) {
+		unsigned char *p = calloc(1, size);
+		assert_ptr_not_null(p, "Unexpected calloc() failure");
+		for (size_t j = 0; j < size; j++) {
+			if (p[j] != 0) {
+				expect_u_eq(p[j], 0,
+				    "calloc() memory not zero at offset %zu, "
+				    "iteration %u",
+				    j, i);
+				break;
+			}
+		}
+		/* Dirty it, so that the SEC recycles written-to pages. */
+		memset(p, 0xa5, size);
+		free(p);
+	}
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_calloc_after_dirty_free);
+}
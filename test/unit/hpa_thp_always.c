@@ -97,11 +97,12 @@ defer_test_unmap(void *ptr, size_t size) {
 
 static size_t ndefer_purge_calls = 0;
 static size_t npurge_size = 0;
-static void
+static bool
 defer_test_purge(void *ptr, size_t size) {
 	(void)ptr;
 	npurge_size = size;
 	++ndefer_purge_calls;
+	return false;
 }
 
 static bool defer_vectorized_purge_called = false;
@@ -96,11 +96,12 @@ defer_test_unmap(void *ptr, size_t size) {
 }
 
 static size_t ndefer_purge_calls = 0;
-static void
+static bool
 defer_test_purge(void *ptr, size_t size) {
 	(void)ptr;
 	(void)size;
 	++ndefer_purge_calls;
+	return false;
 }
 
 static size_t ndefer_vec_purge_calls = 0;
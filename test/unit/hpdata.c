@@ -12,7 +12,7 @@ TEST_BEGIN(test_reserve_alloc) {
 		expect_true(hpdata_consistent(&hpdata), "");
 		expect_zu_eq(HUGEPAGE_PAGES - i,
 		    hpdata_longest_free_range_get(&hpdata), "");
-		void *alloc = hpdata_reserve_alloc(&hpdata, PAGE);
+		void *alloc = hpdata_reserve_alloc(&hpdata, PAGE, NULL);
 		expect_ptr_eq((char *)HPDATA_ADDR + i * PAGE, alloc, "");
 		expect_true(hpdata_consistent(&hpdata), "");
 	}
@@ -59,7 +59,8 @@ TEST_BEGIN(test_purge_simple) {
 	hpdata_t hpdata;
 	hpdata_init(&hpdata, HPDATA_ADDR, HPDATA_AGE, /* is_huge */ false);
 
-	void *alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE_PAGES / 2 * PAGE);
+	void *alloc = hpdata_reserve_alloc(
+	    &hpdata, HUGEPAGE_PAGES / 2 * PAGE, NULL);
 	expect_ptr_eq(alloc, HPDATA_ADDR, "");
 
 	/* Create HUGEPAGE_PAGES / 4 dirty inactive pages at the beginning. */
@@ -105,7 +106,7 @@ TEST_BEGIN(test_purge_intervening_dalloc) {
 
 	/* Allocate the first 3/4 of the pages. */
 	void *alloc = hpdata_reserve_alloc(
-	    &hpdata, 3 * HUGEPAGE_PAGES / 4 * PAGE);
+	    &hpdata, 3 * HUGEPAGE_PAGES / 4 * PAGE, NULL);
 	expect_ptr_eq(alloc, HPDATA_ADDR, "");
 
 	/* Free the first 1/4 and the third 1/4 of the pages. */
@@ -168,7 +169,7 @@ TEST_BEGIN(test_purge_over_retained) {
 
 	/* Allocate the first 3/4 of the pages. */
 	void *alloc = hpdata_reserve_alloc(
-	    &hpdata, 3 * HUGEPAGE_PAGES / 4 * PAGE);
+	    &hpdata, 3 * HUGEPAGE_PAGES / 4 * PAGE, NULL);
 	expect_ptr_eq(alloc, HPDATA_ADDR, "");
 
 	/* Free the second quarter. */
@@ -240,7 +241,7 @@ TEST_BEGIN(test_hugify) {
 	hpdata_t hpdata;
 	hpdata_init(&hpdata, HPDATA_ADDR, HPDATA_AGE, /* is_huge */ false);
 
-	void *alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 2);
+	void *alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 2, NULL);
 	expect_ptr_eq(alloc, HPDATA_ADDR, "");
 
 	expect_zu_eq(HUGEPAGE_PAGES / 2, hpdata_ntouched_get(&hpdata), "");
@@ -252,9 +253,56 @@ TEST_BEGIN(test_hugify) {
 }
 TEST_END
 
+TEST_BEGIN(test_reserve_zeroed) {
+	hpdata_t hpdata;
+	hpdata_init(&hpdata, HPDATA_ADDR, HPDATA_AGE, /* is_huge */ false);
+
+	bool  zeroed;
+	void *alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 2, &zeroed);
+	expect_true(zeroed, "Untouched pages of a fresh hpdata should be zero");
+
+	/* Reusing dirty pages can't be zeroed, even partially. */
+	hpdata_unreserve(&hpdata, alloc, HUGEPAGE / 2);
+	alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 4, &zeroed);
+	expect_ptr_eq(alloc, HPDATA_ADDR, "");
+	expect_false(zeroed, "Dirty pages should not be reported as zeroed");
+	hpdata_unreserve(&hpdata, alloc, HUGEPAGE / 4);
+	alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 2 + PAGE, &zeroed);
+	expect_ptr_eq(alloc, HPDATA_ADDR, "");
+	expect_false(zeroed, "Partially dirty range reported as zeroed");
+	hpdata_unreserve(&hpdata, alloc, HUGEPAGE / 2 + PAGE);
+
+	/* Purging the dirty pages makes them zeroed again. */
+	hpdata_alloc_allowed_set(&hpdata, false);
+	hpdata_purge_state_t purge_state;
+	size_t               nranges;
+	hpdata_purge_begin(&hpdata, &purge_state, &nranges);
+	void  *purge_addr;
+	size_t purge_size;
+	while (hpdata_purge_next(
+	    &hpdata, &purge_state, &purge_addr, &purge_size)) {
+	}
+	hpdata_purge_end(&hpdata, &purge_state);
+	hpdata_alloc_allowed_set(&hpdata, true);
+	alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 4, &zeroed);
+	expect_ptr_eq(alloc, HPDATA_ADDR, "");
+	expect_true(zeroed, "Purged pages should be reported as zeroed");
+
+	/* Unless a purge failed at some point. */
+	hpdata_untouched_zeroed_set(&hpdata, false);
+	alloc = hpdata_reserve_alloc(&hpdata, HUGEPAGE / 4, &zeroed);
+	expect_false(zeroed, "Zeroed reported after a failed purge");
+
+	/* Hugified pages are always considered touched. */
+	hpdata_init(&hpdata, HPDATA_ADDR, HPDATA_AGE, /* is_huge */ true);
+	alloc = hpdata_reserve_alloc(&hpdata, PAGE, &zeroed);
+	expect_false(zeroed, "Huge pages should not be reported as zeroed");
+}
+TEST_END
+
 int
 main(void) {
 	return test_no_reentrancy(test_reserve_alloc, test_purge_simple,
 	    test_purge_intervening_dalloc, test_purge_over_retained,
-	    test_hugify);
+	    test_hugify, test_reserve_zeroed);
 }
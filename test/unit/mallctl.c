@@ -273,6 +273,7 @@ TEST_BEGIN(test_mallctl_config) {
 	TEST_MALLCTL_CONFIG(prof_libgcc, bool);
 	TEST_MALLCTL_CONFIG(prof_libunwind, bool);
 	TEST_MALLCTL_CONFIG(prof_frameptr, bool);
+	TEST_MALLCTL_CONFIG(rtree_ctx_stats, bool);
 	TEST_MALLCTL_CONFIG(stats, bool);
 	TEST_MALLCTL_CONFIG(utrace, bool);
 	TEST_MALLCTL_CONFIG(xmalloc, bool);
@@ -304,6 +305,7 @@ TEST_BEGIN(test_mallctl_opt) {
 	    bool, experimental_hpa_start_huge_if_thp_always, always);
 	TEST_MALLCTL_OPT(bool, confirm_conf, always);
 	TEST_MALLCTL_OPT(const char *, metadata_thp, always);
+	TEST_MALLCTL_OPT(bool, metadata_reclaim, always);
 	TEST_MALLCTL_OPT(bool, retain, always);
 	TEST_MALLCTL_OPT(const char *, dss, always);
 	TEST_MALLCTL_OPT(bool, hpa, always);
@@ -321,6 +323,7 @@ TEST_BEGIN(test_mallctl_opt) {
 	TEST_MALLCTL_OPT(unsigned, narenas, always);
 	TEST_MALLCTL_OPT(const char *, percpu_arena, always);
 	TEST_MALLCTL_OPT(size_t, oversize_threshold, always);
+	TEST_MALLCTL_OPT(size_t, large_remap_threshold, always);
 	TEST_MALLCTL_OPT(bool, background_thread, always);
 	TEST_MALLCTL_OPT(ssize_t, dirty_decay_ms, always);
 	TEST_MALLCTL_OPT(ssize_t, muzzy_decay_ms, always);
@@ -333,10 +336,20 @@ TEST_BEGIN(test_mallctl_opt) {
 	TEST_MALLCTL_OPT(bool, utrace, utrace);
 	TEST_MALLCTL_OPT(bool, xmalloc, xmalloc);
 	TEST_MALLCTL_OPT(bool, tcache, always);
+	TEST_MALLCTL_OPT(bool, experimental_tcache_gc_reuse, always);
+	TEST_MALLCTL_OPT(ssize_t, tcache_idle_reclaim_ms, always);
+	TEST_MALLCTL_OPT(ssize_t, tcache_ncached_max_learn_ms, always);
+	TEST_MALLCTL_OPT(size_t, tcache_large_cache_bytes, always);
+	TEST_MALLCTL_OPT(size_t, tcache_large_cache_max, always);
+	TEST_MALLCTL_OPT(bool, tcache_steal, always);
+	TEST_MALLCTL_OPT(bool, tcache_fill_sort, always);
 	TEST_MALLCTL_OPT(size_t, lg_extent_max_active_fit, always);
+	TEST_MALLCTL_OPT(size_t, edata_cache_percpu_max, always);
+	TEST_MALLCTL_OPT(unsigned, mutex_hold_sample, always);
 	TEST_MALLCTL_OPT(size_t, tcache_max, always);
 	TEST_MALLCTL_OPT(const char *, thp, always);
 	TEST_MALLCTL_OPT(const char *, zero_realloc, always);
+	TEST_MALLCTL_OPT(const char *, alloc_trace, always);
 	TEST_MALLCTL_OPT(bool, prof, prof);
 	TEST_MALLCTL_OPT(const char *, prof_prefix, prof);
 	TEST_MALLCTL_OPT(bool, prof_active, prof);
@@ -353,6 +366,14 @@ TEST_BEGIN(test_mallctl_opt) {
 	TEST_MALLCTL_OPT(ssize_t, prof_recent_alloc_max, prof);
 	TEST_MALLCTL_OPT(bool, prof_stats, prof);
 	TEST_MALLCTL_OPT(bool, prof_sys_thread_name, prof);
+	TEST_MALLCTL_OPT(bool, prof_unwind_validate, prof);
+	TEST_MALLCTL_OPT(bool, prof_lifetime, prof);
+	TEST_MALLCTL_OPT(bool, prof_per_arena, prof);
+	TEST_MALLCTL_OPT(bool, prof_log_stream, prof);
+	TEST_MALLCTL_OPT(size_t, prof_log_stream_buf_size, prof);
+	TEST_MALLCTL_OPT(unsigned, prof_leak_epochs, prof);
+	TEST_MALLCTL_OPT(uint64_t, prof_leak_epoch_ms, prof);
+	TEST_MALLCTL_OPT(const char *, prof_dump_format, prof);
 	TEST_MALLCTL_OPT(ssize_t, lg_san_uaf_align, uaf_detection);
 	TEST_MALLCTL_OPT(unsigned, debug_double_free_max_scan, always);
 	TEST_MALLCTL_OPT(bool, disable_large_size_classes, always);
@@ -952,6 +973,8 @@ TEST_BEGIN(test_arenas_bin_constants) {
 	TEST_ARENAS_BIN_CONSTANT(uint32_t, nregs, bin_infos[0].nregs);
 	TEST_ARENAS_BIN_CONSTANT(size_t, slab_size, bin_infos[0].slab_size);
 	TEST_ARENAS_BIN_CONSTANT(uint32_t, nshards, bin_infos[0].n_shards);
+	TEST_ARENAS_BIN_CONSTANT(
+	    unsigned, hugepage_regions, arena_slab_hugepage_regions[0]);
 
 #undef TEST_ARENAS_BIN_CONSTANT
 }
@@ -1333,6 +1356,40 @@ TEST_BEGIN(test_thread_peak) {
 }
 TEST_END
 
+TEST_BEGIN(test_thread_rtree_ctx) {
+	uint64_t hits, l2_hits, misses, evictions;
+	size_t   sz = sizeof(uint64_t);
+	int      expected = config_rtree_ctx_stats ? 0 : ENOENT;
+
+	expect_d_eq(mallctl("thread.rtree_ctx.reset", NULL, NULL, NULL, 0),
+	    expected, "Unexpected mallctl() result");
+	test_skip_if(!config_rtree_ctx_stats);
+
+	expect_d_eq(mallctl("thread.rtree_ctx.hits", &hits, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u64_eq(hits, 0, "Reset should clear hits");
+
+	/* Frees of large extents always consult the rtree. */
+	for (unsigned i = 0; i < 16; i++) {
+		void *p = mallocx(SC_LARGE_MINCLASS, MALLOCX_TCACHE_NONE);
+		expect_ptr_not_null(p, "Unexpected mallocx() failure");
+		dallocx(p, MALLOCX_TCACHE_NONE);
+	}
+
+	expect_d_eq(mallctl("thread.rtree_ctx.hits", &hits, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_d_eq(mallctl("thread.rtree_ctx.l2_hits", &l2_hits, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	expect_d_eq(mallctl("thread.rtree_ctx.misses", &misses, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	expect_d_eq(
+	    mallctl("thread.rtree_ctx.evictions", &evictions, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u64_gt(hits + l2_hits + misses, 0, "Lookups weren't counted");
+	expect_u64_le(evictions, misses, "Only misses can evict");
+}
+TEST_END
+
 typedef struct activity_test_data_s activity_test_data_t;
 struct activity_test_data_s {
 	uint64_t obtained_alloc;
@@ -1456,5 +1513,6 @@ main(void) {
 	    test_stats_arenas_hpa_shard_counters,
 	    test_stats_arenas_hpa_shard_slabs, test_hooks,
 	    test_hooks_exhaustion, test_thread_idle, test_thread_peak,
-	    test_thread_activity_callback, test_thread_event_hook);
+	    test_thread_rtree_ctx, test_thread_activity_callback,
+	    test_thread_event_hook);
 }
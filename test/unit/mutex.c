@@ -0,0 +1,202 @@
+#include "test/jemalloc_test.h"
+
+#define NTHREADS 4
+#define NINCS 100000
+
+static malloc_mutex_t test_mtx;
+static uint64_t       counter;
+
+TEST_BEGIN(test_mutex_lock_trylock) {
+	tsdn_t *tsdn = tsdn_fetch();
+	malloc_mutex_t mtx;
+	expect_false(malloc_mutex_init(&mtx, "test_mutex", WITNESS_RANK_OMIT,
+	                 malloc_mutex_rank_exclusive),
+	    "Unexpected malloc_mutex_init() failure");
+
+	expect_false(malloc_mutex_trylock(tsdn, &mtx),
+	    "trylock of an unlocked mutex should succeed");
+	expect_true(malloc_mutex_trylock_final(&mtx),
+	    "trylock of a locked mutex should fail");
+	malloc_mutex_unlock(tsdn, &mtx);
+
+	malloc_mutex_lock(tsdn, &mtx);
+	expect_true(malloc_mutex_trylock_final(&mtx),
+	    "trylock of a locked mutex should fail");
+	malloc_mutex_unlock(tsdn, &mtx);
+	expect_false(malloc_mutex_trylock(tsdn, &mtx),
+	    "trylock of an unlocked mutex should succeed");
+	malloc_mutex_unlock(tsdn, &mtx);
+}
+TEST_END
+
+static void *
+thd_start(void *arg) {
+	tsdn_t *tsdn = tsdn_fetch();
+	for (unsigned i = 0; i < NINCS; i++) {
+		malloc_mutex_lock(tsdn, &test_mtx);
+		counter++;
+		malloc_mutex_unlock(tsdn, &test_mtx);
+	}
+	return NULL;
+}
+
+TEST_BEGIN(test_mutex_contended) {
+	expect_false(malloc_mutex_init(&test_mtx, "test_mutex",
+	                 WITNESS_RANK_OMIT, malloc_mutex_rank_exclusive),
+	    "Unexpected malloc_mutex_init() failure");
+	counter = 0;
+
+	thd_t thds[NTHREADS];
+	for (unsigned i = 0; i < NTHREADS; i++) {
+		thd_create(&thds[i], thd_start, NULL);
+	}
+	for (unsigned i = 0; i < NTHREADS; i++) {
+		thd_join(thds[i], NULL);
+	}
+	expect_u64_eq(counter, (uint64_t)NTHREADS * NINCS,
+	    "Lost updates under the mutex");
+
+	if (config_stats) {
+		mutex_prof_data_t *data = &test_mtx.prof_data;
+		expect_u64_eq(data->n_lock_ops, (uint64_t)NTHREADS * NINCS,
+		    "Unexpected lock op count");
+		expect_u64_le(data->n_spin_acquired + data->n_wait_times,
+		    data->n_lock_ops, "Slow path acquisitions exceed lock ops");
+	}
+}
+TEST_END
+
+TEST_BEGIN(test_mutex_max_spin_ranks) {
+	expect_d64_eq(malloc_mutex_max_spin_get(WITNESS_RANK_ARENAS),
+	    opt_mutex_max_spin, "Unset ranks should use opt.mutex_max_spin");
+
+	expect_false(malloc_mutex_max_spin_ranks_parse("arenas:5|bin:-1",
+	                 strlen("arenas:5|bin:-1")),
+	    "Unexpected parse failure");
+	expect_d64_eq(malloc_mutex_max_spin_get(WITNESS_RANK_ARENAS), 5,
+	    "Per rank spin limit not applied");
+	expect_d64_eq(malloc_mutex_max_spin_get(WITNESS_RANK_BIN), -1,
+	    "Per rank spin limit not applied");
+	expect_d64_eq(malloc_mutex_max_spin_get(WITNESS_RANK_ARENA_STATS), -1,
+	    "Leaf ranks should share a spin limit");
+	expect_d64_eq(malloc_mutex_max_spin_get(WITNESS_RANK_CTL),
+	    opt_mutex_max_spin, "Unrelated rank should be unaffected");
+
+	expect_false(malloc_mutex_max_spin_ranks_parse("", 0),
+	    "An empty list should be accepted");
+	const char *invalid[] = {"arenas", "arenas:", ":5", "nosuch:5",
+	    "arenas:-2", "arenas:5x", "arenas:5|", "arenas:5||bin:1"};
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		expect_true(malloc_mutex_max_spin_ranks_parse(
+		                invalid[i], strlen(invalid[i])),
+		    "\"%s\" should fail to parse", invalid[i]);
+	}
+
+	/* Restore the defaults for the rest of the process. */
+	char buf[64];
+	malloc_snprintf(buf, sizeof(buf), "arenas:%" FMTd64 "|leaf:%" FMTd64,
+	    opt_mutex_max_spin, opt_mutex_max_spin);
+	expect_false(malloc_mutex_max_spin_ranks_parse(buf, strlen(buf)),
+	    "Unexpected parse failure");
+}
+TEST_END
+
+static void
+hold_for(uint64_t ns) {
+	nstime_t start, now;
+	nstime_init_update(&start);
+	do {
+		nstime_init_update(&now);
+	} while (nstime_ns(&now) - nstime_ns(&start) < ns);
+}
+
+TEST_BEGIN(test_mutex_hold_sample) {
+	test_skip_if(!config_stats);
+
+	tsdn_t        *tsdn = tsdn_fetch();
+	malloc_mutex_t mtx;
+	expect_false(malloc_mutex_init(&mtx, "test_mutex", WITNESS_RANK_OMIT,
+	                 malloc_mutex_rank_exclusive),
+	    "Unexpected malloc_mutex_init() failure");
+	mutex_prof_data_t *data = &mtx.prof_data;
+
+	unsigned hold_sample_orig = opt_mutex_hold_sample;
+	/* Sample one in every 4 holds. */
+	opt_mutex_hold_sample = 4;
+	for (unsigned i = 0; i < 8; i++) {
+		malloc_mutex_lock(tsdn, &mtx);
+		malloc_mutex_unlock(tsdn, &mtx);
+	}
+	expect_u64_eq(data->n_hold_samples, 2, "Wrong number of samples");
+
+	/* The next hold is sampled; a long one lands in its log2 bucket. */
+	uint64_t hold_ns = 3 * (UINT64_C(1) << 20);
+	malloc_mutex_lock(tsdn, &mtx);
+	expect_true(data->hold_sampled, "Hold should be sampled");
+	hold_for(hold_ns);
+	malloc_mutex_unlock(tsdn, &mtx);
+	opt_mutex_hold_sample = hold_sample_orig;
+
+	expect_u64_eq(data->n_hold_samples, 3, "Wrong number of samples");
+	uint64_t max_ns = nstime_ns(&data->max_hold_time);
+	expect_u64_ge(max_ns, hold_ns, "Max hold time too short");
+	expect_u64_ge(nstime_ns(&data->tot_hold_time), max_ns,
+	    "Total hold time below the max");
+	unsigned bucket = fls_u64(max_ns) - MUTEX_PROF_HOLD_HIST_LG_MIN + 1;
+	if (bucket >= MUTEX_PROF_HOLD_HIST_NBUCKETS) {
+		bucket = MUTEX_PROF_HOLD_HIST_NBUCKETS - 1;
+	}
+	expect_u64_ge(data->hold_hist[bucket], 1, "Long hold not in its bucket");
+	uint64_t total = 0;
+	for (unsigned k = 0; k < MUTEX_PROF_HOLD_HIST_NBUCKETS; k++) {
+		total += data->hold_hist[k];
+	}
+	expect_u64_eq(total, data->n_hold_samples,
+	    "Histogram doesn't add up to the number of samples");
+}
+TEST_END
+
+TEST_BEGIN(test_mutex_hold_hist_mallctl) {
+	test_skip_if(!config_stats);
+
+	uint64_t epoch = 1;
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch,
+	                sizeof(epoch)),
+	    0, "Unexpected mallctl() failure");
+
+	uint64_t nsamples, v, total = 0;
+	size_t   sz = sizeof(uint64_t);
+	expect_d_eq(mallctl("stats.mutexes.ctl.num_hold_samples",
+	                (void *)&nsamples, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	for (unsigned k = 0; k < MUTEX_PROF_HOLD_HIST_NBUCKETS; k++) {
+		char name[64];
+		malloc_snprintf(
+		    name, sizeof(name), "stats.mutexes.ctl.hold_hist.%u", k);
+		expect_d_eq(mallctl(name, (void *)&v, &sz, NULL, 0), 0,
+		    "Unexpected mallctl() failure for %s", name);
+		total += v;
+	}
+	expect_u64_eq(total, nsamples,
+	    "Histogram doesn't add up to the number of samples");
+
+	char name[64];
+	malloc_snprintf(name, sizeof(name), "stats.mutexes.ctl.hold_hist.%u",
+	    MUTEX_PROF_HOLD_HIST_NBUCKETS);
+	expect_d_eq(mallctl(name, (void *)&v, &sz, NULL, 0), ENOENT,
+	    "Out of range bucket should not exist");
+	expect_d_eq(mallctl("stats.arenas.0.mutexes.large.hold_hist.0",
+	                (void *)&v, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	expect_d_eq(mallctl("stats.arenas.0.bins.0.mutex.hold_hist.0",
+	                (void *)&v, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_mutex_lock_trylock, test_mutex_contended,
+	    test_mutex_max_spin_ranks, test_mutex_hold_sample,
+	    test_mutex_hold_hist_mallctl);
+}
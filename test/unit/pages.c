@@ -23,7 +23,58 @@ TEST_BEGIN(test_pages_huge) {
 }
 TEST_END
 
+TEST_BEGIN(test_pages_remap) {
+	test_skip_if(!pages_can_remap);
+
+	size_t size = 4 * PAGE;
+	bool   commit = true;
+	byte_t *src = (byte_t *)pages_map(NULL, size, PAGE, &commit);
+	expect_ptr_not_null(src, "Unexpected pages_map() error");
+	commit = true;
+	byte_t *dst = (byte_t *)pages_map(NULL, size, PAGE, &commit);
+	expect_ptr_not_null(dst, "Unexpected pages_map() error");
+
+	for (size_t i = 0; i < size; i++) {
+		src[i] = (byte_t)(i / PAGE + 1);
+	}
+	memset(dst, 0xa5, size);
+	if (pages_remap(src, dst, size)) {
+		/* The kernel lacks MREMAP_DONTUNMAP; nothing may have moved. */
+		for (size_t i = 0; i < size; i++) {
+			if (src[i] != (byte_t)(i / PAGE + 1) || dst[i] != 0xa5) {
+				expect_true(false,
+				    "Failed remap changed pages, offset %zu", i);
+				break;
+			}
+		}
+		pages_unmap(src, size);
+		pages_unmap(dst, size);
+		test_skip("MREMAP_DONTUNMAP unsupported by the kernel");
+		goto label_test_end;
+	}
+	for (size_t i = 0; i < size; i++) {
+		if (dst[i] != (byte_t)(i / PAGE + 1)) {
+			expect_u_eq(dst[i], (byte_t)(i / PAGE + 1),
+			    "Pages should have moved, offset %zu", i);
+			break;
+		}
+	}
+	/* The source range stays mapped, as fresh pages. */
+	for (size_t i = 0; i < size; i++) {
+		if (src[i] != 0) {
+			expect_u_eq(src[i], 0,
+			    "Source should be demand-zeroed, offset %zu", i);
+			break;
+		}
+	}
+	src[0] = 1;
+
+	pages_unmap(src, size);
+	pages_unmap(dst, size);
+}
+TEST_END
+
 int
 main(void) {
-	return test(test_pages_huge);
+	return test(test_pages_huge, test_pages_remap);
 }
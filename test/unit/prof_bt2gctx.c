@@ -0,0 +1,168 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_data.h"
+
+/*
+ * Allocates from more distinct backtraces than the initial table can take, so
+ * that it is rebuilt, then frees and reallocates half of them, so that their
+ * slots become tombstones which the reinsertions reuse.  The frees retire many
+ * batches of gctx's while another thread keeps looking backtraces up.
+ */
+
+#define NBTS 1024
+/* Number of objects freed between two lookup passes of the other thread. */
+#define NFREE_PER_PASS 16
+
+static void        *ptrs[NBTS];
+static prof_gctx_t *gctxs[NBTS];
+/* Copies of the backtraces, for looking them up once their gctx's are gone. */
+static prof_bt_t bts[NBTS];
+static void     *bt_vecs[NBTS][PROF_BT_MAX_DEFAULT];
+
+static atomic_b_t lookup_stop;
+static atomic_u_t lookup_npasses;
+
+static prof_gctx_t *
+gctx_get(void *p) {
+	prof_info_t prof_info;
+	prof_info_get(tsd_fetch(), p, NULL, &prof_info);
+	expect_ptr_ne(prof_info.alloc_tctx, PROF_TCTX_SENTINEL,
+	    "Expected valid tctx");
+	return prof_info.alloc_tctx->gctx;
+}
+
+static void
+validate(size_t *r_nslots, size_t *r_nused) {
+	expect_false(prof_bt2gctx_validate(tsd_fetch(), r_nslots, r_nused),
+	    "Inconsistent backtrace table");
+}
+
+static void
+wait_for_pass(unsigned npasses) {
+	for (unsigned i = 0; i < 10 * 1000
+	    && atomic_load_u(&lookup_npasses, ATOMIC_ACQUIRE) <= npasses;
+	    i++) {
+		sleep_ns(1000 * 1000);
+	}
+	expect_u_gt(atomic_load_u(&lookup_npasses, ATOMIC_ACQUIRE), npasses,
+	    "Lookup thread made no progress");
+}
+
+static void *
+thd_lookup(void *unused) {
+	tsd_t *tsd = tsd_fetch();
+	while (!atomic_load_b(&lookup_stop, ATOMIC_ACQUIRE)) {
+		for (unsigned i = 0; i < NBTS; i++) {
+			if (i % 2 == 0) {
+				/* Pinned by the main thread. */
+				expect_ptr_eq(prof_bt2gctx_lookup(tsd,
+				                  &gctxs[i]->bt),
+				    gctxs[i], "Pinned backtrace not found");
+			} else {
+				/* May be removed at any time. */
+				prof_bt2gctx_lookup(tsd, &bts[i]);
+			}
+		}
+		atomic_fetch_add_u(&lookup_npasses, 1, ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static void
+remove_odd(void) {
+	atomic_store_b(&lookup_stop, false, ATOMIC_RELAXED);
+	atomic_store_u(&lookup_npasses, 0, ATOMIC_RELAXED);
+	thd_t thd;
+	thd_create(&thd, thd_lookup, NULL);
+	wait_for_pass(0);
+	for (unsigned i = 1; i < NBTS; i += 2) {
+		dallocx(ptrs[i], 0);
+		ptrs[i] = NULL;
+		if (i / 2 % NFREE_PER_PASS == NFREE_PER_PASS - 1) {
+			wait_for_pass(
+			    atomic_load_u(&lookup_npasses, ATOMIC_ACQUIRE));
+		}
+	}
+	atomic_store_b(&lookup_stop, true, ATOMIC_RELEASE);
+	thd_join(thd, NULL);
+}
+
+TEST_BEGIN(test_prof_bt2gctx) {
+	test_skip_if(!config_prof);
+	test_skip_if(opt_prof_accum || opt_prof_lifetime);
+
+	tsd_t *tsd = tsd_fetch();
+	size_t nslots, nused, nused_removed;
+
+	size_t nbts_base = prof_bt_count();
+	/*
+	 * Both passes allocate from the same call site, so that the second one
+	 * recreates the backtraces that were removed.
+	 */
+	for (unsigned pass = 0; pass < 2; pass++) {
+		for (unsigned i = pass; i < NBTS; i += pass + 1) {
+			ptrs[i] = btalloc(1, i);
+			gctxs[i] = gctx_get(ptrs[i]);
+			if (pass == 1) {
+				expect_true(
+				    prof_bt_keycomp(&gctxs[i]->bt, &bts[i]),
+				    "Expected the same backtrace as before");
+				continue;
+			}
+			bts[i] = gctxs[i]->bt;
+			assert_u_le(bts[i].len, PROF_BT_MAX_DEFAULT,
+			    "Backtrace too long");
+			memcpy(bt_vecs[i], gctxs[i]->bt.vec,
+			    gctxs[i]->bt.len * sizeof(void *));
+			bts[i].vec = bt_vecs[i];
+		}
+		if (pass == 1) {
+			break;
+		}
+
+		expect_zu_eq(prof_bt_count(), nbts_base + NBTS,
+		    "Expected a new backtrace per allocation");
+		validate(&nslots, &nused);
+		expect_zu_gt(
+		    nslots * 3 / 4, NBTS, "Expected the table to grow");
+
+		remove_odd();
+		validate(&nslots, &nused_removed);
+		expect_zu_eq(prof_bt_count(), nbts_base + NBTS / 2,
+		    "Expected freed backtraces to be removed");
+		for (unsigned i = 0; i < NBTS; i++) {
+			if (i % 2 == 0) {
+				expect_ptr_eq(
+				    prof_bt2gctx_lookup(tsd, &gctxs[i]->bt),
+				    gctxs[i], "Pinned backtrace not found");
+			} else {
+				expect_ptr_null(
+				    prof_bt2gctx_lookup(tsd, &bts[i]),
+				    "Removed backtrace still found");
+			}
+		}
+	}
+
+	validate(&nslots, &nused);
+	expect_zu_eq(nused, nused_removed,
+	    "Reinsertions should have reused tombstones");
+	expect_zu_eq(prof_bt_count(), nbts_base + NBTS,
+	    "Expected reinserted backtraces to be counted");
+	for (unsigned i = 0; i < NBTS; i++) {
+		expect_ptr_eq(prof_bt2gctx_lookup(tsd, &bts[i]), gctxs[i],
+		    "Backtrace not found");
+	}
+
+	for (unsigned i = 0; i < NBTS; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	validate(&nslots, &nused);
+	expect_zu_eq(prof_bt_count(), nbts_base,
+	    "Expected all backtraces to be removed");
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_prof_bt2gctx);
+}
@@ -0,0 +1,152 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_sys.h"
+
+#define NBTS 32
+#define DUMP_BUF_SIZE (4 * 1024 * 1024)
+
+static const char *test_filename = "test_filename";
+static char        dump_buf[DUMP_BUF_SIZE];
+static size_t      dump_len;
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	return fd;
+}
+
+static ssize_t
+prof_dump_write_file_intercept(int fd, const void *s, size_t len) {
+	assert_zu_le(dump_len + len, DUMP_BUF_SIZE, "Dump buffer too small");
+	memcpy(dump_buf + dump_len, s, len);
+	dump_len += len;
+	return len;
+}
+
+static void
+dump(prof_dump_format_t format) {
+	opt_prof_dump_format = format;
+	dump_len = 0;
+	expect_d_eq(mallctl("prof.dump", NULL, NULL, (void *)&test_filename,
+	                sizeof(test_filename)),
+	    0, "Unexpected mallctl failure while dumping");
+	opt_prof_dump_format = prof_dump_format_text;
+}
+
+static uint64_t
+read_uint(const char *buf, size_t len, size_t *pos) {
+	uint64_t v = 0;
+	uint8_t  b;
+	do {
+		assert_zu_lt(*pos, len, "Truncated integer");
+		b = (uint8_t)buf[(*pos)++];
+		v = (v << 7) | (b & 0x7f);
+	} while ((b & 0x80) != 0);
+	return v;
+}
+
+/*
+ * Decodes the binary dump in bin, and checks that each of its backtraces
+ * appears with the same counts in the text dump.  Returns the number of
+ * backtraces.
+ */
+static unsigned
+expect_dumps_match(const char *bin, size_t bin_len, const char *text) {
+	const char *header = "heap_v2b/";
+	assert_d_eq(strncmp(bin, header, strlen(header)), 0,
+	    "Unexpected header");
+	size_t pos = (size_t)((const char *)memchr(bin, '\n', bin_len) - bin) + 1;
+
+	static uintptr_t frames[NBTS * PROF_BT_MAX_DEFAULT];
+	uint64_t         nframes = 0;
+	unsigned         nstacks = 0;
+	expect_c_eq(bin[pos++], 'T', "Dump should start with the totals");
+	for (unsigned i = 0; i < 4; i++) {
+		read_uint(bin, bin_len, &pos);
+	}
+	while (pos < bin_len && bin[pos] != '\n') {
+		assert_c_eq(bin[pos++], 'S', "Unexpected record");
+		char     expected[PROF_BT_MAX_DEFAULT * 24 + 128];
+		size_t   len = malloc_snprintf(expected, sizeof(expected), "@");
+		uint64_t bt_len = read_uint(bin, bin_len, &pos);
+		for (uint64_t i = 0; i < bt_len; i++) {
+			uint64_t frame = read_uint(bin, bin_len, &pos);
+			if (frame == 0) {
+				uintptr_t addr = (uintptr_t)read_uint(
+				    bin, bin_len, &pos);
+				for (uint64_t j = 0; j < nframes; j++) {
+					expect_zu_ne(frames[j], addr,
+					    "Frame written twice");
+				}
+				assert_u64_lt(nframes,
+				    sizeof(frames) / sizeof(frames[0]),
+				    "Too many frames");
+				frames[nframes++] = addr;
+				frame = nframes;
+			}
+			assert_u64_le(frame, nframes, "Unknown frame");
+			len += malloc_snprintf(expected + len,
+			    sizeof(expected) - len, " %#" FMTxPTR,
+			    frames[frame - 1]);
+		}
+		uint64_t cnts[4];
+		for (unsigned i = 0; i < 4; i++) {
+			cnts[i] = read_uint(bin, bin_len, &pos);
+		}
+		malloc_snprintf(expected + len, sizeof(expected) - len,
+		    "\n  t*: %" FMTu64 ": %" FMTu64 " [%" FMTu64 ": %" FMTu64
+		    "]\n",
+		    cnts[0], cnts[1], cnts[2], cnts[3]);
+		expect_ptr_not_null(strstr(text, expected),
+		    "Backtrace missing from the text dump: %s", expected);
+		nstacks++;
+	}
+	expect_zu_lt(pos, bin_len, "Mappings missing");
+	expect_d_eq(strncmp(bin + pos, "\nMAPPED_LIBRARIES:\n", 19), 0,
+	    "Records should be followed by the mappings");
+	return nstacks;
+}
+
+TEST_BEGIN(test_prof_dump_binary) {
+	test_skip_if(!config_prof);
+
+	prof_dump_open_file_t  *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+
+	/* Backtraces that share all but their innermost frames. */
+	void *ptrs[NBTS];
+	for (unsigned i = 0; i < NBTS; i++) {
+		ptrs[i] = btalloc(1, i);
+	}
+
+	static char text[DUMP_BUF_SIZE];
+	dump(prof_dump_format_text);
+	memcpy(text, dump_buf, dump_len);
+	size_t text_len = dump_len;
+	text[text_len] = '\0';
+	dump(prof_dump_format_binary);
+	expect_zu_lt(dump_len, text_len, "Binary dump should be smaller");
+
+	unsigned nstacks = expect_dumps_match(dump_buf, dump_len, text);
+	expect_u_ge(nstacks, NBTS, "Too few backtraces");
+	unsigned ntext = 0;
+	for (const char *s = text; (s = strstr(s, "\n@ ")) != NULL; s++) {
+		ntext++;
+	}
+	expect_u_eq(nstacks, ntext, "Dumps should list the same backtraces");
+
+	for (unsigned i = 0; i < NBTS; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_prof_dump_binary);
+}
@@ -0,0 +1,198 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_data.h"
+#include "jemalloc/internal/prof_sys.h"
+
+#define NBTS 16
+#define DUMP_BUF_SIZE (1024 * 1024)
+
+static const char *test_filename = "test_filename";
+static char        dump_buf[DUMP_BUF_SIZE];
+static size_t      dump_len;
+/* Sequence number of the next delta dump. */
+static uint64_t delta_seq;
+/* Makes writes fail, to test a dump that doesn't make it out. */
+static bool write_fail;
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	return fd;
+}
+
+static ssize_t
+prof_dump_write_file_intercept(int fd, const void *s, size_t len) {
+	if (write_fail) {
+		return -1;
+	}
+	assert_zu_lt(dump_len + len, DUMP_BUF_SIZE, "Dump buffer too small");
+	memcpy(dump_buf + dump_len, s, len);
+	dump_len += len;
+	dump_buf[dump_len] = '\0';
+	return len;
+}
+
+static void
+dump(const char *cmd) {
+	dump_len = 0;
+	dump_buf[0] = '\0';
+	expect_d_eq(mallctl(cmd, NULL, NULL, (void *)&test_filename,
+	                sizeof(test_filename)),
+	    0, "Unexpected mallctl failure while dumping");
+}
+
+/* Returns the number of backtraces in the dump; nempty gets the empty ones. */
+static unsigned
+dump_nstacks(unsigned *nempty) {
+	unsigned n = 0;
+	*nempty = 0;
+	for (const char *s = dump_buf; (s = strstr(s, "\n@ ")) != NULL; s++) {
+		const char *cnts = strstr(s, "\n  t*: ");
+		assert_ptr_not_null(cnts, "Backtrace without counts");
+		if (strncmp(cnts, "\n  t*: 0: 0 [", 13) == 0) {
+			(*nempty)++;
+		}
+		n++;
+	}
+	return n;
+}
+
+static void
+expect_delta(bool full) {
+	char header[64];
+	malloc_snprintf(header, sizeof(header),
+	    "%%delta %" FMTu64 "%s\nheap_v2/", delta_seq++, full ? " full" : "");
+	expect_d_eq(strncmp(dump_buf, header, strlen(header)), 0,
+	    "Expected header \"%s\"", header);
+}
+
+TEST_BEGIN(test_prof_dump_delta) {
+	test_skip_if(!config_prof);
+
+	prof_dump_open_file_t  *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+
+	/* Start over, in case an earlier run of this test left state behind. */
+	expect_d_eq(mallctl("prof.reset", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure while resetting");
+	void *ptrs[NBTS];
+	for (unsigned i = 0; i < NBTS; i++) {
+		ptrs[i] = btalloc(1, i);
+	}
+	unsigned nempty;
+
+	/* The first delta dump (after a reset) is a complete snapshot. */
+	dump("prof.dump_delta");
+	expect_delta(true);
+	expect_u_ge(dump_nstacks(&nempty), NBTS, "Too few backtraces");
+
+	dump("prof.dump_delta");
+	expect_delta(false);
+	expect_u_eq(dump_nstacks(&nempty), 0, "Nothing changed");
+
+	/* Full dumps are unaffected, and don't disturb the delta dumps. */
+	dump("prof.dump");
+	expect_c_eq(dump_buf[0], 'h', "Full dumps have no delta header");
+	expect_u_ge(dump_nstacks(&nempty), NBTS, "Too few backtraces");
+
+	/* Freed backtraces are reported once, as empty, then dropped. */
+	size_t bt_count = prof_bt_count();
+	for (unsigned i = 0; i < NBTS / 2; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	expect_zu_eq(prof_bt_count(), bt_count,
+	    "Backtraces should be kept until reported");
+	dump("prof.dump_delta");
+	expect_delta(false);
+	expect_u_eq(dump_nstacks(&nempty), NBTS / 2, "Unexpected backtraces");
+	expect_u_eq(nempty, NBTS / 2, "Freed backtraces should be empty");
+	expect_zu_eq(prof_bt_count(), bt_count - NBTS / 2,
+	    "Reported backtraces should be dropped");
+
+	dump("prof.dump_delta");
+	expect_delta(false);
+	expect_u_eq(dump_nstacks(&nempty), 0, "Nothing changed");
+
+	void *p = btalloc(1, NBTS);
+	dump("prof.dump_delta");
+	expect_delta(false);
+	expect_u_eq(dump_nstacks(&nempty), 1, "Expected the new backtrace");
+	expect_u_eq(nempty, 0, "New backtrace should be nonempty");
+	dallocx(p, 0);
+
+	/* The first delta dump after a reset is complete again. */
+	expect_d_eq(mallctl("prof.reset", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure while resetting");
+	p = btalloc(1, NBTS);
+	dump("prof.dump_delta");
+	expect_delta(true);
+	expect_u_ge(dump_nstacks(&nempty), 1, "Too few backtraces");
+	dallocx(p, 0);
+
+	for (unsigned i = NBTS / 2; i < NBTS; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+}
+TEST_END
+
+TEST_BEGIN(test_prof_dump_delta_failed) {
+	test_skip_if(!config_prof);
+
+	prof_dump_open_file_t  *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+
+	expect_d_eq(mallctl("prof.reset", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure while resetting");
+	void *ptrs[NBTS];
+	for (unsigned i = 0; i < NBTS; i++) {
+		ptrs[i] = btalloc(1, i);
+	}
+	unsigned nempty;
+	dump("prof.dump_delta");
+	expect_delta(true);
+	dump("prof.dump_delta");
+	expect_delta(false);
+	expect_u_eq(dump_nstacks(&nempty), 0, "Nothing changed");
+
+	/* Changes covered by a dump that fails to be written out... */
+	for (unsigned i = 0; i < NBTS / 2; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	void *p = btalloc(1, NBTS);
+	write_fail = true;
+	expect_d_ne(mallctl("prof.dump_delta", NULL, NULL,
+	                (void *)&test_filename, sizeof(test_filename)),
+	    0, "Dump should have failed");
+	write_fail = false;
+	delta_seq++;
+
+	/* ... are not lost: the next delta dump is a complete snapshot. */
+	dump("prof.dump_delta");
+	expect_delta(true);
+	expect_u_ge(dump_nstacks(&nempty), NBTS / 2 + 1,
+	    "Too few backtraces");
+	expect_u_eq(nempty, 0, "A snapshot has no use for empty backtraces");
+	dump("prof.dump_delta");
+	expect_delta(false);
+	expect_u_eq(dump_nstacks(&nempty), 0, "Nothing changed");
+
+	dallocx(p, 0);
+	for (unsigned i = NBTS / 2; i < NBTS; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_prof_dump_delta, test_prof_dump_delta_failed);
+}
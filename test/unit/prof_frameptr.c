@@ -0,0 +1,67 @@
+#include "test/jemalloc_test.h"
+
+static prof_stack_range_t *
+stack_range_get(void) {
+	return tsd_prof_stack_rangep_get(tsd_fetch());
+}
+
+static JEMALLOC_NOINLINE unsigned
+backtrace_here(void **vec, void **ret_addr) {
+	unsigned len = 0;
+	prof_backtrace_hook_get()(vec, &len, PROF_BT_MAX_DEFAULT);
+	*ret_addr = __builtin_return_address(0);
+	return len;
+}
+
+static void
+expect_frame_pointer_backtrace(void) {
+	void    *vec[PROF_BT_MAX_DEFAULT];
+	void    *ret_addr;
+	unsigned len = backtrace_here(vec, &ret_addr);
+	/* vec[0] is in backtrace_here(), vec[1] in its caller. */
+	expect_u_ge(len, 2, "Backtrace too short");
+	expect_ptr_eq(vec[1], ret_addr, "Unexpected return address");
+
+	prof_stack_range_t *stack_range = stack_range_get();
+	expect_false(stack_range->fallback, "Unexpected unwinder fallback");
+	uintptr_t local = (uintptr_t)&len;
+	expect_true(local >= stack_range->low && local < stack_range->high,
+	    "Stack range should contain the stack");
+}
+
+static void *
+thd_start(void *arg) {
+	prof_stack_range_t *stack_range = stack_range_get();
+	expect_true(stack_range->low == stack_range->high,
+	    "Stack range should be looked up lazily");
+	expect_frame_pointer_backtrace();
+	*(prof_stack_range_t *)arg = *stack_range;
+	return NULL;
+}
+
+TEST_BEGIN(test_prof_frameptr) {
+	test_skip_if(!config_prof || !config_prof_frameptr);
+	test_skip_if(!opt_prof);
+
+	bool validate = opt_prof_unwind_validate;
+	opt_prof_unwind_validate = false;
+	expect_frame_pointer_backtrace();
+	opt_prof_unwind_validate = true;
+	expect_frame_pointer_backtrace();
+	opt_prof_unwind_validate = validate;
+
+	/* Each thread caches its own stack range. */
+	prof_stack_range_t thd_range;
+	thd_t              thd;
+	thd_create(&thd, thd_start, (void *)&thd_range);
+	thd_join(thd, NULL);
+	expect_false(thd_range.low == stack_range_get()->low
+	        && thd_range.high == stack_range_get()->high,
+	    "Threads should not share a stack range");
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_prof_frameptr);
+}
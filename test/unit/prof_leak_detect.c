@@ -0,0 +1,200 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_data.h"
+
+/* Must match opt.prof_leak_epochs in prof_leak_detect.sh. */
+#define NEPOCHS 3
+#define REPORT_BUF_SIZE (64 * 1024)
+
+static char   report_buf[REPORT_BUF_SIZE];
+static size_t report_len;
+
+static uint64_t mock_time_ns;
+
+static void
+nstime_update_mock(nstime_t *time) {
+	nstime_init(time, mock_time_ns);
+}
+
+static void
+report_write_cb(void *opaque, const char *str) {
+	size_t len = strlen(str);
+	assert_zu_lt(
+	    report_len + len, REPORT_BUF_SIZE, "Report buffer too small");
+	memcpy(report_buf + report_len, str, len + 1);
+	report_len += len;
+}
+
+static void
+report(void) {
+	report_len = 0;
+	report_buf[0] = '\0';
+	struct {
+		write_cb_t *write_cb;
+		void       *cbopaque;
+	} packet = {report_write_cb, NULL};
+	expect_d_eq(mallctl("prof.leak_report", NULL, NULL, &packet,
+	                sizeof(packet)),
+	    0, "Unexpected mallctl failure while reporting");
+}
+
+static unsigned
+report_nleaks(void) {
+	unsigned    n = 0;
+	const char *s = report_buf;
+	while ((s = strstr(s, "{\"epochs\":")) != NULL) {
+		n++;
+		s++;
+	}
+	return n;
+}
+
+static unsigned
+leak_epoch_get(void) {
+	unsigned epoch;
+	size_t   sz = sizeof(epoch);
+	expect_d_eq(mallctl("prof.leak_epoch", &epoch, &sz, NULL, 0), 0,
+	    "Unexpected mallctl failure while reading the epoch");
+	return epoch;
+}
+
+static void
+leak_epoch_end(void) {
+	unsigned epoch = leak_epoch_get();
+	unsigned dummy = 0;
+	unsigned new_epoch;
+	size_t   sz = sizeof(new_epoch);
+	expect_d_eq(mallctl("prof.leak_epoch", &new_epoch, &sz, &dummy,
+	                sizeof(dummy)),
+	    0, "Unexpected mallctl failure while ending an epoch");
+	expect_u_eq(new_epoch, epoch + 1, "Epoch should have advanced");
+}
+
+TEST_BEGIN(test_prof_leak_detect) {
+	test_skip_if(!config_prof);
+
+	/* Objects allocated before the first epoch ends count as growth. */
+	void *stable[NEPOCHS];
+	for (unsigned i = 0; i < NEPOCHS; i++) {
+		stable[i] = btalloc(1, 1);
+	}
+	/*
+	 * A backtrace that grows during every epoch; reported from the
+	 * NEPOCHS-th on.
+	 */
+	void  *leaked[NEPOCHS + 1];
+	char   expected[256];
+	size_t usize = 0;
+	for (unsigned i = 0; i <= NEPOCHS; i++) {
+		leaked[i] = btalloc(1, 0);
+		usize = sallocx(leaked[i], 0);
+		leak_epoch_end();
+		report();
+		if (i + 1 < NEPOCHS) {
+			expect_u_eq(report_nleaks(), 0,
+			    "No leaks expected after %u epochs: %s", i + 1,
+			    report_buf);
+			continue;
+		}
+		expect_u_eq(report_nleaks(), 1,
+		    "One leak expected after %u epochs: %s", i + 1, report_buf);
+		malloc_snprintf(expected, sizeof(expected),
+		    "{\"epochs\":%u,\"growth_bytes\":%zu,\"live_objs\":%u,"
+		    "\"live_bytes\":%zu,\"trace\":[\"0x",
+		    i + 1, (i + 1) * usize, i + 1, (i + 1) * usize);
+		expect_ptr_not_null(strstr(report_buf, expected),
+		    "Expected \"%s\" in the report: %s", expected, report_buf);
+	}
+	char header[64];
+	malloc_snprintf(header, sizeof(header),
+	    "{\"epoch\":%u,\"epochs_threshold\":%u,", leak_epoch_get(),
+	    NEPOCHS);
+	expect_d_eq(strncmp(report_buf, header, strlen(header)), 0,
+	    "Expected header \"%s\": %s", header, report_buf);
+
+	/* An epoch without growth ends the streak. */
+	dallocx(leaked[NEPOCHS], 0);
+	leak_epoch_end();
+	report();
+	expect_u_eq(report_nleaks(), 0, "Leak should no longer be reported");
+	expect_ptr_not_null(strstr(report_buf, "\"leaks\":[]"),
+	    "Expected an empty list of leaks: %s", report_buf);
+
+	for (unsigned i = 0; i < NEPOCHS; i++) {
+		dallocx(stable[i], 0);
+		dallocx(leaked[i], 0);
+	}
+}
+TEST_END
+
+TEST_BEGIN(test_prof_leak_detect_timer) {
+	test_skip_if(!config_prof);
+
+	nstime_update_t *update_orig = nstime_update;
+	uint64_t         epoch_ms_orig = opt_prof_leak_epoch_ms;
+	nstime_t         now;
+	nstime_init_update(&now);
+	/* Well past the deadline set at boot, which was a 0 ms epoch. */
+	mock_time_ns = nstime_ns(&now) + UINT64_C(3600) * 1000 * 1000 * 1000;
+	nstime_update = nstime_update_mock;
+	opt_prof_leak_epoch_ms = 1000;
+
+	/*
+	 * Sampled allocations only flag due epochs; without background
+	 * threads, reading prof.leak_epoch ends them.
+	 */
+	unsigned epoch = prof_leak_epoch_get();
+	free(btalloc(1, 0));
+	expect_u_eq(prof_leak_epoch_get(), epoch,
+	    "Sampled allocations should not end epochs");
+	expect_u_eq(leak_epoch_get(), epoch + 1, "Epoch should have ended");
+	mock_time_ns += UINT64_C(999) * 1000 * 1000;
+	free(btalloc(1, 0));
+	expect_u_eq(leak_epoch_get(), epoch + 1, "Epoch is not due yet");
+	mock_time_ns += UINT64_C(1) * 1000 * 1000;
+	expect_u_eq(leak_epoch_get(), epoch + 2, "Epoch should have ended");
+
+	opt_prof_leak_epoch_ms = epoch_ms_orig;
+	nstime_update = update_orig;
+}
+TEST_END
+
+static void
+background_thread_enable(bool enable) {
+	expect_d_eq(mallctl("background_thread", NULL, NULL, &enable,
+	                sizeof(enable)),
+	    0, "Unexpected mallctl failure");
+}
+
+TEST_BEGIN(test_prof_leak_detect_background) {
+	test_skip_if(!config_prof);
+	test_skip_if(!have_background_thread);
+
+	nstime_update_t *update_orig = nstime_update;
+	uint64_t         epoch_ms_orig = opt_prof_leak_epoch_ms;
+	nstime_t         now;
+	nstime_init_update(&now);
+	mock_time_ns = nstime_ns(&now) + UINT64_C(7200) * 1000 * 1000 * 1000;
+	nstime_update = nstime_update_mock;
+	opt_prof_leak_epoch_ms = 1000;
+
+	/* The background thread ends due epochs on its own. */
+	unsigned epoch = prof_leak_epoch_get();
+	background_thread_enable(true);
+	unsigned i;
+	for (i = 0; i < 10 * 1000 && prof_leak_epoch_get() == epoch; i++) {
+		sleep_ns(1000 * 1000);
+	}
+	expect_u_lt(i, 10 * 1000, "Background thread should end the epoch");
+	background_thread_enable(false);
+
+	opt_prof_leak_epoch_ms = epoch_ms_orig;
+	nstime_update = update_orig;
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_prof_leak_detect,
+	    test_prof_leak_detect_timer, test_prof_leak_detect_background);
+}
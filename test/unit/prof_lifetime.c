@@ -0,0 +1,164 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_sys.h"
+
+#define NOBJS 3
+/* Objects live for 2^LG_LIFETIME ns plus a bit, landing in that bucket. */
+#define LG_LIFETIME 20
+#define DUMP_BUF_SIZE (1024 * 1024)
+
+static const char *test_filename = "test_filename";
+static char        dump_buf[DUMP_BUF_SIZE];
+static size_t      dump_len;
+
+static uint64_t mock_time_ns;
+
+static void
+nstime_prof_update_mock(nstime_t *time) {
+	nstime_init(time, mock_time_ns);
+}
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	return fd;
+}
+
+static ssize_t
+prof_dump_write_file_intercept(int fd, const void *s, size_t len) {
+	assert_zu_lt(dump_len + len, DUMP_BUF_SIZE, "Dump buffer too small");
+	memcpy(dump_buf + dump_len, s, len);
+	dump_len += len;
+	dump_buf[dump_len] = '\0';
+	return len;
+}
+
+static void
+dump(prof_dump_format_t format) {
+	opt_prof_dump_format = format;
+	dump_len = 0;
+	dump_buf[0] = '\0';
+	expect_d_eq(mallctl("prof.dump", NULL, NULL, (void *)&test_filename,
+	                sizeof(test_filename)),
+	    0, "Unexpected mallctl failure while dumping");
+	opt_prof_dump_format = prof_dump_format_text;
+}
+
+static const char *
+find(const char *needle, size_t needle_len) {
+	for (size_t i = 0; i + needle_len <= dump_len; i++) {
+		if (memcmp(dump_buf + i, needle, needle_len) == 0) {
+			return dump_buf + i;
+		}
+	}
+	return NULL;
+}
+
+TEST_BEGIN(test_prof_lifetime) {
+	test_skip_if(!config_prof);
+
+	nstime_prof_update_t   *update_orig = nstime_prof_update;
+	prof_dump_open_file_t  *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	nstime_prof_update = nstime_prof_update_mock;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+
+	expect_d_eq(mallctl("prof.reset", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure while resetting");
+	mock_time_ns = 1000;
+	void *ptrs[NOBJS];
+	for (unsigned i = 0; i < NOBJS; i++) {
+		ptrs[i] = btalloc(1, 0);
+	}
+	mock_time_ns += (UINT64_C(1) << LG_LIFETIME) + 1;
+	for (unsigned i = 0; i < NOBJS; i++) {
+		dallocx(ptrs[i], 0);
+	}
+
+	/* The backtrace is dumped even though it has no live objects. */
+	char   expected[256];
+	size_t len = malloc_snprintf(
+	    expected, sizeof(expected), "\n  t*: 0: 0 [0: 0]\n  lifetimes:");
+	for (unsigned i = 0; i < LG_LIFETIME; i++) {
+		len += malloc_snprintf(
+		    expected + len, sizeof(expected) - len, " 0");
+	}
+	len += malloc_snprintf(
+	    expected + len, sizeof(expected) - len, " %u\n", NOBJS);
+	dump(prof_dump_format_text);
+	expect_ptr_not_null(find(expected, len),
+	    "Lifetime histogram missing from the text dump");
+
+	uint8_t binary[LG_LIFETIME + 3] = {'L', LG_LIFETIME + 1};
+	binary[LG_LIFETIME + 2] = NOBJS;
+	dump(prof_dump_format_binary);
+	expect_ptr_not_null(find((const char *)binary, sizeof(binary)),
+	    "Lifetime histogram missing from the binary dump");
+
+	/* Histograms are cleared along with the other statistics. */
+	expect_d_eq(mallctl("prof.reset", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure while resetting");
+	dump(prof_dump_format_text);
+	expect_ptr_null(find(expected, len),
+	    "Lifetime histogram should have been reset");
+
+	nstime_prof_update = update_orig;
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+}
+TEST_END
+
+TEST_BEGIN(test_prof_lifetime_log) {
+	test_skip_if(!config_prof);
+
+	nstime_prof_update_t *update_orig = nstime_prof_update;
+	nstime_prof_update = nstime_prof_update_mock;
+
+	const char *filename = "prof_lifetime.log.json";
+	expect_d_eq(mallctl("prof.log_start", NULL, NULL, (void *)&filename,
+	                sizeof(filename)),
+	    0, "Unexpected mallctl failure when starting logging");
+	mock_time_ns = 1000;
+	void *ptrs[NOBJS];
+	for (unsigned i = 0; i < NOBJS; i++) {
+		ptrs[i] = btalloc(1, 0);
+	}
+	mock_time_ns += (UINT64_C(1) << LG_LIFETIME) + 1;
+	for (unsigned i = 0; i < NOBJS; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	expect_d_eq(mallctl("prof.log_stop", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure when stopping logging");
+	nstime_prof_update = update_orig;
+
+	int fd = open(filename, O_RDONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	ssize_t nread = read(fd, dump_buf, DUMP_BUF_SIZE - 1);
+	close(fd);
+	unlink(filename);
+	assert_zd_gt(nread, 0, "Unexpected read() failure");
+	dump_buf[nread] = '\0';
+	dump_len = nread;
+
+	char   expected[256];
+	size_t len = malloc_snprintf(
+	    expected, sizeof(expected), "\"counts\":[");
+	for (unsigned i = 0; i < LG_LIFETIME; i++) {
+		len += malloc_snprintf(
+		    expected + len, sizeof(expected) - len, "0,");
+	}
+	len += malloc_snprintf(
+	    expected + len, sizeof(expected) - len, "%u]", NOBJS);
+	expect_ptr_not_null(strstr(dump_buf, "\"lifetime_histograms\":["),
+	    "Log should have lifetime histograms");
+	expect_ptr_not_null(
+	    find(expected, len), "Lifetime histogram missing from the log");
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_prof_lifetime, test_prof_lifetime_log);
+}
@@ -0,0 +1,295 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_log.h"
+#include "jemalloc/internal/prof_sys.h"
+
+#define NPTRS 100
+#define MAX_INDEX 1024
+#define LOG_BUF_SIZE (1024 * 1024)
+
+static const char *test_filename = "prof_log_stream.log";
+static char        log_buf[LOG_BUF_SIZE];
+static size_t      log_len;
+static unsigned    nwrites;
+
+static void    *ptrs[NPTRS];
+static unsigned nfreed;
+/*
+ * Whether the next write has another thread free the remaining objects, while
+ * it's going on.
+ */
+static bool       free_in_write;
+static atomic_u_t free_state;
+#define FREE_STATE_IDLE 0
+#define FREE_STATE_READY 1
+#define FREE_STATE_GO 2
+#define FREE_STATE_DONE 3
+
+static void
+free_rest(void) {
+	while (nfreed < NPTRS) {
+		void *p = ptrs[nfreed++];
+		free(p);
+	}
+}
+
+static void *
+thd_free_rest(void *unused) {
+	/* Frees are only logged once the thread has sampled an allocation. */
+	free(malloc(1));
+	atomic_store_u(&free_state, FREE_STATE_READY, ATOMIC_RELEASE);
+	while (atomic_load_u(&free_state, ATOMIC_ACQUIRE) != FREE_STATE_GO) {
+	}
+	free_rest();
+	atomic_store_u(&free_state, FREE_STATE_DONE, ATOMIC_RELEASE);
+	return NULL;
+}
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	return fd;
+}
+
+static ssize_t
+prof_dump_write_file_intercept(int fd, const void *s, size_t len) {
+	assert_zu_lt(log_len + len, LOG_BUF_SIZE, "Log buffer too small");
+	memcpy(log_buf + log_len, s, len);
+	log_len += len;
+	log_buf[log_len] = '\0';
+	nwrites++;
+	if (free_in_write) {
+		free_in_write = false;
+		atomic_store_u(&free_state, FREE_STATE_GO, ATOMIC_RELEASE);
+		while (atomic_load_u(&free_state, ATOMIC_ACQUIRE)
+		    != FREE_STATE_DONE) {
+		}
+	}
+	return len;
+}
+
+static void
+log_start(void) {
+	log_len = 0;
+	log_buf[0] = '\0';
+	nwrites = 0;
+	expect_d_eq(mallctl("prof.log_start", NULL, NULL,
+	                (void *)&test_filename, sizeof(test_filename)),
+	    0, "Unexpected mallctl failure when starting logging");
+}
+
+static void
+log_stop(void) {
+	expect_d_eq(mallctl("prof.log_stop", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl failure when stopping logging");
+}
+
+static uint64_t
+log_dropped(void) {
+	uint64_t dropped;
+	size_t   sz = sizeof(dropped);
+	expect_d_eq(mallctl("prof.log_dropped", &dropped, &sz, NULL, 0), 0,
+	    "Unexpected mallctl failure while reading the drop count");
+	return dropped;
+}
+
+static size_t
+json_uint(const char *line, const char *key) {
+	const char *s = strstr(line, key);
+	assert_ptr_not_null(s, "Missing key %s", key);
+	return (size_t)strtoull(s + strlen(key), NULL, 10);
+}
+
+/*
+ * Checks the lines of the log, and that every allocation only refers to
+ * threads and backtraces defined above it.  Returns the number of allocations,
+ * and sets dropped to the count on the last line.
+ */
+static unsigned
+log_check(uint64_t *dropped) {
+	static bool threads[MAX_INDEX];
+	static bool traces[MAX_INDEX];
+	memset(threads, 0, sizeof(threads));
+	memset(traces, 0, sizeof(traces));
+
+	expect_d_eq(strncmp(log_buf, "{\"info\":{", 9), 0,
+	    "Log should start with its metadata");
+	unsigned nallocs = 0;
+	char    *line = log_buf;
+	char    *end;
+	for (; (end = strchr(line, '\n')) != NULL; line = end + 1) {
+		*end = '\0';
+		if (strncmp(line, "{\"thread\":{", 11) == 0) {
+			size_t ind = json_uint(line, "\"index\":");
+			assert_zu_lt(ind, MAX_INDEX, "Unexpected index");
+			expect_false(threads[ind], "Thread defined twice");
+			threads[ind] = true;
+		} else if (strncmp(line, "{\"stack_trace\":{", 16) == 0) {
+			size_t ind = json_uint(line, "\"index\":");
+			assert_zu_lt(ind, MAX_INDEX, "Unexpected index");
+			expect_false(traces[ind], "Backtrace defined twice");
+			traces[ind] = true;
+		} else if (strncmp(line, "{\"allocation\":{", 15) == 0) {
+			size_t thr0 = json_uint(line, "\"alloc_thread\":");
+			size_t thr1 = json_uint(line, "\"free_thread\":");
+			size_t bt0 = json_uint(line, "\"alloc_trace\":");
+			size_t bt1 = json_uint(line, "\"free_trace\":");
+			assert_true(thr0 < MAX_INDEX && thr1 < MAX_INDEX
+			        && bt0 < MAX_INDEX && bt1 < MAX_INDEX,
+			    "Unexpected index");
+			expect_true(threads[thr0] && threads[thr1],
+			    "Allocation refers to an undefined thread");
+			expect_true(traces[bt0] && traces[bt1],
+			    "Allocation refers to an undefined backtrace");
+			nallocs++;
+		} else if (strncmp(line, "{\"end\":{\"duration\":", 19) == 0) {
+			*dropped = json_uint(line, "\"dropped\":");
+			expect_c_eq(
+			    end[1], '\0', "Nothing should follow the end");
+		} else if (line != log_buf) {
+			expect_not_reached("Unexpected line: %s", line);
+		}
+	}
+	expect_c_eq(*line, '\0', "Log should end with a newline");
+	return nallocs;
+}
+
+static void
+ptrs_alloc(void) {
+	for (unsigned i = 0; i < NPTRS; i++) {
+		ptrs[i] = malloc(100);
+		expect_ptr_not_null(ptrs[i], "Unexpected malloc failure");
+	}
+	nfreed = 0;
+}
+
+TEST_BEGIN(test_prof_log_stream) {
+	test_skip_if(!config_prof);
+	test_skip_if(!opt_prof_log_stream);
+
+	prof_dump_open_file_t  *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+
+	ptrs_alloc();
+	log_start();
+	free_rest();
+	/* Records are written out while logging, not kept until the end. */
+	expect_u_gt(nwrites, 0, "Log should have been flushed");
+	expect_zu_eq(prof_log_alloc_count(), 0, "Records should not be kept");
+	log_stop();
+
+	uint64_t dropped = UINT64_MAX;
+	expect_u_ge(log_check(&dropped), NPTRS, "Allocations are missing");
+	expect_u64_eq(dropped, 0, "Nothing should have been dropped");
+	expect_u64_eq(log_dropped(), 0, "Nothing should have been dropped");
+
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+}
+TEST_END
+
+TEST_BEGIN(test_prof_log_stream_drop) {
+	test_skip_if(!config_prof);
+	test_skip_if(!opt_prof_log_stream);
+
+	prof_dump_open_file_t  *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+
+	/*
+	 * Free most objects while the first full buffer is being written, so
+	 * that the other one overflows.
+	 */
+	thd_t thd;
+	atomic_store_u(&free_state, FREE_STATE_IDLE, ATOMIC_RELAXED);
+	thd_create(&thd, thd_free_rest, NULL);
+	while (atomic_load_u(&free_state, ATOMIC_ACQUIRE) != FREE_STATE_READY) {
+	}
+	ptrs_alloc();
+	log_start();
+	free_in_write = true;
+	free_rest();
+	expect_false(free_in_write, "Log should have been flushed");
+	thd_join(thd, NULL);
+	log_stop();
+
+	uint64_t dropped = UINT64_MAX;
+	unsigned nallocs = log_check(&dropped);
+	expect_u64_gt(dropped, 0, "Records should have been dropped");
+	expect_u64_eq(dropped, log_dropped(), "Inconsistent drop counts");
+	expect_u64_eq(nallocs + dropped, NPTRS, "Records are missing");
+
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+}
+TEST_END
+
+static mtx_t      stream_gate;
+static atomic_b_t stream_held;
+
+static void *
+thd_hold_stream(void *unused) {
+	tsdn_t *tsdn = tsdn_fetch();
+	malloc_mutex_lock(tsdn, &log_stream_mtx);
+	atomic_store_b(&stream_held, true, ATOMIC_RELEASE);
+	mtx_lock(&stream_gate);
+	mtx_unlock(&stream_gate);
+	malloc_mutex_unlock(tsdn, &log_stream_mtx);
+	return NULL;
+}
+
+TEST_BEGIN(test_prof_log_stream_busy) {
+	test_skip_if(!config_prof);
+	test_skip_if(!opt_prof_log_stream);
+
+	prof_dump_open_file_t  *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+
+	ptrs_alloc();
+	log_start();
+	expect_false(mtx_init(&stream_gate), "Unexpected mtx_init() failure");
+	mtx_lock(&stream_gate);
+	atomic_store_b(&stream_held, false, ATOMIC_RELAXED);
+	thd_t thd;
+	thd_create(&thd, thd_hold_stream, NULL);
+	unsigned i;
+	for (i = 0;
+	     i < 10 * 1000 && !atomic_load_b(&stream_held, ATOMIC_ACQUIRE);
+	     i++) {
+		sleep_ns(1000 * 1000);
+	}
+	assert_u_lt(i, 10 * 1000, "Thread didn't take the stream mutex");
+
+	/* Frees hand full buffers off without waiting for the writer. */
+	free_rest();
+	expect_u_eq(nwrites, 0, "Nothing should be written while busy");
+	mtx_unlock(&stream_gate);
+	thd_join(thd, NULL);
+	mtx_fini(&stream_gate);
+
+	/* The next flush writes what was left behind. */
+	free(malloc(1));
+	expect_u_gt(nwrites, 0, "Log should have been flushed");
+	log_stop();
+
+	uint64_t dropped = UINT64_MAX;
+	unsigned nallocs = log_check(&dropped);
+	expect_u64_gt(dropped, 0, "Records should have been dropped");
+	expect_u64_ge(nallocs + dropped, NPTRS, "Records are missing");
+
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_prof_log_stream,
+	    test_prof_log_stream_drop, test_prof_log_stream_busy);
+}
@@ -0,0 +1,172 @@
+#include "test/jemalloc_test.h"
+
+#include "jemalloc/internal/prof_sys.h"
+
+#define DUMP_BUF_SIZE (1024 * 1024)
+
+static const char *test_filename = "test_filename";
+static char        dump_buf[DUMP_BUF_SIZE];
+static size_t      dump_len;
+
+static int
+prof_dump_open_file_intercept(const char *filename, int mode) {
+	int fd = open("/dev/null", O_WRONLY);
+	assert_d_ne(fd, -1, "Unexpected open() failure");
+	return fd;
+}
+
+static ssize_t
+prof_dump_write_file_intercept(int fd, const void *s, size_t len) {
+	assert_zu_lt(dump_len + len, DUMP_BUF_SIZE, "Dump buffer too small");
+	memcpy(dump_buf + dump_len, s, len);
+	dump_len += len;
+	dump_buf[dump_len] = '\0';
+	return len;
+}
+
+static void
+dump(void) {
+	dump_len = 0;
+	dump_buf[0] = '\0';
+	expect_d_eq(mallctl("prof.dump", NULL, NULL, (void *)&test_filename,
+	                sizeof(test_filename)),
+	    0, "Unexpected mallctl failure while dumping");
+}
+
+static unsigned
+arena_create(void) {
+	unsigned arena_ind;
+	size_t   sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", &arena_ind, &sz, NULL, 0), 0,
+	    "Unexpected mallctl failure creating an arena");
+	return arena_ind;
+}
+
+static unsigned
+arena_lookup(void *ptr) {
+	unsigned arena_ind;
+	size_t   sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.lookup", &arena_ind, &sz, &ptr, sizeof(ptr)),
+	    0, "Unexpected mallctl failure looking up an arena");
+	return arena_ind;
+}
+
+/*
+ * Returns the backtrace line of the record whose arena line starts with
+ * prefix, or NULL if there is none.
+ */
+static const char *
+find_stack(const char *prefix, size_t *stack_len) {
+	const char *s = strstr(dump_buf, prefix);
+	if (s == NULL) {
+		return NULL;
+	}
+	const char *stack = s;
+	while (stack > dump_buf && strncmp(stack, "\n@ ", 3) != 0) {
+		stack--;
+	}
+	*stack_len = (size_t)(strchr(stack + 1, '\n') - stack);
+	return stack;
+}
+
+TEST_BEGIN(test_prof_per_arena) {
+	test_skip_if(!config_prof);
+
+	prof_dump_open_file_t  *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+
+	/* One call site, allocating from two arenas. */
+	unsigned arenas[2] = {arena_create(), arena_create()};
+	void    *ptrs[2][3];
+	for (unsigned i = 0; i < 2 * 3; i++) {
+		unsigned a = i % 2;
+		ptrs[a][i / 2] = mallocx(
+		    1, MALLOCX_ARENA(arenas[a]) | MALLOCX_TCACHE_NONE);
+		expect_ptr_not_null(ptrs[a][i / 2], "Unexpected mallocx failure");
+	}
+	/* Goes to the huge arena, rather than to the thread's arena. */
+	void *huge = malloc(opt_oversize_threshold + 1);
+	expect_ptr_not_null(huge, "Unexpected malloc failure");
+
+	dump();
+	char        prefix[2][32];
+	const char *stacks[2];
+	size_t      stack_lens[2];
+	for (unsigned a = 0; a < 2; a++) {
+		malloc_snprintf(prefix[a], sizeof(prefix[a]), "\n  a%u: 3: ",
+		    arenas[a]);
+		stacks[a] = find_stack(prefix[a], &stack_lens[a]);
+		assert_ptr_not_null(stacks[a], "No record for arena %u: %s",
+		    arenas[a], dump_buf);
+	}
+	expect_zu_eq(stack_lens[0], stack_lens[1],
+	    "Both arenas should have the same backtrace");
+	expect_d_eq(strncmp(stacks[0], stacks[1], stack_lens[0]), 0,
+	    "Both arenas should have the same backtrace");
+	expect_ptr_ne(stacks[0], stacks[1], "Arenas should have own records");
+
+	/* Allocations that go elsewhere than expected are charged correctly. */
+	char huge_prefix[32];
+	malloc_snprintf(huge_prefix, sizeof(huge_prefix), "\n  a%u: 1: ",
+	    arena_lookup(huge));
+	expect_ptr_not_null(strstr(dump_buf, huge_prefix),
+	    "No record for the huge allocation: %s", dump_buf);
+
+	free(huge);
+	for (unsigned a = 0; a < 2; a++) {
+		for (unsigned i = 0; i < 3; i++) {
+			dallocx(ptrs[a][i], 0);
+		}
+	}
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+}
+TEST_END
+
+/* More than fit in the cuckoo hash buckets that one hash value maps to. */
+#define NARENAS_MANY 24
+
+TEST_BEGIN(test_prof_per_arena_many) {
+	test_skip_if(!config_prof);
+
+	prof_dump_open_file_t  *open_file_orig = prof_dump_open_file;
+	prof_dump_write_file_t *write_file_orig = prof_dump_write_file;
+	prof_dump_open_file = prof_dump_open_file_intercept;
+	prof_dump_write_file = prof_dump_write_file_intercept;
+
+	/* One call site, allocating from many arenas. */
+	unsigned arenas[NARENAS_MANY];
+	void    *ptrs[NARENAS_MANY];
+	for (unsigned a = 0; a < NARENAS_MANY; a++) {
+		arenas[a] = arena_create();
+	}
+	for (unsigned a = 0; a < NARENAS_MANY; a++) {
+		ptrs[a] = mallocx(
+		    1, MALLOCX_ARENA(arenas[a]) | MALLOCX_TCACHE_NONE);
+		expect_ptr_not_null(ptrs[a], "Unexpected mallocx failure");
+	}
+
+	dump();
+	for (unsigned a = 0; a < NARENAS_MANY; a++) {
+		char   prefix[32];
+		size_t stack_len;
+		malloc_snprintf(
+		    prefix, sizeof(prefix), "\n  a%u: 1: ", arenas[a]);
+		expect_ptr_not_null(find_stack(prefix, &stack_len),
+		    "No record for arena %u: %s", arenas[a], dump_buf);
+	}
+
+	for (unsigned a = 0; a < NARENAS_MANY; a++) {
+		dallocx(ptrs[a], 0);
+	}
+	prof_dump_open_file = open_file_orig;
+	prof_dump_write_file = write_file_orig;
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_prof_per_arena, test_prof_per_arena_many);
+}
@@ -149,6 +149,20 @@ confirm_record_released(prof_recent_t *n) {
 	    "dalloc_tctx in record should not be NULL for released pointer");
 }
 
+#define MAX_RECORDS 16
+static prof_recent_t *recent_records[MAX_RECORDS];
+
+/* The last max records of all threads, oldest first. */
+static unsigned
+recent_records_get(void) {
+	return (unsigned)prof_recent_alloc_records_test(
+	    recent_records, MAX_RECORDS);
+}
+
+#define recent_foreach(n)                                                     \
+	for (unsigned k_ = 0, n_ = recent_records_get();                     \
+	     k_ < n_ && ((n) = recent_records[k_], true); ++k_)
+
 TEST_BEGIN(test_prof_recent_alloc) {
 	test_skip_if(!config_prof);
 
@@ -171,7 +185,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 		p = malloc(req_size);
 		confirm_malloc(p);
 		if (i < OPT_ALLOC_MAX - 1) {
-			assert_false(ql_empty(&prof_recent_alloc_list),
+			assert_u_ne(recent_records_get(), 0,
 			    "Empty recent allocation");
 			free(p);
 			/*
@@ -182,7 +196,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 			continue;
 		}
 		c = 0;
-		ql_foreach (n, &prof_recent_alloc_list, link) {
+		recent_foreach (n) {
 			++c;
 			confirm_record_size(n, i + c - OPT_ALLOC_MAX);
 			if (c == OPT_ALLOC_MAX) {
@@ -211,7 +225,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 		p = malloc(req_size);
 		assert_ptr_not_null(p, "malloc failed unexpectedly");
 		c = 0;
-		ql_foreach (n, &prof_recent_alloc_list, link) {
+		recent_foreach (n) {
 			confirm_record_size(n, c + OPT_ALLOC_MAX);
 			confirm_record_released(n);
 			++c;
@@ -238,7 +252,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 		p = malloc(req_size);
 		confirm_malloc(p);
 		c = 0;
-		ql_foreach (n, &prof_recent_alloc_list, link) {
+		recent_foreach (n) {
 			++c;
 			confirm_record_size(n,
 			    /* Is the allocation from the third batch? */
@@ -269,7 +283,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	                &future, sizeof(ssize_t)),
 	    0, "Write error");
 	c = 0;
-	ql_foreach (n, &prof_recent_alloc_list, link) {
+	recent_foreach (n) {
 		confirm_record_size(n, c + 3 * OPT_ALLOC_MAX);
 		confirm_record_released(n);
 		++c;
@@ -285,7 +299,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	                &future, sizeof(ssize_t)),
 	    0, "Write error");
 	c = 0;
-	ql_foreach (n, &prof_recent_alloc_list, link) {
+	recent_foreach (n) {
 		confirm_record_size(n, c + 3 * OPT_ALLOC_MAX);
 		confirm_record_released(n);
 		++c;
@@ -301,7 +315,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	                &future, sizeof(ssize_t)),
 	    0, "Write error");
 	c = 0;
-	ql_foreach (n, &prof_recent_alloc_list, link) {
+	recent_foreach (n) {
 		++c;
 		confirm_record_size(n, c + 3 * OPT_ALLOC_MAX);
 		confirm_record_released(n);
@@ -315,7 +329,7 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	                &future, sizeof(ssize_t)),
 	    0, "Write error");
 	c = 0;
-	ql_foreach (n, &prof_recent_alloc_list, link) {
+	recent_foreach (n) {
 		++c;
 		confirm_record_size(n, c + 3 * OPT_ALLOC_MAX);
 		confirm_record_released(n);
@@ -328,33 +342,81 @@ TEST_BEGIN(test_prof_recent_alloc) {
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max", NULL, NULL,
 	                &future, sizeof(ssize_t)),
 	    0, "Write error");
-	assert_false(ql_empty(&prof_recent_alloc_list), "Recent list is empty");
-	n = ql_first(&prof_recent_alloc_list);
+	assert_u_eq(recent_records_get(), 1,
+	    "Recent list should only contain one record");
+	n = recent_records[0];
 	confirm_record_size(n, 4 * OPT_ALLOC_MAX - 1);
 	confirm_record_released(n);
-	n = ql_next(&prof_recent_alloc_list, n, link);
-	assert_ptr_null(n, "Recent list should only contain one record");
 
 	/* Completely turn off. */
 	future = 0;
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max", NULL, NULL,
 	                &future, sizeof(ssize_t)),
 	    0, "Write error");
-	assert_true(
-	    ql_empty(&prof_recent_alloc_list), "Recent list should be empty");
+	assert_u_eq(recent_records_get(), 0, "Recent list should be empty");
 
 	/* Restore the settings. */
 	future = OPT_ALLOC_MAX;
 	assert_d_eq(mallctl("experimental.prof_recent.alloc_max", NULL, NULL,
 	                &future, sizeof(ssize_t)),
 	    0, "Write error");
-	assert_true(
-	    ql_empty(&prof_recent_alloc_list), "Recent list should be empty");
+	assert_u_eq(recent_records_get(), 0, "Recent list should be empty");
+
+	confirm_prof_setup();
+}
+TEST_END
+
+static void *
+f_thread_alloc(void *arg) {
+	unsigned *i = (unsigned *)arg;
+	for (unsigned j = 0; j < OPT_ALLOC_MAX; ++j, ++*i) {
+		void *p = malloc(NTH_REQ_SIZE(*i));
+		confirm_malloc(p);
+		free(p);
+	}
+	return NULL;
+}
+
+TEST_BEGIN(test_prof_recent_alloc_threads) {
+	test_skip_if(!config_prof);
+
+	unsigned       i = 0, c;
+	prof_recent_t *n;
+
+	confirm_prof_setup();
+
+	/*
+	 * Records are kept by the allocating threads, but the list is still the
+	 * last OPT_ALLOC_MAX allocations of all threads, in order, including
+	 * those of threads which have exited.
+	 */
+	thd_t thd;
+	thd_create(&thd, f_thread_alloc, (void *)&i);
+	thd_join(thd, NULL);
+	for (; i < 2 * OPT_ALLOC_MAX; ++i) {
+		c = 0;
+		recent_foreach (n) {
+			confirm_record_size(n, i + c - OPT_ALLOC_MAX);
+			confirm_record_released(n);
+			++c;
+		}
+		assert_u_eq(
+		    c, OPT_ALLOC_MAX, "Incorrect total number of allocations");
+		free(malloc(NTH_REQ_SIZE(i)));
+	}
+	c = 0;
+	recent_foreach (n) {
+		confirm_record_size(n, c + OPT_ALLOC_MAX);
+		++c;
+	}
+	assert_u_eq(c, OPT_ALLOC_MAX, "Incorrect total number of allocations");
 
 	confirm_prof_setup();
 }
 TEST_END
 
+#undef recent_foreach
+#undef MAX_RECORDS
 #undef NTH_REQ_SIZE
 
 #define DUMP_OUT_SIZE 4096
@@ -693,5 +755,6 @@ int
 main(void) {
 	return test(test_confirm_setup, test_prof_recent_off,
 	    test_prof_recent_on, test_prof_recent_alloc,
-	    test_prof_recent_alloc_dump, test_prof_recent_stress);
+	    test_prof_recent_alloc_threads, test_prof_recent_alloc_dump,
+	    test_prof_recent_stress);
 }
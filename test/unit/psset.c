@@ -40,7 +40,7 @@ test_psset_alloc_new(
 	psset_insert(psset, ps);
 	psset_update_begin(psset, ps);
 
-	void *addr = hpdata_reserve_alloc(ps, size);
+	void *addr = hpdata_reserve_alloc(ps, size, NULL);
 	edata_init(r_edata, edata_arena_ind_get(r_edata), addr, size,
 	    /* slab */ false, SC_NSIZES, /* sn */ 0, extent_state_active,
 	    /* zeroed */ false, /* committed */ true, EXTENT_PAI_HPA,
@@ -56,7 +56,7 @@ test_psset_alloc_reuse(psset_t *psset, edata_t *r_edata, size_t size) {
 		return true;
 	}
 	psset_update_begin(psset, ps);
-	void *addr = hpdata_reserve_alloc(ps, size);
+	void *addr = hpdata_reserve_alloc(ps, size, NULL);
 	edata_init(r_edata, edata_arena_ind_get(r_edata), addr, size,
 	    /* slab */ false, SC_NSIZES, /* sn */ 0, extent_state_active,
 	    /* zeroed */ false, /* committed */ true, EXTENT_PAI_HPA,
@@ -788,14 +788,14 @@ TEST_BEGIN(test_purge_prefers_nonhuge) {
 		hpdata = psset_pick_alloc(&psset, HUGEPAGE * 3 / 4);
 		psset_update_begin(&psset, hpdata);
 		void *ptr;
-		ptr = hpdata_reserve_alloc(hpdata, HUGEPAGE * 3 / 4);
+		ptr = hpdata_reserve_alloc(hpdata, HUGEPAGE * 3 / 4, NULL);
 		/* Ignore the first alloc, which will stick around. */
 		(void)ptr;
 		/*
 		 * The second alloc is to dirty the pages; free it immediately
 		 * after allocating.
 		 */
-		ptr = hpdata_reserve_alloc(hpdata, HUGEPAGE / 4);
+		ptr = hpdata_reserve_alloc(hpdata, HUGEPAGE / 4, NULL);
 		hpdata_unreserve(hpdata, ptr, HUGEPAGE / 4);
 
 		if (huge_begin <= (uintptr_t)hpdata
@@ -860,7 +860,7 @@ TEST_BEGIN(test_purge_timing) {
 	psset_insert(&psset, &hpdata_nonempty);
 
 	psset_update_begin(&psset, &hpdata_empty_nh);
-	ptr = hpdata_reserve_alloc(&hpdata_empty_nh, PAGE);
+	ptr = hpdata_reserve_alloc(&hpdata_empty_nh, PAGE, NULL);
 	expect_ptr_eq(hpdata_addr_get(&hpdata_empty_nh), ptr, "");
 	hpdata_unreserve(&hpdata_empty_nh, ptr, PAGE);
 	hpdata_purge_allowed_set(&hpdata_empty_nh, true);
@@ -869,7 +869,7 @@ TEST_BEGIN(test_purge_timing) {
 	psset_update_end(&psset, &hpdata_empty_nh);
 
 	psset_update_begin(&psset, &hpdata_empty_huge);
-	ptr = hpdata_reserve_alloc(&hpdata_empty_huge, PAGE);
+	ptr = hpdata_reserve_alloc(&hpdata_empty_huge, PAGE, NULL);
 	expect_ptr_eq(hpdata_addr_get(&hpdata_empty_huge), ptr, "");
 	hpdata_unreserve(&hpdata_empty_huge, ptr, PAGE);
 	nstime_init2(&empty_huge_tm, BASE_SEC + 110, 0);
@@ -878,7 +878,7 @@ TEST_BEGIN(test_purge_timing) {
 	psset_update_end(&psset, &hpdata_empty_huge);
 
 	psset_update_begin(&psset, &hpdata_nonempty);
-	ptr = hpdata_reserve_alloc(&hpdata_nonempty, 10 * PAGE);
+	ptr = hpdata_reserve_alloc(&hpdata_nonempty, 10 * PAGE, NULL);
 	expect_ptr_eq(hpdata_addr_get(&hpdata_nonempty), ptr, "");
 	hpdata_unreserve(&hpdata_nonempty, ptr, 9 * PAGE);
 	hpdata_purge_allowed_set(&hpdata_nonempty, true);
@@ -919,14 +919,14 @@ TEST_BEGIN(test_purge_prefers_empty) {
 	psset_insert(&psset, &hpdata_nonempty);
 
 	psset_update_begin(&psset, &hpdata_empty);
-	ptr = hpdata_reserve_alloc(&hpdata_empty, PAGE);
+	ptr = hpdata_reserve_alloc(&hpdata_empty, PAGE, NULL);
 	expect_ptr_eq(hpdata_addr_get(&hpdata_empty), ptr, "");
 	hpdata_unreserve(&hpdata_empty, ptr, PAGE);
 	hpdata_purge_allowed_set(&hpdata_empty, true);
 	psset_update_end(&psset, &hpdata_empty);
 
 	psset_update_begin(&psset, &hpdata_nonempty);
-	ptr = hpdata_reserve_alloc(&hpdata_nonempty, 10 * PAGE);
+	ptr = hpdata_reserve_alloc(&hpdata_nonempty, 10 * PAGE, NULL);
 	expect_ptr_eq(hpdata_addr_get(&hpdata_nonempty), ptr, "");
 	hpdata_unreserve(&hpdata_nonempty, ptr, 9 * PAGE);
 	hpdata_purge_allowed_set(&hpdata_nonempty, true);
@@ -973,7 +973,7 @@ TEST_BEGIN(test_purge_prefers_empty_huge) {
 		 * huge.
 		 */
 		psset_update_begin(&psset, &hpdata_huge[i]);
-		ptr = hpdata_reserve_alloc(&hpdata_huge[i], HUGEPAGE);
+		ptr = hpdata_reserve_alloc(&hpdata_huge[i], HUGEPAGE, NULL);
 		expect_ptr_eq(hpdata_addr_get(&hpdata_huge[i]), ptr, "");
 		hpdata_hugify(&hpdata_huge[i]);
 		hpdata_unreserve(&hpdata_huge[i], ptr, HUGEPAGE);
@@ -985,7 +985,7 @@ TEST_BEGIN(test_purge_prefers_empty_huge) {
 		 * non-huge.
 		 */
 		psset_update_begin(&psset, &hpdata_nonhuge[i]);
-		ptr = hpdata_reserve_alloc(&hpdata_nonhuge[i], HUGEPAGE);
+		ptr = hpdata_reserve_alloc(&hpdata_nonhuge[i], HUGEPAGE, NULL);
 		expect_ptr_eq(hpdata_addr_get(&hpdata_nonhuge[i]), ptr, "");
 		hpdata_unreserve(&hpdata_nonhuge[i], ptr, HUGEPAGE);
 		hpdata_purge_allowed_set(&hpdata_nonhuge[i], true);
@@ -226,6 +226,32 @@ TEST_BEGIN(test_reuse) {
 }
 TEST_END
 
+TEST_BEGIN(test_dirty_reuse_not_zeroed) {
+	pai_test_allocator_t ta;
+	pai_test_allocator_init(&ta);
+	sec_t    sec;
+	tsdn_t  *tsdn = TSDN_NULL;
+	bool     deferred_work_generated = false;
+	test_sec_init(&sec, &ta.pai, /* nshards */ 1, /* max_alloc */ PAGE,
+	    /* max_bytes */ 16 * PAGE);
+
+	edata_t *edata = pai_alloc(tsdn, &sec.pai, PAGE, PAGE,
+	    /* zero */ false, /* guarded */ false, /* frequent_reuse */ false,
+	    &deferred_work_generated);
+	expect_ptr_not_null(edata, "Unexpected alloc failure");
+	/* Like the HPA handing out pages untouched since they were purged. */
+	edata_zeroed_set(edata, true);
+	pai_dalloc(tsdn, &sec.pai, edata, &deferred_work_generated);
+
+	edata_t *reused = pai_alloc(tsdn, &sec.pai, PAGE, PAGE,
+	    /* zero */ false, /* guarded */ false, /* frequent_reuse */ false,
+	    &deferred_work_generated);
+	expect_ptr_eq(edata, reused, "Expected the cached extent");
+	expect_false(edata_zeroed_get(reused),
+	    "Extents recycled by the SEC may have been written to");
+}
+TEST_END
+
 TEST_BEGIN(test_auto_flush) {
 	pai_test_allocator_t ta;
 	pai_test_allocator_init(&ta);
@@ -615,5 +641,5 @@ main(void) {
 	return test(test_reuse, test_auto_flush, test_disable, test_flush,
 	    test_max_alloc_respected, test_expand_shrink_delegate,
 	    test_nshards_0, test_stats_simple, test_stats_auto_flush,
-	    test_stats_manual_flush);
+	    test_stats_manual_flush, test_dirty_reuse_not_zeroed);
 }
@@ -0,0 +1,218 @@
+#include "test/jemalloc_test.h"
+
+const char *malloc_conf = "slab_hugepage_sizes:64-64:2";
+
+#define SZ 64
+#define NREGIONS 2
+
+static unsigned arena_ind;
+
+static size_t
+bin_stat_get(const char *stat) {
+	uint64_t epoch = 1;
+	size_t   v, sz = sizeof(v);
+	char     name[128];
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch, sizeof(epoch)),
+	    0, "Unexpected mallctl() failure");
+	malloc_snprintf(name, sizeof(name), "stats.arenas.%u.bins.%u.%s",
+	    arena_ind, (unsigned)sz_size2index(SZ), stat);
+	expect_d_eq(mallctl(name, (void *)&v, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	return v;
+}
+
+static bool
+ptr_in_hugepage_slab(void *ptr) {
+	edata_t *edata = emap_edata_lookup(
+	    tsdn_fetch(), &arena_emap_global, ptr);
+	return edata_hugepage_slab_get(edata);
+}
+
+TEST_BEGIN(test_slab_hugepage_regions_mallctl) {
+	unsigned nregions;
+	size_t   sz = sizeof(nregions);
+	char     name[64];
+
+	malloc_snprintf(name, sizeof(name), "arenas.bin.%u.hugepage_regions",
+	    (unsigned)sz_size2index(SZ));
+	expect_d_eq(mallctl(name, (void *)&nregions, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u_eq(nregions, NREGIONS, "Option not applied to the class");
+
+	malloc_snprintf(name, sizeof(name), "arenas.bin.%u.hugepage_regions",
+	    (unsigned)sz_size2index(2 * SZ));
+	expect_d_eq(mallctl(name, (void *)&nregions, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u_eq(nregions, 0, "Option applied outside of its range");
+}
+TEST_END
+
+TEST_BEGIN(test_slab_hugepage) {
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	arena_t *arena = arena_get(tsdn_fetch(), arena_ind, false);
+	assert_ptr_not_null(arena, "Unexpected arena_get() failure");
+	test_skip_if(pa_shard_uses_hpa(&arena->pa_shard));
+
+	const bin_info_t *bin_info = &bin_infos[sz_size2index(SZ)];
+	size_t slabs_per_region = HUGEPAGE / bin_info->slab_size;
+	size_t nptrs = NREGIONS * slabs_per_region * bin_info->nregs;
+	int    flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+	void **ptrs = mallocx((nptrs + 1) * sizeof(void *), 0);
+	assert_ptr_not_null(ptrs, "Unexpected mallocx() failure");
+
+	/* The first slab starts a region. */
+	ptrs[0] = mallocx(SZ, flags);
+	assert_ptr_not_null(ptrs[0], "Unexpected mallocx() failure");
+	expect_true(ptr_in_hugepage_slab(ptrs[0]),
+	    "Slab should come from a dedicated region");
+	expect_ptr_eq(HUGEPAGE_ADDR2BASE(ptrs[0]), ptrs[0],
+	    "First slab should be at the start of a hugepage");
+	void *other = mallocx(2 * SZ, flags);
+	assert_ptr_not_null(other, "Unexpected mallocx() failure");
+	expect_false(ptr_in_hugepage_slab(other),
+	    "Unconfigured classes should use ordinary slabs");
+	dallocx(other, flags);
+
+	/* Fill every region; the class then falls back to ordinary slabs. */
+	for (size_t i = 1; i <= nptrs; i++) {
+		ptrs[i] = mallocx(SZ, flags);
+		assert_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+		expect_b_eq(ptr_in_hugepage_slab(ptrs[i]), i < nptrs,
+		    "Unexpected slab placement for allocation %zu", i);
+	}
+	if (config_stats) {
+		expect_zu_eq(bin_stat_get("hugepage_regions"), NREGIONS,
+		    "Unexpected number of regions");
+		expect_zu_eq(bin_stat_get("hugepage_curslabs"),
+		    NREGIONS * slabs_per_region, "Unexpected number of slabs");
+		expect_zu_eq(bin_stat_get("curslabs"),
+		    NREGIONS * slabs_per_region + 1,
+		    "Unexpected number of slabs");
+	}
+
+	/* Emptied slabs stay with the class. */
+	for (size_t i = 0; i < bin_info->nregs; i++) {
+		dallocx(ptrs[i], flags);
+	}
+	if (config_stats) {
+		expect_zu_eq(bin_stat_get("hugepage_curslabs"),
+		    NREGIONS * slabs_per_region - 1,
+		    "Empty slab should have left the bin");
+	}
+	/* Use up the current slab first, then a fresh one is needed. */
+	for (size_t i = 1; i < bin_info->nregs; i++) {
+		void *p = mallocx(SZ, flags);
+		assert_ptr_not_null(p, "Unexpected mallocx() failure");
+		expect_false(ptr_in_hugepage_slab(p),
+		    "Allocation should come from the current slab");
+	}
+	for (size_t i = 0; i < bin_info->nregs; i++) {
+		void *p = mallocx(SZ, flags);
+		assert_ptr_not_null(p, "Unexpected mallocx() failure");
+		expect_true(ptr_in_hugepage_slab(p),
+		    "Emptied slab should have been reused");
+	}
+	if (config_stats) {
+		expect_zu_eq(bin_stat_get("hugepage_curslabs"),
+		    NREGIONS * slabs_per_region, "Slab should have been reused");
+		expect_zu_eq(bin_stat_get("hugepage_regions"), NREGIONS,
+		    "Reuse should not map new regions");
+	}
+
+	/* Resetting the arena gives the regions back. */
+	char name[64];
+	malloc_snprintf(name, sizeof(name), "arena.%u.reset", arena_ind);
+	expect_d_eq(mallctl(name, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	if (config_stats) {
+		expect_zu_eq(bin_stat_get("hugepage_regions"), 0,
+		    "Reset should release the regions");
+		expect_zu_eq(bin_stat_get("hugepage_curslabs"), 0,
+		    "Reset should release the slabs");
+	}
+	void *p = mallocx(SZ, flags);
+	assert_ptr_not_null(p, "Unexpected mallocx() failure");
+	expect_true(ptr_in_hugepage_slab(p),
+	    "Regions should be available again after reset");
+	dallocx(p, flags);
+	dallocx(ptrs, 0);
+
+	malloc_snprintf(name, sizeof(name), "arena.%u.destroy", arena_ind);
+	expect_d_eq(mallctl(name, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+}
+TEST_END
+
+TEST_BEGIN(test_slab_hugepage_purge) {
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	arena_t *arena = arena_get(tsdn_fetch(), arena_ind, false);
+	assert_ptr_not_null(arena, "Unexpected arena_get() failure");
+	test_skip_if(pa_shard_uses_hpa(&arena->pa_shard));
+
+	const bin_info_t *bin_info = &bin_infos[sz_size2index(SZ)];
+	int    flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+	void **ptrs = mallocx(bin_info->nregs * sizeof(void *), 0);
+	assert_ptr_not_null(ptrs, "Unexpected mallocx() failure");
+
+	/* One slab of a region in use, the rest not carved yet. */
+	for (size_t i = 0; i < bin_info->nregs; i++) {
+		ptrs[i] = mallocx(SZ, flags);
+		assert_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+		memset(ptrs[i], 0xa5, SZ);
+	}
+	expect_true(ptr_in_hugepage_slab(ptrs[0]),
+	    "Slab should come from a dedicated region");
+	if (config_stats) {
+		expect_zu_eq(bin_stat_get("hugepage_unused_bytes"),
+		    HUGEPAGE - bin_info->slab_size,
+		    "Uncarved space not counted");
+	}
+
+	/* The emptied slab is kept, and counted as unused. */
+	for (size_t i = 0; i < bin_info->nregs; i++) {
+		dallocx(ptrs[i], flags);
+	}
+	if (config_stats) {
+		expect_zu_eq(bin_stat_get("hugepage_curslabs"), 0,
+		    "Empty slab should have left the bin");
+		expect_zu_eq(bin_stat_get("hugepage_unused_bytes"), HUGEPAGE,
+		    "Empty slab not counted");
+	}
+
+	/* Purging returns its pages, but keeps it for the class. */
+	char name[64];
+	malloc_snprintf(name, sizeof(name), "arena.%u.purge", arena_ind);
+	expect_d_eq(mallctl(name, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	if (pages_can_purge_forced) {
+		expect_u_eq(*(unsigned char *)ptrs[0], 0,
+		    "Empty slab should have been purged");
+	}
+	if (config_stats) {
+		expect_zu_eq(bin_stat_get("hugepage_regions"), 1,
+		    "Purge should keep the region");
+		expect_zu_eq(bin_stat_get("hugepage_unused_bytes"), HUGEPAGE,
+		    "Purge should keep the empty slab");
+	}
+	void *p = mallocx(SZ, flags);
+	assert_ptr_not_null(p, "Unexpected mallocx() failure");
+	expect_true(ptr_in_hugepage_slab(p),
+	    "Purged slab should be reused");
+	dallocx(p, flags);
+	dallocx(ptrs, 0);
+
+	malloc_snprintf(name, sizeof(name), "arena.%u.destroy", arena_ind);
+	expect_d_eq(mallctl(name, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_slab_hugepage_regions_mallctl, test_slab_hugepage,
+	    test_slab_hugepage_purge);
+}
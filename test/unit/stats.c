@@ -5,7 +5,8 @@
 
 TEST_BEGIN(test_stats_summary) {
 	size_t sz, allocated, active, resident, mapped, metadata,
-	    metadata_edata, metadata_rtree;
+	    metadata_edata, metadata_rtree, metadata_reclaimable,
+	    metadata_pinned;
 	int expected = config_stats ? 0 : ENOENT;
 
 	sz = sizeof(size_t);
@@ -27,6 +28,12 @@ TEST_BEGIN(test_stats_summary) {
 	expect_d_eq(mallctl("stats.metadata_rtree", (void *)&metadata_rtree,
 	                &sz, NULL, 0),
 	    expected, "Unexpected mallctl() result");
+	expect_d_eq(mallctl("stats.metadata_reclaimable",
+	                (void *)&metadata_reclaimable, &sz, NULL, 0),
+	    expected, "Unexpected mallctl() result");
+	expect_d_eq(mallctl("stats.metadata_pinned", (void *)&metadata_pinned,
+	                &sz, NULL, 0),
+	    expected, "Unexpected mallctl() result");
 
 	if (config_stats) {
 		expect_zu_le(allocated, active,
@@ -38,6 +45,10 @@ TEST_BEGIN(test_stats_summary) {
 		expect_zu_le(metadata_edata + metadata_rtree, metadata,
 		    "the sum of metadata_edata and metadata_rtree "
 		    "should be no larger than metadata");
+		expect_zu_le(metadata_reclaimable, metadata_edata,
+		    "Only edata metadata can be reclaimable");
+		expect_zu_eq(metadata_reclaimable + metadata_pinned, metadata,
+		    "metadata should split into reclaimable and pinned");
 	}
 }
 TEST_END
@@ -251,6 +262,72 @@ TEST_BEGIN(test_stats_arenas_large) {
 }
 TEST_END
 
+static void
+stats_arena_large_zero_get(
+    unsigned arena_ind, uint64_t *zeroed, uint64_t *skipped) {
+	uint64_t epoch = 1;
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch, sizeof(epoch)),
+	    0, "Unexpected mallctl() failure");
+
+	char   cmd[128];
+	size_t sz = sizeof(uint64_t);
+	sprintf(cmd, "stats.arenas.%u.large.zeroed_bytes", arena_ind);
+	expect_d_eq(mallctl(cmd, (void *)zeroed, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	sprintf(cmd, "stats.arenas.%u.large.zero_skipped_bytes", arena_ind);
+	expect_d_eq(mallctl(cmd, (void *)skipped, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+}
+
+TEST_BEGIN(test_stats_arenas_large_zeroed) {
+	test_skip_if(!config_stats);
+
+	unsigned arena_ind;
+	size_t   sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	int      flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+	size_t   usize = sz_s2u((1U << (SC_LG_LARGE_MINCLASS + 1)) + 1);
+	uint64_t zeroed0, skipped0, zeroed1, skipped1;
+
+	/* Freshly mapped pages of a new arena are known to be zero. */
+	stats_arena_large_zero_get(arena_ind, &zeroed0, &skipped0);
+	void *p = mallocx(usize, flags | MALLOCX_ZERO);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	stats_arena_large_zero_get(arena_ind, &zeroed1, &skipped1);
+	expect_u64_eq(zeroed1, zeroed0, "Fresh pages should not be zeroed");
+	expect_u64_eq(skipped1 - skipped0, usize,
+	    "Fresh pages should be counted as skipped");
+
+	/* Dirty pages reused for a zeroed allocation must be zeroed. */
+	memset(p, 0xa5, usize);
+	dallocx(p, flags);
+	p = mallocx(usize, flags | MALLOCX_ZERO);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	for (size_t i = 0; i < usize; i++) {
+		expect_u_eq(((unsigned char *)p)[i], 0,
+		    "Zeroed allocation not zero at offset %zu", i);
+		if (((unsigned char *)p)[i] != 0) {
+			break;
+		}
+	}
+	stats_arena_large_zero_get(arena_ind, &zeroed0, &skipped0);
+	expect_u64_eq(zeroed0 - zeroed1, usize,
+	    "Reused dirty pages should be counted as zeroed");
+	expect_u64_eq(skipped0, skipped1, "Dirty pages should not be skipped");
+
+	/* Allocations that don't ask for zeroing aren't counted at all. */
+	void *q = mallocx(usize, flags);
+	expect_ptr_not_null(q, "Unexpected mallocx() failure");
+	stats_arena_large_zero_get(arena_ind, &zeroed1, &skipped1);
+	expect_u64_eq(zeroed1, zeroed0, "");
+	expect_u64_eq(skipped1, skipped0, "");
+
+	dallocx(q, flags);
+	dallocx(p, flags);
+}
+TEST_END
+
 static void
 gen_mallctl_str(char *cmd, char *name, unsigned arena_ind) {
 	sprintf(cmd, "stats.arenas.%u.bins.0.%s", arena_ind, name);
@@ -449,7 +526,8 @@ int
 main(void) {
 	return test_no_reentrancy(test_stats_summary, test_stats_large,
 	    test_stats_arenas_summary, test_stats_arenas_small,
-	    test_stats_arenas_large, test_stats_arenas_bins,
+	    test_stats_arenas_large, test_stats_arenas_large_zeroed,
+	    test_stats_arenas_bins,
 	    test_stats_arenas_lextents, test_stats_tcache_bytes_small,
 	    test_stats_tcache_bytes_large);
 }
@@ -0,0 +1,76 @@
+#include "test/jemalloc_test.h"
+
+const char *malloc_conf = "tcache_fill_sort:true";
+
+#define SZ 64
+#define NSLABS 3
+
+TEST_BEGIN(test_tcache_fill_sort) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(!opt_tcache_fill_sort);
+
+	unsigned arena_ind;
+	size_t   sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	expect_d_eq(mallctl("thread.arena", NULL, NULL, (void *)&arena_ind,
+	                sizeof(arena_ind)),
+	    0, "Unexpected mallctl() failure");
+
+	/*
+	 * Free the lowest slab entirely, and every other region of the highest
+	 * one.  A fill then takes the holes in the high slab first, and the rest
+	 * from a fresh slab that reuses the low slab's address.
+	 */
+	szind_t  binind = sz_size2index(SZ);
+	int      flags = MALLOCX_ARENA(arena_ind) | MALLOCX_TCACHE_NONE;
+	unsigned nregs = bin_infos[binind].nregs;
+	size_t   nptrs = NSLABS * nregs;
+	void   **ptrs = mallocx(nptrs * sizeof(void *), 0);
+	expect_ptr_not_null(ptrs, "Unexpected mallocx() failure");
+	for (size_t i = 0; i < nptrs; i++) {
+		ptrs[i] = mallocx(SZ, flags);
+		expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+	}
+	for (size_t i = 0; i < nregs; i++) {
+		dallocx(ptrs[i], flags);
+	}
+	for (size_t i = nptrs - nregs; i < nptrs; i += 2) {
+		dallocx(ptrs[i], flags);
+	}
+
+	expect_d_eq(mallctl("thread.tcache.flush", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	tcache_t    *tcache = tcache_get(tsd_fetch());
+	cache_bin_t *bin = &tcache->bins[binind];
+	void        *p = mallocx(SZ, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	cache_bin_sz_t ncached = cache_bin_ncached_get_local(bin);
+	expect_u_gt(ncached, 0, "Bin should have been filled");
+
+	/* Every allocation served by the fill follows the previous one. */
+	void *prev = p;
+	for (cache_bin_sz_t i = 0; i < ncached; i++) {
+		void *q = mallocx(SZ, 0);
+		expect_ptr_not_null(q, "Unexpected mallocx() failure");
+		expect_true((uintptr_t)q > (uintptr_t)prev,
+		    "Fill should be handed out in address order");
+		dallocx(prev, MALLOCX_TCACHE_NONE);
+		prev = q;
+	}
+	dallocx(prev, MALLOCX_TCACHE_NONE);
+
+	for (size_t i = nregs; i < nptrs - nregs; i++) {
+		dallocx(ptrs[i], flags);
+	}
+	for (size_t i = nptrs - nregs + 1; i < nptrs; i += 2) {
+		dallocx(ptrs[i], flags);
+	}
+	dallocx(ptrs, 0);
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_tcache_fill_sort);
+}
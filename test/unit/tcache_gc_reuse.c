@@ -0,0 +1,90 @@
+#include "test/jemalloc_test.h"
+
+#define TEST_SZ 64
+#define NREUSE 4
+#define NROUNDS 20000
+
+static cache_bin_t *
+test_bin_get(szind_t *szind) {
+	tsd_t    *tsd = tsd_fetch();
+	tcache_t *tcache = tcache_get(tsd);
+	assert_ptr_not_null(tcache, "Unexpected tcache_get() failure");
+	*szind = sz_size2index(TEST_SZ);
+	return &tcache->bins[*szind];
+}
+
+static uint64_t
+nflushes_avoided_read(void) {
+	uint64_t epoch = 1;
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch, sizeof(epoch)),
+	    0, "Unexpected mallctl() failure");
+	uint64_t nflushes_avoided;
+	size_t   sz = sizeof(nflushes_avoided);
+	expect_d_eq(mallctl("stats.arenas." STRINGIFY(
+	                        MALLCTL_ARENAS_ALL) ".tcache_gc_nflushes_avoided",
+	                (void *)&nflushes_avoided, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	return nflushes_avoided;
+}
+
+TEST_BEGIN(test_tcache_gc_reuse) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(!opt_experimental_tcache_gc_reuse);
+
+	szind_t        szind;
+	cache_bin_t   *bin = test_bin_get(&szind);
+	tcache_slow_t *tcache_slow = tsd_tcache_slowp_get(tsd_fetch());
+	cache_bin_sz_t ncached_max = cache_bin_ncached_max_get(bin);
+	expect_u_le(tcache_slow->bin_gc_target[szind], ncached_max,
+	    "Target should never exceed the bin capacity");
+
+	/* Fill the bin up, then only ever reuse a few items at a time. */
+	void **ptrs = mallocx(sizeof(void *) * ncached_max, 0);
+	assert_ptr_not_null(ptrs, "Unexpected mallocx() failure");
+	for (unsigned i = 0; i < ncached_max; i++) {
+		ptrs[i] = mallocx(TEST_SZ, 0);
+		assert_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+	}
+	for (unsigned i = 0; i < ncached_max; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	uint64_t nflushes_avoided = config_stats ? nflushes_avoided_read() : 0;
+	for (unsigned r = 0; r < NROUNDS; r++) {
+		for (unsigned i = 0; i < NREUSE; i++) {
+			ptrs[i] = mallocx(TEST_SZ, 0);
+			assert_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+		}
+		for (unsigned i = 0; i < NREUSE; i++) {
+			dallocx(ptrs[i], 0);
+		}
+	}
+
+	cache_bin_sz_t target = tcache_slow->bin_gc_target[szind];
+	expect_u_le(target, 4 * NREUSE,
+	    "Target should converge towards the reuse depth");
+	expect_u_le(cache_bin_ncached_get_local(bin), 4 * NREUSE,
+	    "Idle items above the target should have been flushed");
+	if (config_stats) {
+		expect_u64_gt(nflushes_avoided_read(), nflushes_avoided,
+		    "Low-water flushes of a bin at its target should be avoided");
+	}
+
+	/* Drain the bin; the refill shouldn't exceed the target. */
+	cache_bin_sz_t ncached = cache_bin_ncached_get_local(bin);
+	for (unsigned i = 0; i <= ncached; i++) {
+		ptrs[i] = mallocx(TEST_SZ, 0);
+		assert_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+	}
+	expect_u_lt(cache_bin_ncached_get_local(bin),
+	    tcache_slow->bin_gc_target[szind], "Refill exceeded the target");
+	for (unsigned i = 0; i <= ncached; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	dallocx(ptrs, 0);
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_tcache_gc_reuse);
+}
@@ -0,0 +1,3 @@
+#!/bin/sh
+
+export MALLOC_CONF="experimental_tcache_gc_reuse:true,experimental_tcache_gc:false,tcache_gc_incr_bytes:1024"
@@ -0,0 +1,263 @@
+#include "test/jemalloc_test.h"
+
+const char *malloc_conf = "tcache_idle_reclaim_ms:10,tcache_gc_incr_bytes:1024";
+
+#define TEST_SZ 64
+#define NITEMS 32
+/* Bound on any wait below, in milliseconds. */
+#define WAIT_MS (10 * 1000)
+
+static atomic_p_t worker_tcache_slow;
+static atomic_b_t worker_resume;
+static atomic_u_t worker_cmd;
+static atomic_u_t worker_ack;
+static mtx_t      worker_gate;
+
+static cache_bin_t *
+test_bin_get(void) {
+	tcache_t *tcache = tcache_get(tsd_fetch());
+	assert_ptr_not_null(tcache, "Unexpected tcache_get() failure");
+	return &tcache->bins[sz_size2index(TEST_SZ)];
+}
+
+static size_t
+test_reclaimed_bytes(void) {
+	size_t reclaimed = 0;
+	size_t sz = sizeof(size_t);
+	if (config_stats) {
+		expect_d_eq(mallctl("stats.tcache_idle_reclaimed_bytes",
+		                (void *)&reclaimed, &sz, NULL, 0),
+		    0, "Unexpected mallctl() failure");
+	}
+	return reclaimed;
+}
+
+static void
+test_fill_bin(void) {
+	void *ptrs[NITEMS];
+	for (unsigned i = 0; i < NITEMS; i++) {
+		ptrs[i] = mallocx(TEST_SZ, 0);
+		expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+	}
+	for (unsigned i = 0; i < NITEMS; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	expect_u_ge(cache_bin_ncached_get_local(test_bin_get()), NITEMS,
+	    "Freed items should be cached");
+}
+
+static tcache_slow_t *
+test_wait_worker(void) {
+	tcache_slow_t *tcache_slow;
+	for (unsigned i = 0; (tcache_slow = atomic_load_p(&worker_tcache_slow,
+	                          ATOMIC_ACQUIRE)) == NULL
+	     && i < WAIT_MS;
+	     i++) {
+		sleep_ns(1000 * 1000);
+	}
+	assert_ptr_not_null(tcache_slow, "Worker thread didn't start");
+	return tcache_slow;
+}
+
+static cache_bin_sz_t
+test_ncached_remote(tcache_slow_t *tcache_slow) {
+	cache_bin_sz_t ncached, nstashed;
+	cache_bin_nitems_get_remote(
+	    &tcache_slow->tcache->bins[sz_size2index(TEST_SZ)], &ncached,
+	    &nstashed);
+	return ncached + nstashed;
+}
+
+static void *
+thd_start_pending(void *arg) {
+	test_fill_bin();
+
+	/* Go idle until the main thread has seen it. */
+	atomic_store_p(&worker_tcache_slow, tsd_tcache_slowp_get(tsd_fetch()),
+	    ATOMIC_RELEASE);
+	for (unsigned i = 0; !atomic_load_b(&worker_resume, ATOMIC_ACQUIRE)
+	     && i < WAIT_MS;
+	     i++) {
+		sleep_ns(1000 * 1000);
+	}
+
+	/* The first GC event after going idle flushes everything. */
+	void *p = mallocx(1024, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	dallocx(p, 0);
+	expect_u_eq(cache_bin_ncached_get_local(test_bin_get()), 0,
+	    "Idle tcache should have been flushed");
+	return NULL;
+}
+
+TEST_BEGIN(test_tcache_idle_reclaim_pending) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(opt_tcache_idle_reclaim_ms < 0);
+	/* Idle tcaches are only left to their owners without membarrier(2). */
+	test_skip_if(tcache_idle_reclaim_remote);
+
+	size_t reclaimed_before = test_reclaimed_bytes();
+	atomic_store_p(&worker_tcache_slow, NULL, ATOMIC_RELAXED);
+	atomic_store_b(&worker_resume, false, ATOMIC_RELAXED);
+	thd_t thd;
+	thd_create(&thd, thd_start_pending, NULL);
+	tcache_slow_t *tcache_slow = test_wait_worker();
+
+	/* Keep scanning until the worker is found idle. */
+	tsdn_t *tsdn = tsdn_fetch();
+	for (unsigned i = 0; i < WAIT_MS && !atomic_load_b(
+	         &tcache_slow->idle_reclaim_pending, ATOMIC_RELAXED);
+	     i++) {
+		tcache_idle_reclaim_scan(tsdn);
+		sleep_ns(1000 * 1000);
+	}
+	expect_true(atomic_load_b(&tcache_slow->idle_reclaim_pending,
+	                ATOMIC_RELAXED),
+	    "Idle tcache was not found");
+
+	atomic_store_b(&worker_resume, true, ATOMIC_RELEASE);
+	thd_join(thd, NULL);
+
+	if (config_stats) {
+		expect_zu_ge(test_reclaimed_bytes() - reclaimed_before,
+		    NITEMS * TEST_SZ, "Reclaimed bytes not accounted");
+	}
+}
+TEST_END
+
+static void *
+thd_start_blocked(void *arg) {
+	test_fill_bin();
+
+	/* Block, without going through the allocator, until let go. */
+	atomic_store_p(&worker_tcache_slow, tsd_tcache_slowp_get(tsd_fetch()),
+	    ATOMIC_RELEASE);
+	mtx_lock(&worker_gate);
+	mtx_unlock(&worker_gate);
+
+	expect_u_eq(cache_bin_ncached_get_local(test_bin_get()), 0,
+	    "Idle tcache should have been flushed while blocked");
+	void *p = mallocx(TEST_SZ, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	dallocx(p, 0);
+	expect_u_gt(cache_bin_ncached_get_local(test_bin_get()), 0,
+	    "Tcache should be usable after a remote flush");
+	return NULL;
+}
+
+TEST_BEGIN(test_tcache_idle_reclaim_blocked) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(opt_tcache_idle_reclaim_ms < 0);
+	test_skip_if(!tcache_idle_reclaim_remote);
+
+	size_t reclaimed_before = test_reclaimed_bytes();
+	atomic_store_p(&worker_tcache_slow, NULL, ATOMIC_RELAXED);
+	expect_false(mtx_init(&worker_gate), "Unexpected mtx_init() failure");
+	mtx_lock(&worker_gate);
+	thd_t thd;
+	thd_create(&thd, thd_start_blocked, NULL);
+	tcache_slow_t *tcache_slow = test_wait_worker();
+	expect_u_ge(test_ncached_remote(tcache_slow), NITEMS,
+	    "Freed items should be cached");
+
+	/* The worker never comes back on its own; the scan has to flush. */
+	tsdn_t *tsdn = tsdn_fetch();
+	for (unsigned i = 0;
+	     i < WAIT_MS && test_ncached_remote(tcache_slow) != 0; i++) {
+		tcache_idle_reclaim_scan(tsdn);
+		sleep_ns(1000 * 1000);
+	}
+	expect_u_eq(test_ncached_remote(tcache_slow), 0,
+	    "Blocked thread's tcache was not flushed");
+	expect_u_eq(atomic_load_u32(&tcache_slow->reclaim_state,
+	                ATOMIC_ACQUIRE),
+	    TCACHE_RECLAIM_NONE, "Remote flush should be over");
+	if (config_stats) {
+		expect_zu_ge(test_reclaimed_bytes() - reclaimed_before,
+		    NITEMS * TEST_SZ, "Reclaimed bytes not accounted");
+	}
+
+	mtx_unlock(&worker_gate);
+	thd_join(thd, NULL);
+	mtx_fini(&worker_gate);
+}
+TEST_END
+
+enum {
+	WORKER_CMD_NONE,
+	WORKER_CMD_ALLOC,
+	WORKER_CMD_EXIT
+};
+
+static void *
+thd_start_active(void *arg) {
+	test_fill_bin();
+	atomic_store_p(&worker_tcache_slow, tsd_tcache_slowp_get(tsd_fetch()),
+	    ATOMIC_RELEASE);
+	unsigned seq = 0;
+	for (unsigned i = 0; i < WAIT_MS; i++) {
+		unsigned cmd = atomic_load_u(&worker_cmd, ATOMIC_ACQUIRE);
+		if (cmd == WORKER_CMD_EXIT) {
+			break;
+		}
+		if (cmd == WORKER_CMD_NONE) {
+			sleep_ns(1000 * 1000);
+			continue;
+		}
+		void *p = mallocx(TEST_SZ, 0);
+		expect_ptr_not_null(p, "Unexpected mallocx() failure");
+		dallocx(p, 0);
+		atomic_store_u(&worker_cmd, WORKER_CMD_NONE, ATOMIC_RELAXED);
+		atomic_store_u(&worker_ack, ++seq, ATOMIC_RELEASE);
+		i = 0;
+	}
+	return NULL;
+}
+
+TEST_BEGIN(test_tcache_idle_reclaim_active) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(opt_tcache_idle_reclaim_ms < 0);
+	test_skip_if(!config_stats);
+
+	size_t reclaimed_before = test_reclaimed_bytes();
+	atomic_store_p(&worker_tcache_slow, NULL, ATOMIC_RELAXED);
+	atomic_store_u(&worker_cmd, WORKER_CMD_NONE, ATOMIC_RELAXED);
+	atomic_store_u(&worker_ack, 0, ATOMIC_RELAXED);
+	thd_t thd;
+	thd_create(&thd, thd_start_active, NULL);
+	test_wait_worker();
+
+	/*
+	 * Scan for several idle periods, with the worker doing a little work
+	 * right before each scan.
+	 */
+	tsdn_t  *tsdn = tsdn_fetch();
+	nstime_t start;
+	nstime_init_update(&start);
+	for (unsigned seq = 1; nstime_ns_since(&start)
+	     < (uint64_t)opt_tcache_idle_reclaim_ms * 5 * 1000 * 1000;
+	     seq++) {
+		atomic_store_u(&worker_cmd, WORKER_CMD_ALLOC, ATOMIC_RELEASE);
+		unsigned i;
+		for (i = 0; i < WAIT_MS
+		     && atomic_load_u(&worker_ack, ATOMIC_ACQUIRE) != seq;
+		     i++) {
+			sleep_ns(1000 * 1000);
+		}
+		assert_u_lt(i, WAIT_MS, "Worker thread stopped responding");
+		tcache_idle_reclaim_scan(tsdn);
+		sleep_ns(2 * 1000 * 1000);
+	}
+	atomic_store_u(&worker_cmd, WORKER_CMD_EXIT, ATOMIC_RELEASE);
+	thd_join(thd, NULL);
+
+	expect_zu_eq(test_reclaimed_bytes(), reclaimed_before,
+	    "Active thread's tcache should not be reclaimed");
+}
+TEST_END
+
+int
+main(void) {
+	return test_no_reentrancy(test_tcache_idle_reclaim_pending,
+	    test_tcache_idle_reclaim_blocked, test_tcache_idle_reclaim_active);
+}
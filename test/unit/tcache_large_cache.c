@@ -0,0 +1,177 @@
+#include "test/jemalloc_test.h"
+
+const char *malloc_conf =
+    "tcache_max:32768,tcache_large_cache_bytes:2097152,"
+    "tcache_large_cache_max:1048576";
+
+static tcache_slow_t *
+test_tcache_slow_get(void) {
+	tcache_t *tcache = tcache_get(tsd_fetch());
+	assert_ptr_not_null(tcache, "Unexpected tcache_get() failure");
+	return tcache->tcache_slow;
+}
+
+static size_t
+test_large_cache_nbytes(tcache_slow_t *tcache_slow) {
+	return atomic_load_zu(&tcache_slow->large_cache_nbytes, ATOMIC_RELAXED);
+}
+
+static void
+thread_tcache_flush(void) {
+	expect_d_eq(mallctl("thread.tcache.flush", NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+}
+
+TEST_BEGIN(test_tcache_large_cache_reuse) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(opt_tcache_large_cache_bytes == 0);
+
+	thread_tcache_flush();
+	tcache_slow_t *tcache_slow = test_tcache_slow_get();
+	size_t         sz = 256 * 1024;
+	void          *p = mallocx(sz, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	memset(p, 0xa5, sz);
+	dallocx(p, 0);
+	expect_u_eq(tcache_slow->large_cache_nitems, 1, "Extent not cached");
+	expect_zu_eq(
+	    test_large_cache_nbytes(tcache_slow), sz, "Wrong cached bytes");
+
+	/* A different size class misses. */
+	void *q = mallocx(2 * sz, 0);
+	expect_ptr_ne(q, p, "Should not reuse an extent of another size");
+	dallocx(q, 0);
+	expect_u_eq(tcache_slow->large_cache_nitems, 2, "Extent not cached");
+
+	/* So does a size sharing its szind, when large size classes are off. */
+	q = mallocx(sz + PAGE, 0);
+	expect_ptr_ne(q, p, "Should not reuse an extent of another size");
+	dallocx(q, 0);
+	expect_u_eq(tcache_slow->large_cache_nitems, 3, "Extent not cached");
+
+	/* Same size hits, and zeroing still happens. */
+	void *r = mallocx(sz, MALLOCX_ZERO);
+	expect_ptr_eq(r, p, "Cached extent should be reused");
+	for (size_t i = 0; i < sz; i++) {
+		expect_zu_eq(((unsigned char *)r)[i], 0, "Memory not zeroed");
+		if (((unsigned char *)r)[i] != 0) {
+			break;
+		}
+	}
+	expect_u_eq(tcache_slow->large_cache_nitems, 2, "Extent not taken");
+	expect_zu_eq(test_large_cache_nbytes(tcache_slow),
+	    2 * sz + sz_s2u(sz + PAGE), "Wrong cached bytes");
+	dallocx(r, 0);
+
+	thread_tcache_flush();
+	expect_u_eq(tcache_slow->large_cache_nitems, 0, "Cache not flushed");
+	expect_zu_eq(
+	    test_large_cache_nbytes(tcache_slow), 0, "Cache not flushed");
+}
+TEST_END
+
+TEST_BEGIN(test_tcache_large_cache_budget) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(opt_tcache_large_cache_bytes == 0);
+
+	thread_tcache_flush();
+	tcache_slow_t *tcache_slow = test_tcache_slow_get();
+	size_t         sz = 512 * 1024;
+	void          *ptrs[8];
+	for (unsigned i = 0; i < 8; i++) {
+		ptrs[i] = mallocx(sz, 0);
+		expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+	}
+	for (unsigned i = 0; i < 8; i++) {
+		dallocx(ptrs[i], 0);
+		expect_zu_le(test_large_cache_nbytes(tcache_slow),
+		    opt_tcache_large_cache_bytes, "Over the byte budget");
+	}
+	unsigned nitems = (unsigned)(opt_tcache_large_cache_bytes / sz);
+	expect_u_eq(tcache_slow->large_cache_nitems, nitems,
+	    "Budget should be filled");
+	/* The oldest ones were dropped; the newest comes back first. */
+	void *p = mallocx(sz, 0);
+	expect_ptr_eq(p, ptrs[7], "Most recently cached should be reused");
+	dallocx(p, 0);
+
+	/* Too many small enough extents run out of slots instead. */
+	thread_tcache_flush();
+	void *small[TCACHE_LARGE_CACHE_NSLOTS + 4];
+	size_t small_sz = 40 * 1024;
+	for (unsigned i = 0; i < TCACHE_LARGE_CACHE_NSLOTS + 4; i++) {
+		small[i] = mallocx(small_sz, 0);
+		expect_ptr_not_null(small[i], "Unexpected mallocx() failure");
+	}
+	for (unsigned i = 0; i < TCACHE_LARGE_CACHE_NSLOTS + 4; i++) {
+		dallocx(small[i], 0);
+	}
+	expect_u_eq(tcache_slow->large_cache_nitems, TCACHE_LARGE_CACHE_NSLOTS,
+	    "Slots should be filled");
+
+	/* Above tcache_large_cache_max isn't cached. */
+	thread_tcache_flush();
+	p = mallocx(2 * opt_tcache_large_cache_max, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	dallocx(p, 0);
+	expect_u_eq(tcache_slow->large_cache_nitems, 0,
+	    "Should not cache above tcache_large_cache_max");
+}
+TEST_END
+
+TEST_BEGIN(test_tcache_large_cache_stats) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(opt_tcache_large_cache_bytes == 0);
+	test_skip_if(!config_stats);
+
+	size_t   sz = 256 * 1024;
+	char     name[64];
+	unsigned arena_ind;
+	size_t   usz = sizeof(arena_ind);
+	expect_d_eq(mallctl("thread.arena", (void *)&arena_ind, &usz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	malloc_snprintf(name, sizeof(name),
+	    "stats.arenas.%u.lextents.%u.nrequests", arena_ind,
+	    (unsigned)(sz_size2index(sz) - SC_NBINS));
+
+	thread_tcache_flush();
+	uint64_t epoch = 1, before, after;
+	usz = sizeof(uint64_t);
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch, sizeof(epoch)),
+	    0, "Unexpected mallctl() failure");
+	expect_d_eq(mallctl(name, (void *)&before, &usz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	for (unsigned i = 0; i < 10; i++) {
+		void *p = mallocx(sz, 0);
+		expect_ptr_not_null(p, "Unexpected mallocx() failure");
+		dallocx(p, 0);
+	}
+	thread_tcache_flush();
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch, sizeof(epoch)),
+	    0, "Unexpected mallctl() failure");
+	expect_d_eq(mallctl(name, (void *)&after, &usz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_u64_eq(after - before, 10, "Cache hits should count as requests");
+
+	/* Cached extents count as tcache bytes of the arena. */
+	void *p = mallocx(sz, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	dallocx(p, 0);
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch, sizeof(epoch)),
+	    0, "Unexpected mallctl() failure");
+	malloc_snprintf(
+	    name, sizeof(name), "stats.arenas.%u.tcache_bytes", arena_ind);
+	size_t tcache_bytes;
+	usz = sizeof(tcache_bytes);
+	expect_d_eq(mallctl(name, (void *)&tcache_bytes, &usz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_zu_ge(tcache_bytes, sz, "Large cache not counted");
+	thread_tcache_flush();
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_tcache_large_cache_reuse,
+	    test_tcache_large_cache_budget, test_tcache_large_cache_stats);
+}
@@ -0,0 +1,99 @@
+#include "test/jemalloc_test.h"
+
+const char *malloc_conf =
+    "tcache_ncached_max_learn_ms:200,tcache_gc_incr_bytes:1024";
+
+#define TEST_SZ 64
+
+static size_t
+ncached_max_read(size_t bin_size) {
+	size_t ncached_max;
+	size_t sz = sizeof(ncached_max);
+	expect_d_eq(mallctl("thread.tcache.ncached_max.read_sizeclass",
+	                (void *)&ncached_max, &sz, (void *)&bin_size,
+	                sizeof(bin_size)),
+	    0, "Unexpected mallctl() failure");
+	return ncached_max;
+}
+
+static int
+learned_read(const char **settings) {
+	size_t sz = sizeof(*settings);
+	return mallctl("tcache.ncached_max_learned", (void *)settings, &sz,
+	    NULL, 0);
+}
+
+/* Overflows and refills the TEST_SZ bin over and over. */
+static void
+bin_churn(size_t nitems) {
+	void **ptrs = mallocx(nitems * sizeof(void *), 0);
+	assert_ptr_not_null(ptrs, "Unexpected mallocx() failure");
+	for (unsigned n = 0; n < 32; n++) {
+		for (size_t i = 0; i < nitems; i++) {
+			ptrs[i] = mallocx(TEST_SZ, 0);
+			expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+		}
+		for (size_t i = 0; i < nitems; i++) {
+			dallocx(ptrs[i], 0);
+		}
+	}
+	dallocx(ptrs, 0);
+}
+
+/* The capacity tcaches got before learning finished. */
+static size_t ncached_max_default;
+
+static void *
+thd_start(void *arg) {
+	*(size_t *)arg = ncached_max_read(TEST_SZ);
+	return NULL;
+}
+
+TEST_BEGIN(test_tcache_ncached_max_learn) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(opt_tcache_ncached_max_learn_ms < 0);
+
+	const char *settings;
+	if (learned_read(&settings) == EAGAIN) {
+		ncached_max_default = ncached_max_read(TEST_SZ);
+		bin_churn(2 * ncached_max_default);
+		/* Past the window, the next GC event publishes the result. */
+		nstime_t start, now;
+		nstime_init_update(&start);
+		do {
+			sleep_ns(10 * 1000 * 1000);
+			void *p = mallocx(4096, 0);
+			expect_ptr_not_null(p, "Unexpected mallocx() failure");
+			dallocx(p, 0);
+			nstime_init_update(&now);
+		} while (learned_read(&settings) == EAGAIN
+		    && nstime_ns(&now) - nstime_ns(&start)
+		        < UINT64_C(10) * 1000 * 1000 * 1000);
+		expect_zu_eq(ncached_max_read(TEST_SZ), ncached_max_default,
+		    "Existing tcache should be left alone");
+	}
+	expect_d_eq(learned_read(&settings), 0, "Learning never finished");
+	expect_ptr_not_null(settings, "Unexpected learned settings");
+
+	/* New tcaches get the learned capacity. */
+	size_t ncached_max_learned;
+	thd_t  thd;
+	thd_create(&thd, thd_start, (void *)&ncached_max_learned);
+	thd_join(thd, NULL);
+	expect_zu_gt(ncached_max_learned, ncached_max_default,
+	    "Busy bin should have grown");
+
+	/* The settings are in the opt.tcache_ncached_max format. */
+	char *inputp = (char *)settings;
+	expect_d_eq(mallctl("thread.tcache.ncached_max.write", NULL, NULL,
+	                (void *)&inputp, sizeof(char *)),
+	    0, "Learned settings should be accepted");
+	expect_zu_eq(ncached_max_read(TEST_SZ), ncached_max_learned,
+	    "Learned settings should round trip");
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_tcache_ncached_max_learn);
+}
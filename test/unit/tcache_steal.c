@@ -0,0 +1,237 @@
+#include "test/jemalloc_test.h"
+
+const char *malloc_conf = "tcache_steal:true";
+
+#define SZ 64
+#define NPTRS_MAX 4096
+
+static unsigned   arena_ind;
+static void      *ptrs[NPTRS_MAX];
+static mtx_t      holder_mtx;
+static atomic_b_t holder_bound;
+static thd_t      holder_thd;
+
+static void
+thread_arena_bind(void) {
+	expect_d_eq(mallctl("thread.arena", NULL, NULL, (void *)&arena_ind,
+	                sizeof(arena_ind)),
+	    0, "Unexpected mallctl() failure");
+}
+
+/*
+ * Arenas drain their handoff slots once no thread is bound to them anymore;
+ * keep a thread bound while the producers and consumers come and go.
+ */
+static void *
+holder_start(void *arg) {
+	thread_arena_bind();
+	atomic_store_b(&holder_bound, true, ATOMIC_RELEASE);
+	mtx_lock(&holder_mtx);
+	mtx_unlock(&holder_mtx);
+	return NULL;
+}
+
+static void
+holder_begin(void) {
+	expect_false(mtx_init(&holder_mtx), "Unexpected mtx_init() failure");
+	mtx_lock(&holder_mtx);
+	atomic_store_b(&holder_bound, false, ATOMIC_RELAXED);
+	thd_create(&holder_thd, holder_start, NULL);
+	for (unsigned i = 0;
+	     !atomic_load_b(&holder_bound, ATOMIC_ACQUIRE) && i < 10 * 1000;
+	     i++) {
+		sleep_ns(1000 * 1000);
+	}
+	assert_true(atomic_load_b(&holder_bound, ATOMIC_ACQUIRE),
+	    "Holder thread didn't start");
+}
+
+static void
+holder_end(void) {
+	mtx_unlock(&holder_mtx);
+	thd_join(holder_thd, NULL);
+	mtx_fini(&holder_mtx);
+}
+
+static atomic_p_t *
+handoff_get(void) {
+	arena_t *arena = arena_get(tsdn_fetch(), arena_ind, false);
+	assert_ptr_not_null(arena, "Unexpected arena_get() failure");
+	return &arena->tcache_handoff[sz_size2index(SZ)];
+}
+
+static uint64_t
+arena_stat_get(const char *stat) {
+	uint64_t epoch = 1, v;
+	size_t   sz = sizeof(v);
+	char     name[128];
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch, sizeof(epoch)),
+	    0, "Unexpected mallctl() failure");
+	malloc_snprintf(
+	    name, sizeof(name), "stats.arenas.%u.%s", arena_ind, stat);
+	expect_d_eq(mallctl(name, (void *)&v, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	return v;
+}
+
+static void *
+producer_start(void *arg) {
+	thread_arena_bind();
+	tcache_t *tcache = tcache_get(tsd_fetch());
+	assert_ptr_not_null(tcache, "Unexpected tcache_get() failure");
+	unsigned nptrs = 2 * cache_bin_ncached_max_get(
+	    &tcache->bins[sz_size2index(SZ)]);
+	assert_u_le(nptrs, NPTRS_MAX, "Too many items for the test");
+	for (unsigned i = 0; i < nptrs; i++) {
+		ptrs[i] = mallocx(SZ, 0);
+		expect_ptr_not_null(ptrs[i], "Unexpected mallocx() failure");
+	}
+	for (unsigned i = 0; i < nptrs; i++) {
+		dallocx(ptrs[i], 0);
+	}
+	return NULL;
+}
+
+static void *
+consumer_start(void *arg) {
+	thread_arena_bind();
+	void *p = mallocx(SZ, 0);
+	expect_ptr_not_null(p, "Unexpected mallocx() failure");
+	*(void **)arg = p;
+	return NULL;
+}
+
+TEST_BEGIN(test_tcache_steal) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(!opt_tcache_steal);
+
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	atomic_p_t *handoff = handoff_get();
+	expect_ptr_null(atomic_load_p(handoff, ATOMIC_ACQUIRE),
+	    "Handoff slot should start out empty");
+	holder_begin();
+
+	/* An overflowing bin hands its oldest items off. */
+	thd_t thd;
+	thd_create(&thd, producer_start, NULL);
+	thd_join(thd, NULL);
+	void *head = atomic_load_p(handoff, ATOMIC_ACQUIRE);
+	expect_ptr_not_null(head, "Overflow should have been handed off");
+	uint64_t attempts = config_stats
+	    ? arena_stat_get("tcache_steal_attempts") : 0;
+	uint64_t successes = config_stats
+	    ? arena_stat_get("tcache_steal_successes") : 0;
+
+	/* The next thread to miss in that bin takes them. */
+	void *p;
+	thd_create(&thd, consumer_start, (void *)&p);
+	thd_join(thd, NULL);
+	expect_ptr_ne(atomic_load_p(handoff, ATOMIC_ACQUIRE), head,
+	    "Handed off items should have been taken");
+	if (config_stats) {
+		expect_u64_eq(arena_stat_get("tcache_steal_attempts"),
+		    attempts + 1, "Refill should consult the handoff slot");
+		expect_u64_eq(arena_stat_get("tcache_steal_successes"),
+		    successes + 1, "Refill should have stolen");
+	}
+	dallocx(p, MALLOCX_TCACHE_NONE);
+
+	/* Resetting the arena returns whatever is still handed off. */
+	char name[64];
+	malloc_snprintf(name, sizeof(name), "arena.%u.reset", arena_ind);
+	expect_d_eq(mallctl(name, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	expect_ptr_null(atomic_load_p(handoff, ATOMIC_ACQUIRE),
+	    "Reset should drain the handoff slot");
+	holder_end();
+}
+TEST_END
+
+static void
+arena_ctl(const char *cmd) {
+	char name[64];
+	malloc_snprintf(name, sizeof(name), "arena.%u.%s", arena_ind, cmd);
+	expect_d_eq(mallctl(name, NULL, NULL, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+}
+
+static size_t
+tcache_bytes_get(void) {
+	uint64_t epoch = 1;
+	size_t   v, sz = sizeof(v);
+	char     name[128];
+	expect_d_eq(mallctl("epoch", NULL, NULL, (void *)&epoch, sizeof(epoch)),
+	    0, "Unexpected mallctl() failure");
+	malloc_snprintf(
+	    name, sizeof(name), "stats.arenas.%u.tcache_bytes", arena_ind);
+	expect_d_eq(mallctl(name, (void *)&v, &sz, NULL, 0), 0,
+	    "Unexpected mallctl() failure");
+	return v;
+}
+
+TEST_BEGIN(test_tcache_steal_drain) {
+	test_skip_if(!opt_tcache);
+	test_skip_if(!opt_tcache_steal);
+
+	size_t sz = sizeof(arena_ind);
+	expect_d_eq(mallctl("arenas.create", (void *)&arena_ind, &sz, NULL, 0),
+	    0, "Unexpected mallctl() failure");
+	atomic_p_t *handoff = handoff_get();
+	holder_begin();
+
+	/* The producer's tcache is gone; only the handoff slot is left. */
+	thd_t thd;
+	thd_create(&thd, producer_start, NULL);
+	thd_join(thd, NULL);
+	expect_ptr_not_null(atomic_load_p(handoff, ATOMIC_ACQUIRE),
+	    "Overflow should have been handed off");
+	if (config_stats) {
+		expect_zu_gt(tcache_bytes_get(), 0,
+		    "Handed off items should count as tcache bytes");
+	}
+
+	/*
+	 * A batch nobody takes is freed by the second decay tick after it was
+	 * published (the producer's exit may have been the first).
+	 */
+	arena_ctl("decay");
+	arena_ctl("decay");
+	expect_ptr_null(atomic_load_p(handoff, ATOMIC_ACQUIRE),
+	    "A stale batch should have been drained");
+	if (config_stats) {
+		expect_zu_eq(tcache_bytes_get(), 0,
+		    "Drained items should not count as tcache bytes");
+	}
+
+	/* Purging drains right away. */
+	thd_create(&thd, producer_start, NULL);
+	thd_join(thd, NULL);
+	expect_ptr_not_null(atomic_load_p(handoff, ATOMIC_ACQUIRE),
+	    "Overflow should have been handed off");
+	arena_ctl("purge");
+	expect_ptr_null(atomic_load_p(handoff, ATOMIC_ACQUIRE),
+	    "Purge should drain the handoff slot");
+	if (config_stats) {
+		expect_zu_eq(tcache_bytes_get(), 0,
+		    "Drained items should not count as tcache bytes");
+	}
+
+	/* So does the last thread leaving the arena. */
+	thd_create(&thd, producer_start, NULL);
+	thd_join(thd, NULL);
+	expect_ptr_not_null(atomic_load_p(handoff, ATOMIC_ACQUIRE),
+	    "Overflow should have been handed off");
+	holder_end();
+	if (!background_thread_enabled()) {
+		expect_ptr_null(atomic_load_p(handoff, ATOMIC_ACQUIRE),
+		    "An idle arena should drain its handoff slot");
+	}
+}
+TEST_END
+
+int
+main(void) {
+	return test(test_tcache_steal, test_tcache_steal_drain);
+}